@@ -13,6 +13,8 @@
 #include "freertos/event_groups.h"
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
 #include "nvs_flash.h"
 #include "nimble/nimble_port.h"
 #include "nimble/nimble_port_freertos.h"
@@ -21,6 +23,7 @@
 #include "host/util/util.h"
 #include "driver/gpio.h"
 
+#include "app_ble.h"
 #include "app_gpio.h"
 #include "app_config.h"
 
@@ -29,11 +32,288 @@
  */
 static const char* TAG = "app_ble";
 
+/**
+ * @brief NVS 中保存钥匙列表。
+ */
+#define APP_BLE_NVS_NAMESPACE   "app_ble"
+#define APP_BLE_NVS_KEYS_KEY    "keys"
+
+/**
+ * @brief 哈希表大小，2 的幂，不小于钥匙数的 2 倍，线性探测。
+ */
+#define APP_BLE_HASH_SIZE       16
+
 /**
  * @brief 蓝牙钥匙最后刷新时间。
  */
 _Atomic int app_ble_disc_ts = ATOMIC_VAR_INIT(-3600000);// 提前一小时的毫秒值，不管以后怎么改参数也应该够用了。
 
+/**
+ * @brief 每把钥匙的状态。
+ */
+typedef struct {
+    ble_addr_t addr;
+    int32_t rssi_x16;               // 平滑 RSSI * 16。
+    uint8_t seen_count;             // 离开状态下收到的广播次数。
+    bool present;
+    uint32_t last_ms;               // 最后收到广播的时间。
+} app_ble_key_state_t;
+
+/**
+ * @brief 钥匙列表和状态，BLE 任务、定时器任务、命令任务中使用。
+ */
+static app_ble_key_state_t app_ble_keys[APP_BLE_KEY_MAX];
+static int app_ble_key_count = 0;
+static int app_ble_present_count = 0;
+static pthread_mutex_t app_ble_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 地址哈希表，保存钥匙下标，-1 = 空。
+ */
+static int8_t app_ble_hash[APP_BLE_HASH_SIZE];
+
+/**
+ * @brief 每把钥匙的离开定时器，收到广播时重新开始。参数是钥匙下标。
+ */
+static esp_timer_handle_t app_ble_leave_timers[APP_BLE_KEY_MAX];
+
+/**
+ * @brief 事件回调。
+ */
+static app_ble_event_cb_t app_ble_event_cb = NULL;
+
+/**
+ * @brief 扫描调度任务句柄，只有这个任务调用 NimBLE 的扫描函数。
+ */
+static TaskHandle_t app_ble_scan_task_handle = NULL;
+
+/**
+ * @brief 协议栈已同步；需要重新设置白名单。
+ */
+static _Atomic bool app_ble_synced = ATOMIC_VAR_INIT(false);
+static _Atomic bool app_ble_restart = ATOMIC_VAR_INIT(false);
+
+/**
+ * @brief 最后一次状态变化或者修改钥匙列表的时间，之后 APP_BLE_SCAN_FAST_HOLD_MS 内快速扫描。以下变量使用 app_ble_mutex。
+ */
+static uint32_t app_ble_change_ms = 0;
+
+/**
+ * @brief 积压数据上传：开始时间（0 = 没有上传），最后一次实际传输数据的时间。
+ */
+static uint32_t app_ble_yield_begin_ms = 0;
+static uint32_t app_ble_yield_transfer_ms = 0;
+static bool app_ble_yield_transferred = false;
+
+/**
+ * @brief 射频时间统计。
+ */
+static app_ble_radio_t app_ble_radio;
+
+/**
+ * @brief 唤醒扫描调度任务。
+ */
+static void app_ble_scan_wakeup(void) {
+    if (app_ble_scan_task_handle != NULL) {
+        xTaskNotifyGive(app_ble_scan_task_handle);
+    }
+}
+
+/**
+ * @brief 地址哈希，FNV-1a。
+ */
+static uint32_t app_ble_addr_hash(const ble_addr_t* addr) {
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ addr->type) * 16777619u;
+    for (int i = 0; i < 6; i++) {
+        hash = (hash ^ addr->val[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief 按地址查找钥匙，调用前必须持有互斥锁。
+ * @return 下标，没有返回 -1。
+ */
+static int app_ble_key_find_locked(const ble_addr_t* addr) {
+    uint32_t pos = app_ble_addr_hash(addr) & (APP_BLE_HASH_SIZE - 1);
+    for (int i = 0; i < APP_BLE_HASH_SIZE; i++) {
+        int index = app_ble_hash[pos];
+        if (index < 0) {
+            return -1;
+        }
+        if (ble_addr_cmp(&app_ble_keys[index].addr, addr) == 0) {
+            return index;
+        }
+        pos = (pos + 1) & (APP_BLE_HASH_SIZE - 1);
+    }
+    return -1;
+}
+
+/**
+ * @brief 重建哈希表，清除所有钥匙的状态，调用前必须持有互斥锁。
+ */
+static void app_ble_hash_build_locked(void) {
+    memset(app_ble_hash, -1, sizeof(app_ble_hash));
+    for (int i = 0; i < app_ble_key_count; i++) {
+        uint32_t pos = app_ble_addr_hash(&app_ble_keys[i].addr) & (APP_BLE_HASH_SIZE - 1);
+        while (app_ble_hash[pos] >= 0) {
+            pos = (pos + 1) & (APP_BLE_HASH_SIZE - 1);
+        }
+        app_ble_hash[pos] = i;
+        app_ble_keys[i].present = false;
+        app_ble_keys[i].seen_count = 0;
+        app_ble_keys[i].last_ms = 0;
+    }
+    app_ble_present_count = 0;
+    app_ble_change_ms = esp_log_timestamp();
+}
+
+/**
+ * @brief 读取钥匙列表，调用前必须持有互斥锁。NVS 中没有时使用 APP_BLE_WHITE_LIST，忽略全 0 的地址。
+ */
+static void app_ble_keys_load_locked(void) {
+    app_ble_key_t keys[APP_BLE_KEY_MAX];
+    int count = 0;
+    nvs_handle_t handle;
+    size_t size = sizeof(keys);
+    if (nvs_open(APP_BLE_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        if (nvs_get_blob(handle, APP_BLE_NVS_KEYS_KEY, keys, &size) == ESP_OK && size % sizeof(app_ble_key_t) == 0) {
+            count = size / sizeof(app_ble_key_t);
+        }
+        nvs_close(handle);
+    }
+    if (count == 0) {
+        static const uint8_t zero[6] = {0};
+        ble_addr_t white_list[] = APP_BLE_WHITE_LIST;
+        for (int i = 0; i < sizeof(white_list) / sizeof(ble_addr_t) && count < APP_BLE_KEY_MAX; i++) {
+            if (memcmp(white_list[i].val, zero, 6) != 0) {
+                keys[count].type = white_list[i].type;
+                memcpy(keys[count].val, white_list[i].val, 6);
+                count++;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        app_ble_keys[i].addr.type = keys[i].type;
+        memcpy(app_ble_keys[i].addr.val, keys[i].val, 6);
+    }
+    app_ble_key_count = count;
+    app_ble_hash_build_locked();
+    ESP_LOGI(TAG, "------ 蓝牙钥匙：%d 把。", app_ble_key_count);
+}
+
+/**
+ * @brief 钥匙状态变化，调用前必须持有互斥锁，事件写入 event，释放锁之后调用 app_ble_emit()。
+ */
+static void app_ble_transition_locked(int index, bool present, app_ble_event_t* event) {
+    app_ble_key_state_t* key = &app_ble_keys[index];
+    key->present = present;
+    key->seen_count = 0;
+    app_ble_present_count += present ? 1 : -1;
+    event->key.type = key->addr.type;
+    memcpy(event->key.val, key->addr.val, 6);
+    event->present = present;
+    event->rssi = (int8_t)(key->rssi_x16 / 16);
+    event->present_count = app_ble_present_count;
+    app_ble_change_ms = esp_log_timestamp();
+}
+
+/**
+ * @brief 输出事件，设置蓝牙接近开关的 GPIO，调用回调。
+ */
+static void app_ble_emit(const app_ble_event_t* event) {
+    ESP_LOGI(TAG, "------ 蓝牙钥匙%s：%02x:%02x:%02x:%02x:%02x:%02x，RSSI：%d，在场：%d 把。", event->present ? "进入" : "离开",
+        event->key.val[5], event->key.val[4], event->key.val[3], event->key.val[2], event->key.val[1], event->key.val[0],
+        event->rssi, event->present_count);
+    if (app_gpio_set_level(APP_GPIO_NUM_BLE, event->present_count > 0 ? 1 : 0)) {
+        ESP_LOGI(TAG, "------ 蓝牙接近开关: %s。", event->present_count > 0 ? "开启" : "关闭");
+    }
+    app_ble_event_cb_t cb = app_ble_event_cb;
+    if (cb != NULL) {
+        cb(event);
+    }
+}
+
+/**
+ * @brief 收到钥匙的广播，更新平滑 RSSI，判断进入或者离开。
+ * @param addr
+ * @param rssi
+ */
+static void app_ble_on_adv(const ble_addr_t* addr, int8_t rssi) {
+    app_ble_event_t event;
+    bool emit = false;
+    bool wakeup = false;
+    uint32_t now_ms = esp_log_timestamp();
+    pthread_mutex_lock(&app_ble_mutex);
+    int index = app_ble_key_find_locked(addr);
+    if (index < 0) {
+        pthread_mutex_unlock(&app_ble_mutex);
+        return;
+    }
+    app_ble_key_state_t* key = &app_ble_keys[index];
+    if (key->last_ms == 0 || now_ms - key->last_ms > APP_BLE_LEAVE_TIMEOUT * 1000) {// 第一次或者很久没有收到，直接使用本次的值。
+        key->rssi_x16 = rssi * 16;
+    } else {
+        key->rssi_x16 += (rssi * 16 - key->rssi_x16) >> APP_BLE_RSSI_SHIFT;
+    }
+    key->last_ms = now_ms;
+    int smooth = key->rssi_x16 / 16;
+    if (!key->present) {
+        if (smooth >= APP_BLE_ENTER_RSSI && ++key->seen_count >= APP_BLE_ENTER_COUNT) {
+            app_ble_transition_locked(index, true, &event);
+            emit = true;
+        } else if (key->seen_count == 1) {
+            wakeup = true;// 状态不确定，立即改为快速扫描。
+        }
+    } else if (smooth < APP_BLE_LEAVE_RSSI) {
+        app_ble_transition_locked(index, false, &event);
+        emit = true;
+    }
+    esp_timer_stop(app_ble_leave_timers[index]);
+    esp_timer_start_once(app_ble_leave_timers[index], (uint64_t)APP_BLE_LEAVE_TIMEOUT * 1000000);
+    pthread_mutex_unlock(&app_ble_mutex);
+
+    atomic_store(&app_ble_disc_ts, now_ms);// 更新最后扫描到的时间。
+    if (emit) {
+        app_ble_emit(&event);
+    }
+    if (emit || wakeup) {
+        app_ble_scan_wakeup();
+    }
+}
+
+/**
+ * @brief 离开定时器，APP_BLE_LEAVE_TIMEOUT 秒没有收到广播。
+ *        定时器到期时可能正好收到广播：回调等待锁期间，广播已经更新 last_ms 并重新启动了定时器，
+ *        所以在锁内重新检查 last_ms，最近收到过广播时不是离开。
+ * @param arg 钥匙下标。
+ */
+static void app_ble_leave_cb(void* arg) {
+    int index = (int)(intptr_t)arg;
+    app_ble_event_t event;
+    bool emit = false;
+    uint32_t now_ms = esp_log_timestamp();
+    pthread_mutex_lock(&app_ble_mutex);
+    if (index < app_ble_key_count) {
+        if (app_ble_keys[index].last_ms != 0 && now_ms - app_ble_keys[index].last_ms < APP_BLE_LEAVE_TIMEOUT * 500) {
+            pthread_mutex_unlock(&app_ble_mutex);// 定时器已经由广播重新启动。
+            return;
+        }
+        if (app_ble_keys[index].present) {
+            app_ble_transition_locked(index, false, &event);
+            emit = true;
+        } else {
+            app_ble_keys[index].seen_count = 0;// 没有进入，重新计数。
+        }
+    }
+    pthread_mutex_unlock(&app_ble_mutex);
+    if (emit) {
+        app_ble_emit(&event);
+    }
+    app_ble_scan_wakeup();
+}
+
 /**
  * @brief 发现设备后的事件。
  * @param event
@@ -43,10 +323,7 @@ _Atomic int app_ble_disc_ts = ATOMIC_VAR_INIT(-3600000);// 提前一小时的毫
 static int app_ble_gap_event(struct ble_gap_event* event, void* arg) {
     switch (event->type) {
         case BLE_GAP_EVENT_DISC:
-            // ESP_LOGI(TAG, "------ BLE Address: %02x:%02x:%02x:%02x:%02x:%02x",
-            //     event->disc.addr.val[0], event->disc.addr.val[1], event->disc.addr.val[2],
-            //     event->disc.addr.val[3], event->disc.addr.val[4], event->disc.addr.val[5]);
-            atomic_store(&app_ble_disc_ts, esp_log_timestamp());// 更新最后扫描到的时间。
+            app_ble_on_adv(&event->disc.addr, event->disc.rssi);
             break;
         default:
             break;
@@ -55,56 +332,240 @@ static int app_ble_gap_event(struct ble_gap_event* event, void* arg) {
 }
 
 /**
- * @brief 启动发现任务。
- * @param
+ * @brief 扫描参数，与 app_ble_scan_mode_t 对应。
+ */
+static const uint16_t app_ble_scan_itvl_ms[APP_BLE_SCAN_MODE_COUNT] = {APP_BLE_SCAN_FAST_ITVL_MS, APP_BLE_SCAN_SLOW_ITVL_MS, APP_BLE_SCAN_YIELD_ITVL_MS};
+static const uint16_t app_ble_scan_win_ms[APP_BLE_SCAN_MODE_COUNT] = {APP_BLE_SCAN_FAST_WIN_MS, APP_BLE_SCAN_SLOW_WIN_MS, APP_BLE_SCAN_YIELD_WIN_MS};
+static const char* app_ble_scan_mode_names[APP_BLE_SCAN_MODE_COUNT] = {"快速", "慢速", "让出"};
+
+/**
+ * @brief 积压数据开始上传。
+ */
+void app_ble_yield_begin(void) {
+    pthread_mutex_lock(&app_ble_mutex);
+    app_ble_yield_begin_ms = esp_log_timestamp() | 1;// 不等于 0。
+    pthread_mutex_unlock(&app_ble_mutex);
+}
+
+/**
+ * @brief 积压数据上传结束。
+ * @param transferred
+ */
+void app_ble_yield_end(bool transferred) {
+    pthread_mutex_lock(&app_ble_mutex);
+    app_ble_yield_begin_ms = 0;
+    if (transferred) {
+        app_ble_yield_transfer_ms = esp_log_timestamp();
+        app_ble_yield_transferred = true;
+    }
+    pthread_mutex_unlock(&app_ble_mutex);
+}
+
+/**
+ * @brief 选择扫描模式，调用前必须持有互斥锁。
+ *        钥匙状态不确定（刚变化、离开状态下收到过广播、在场但是很久没有收到广播）时快速扫描；
+ *        状态稳定时慢速扫描，正在上传积压数据时让出。状态不确定时即使在上传也不低于慢速，保证离开检测不误判。
+ * @param now_ms
+ * @return
  */
-void app_ble_gap_discovery(void) {
+static app_ble_scan_mode_t app_ble_scan_select_locked(uint32_t now_ms) {
+    bool uncertain = now_ms - app_ble_change_ms < APP_BLE_SCAN_FAST_HOLD_MS;
+    for (int i = 0; i < app_ble_key_count && !uncertain; i++) {
+        const app_ble_key_state_t* key = &app_ble_keys[i];
+        uncertain = key->present ? now_ms - key->last_ms > APP_BLE_LEAVE_TIMEOUT * 500 : key->seen_count > 0;
+    }
+    bool yield = (app_ble_yield_begin_ms != 0 && now_ms - app_ble_yield_begin_ms >= APP_BLE_SCAN_CHECK_MS) ||
+        (app_ble_yield_transferred && now_ms - app_ble_yield_transfer_ms < APP_BLE_SCAN_YIELD_HOLD_MS);
+    if (uncertain) {
+        return yield ? APP_BLE_SCAN_SLOW : APP_BLE_SCAN_FAST;
+    }
+    return yield ? APP_BLE_SCAN_YIELD : APP_BLE_SCAN_SLOW;
+}
 
-    ble_addr_t white_list[] = APP_BLE_WHITE_LIST;
-    int white_list_count = (sizeof(white_list) / sizeof(ble_addr_t));
+/**
+ * @brief 开始扫描，只在扫描调度任务中调用。
+ * @param mode
+ * @return
+ */
+static int app_ble_scan_start(app_ble_scan_mode_t mode) {
+    if (ble_gap_disc_active()) {
+        ble_gap_disc_cancel();// 白名单和扫描参数只能在停止扫描时修改。
+    }
+
+    ble_addr_t white_list[APP_BLE_KEY_MAX];
+    pthread_mutex_lock(&app_ble_mutex);
+    int white_list_count = app_ble_key_count;
+    for (int i = 0; i < white_list_count; i++) {
+        white_list[i] = app_ble_keys[i].addr;
+    }
+    pthread_mutex_unlock(&app_ble_mutex);
+    if (white_list_count == 0) {
+        return 0;// 没有钥匙，不扫描。
+    }
     ble_gap_wl_set(white_list, white_list_count);// 设置白名单。
 
     struct ble_gap_disc_params disc_params;
-    disc_params.itvl = BLE_GAP_SCAN_ITVL_MS(400);// 400 毫秒中的 100 毫秒用来扫描。
-    disc_params.window = BLE_GAP_SCAN_WIN_MS(100);// 我的蓝色蓝牙钥匙，平均每 0.5 秒发射一次广播。
+    disc_params.itvl = BLE_GAP_SCAN_ITVL_MS(app_ble_scan_itvl_ms[mode]);
+    disc_params.window = BLE_GAP_SCAN_WIN_MS(app_ble_scan_win_ms[mode]);// 我的蓝色蓝牙钥匙，平均每 0.5 秒发射一次广播。
     disc_params.filter_policy = BLE_HCI_SCAN_FILT_USE_WL;// 使用白名单模式。
     disc_params.limited = 0;// 非有限发现模式。
     disc_params.passive = 1;// 被动扫描。
-    disc_params.filter_duplicates = 0;// 不过滤重复，每次扫描到都触发 BLE_GAP_EVENT_DISC 事件。
-    ble_gap_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER, &disc_params, app_ble_gap_event, NULL);
+    disc_params.filter_duplicates = 0;// 不过滤重复，每次扫描到都触发 BLE_GAP_EVENT_DISC 事件，用来平滑 RSSI。
+    return ble_gap_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER, &disc_params, app_ble_gap_event, NULL);
 }
 
 /**
- * @brief 启动蓝牙。
+ * @brief 扫描调度任务，每 APP_BLE_SCAN_CHECK_MS 或者被唤醒时选择扫描模式，模式变化时重新开始扫描，统计射频时间。
  * @param param
  */
-static void app_ble_host_task(void* param) {
-    nimble_port_run();// 此函数会被阻塞，只有执行 nimble_port_stop() 时，此函数才会返回。
-    // 以下的的任何代码都不会被执行。
-    nimble_port_freertos_deinit();// 此行永远不会被执行。
+static void app_ble_scan_task(void* param) {
+    app_ble_scan_mode_t mode = APP_BLE_SCAN_MODE_COUNT;// 没有扫描。
+    uint32_t last_ms = esp_log_timestamp();
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(APP_BLE_SCAN_CHECK_MS));
+        uint32_t now_ms = esp_log_timestamp();
+        pthread_mutex_lock(&app_ble_mutex);
+        if (mode < APP_BLE_SCAN_MODE_COUNT) {// 上一个模式的时间。
+            uint32_t elapsed_ms = now_ms - last_ms;
+            app_ble_radio.mode_ms[mode] += elapsed_ms;
+            app_ble_radio.scan_ms += (uint64_t)elapsed_ms * app_ble_scan_win_ms[mode] / app_ble_scan_itvl_ms[mode];
+        }
+        app_ble_radio.total_ms += now_ms - last_ms;
+        last_ms = now_ms;
+        app_ble_scan_mode_t next = app_ble_scan_select_locked(now_ms);
+        pthread_mutex_unlock(&app_ble_mutex);
+
+        if (!atomic_load(&app_ble_synced)) {
+            mode = APP_BLE_SCAN_MODE_COUNT;
+            continue;
+        }
+        if (next == mode && !atomic_exchange(&app_ble_restart, false)) {
+            continue;
+        }
+        int rc = app_ble_scan_start(next);
+        if (rc != 0) {
+            ESP_LOGE(TAG, "------ 蓝牙扫描：失败！%d", rc);
+            mode = APP_BLE_SCAN_MODE_COUNT;// 下次重试。
+            continue;
+        }
+        if (mode < APP_BLE_SCAN_MODE_COUNT) {
+            pthread_mutex_lock(&app_ble_mutex);
+            app_ble_radio.switches++;
+            pthread_mutex_unlock(&app_ble_mutex);
+        }
+        ESP_LOGI(TAG, "------ 蓝牙扫描：%s，%d/%d 毫秒。", app_ble_scan_mode_names[next], app_ble_scan_win_ms[next], app_ble_scan_itvl_ms[next]);
+        mode = next;
+    }
 }
 
 /**
- * @brief 蓝牙钥匙检测 LEAVE 任务。
- * @param param
+ * @brief 协议栈同步（启动或者复位之后），由扫描调度任务开始扫描。
  */
-static void app_ble_leave_task(void* param) {
-    while (1) {
-        int cur_ts = esp_log_timestamp() / 1000;// 系统启动以后的秒数。
-        int ble_ts = atomic_load(&app_ble_disc_ts) / 1000;// 最后一次扫描到蓝牙开关的秒数。
-        if (cur_ts - ble_ts > APP_BLE_LEAVE_TIMEOUT) {// 如果蓝牙开关离开 1 分钟，则关闭。
-            int ret = app_gpio_set_level(APP_GPIO_NUM_BLE, 0);
-            if (ret) {
-                ESP_LOGI(TAG, "------ 蓝牙接近开关: 关闭。");
-            }
-        } else {
-            int ret = app_gpio_set_level(APP_GPIO_NUM_BLE, 1);// 如果蓝牙开关在 1 分钟内，则开启。
-            if (ret) {
-                ESP_LOGI(TAG, "------ 蓝牙接近开关: 开启。");
-            }
+static void app_ble_on_sync(void) {
+    atomic_store(&app_ble_synced, true);
+    atomic_store(&app_ble_restart, true);
+    app_ble_scan_wakeup();
+}
+
+/**
+ * @brief 协议栈复位，扫描已经停止。
+ * @param reason
+ */
+static void app_ble_on_reset(int reason) {
+    atomic_store(&app_ble_synced, false);
+    ESP_LOGW(TAG, "------ 蓝牙协议栈复位：%d", reason);
+}
+
+/**
+ * @brief 读取射频时间统计。
+ * @param radio
+ * @param reset
+ */
+void app_ble_get_radio(app_ble_radio_t* radio, bool reset) {
+    pthread_mutex_lock(&app_ble_mutex);
+    *radio = app_ble_radio;
+    if (reset) {
+        memset(&app_ble_radio, 0, sizeof(app_ble_radio));
+    }
+    pthread_mutex_unlock(&app_ble_mutex);
+}
+
+/**
+ * @brief 设置事件回调。
+ * @param cb
+ */
+void app_ble_set_event_cb(app_ble_event_cb_t cb) {
+    app_ble_event_cb = cb;
+}
+
+/**
+ * @brief 替换钥匙列表。
+ * @param keys
+ * @param count
+ * @return
+ */
+esp_err_t app_ble_set_keys(const app_ble_key_t* keys, int count) {
+    if (count < 0 || count > APP_BLE_KEY_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(APP_BLE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = count > 0 ? nvs_set_blob(handle, APP_BLE_NVS_KEYS_KEY, keys, count * sizeof(app_ble_key_t)) : nvs_erase_key(handle, APP_BLE_NVS_KEYS_KEY);
+    if (ret == ESP_OK || ret == ESP_ERR_NVS_NOT_FOUND) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    app_ble_event_t events[APP_BLE_KEY_MAX];
+    int event_count = 0;
+    pthread_mutex_lock(&app_ble_mutex);
+    for (int i = 0; i < app_ble_key_count; i++) {
+        esp_timer_stop(app_ble_leave_timers[i]);
+        if (app_ble_keys[i].present) {// 在场的钥匙先离开，新的列表重新检测。
+            app_ble_transition_locked(i, false, &events[event_count++]);
         }
-        vTaskDelay(pdMS_TO_TICKS(1000));// 延迟 1 秒。
     }
+    app_ble_keys_load_locked();
+    pthread_mutex_unlock(&app_ble_mutex);
+    for (int i = 0; i < event_count; i++) {
+        app_ble_emit(&events[i]);
+    }
+
+    atomic_store(&app_ble_restart, true);// 由扫描调度任务重新设置白名单。
+    app_ble_scan_wakeup();
+    return ESP_OK;
+}
+
+/**
+ * @brief 复制钥匙列表。
+ * @param keys
+ * @return
+ */
+int app_ble_get_keys(app_ble_key_t* keys) {
+    pthread_mutex_lock(&app_ble_mutex);
+    int count = app_ble_key_count;
+    for (int i = 0; i < count; i++) {
+        keys[i].type = app_ble_keys[i].addr.type;
+        memcpy(keys[i].val, app_ble_keys[i].addr.val, 6);
+    }
+    pthread_mutex_unlock(&app_ble_mutex);
+    return count;
+}
+
+/**
+ * @brief 启动蓝牙。
+ * @param param
+ */
+static void app_ble_host_task(void* param) {
+    nimble_port_run();// 此函数会被阻塞，只有执行 nimble_port_stop() 时，此函数才会返回。
+    // 以下的的任何代码都不会被执行。
+    nimble_port_freertos_deinit();// 此行永远不会被执行。
 }
 
 /**
@@ -112,12 +573,27 @@ static void app_ble_leave_task(void* param) {
  * @return
  */
 esp_err_t app_ble_init(void) {
+    for (int i = 0; i < APP_BLE_KEY_MAX; i++) {
+        const esp_timer_create_args_t leave_args = {
+            .callback = app_ble_leave_cb,
+            .arg = (void*)(intptr_t)i,
+            .name = "app_ble_leave",
+        };
+        if (esp_timer_create(&leave_args, &app_ble_leave_timers[i]) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    pthread_mutex_lock(&app_ble_mutex);
+    app_ble_keys_load_locked();
+    pthread_mutex_unlock(&app_ble_mutex);
+
     esp_err_t ble_ret = nimble_port_init();
     if (ble_ret != ESP_OK) {
         return ble_ret;
     }
-    ble_hs_cfg.sync_cb = app_ble_gap_discovery;
+    ble_hs_cfg.sync_cb = app_ble_on_sync;
+    ble_hs_cfg.reset_cb = app_ble_on_reset;
+    xTaskCreate(app_ble_scan_task, "app_ble_scan_task", 3072, NULL, 2, &app_ble_scan_task_handle);
     nimble_port_freertos_init(app_ble_host_task);
-    xTaskCreate(app_ble_leave_task, "app_ble_leave_task", 4096, NULL, 10, NULL);// 蓝牙钥匙检测 LEAVE 任务。
     return ESP_OK;
-}
\ No newline at end of file
+}
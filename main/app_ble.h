@@ -1,16 +1,116 @@
 /**
  * @brief   BLE 初始化，蓝牙接近开关功能。
  *
+ *          每把钥匙单独跟踪：最后收到广播的时间、平滑 RSSI、进入/离开状态。按地址哈希查找，O(1)。
+ *          进入：连续 APP_BLE_ENTER_COUNT 次收到广播，并且平滑 RSSI 不低于 APP_BLE_ENTER_RSSI。
+ *          离开：APP_BLE_LEAVE_TIMEOUT 秒没有收到广播（定时器），或者平滑 RSSI 低于 APP_BLE_LEAVE_RSSI。
+ *          状态变化时产生事件，任何一把钥匙在场时打开蓝牙接近开关的 GPIO；事件由 app_main 生成 "evt":"ble" 记录放入发件箱。
+ *          扫描占空比自适应（与 WIFI 共用 2.4G 射频）：状态不确定时快速扫描，稳定时慢速扫描，
+ *          WIFI 上传积压数据时让出射频，只保留很低的占空比；状态不确定时最低为慢速，离开检测不会误判。
+ *          扫描参数见 APP_BLE_SCAN_*，射频时间随指标定期发布（见 app_metrics.h），与同一周期的 acked 数对照比较推送吞吐量。
+ *          钥匙列表保存在 NVS，可以通过 MQTT 命令修改（见 app_param.h），NVS 中没有时使用 APP_BLE_WHITE_LIST。
+ *
  * @author  nyx
  * @date    2024-07-10
  */
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+ /**
+  * @brief 最多钥匙数。
+  */
+#define APP_BLE_KEY_MAX             8
+
  /**
   * @brief 蓝牙钥匙最后刷新时间。
   */
 extern _Atomic int app_ble_disc_ts;
 
+/**
+ * @brief 钥匙地址，与 NimBLE 的 ble_addr_t 相同：type 0 = 公共地址，1 = 随机地址；val 小端，val[5] 是最高字节。
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t val[6];
+} app_ble_key_t;
+
+/**
+ * @brief 钥匙进入或者离开事件。
+ */
+typedef struct {
+    app_ble_key_t key;
+    bool present;               // true = 进入，false = 离开。
+    int8_t rssi;                // 平滑 RSSI。
+    uint8_t present_count;      // 事件之后在场的钥匙数。
+} app_ble_event_t;
+
+/**
+ * @brief 扫描模式。
+ */
+typedef enum {
+    APP_BLE_SCAN_FAST = 0,      // 状态不确定。
+    APP_BLE_SCAN_SLOW,          // 状态稳定。
+    APP_BLE_SCAN_YIELD,         // 状态稳定，WIFI 正在上传积压数据。
+    APP_BLE_SCAN_MODE_COUNT,
+} app_ble_scan_mode_t;
+
+/**
+ * @brief 射频时间统计，单位：毫秒。
+ */
+typedef struct {
+    uint32_t total_ms;                              // 统计时长。
+    uint32_t mode_ms[APP_BLE_SCAN_MODE_COUNT];      // 各扫描模式的时长，合计小于 total_ms 表示有时间没有扫描。
+    uint32_t scan_ms;                               // 扫描窗口合计，即蓝牙占用射频的时间；其余时间留给 WIFI。
+    uint32_t switches;                              // 模式切换次数。
+} app_ble_radio_t;
+
+/**
+ * @brief 事件回调，在 BLE 任务或者定时器任务中执行，不能阻塞。
+ */
+typedef void (*app_ble_event_cb_t)(const app_ble_event_t* event);
+
+/**
+ * @brief 设置事件回调，只支持一个。
+ * @param cb
+ */
+void app_ble_set_event_cb(app_ble_event_cb_t cb);
+
+/**
+ * @brief 替换钥匙列表，保存到 NVS，立即生效，所有钥匙重新开始检测。
+ * @param keys
+ * @param count 不超过 APP_BLE_KEY_MAX，0 表示恢复为 APP_BLE_WHITE_LIST。
+ * @return
+ */
+esp_err_t app_ble_set_keys(const app_ble_key_t* keys, int count);
+
+/**
+ * @brief 复制钥匙列表。
+ * @param keys 至少 APP_BLE_KEY_MAX 个。
+ * @return 钥匙数。
+ */
+int app_ble_get_keys(app_ble_key_t* keys);
+
+/**
+ * @brief 积压数据开始通过 WIFI 上传，积压数据任务调用，持续超过 APP_BLE_SCAN_CHECK_MS 时让出射频。
+ */
+void app_ble_yield_begin(void);
+
+/**
+ * @brief 积压数据上传结束。
+ * @param transferred 是否实际传输了数据，传输过数据时继续让出 APP_BLE_SCAN_YIELD_HOLD_MS。
+ */
+void app_ble_yield_end(bool transferred);
+
+/**
+ * @brief 读取射频时间统计。
+ * @param radio
+ * @param reset 读取后清零。
+ */
+void app_ble_get_radio(app_ble_radio_t* radio, bool reset);
+
 /**
  * @brief 初始化函数。
  * @return
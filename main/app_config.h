@@ -17,8 +17,46 @@
   /*
   * WIFI 热点配置。
   */
-#define APP_WIFI_SSID                   "ldv"
+#define APP_WIFI_SSID                   "ldv"               // NVS 中没有已知网络列表时使用，见 app_wifi.h。
 #define APP_WIFI_PASSWORD               "Yxxxy123!"
+#define APP_WIFI_SCAN_MAX               20                  // 扫描结果最多处理的 AP 数。
+#define APP_WIFI_PRIORITY_DB            10                  // 已知网络每级优先级相当于多少 dB 信号强度。
+#define APP_WIFI_ROAM_CHECK_MS          10000               // 已连接时读取 RSSI 的间隔。
+#define APP_WIFI_ROAM_RSSI              -75                 // RSSI 低于此值时扫描更好的 AP。
+#define APP_WIFI_ROAM_HYSTERESIS_DB     8                   // 新的 AP 至少强多少 dB 才切换。
+#define APP_WIFI_ROAM_INTERVAL_MS       60000               // 两次漫游扫描的最小间隔。
+#define APP_WIFI_RETRY_MIN_MS           1000                // 断开后第一次重连的等待时间，之后每次加倍。
+#define APP_WIFI_RETRY_MAX_MS           60000               // 重连的最长等待时间。
+#define APP_WIFI_STATIC_IP              ""                  // 静态 IP，空 = DHCP（续用上次的 IP，见 CONFIG_LWIP_DHCP_RESTORE_LAST_IP）。
+#define APP_WIFI_STATIC_NETMASK         "255.255.255.0"
+#define APP_WIFI_STATIC_GW              "192.168.1.1"
+#define APP_WIFI_STATIC_DNS             "192.168.1.1"
+#define APP_WIFI_BOOT_WAIT_MS           15000               // 启动时最多等待 WIFI 连接的时间，超时后继续启动，后台重连。
+#define APP_WIFI_AP_ENABLE              1                   // 1 = 同时开启热点，本地网页使用，见 app_web.h。
+#define APP_WIFI_AP_SSID_PREFIX         "GT-U13-"           // 热点默认名称，后面加 MAC 地址后 3 字节；网页修改后保存在 WIFI 的 NVS 中。
+#define APP_WIFI_DEVICE_KEY_LEN         12                  // 设备密码长度，热点默认密码（WPA2）和网页登录密码，随机生成保存在 NVS，见 app_wifi_device_key_init()。
+                                                            // 量产时建议开启 flash 加密和 NVS 加密（CONFIG_NVS_ENCRYPTION），否则读出 flash 可以得到密码。
+#define APP_WIFI_AP_CHANNEL             1                   // 热点默认信道，STA 连接后跟随 STA 的信道。
+#define APP_WIFI_AP_MAX_CONN            10                  // 热点最多连接数。
+
+  /*
+  * 本地网页服务器，APP_WIFI_AP_ENABLE = 1 时启动，见 app_web.h。
+  */
+#define APP_WEB_BASE_PATH               "/spiffs"           // SPIFFS 挂载路径。
+#define APP_WEB_PARTITION               "storage"           // SPIFFS 分区名称，见 partitions.csv。
+#define APP_WEB_FILE_MAX                32                  // 最多文件数，见 /.etags。
+#define APP_WEB_PATH_LEN                32                  // 文件路径最大长度，与 CONFIG_SPIFFS_OBJ_NAME_LEN 相同。
+#define APP_WEB_IO_SIZE                 1024                // 文件分块发送的字节数。
+#define APP_WEB_BODY_MAX                512                 // POST 请求最大字节数。
+#define APP_WEB_MAX_AGE_S               86400               // html 以外的文件缓存秒数，html 每次用 ETag 验证。
+#define APP_WEB_STA_MAX                 16                  // 热点设备名称最多保存个数。
+#define APP_WEB_SESSION_MAX             4                   // 同时登录的浏览器数，满了替换最早过期的。
+#define APP_WEB_SESSION_S               1800                // 登录有效秒数，每次请求重新计时。
+#define APP_WEB_LOGIN_FAIL_MAX          5                   // 连续登录失败次数，达到后锁定。
+#define APP_WEB_LOGIN_LOCK_S            60                  // 登录锁定秒数。
+#define APP_LIVE_CLIENT_MAX             8                   // WebSocket 实时数据最多客户端数，见 app_live.h。
+#define APP_LIVE_QUEUE_LEN              8                   // 每个客户端最多排队的帧数，满了丢弃最早的。
+#define APP_LIVE_SEND_TIMEOUT_MS        100                 // 发送前等待 socket 可写的最长时间，超时关闭连接。慢客户端最多占用 HTTP 服务器任务这么长时间。
 
   /*
   * GPIO 输出针脚。
@@ -26,21 +64,132 @@
 #define APP_GPIO_NUM_BLE                21  // 蓝牙接近开关。
 #define APP_GPIO_PIN_BIT_MASK           (1ULL << APP_GPIO_NUM_BLE)
 
+  /*
+  * 输入通道，中断检测，见 app_input.h。低电平有效时打开内部上拉，干接点接地。
+  */
+#define APP_INPUT_ENABLE                1
+#define APP_INPUT_CHANNELS { \
+    {.name = "ign", .gpio = 4, .active_low = true, .debounce_us = 20000}, /* 点火。 */ \
+    {.name = "door", .gpio = 5, .active_low = true, .debounce_us = 5000}, /* 车门。 */ \
+    {.name = "pto", .gpio = 6, .active_low = true, .debounce_us = 5000}, /* 取力器。 */ \
+}
+#define APP_INPUT_QUEUE_LEN             64  // 中断边沿队列长度，2 的幂。
+
   /*
   * 如果蓝牙接近开关离开 60 秒，则关闭。
   */
 #define APP_BLE_LEAVE_TIMEOUT           60
+#define APP_BLE_ENTER_COUNT             2   // 连续收到几次广播才算进入，过滤偶尔收到的远处广播。
+#define APP_BLE_ENTER_RSSI              -90 // 平滑 RSSI 不低于这个值才算进入。
+#define APP_BLE_LEAVE_RSSI              -97 // 平滑 RSSI 低于这个值算离开，与进入阈值之间留回差，避免边界处来回切换。
+#define APP_BLE_RSSI_SHIFT              2   // RSSI 指数平滑系数 = 1 / (1 << 2)。
+
+  /*
+  * 蓝牙扫描占空比，窗口/间隔，单位：毫秒。钥匙平均每 0.5 秒广播一次。
+  */
+#define APP_BLE_SCAN_FAST_WIN_MS        100 // 状态不确定：33%，几秒内确认进入或者离开。
+#define APP_BLE_SCAN_FAST_ITVL_MS       300
+#define APP_BLE_SCAN_SLOW_WIN_MS        50  // 状态稳定：5%，离开超时的一半时间内仍然可以收到多次广播。
+#define APP_BLE_SCAN_SLOW_ITVL_MS       1000
+#define APP_BLE_SCAN_YIELD_WIN_MS       30  // 让出 WIFI：1.5%。
+#define APP_BLE_SCAN_YIELD_ITVL_MS      2000
+#define APP_BLE_SCAN_FAST_HOLD_MS       10000   // 状态变化之后继续快速扫描的时间。
+#define APP_BLE_SCAN_YIELD_HOLD_MS      5000    // 积压数据上传结束之后继续让出的时间，避免上传间隙来回切换。
+#define APP_BLE_SCAN_CHECK_MS           1000    // 检查扫描模式的周期。
 
   /*
    * MQTT 服务器配置。
    */
-#define APP_MQTT_URI                    "mqtt://codingau.i234.me"
+#define APP_MQTT_URI                    "mqtt://codingau.i234.me"   // mqtts:// = TLS，见 app_tls.h；本地测试可以用开启 TLS 监听（8883）的 mosquitto。
+#define APP_MQTT_TLS_CA_PEM             ""                  // mqtts:// 只信任这个证书（服务器证书或者 CA 证书），PEM 格式，必须配置。
+#define APP_MQTT_TLS_PIN_SHA256         ""                  // 服务器证书（DER）的 SHA-256，64 个十六进制字符，空 = 只校验证书链。
 #define APP_MQTT_USERNAME               "iot001"
 #define APP_MQTT_PASSWORD               "iot001esp32s3"
-#define APP_MQTT_PUB_MGS_TOPIC          "topic/iotmsg"
-#define APP_MQTT_PUB_LOG_TOPIC          "topic/iotlog"
-#define APP_MQTT_WILL_TOPIC             "topic/will"
-#define APP_MQTT_QOS                    0                   // 实际测试连续发送 1000 条 200 个字符，QOS = 0 耗时 2.5 秒，QOS = 1 耗时 9 秒左右。
+#define APP_MQTT_TOPIC_MSG_FMT          "iot/%s/msg"        // 按设备区分主题，%s = 设备地址，消息中不再包含设备地址。
+#define APP_MQTT_TOPIC_LOG_FMT          "iot/%s/log"
+#define APP_MQTT_TOPIC_BULK_FMT         "iot/%s/bulk"       // 积压数据批量推送，压缩段按块发送。
+#define APP_MQTT_TOPIC_WILL_FMT         "iot/%s/will"
+#define APP_MQTT_TOPIC_CMD_FMT          "iot/%s/cmd"        // 订阅，远程调整运行参数，见 app_param.h。
+#define APP_MQTT_TOPIC_RESP_FMT         "iot/%s/resp"       // 命令执行结果。
+#define APP_MQTT_TOPIC_METRICS_FMT      "iot/%s/metrics"    // 推送延迟和投递统计，见 app_metrics.h。
+#define APP_MQTT_TOPIC_ALIAS            1                   // 1 = QoS 0 的消息使用 MQTT 5 主题别名，每次连接后每个主题只发送一次完整名称；QoS 1 的消息总是发送完整名称。
+#define APP_MQTT_SESSION_PERSIST        1                   // 1 = 持久会话，重连时保留订阅和离线期间的 QoS 1 命令；客户端 ID 使用设备地址。
+#define APP_MQTT_SESSION_EXPIRY_S       3600                // 会话过期秒数，断开超过此时间服务器丢弃会话。
+#define APP_MQTT_RECEIVE_MAX            8                   // 服务器同时下发未确认的 QoS 1 消息数，命令很少，不需要很大。
+#define APP_MQTT_LOG_QOS                0                   // 日志消息和遗嘱消息的 QoS；定位记录和积压数据固定使用 QoS 1 流水线推送（APP_PUB_*）。
+
+  /*
+   * QoS 1 流水线推送，不逐条等待 PUBACK。逐条等待时，连续发送 1000 条 200 个字符，QoS 1 耗时 9 秒左右，QoS 0 耗时 2.5 秒。
+   */
+#define APP_PUB_WINDOW                  16                  // 最多在途（已发送、未确认）的消息数。
+#define APP_PUB_WINDOW_BYTES            (64 * 1024)         // 最多在途字节数，限制 outbox 占用的内存。
+#define APP_PUB_SEND_TIMEOUT_MS         5000                // 等待窗口空位的时间，运行参数默认值。
+#define APP_PUB_FLUSH_TIMEOUT_MS        10000               // 等待全部确认的时间，超时按失败处理。
+
+  /*
+   * HTTP 批量上传积压数据，每个分片一次 POST，比 MQTT 按块推送快；不可用时改用 MQTT。
+   * 请求体与 MQTT 块格式相同：块头 + 数据，服务器按（设备、kind、seq、offset）重组。
+   */
+#ifndef APP_HTTP_BULK_URL                                   // 主机测试编译时指定本地服务器，见 test/host。
+#define APP_HTTP_BULK_URL               ""                  // 例如 "http://codingau.i234.me:8080/bulk"，空字符串表示不使用。
+#endif
+#ifndef APP_HTTP_BULK_PART_SIZE
+#define APP_HTTP_BULK_PART_SIZE         (128 * 1024)        // 每次 POST 的数据字节数，服务器确认后提交偏移。
+#endif
+#define APP_HTTP_BULK_TIMEOUT_MS        10000               // 网络操作超时。
+#define APP_HTTP_BULK_RETRY_MS          300000              // 失败后改用 MQTT，间隔一段时间再尝试 HTTP。
+
+  /*
+   * 实时数据发件箱，超过高水位时把最早的消息写入缓存，直到低水位。
+   */
+#define APP_OUTBOX_MAX_COUNT            64                  // 队列最多条数。
+#define APP_OUTBOX_HIGH_BYTES           (16 * 1024)         // 高水位字节数。
+#define APP_OUTBOX_LOW_BYTES            (8 * 1024)          // 低水位字节数。
+#define APP_OUTBOX_HEAP_MIN             (48 * 1024)         // 剩余堆内存低于此值时按高水位处理。
+#define APP_OUTBOX_REFILL_MS            60000               // 从缓存补发的最小间隔，避免产生很多小的缓存段。
+
+  /*
+   * 推送延迟和投递统计，见 app_metrics.h。
+   */
+#define APP_METRICS_INTERVAL_MS         60000               // 发布间隔，发布后清零。
+
+  /*
+   * 网络健康监测，见 app_health.h。
+   */
+#define APP_HEALTH_CHECK_MS             1000                // 检查间隔。
+#define APP_HEALTH_SCORE_MIN            60                  // 健康分数低于此值开始恢复。
+#define APP_HEALTH_STEP_MS              20000               // 持续不健康时，每级恢复之间的间隔。
+#define APP_HEALTH_RTT_WARN_MS          2000                // PUBACK 平滑往返时间超过此值开始扣分。
+#define APP_HEALTH_PING_ENABLE          0                   // 1 = 定期 PING，超时扣分。
+#define APP_HEALTH_PING_ADDRESS         "8.8.8.8"           // PING 网络地址。
+#define APP_HEALTH_PING_INTERVAL_MS     10000               // PING 间隔。
+
+  /*
+   * 采样策略默认值，可以通过 MQTT 命令修改，见 app_param.h。
+   */
+#define APP_SAMPLE_FAST_MS              1000                // 高速移动，速度不小于 APP_SAMPLE_SPD_FAST。
+#define APP_SAMPLE_MID_MS               2000                // 低速移动。
+#define APP_SAMPLE_SLOW_MS              5000                // 静止未移动，速度小于 APP_SAMPLE_SPD_MID，或者定位无效。
+#define APP_SAMPLE_BURST_MS             1000                // 突发模式。
+#define APP_SAMPLE_BURST_MAX_MIN        120                 // 突发模式最多分钟数。
+#define APP_SAMPLE_SPD_MID              5                   // 单位：节，9.26 公里。
+#define APP_SAMPLE_SPD_FAST             30                  // 单位：节，55.56 公里。
+#define APP_SAMPLE_DEADBAND_M           0                   // 移动距离小于此值、GPIO 不变时不推送，0 = 不使用。
+#define APP_SAMPLE_DEADBAND_MAX_S       60                  // 不推送的最长秒数。
+#define APP_SAMPLE_MAX_MS               30000               // 采样间隔上限，包括 PPP 倍数，主循环守护任务 60 秒超时（见 app_deamon.c）。
+
+  /*
+   * SD 卡保存策略，剩余空间百分比。
+   */
+#define APP_SD_FREE_LOW_PCT             10                  // 低于此值开始删除已推送的数据。
+#define APP_SD_FREE_HIGH_PCT            20                  // 达到此值停止删除。
+#define APP_SD_FREE_CRITICAL_PCT        2                   // 低于此值才删除未推送的数据。
+#define APP_SD_RETAIN_DAYS              90                  // 已推送的数据最多保存天数。
+#define APP_SD_RETAIN_CHECK_MS          10000               // 不清理时，检查剩余空间的间隔。
+#define APP_SD_LOG_QUEUE_SIZE           (16 * 1024)         // 日志队列字节数，SD 卡写入任务来不及写时丢弃新的日志。
+#define APP_SD_FSYNC_MS                 1000                // 日志段和缓存段 fsync 的最长间隔。
+#define APP_SD_FSYNC_COUNT              64                  // 写入多少行日志后立即 fsync，不等 APP_SD_FSYNC_MS。
+#define APP_SD_TRACK_QUEUE_LEN          64                  // 轨迹记录队列条数，1 Hz 采样约 1 分钟，SD 卡写入任务来不及写时丢弃新的记录。
 
 
    /*
@@ -50,4 +199,20 @@
 #define APP_UART_BAUD_RATE           115200
 #define APP_UART_TX_PIN              20
 #define APP_UART_RX_PIN              19
-#define APP_UART_BUF_SIZE            1024
\ No newline at end of file
+#define APP_UART_BUF_SIZE            1024
+
+   /*
+    * 4G 蜂窝网络备用上行（PPPoS），见 app_ppp.h。GNSS 占用上面的 UART，PPP 使用单独的 UART。
+    */
+#define APP_PPP_ENABLE               0                      // 1 = WIFI 断开时切换到 PPP。
+#define APP_PPP_UART_PORT_NUM        UART_NUM_2
+#define APP_PPP_UART_BAUD_RATE       115200
+#define APP_PPP_UART_TX_PIN          17
+#define APP_PPP_UART_RX_PIN          18
+#define APP_PPP_UART_BUF_SIZE        1024
+#define APP_PPP_APN                  "internet"
+#define APP_PPP_FAILOVER_MS          30000                  // WIFI 断开超过此时间后拨号。
+#define APP_PPP_FAILBACK_MS          10000                  // WIFI 恢复超过此时间后挂断 PPP。
+#define APP_PPP_RETRY_MS             60000                  // 拨号失败或者协商超时后，再次拨号的间隔。
+#define APP_PPP_SAMPLE_FACTOR        2                      // 使用 PPP 时采样间隔乘以此值，突发模式除外。
+#define APP_PPP_BULK                 0                      // 0 = 使用 PPP 时不推送 SD 卡积压数据，等待 WIFI；闪存缓存和实时数据照常推送。
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/uart.h"
 
 #include "nmea.h"
@@ -20,6 +21,7 @@
 #include "gprmc.h"
 
 #include "app_gnss.h"
+#include "app_live.h"
 #include "app_config.h"
 
  /**
@@ -136,6 +138,7 @@ static void app_gnss_read_task(void* param) {
         if (length == 0) {
             continue;
         }
+        int64_t rx_us = esp_timer_get_time();
         // ESP_LOGW(TAG, "%d ------ %.*s", length, length, start);
 
         char print_str[length];
@@ -143,6 +146,7 @@ static void app_gnss_read_task(void* param) {
         print_str[length - 2] = '\0';
 
         nmea_s* data = nmea_parse(start, length, 0);
+        int64_t parse_us = esp_timer_get_time();
         if (data == NULL) {// 没有解析器的数据，不处理。
             free(data);
             continue;
@@ -167,6 +171,8 @@ static void app_gnss_read_task(void* param) {
             pthread_mutex_lock(&app_gnss_data.mutex);
             nmea_gprmc_s* rmc = (nmea_gprmc_s*)data;
             app_gnss_data.valid = rmc->valid;
+            app_gnss_data.rx_us = rx_us;
+            app_gnss_data.parse_us = parse_us;
             if (app_gnss_data.valid) {// false 的时候，以下数据全部为 0。
                 app_gnss_data.date_time = rmc->date_time;
                 app_gnss_data.lat = rmc->latitude.degrees + (rmc->latitude.minutes / 60.0);
@@ -186,7 +192,11 @@ static void app_gnss_read_task(void* param) {
                     app_gnss_data.mag = -app_gnss_data.mag;
                 }
             }
+            app_gnss_data_t gnss = app_gnss_data;
             pthread_mutex_unlock(&app_gnss_data.mutex);
+#if APP_WIFI_AP_ENABLE
+            app_live_push(&gnss);// 本地 WebSocket 客户端，每条 RMC 推送一次。
+#endif
         }
         if (data != NULL) {
             free(data);
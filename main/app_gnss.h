@@ -22,6 +22,8 @@ typedef struct {
     double spd;                         // 速度，默认单位：节。
     double trk;                         // 航向角度。
     double mag;                         // 磁偏角度。
+    int64_t rx_us;                      // 收到 RMC 语句的时间，esp_timer_get_time()。
+    int64_t parse_us;                   // RMC 语句解析完成的时间。
     pthread_mutex_t mutex;              // 互斥锁。
 
 } app_gnss_data_t;
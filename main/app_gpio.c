@@ -8,6 +8,7 @@
 #include "esp_log.h"
 #include "driver/gpio.h"
 
+#include "app_input.h"
 #include "app_config.h"
 
  /**
@@ -42,6 +43,12 @@ int app_gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
 void app_gpio_get_string(char* buffer, size_t size) {
     int level = gpio_get_level(APP_GPIO_NUM_BLE);
     int length = snprintf(buffer, size, "%d%d", APP_GPIO_NUM_BLE, level);
+    for (int i = 0; i < app_input_count() && length < size; i++) {// 输入通道消抖后的电平。
+        app_input_cfg_t cfg;
+        app_input_state_t state;
+        app_input_get(i, &cfg, &state);
+        length += snprintf(buffer + length, size - length, ",%d%d", cfg.gpio, state.level);
+    }
     if (length >= size) {
         ESP_LOGE(TAG, "------ GPIO 电平字符串被截断。");
     }
@@ -21,7 +21,7 @@ int app_gpio_set_level(gpio_num_t gpio_num, uint32_t level);
 void app_gpio_power_restart(void);
 
 /**
- * @brief 返回 GPIO 电平字符串。
+ * @brief 返回 GPIO 电平字符串：蓝牙接近开关，之后是每个输入通道，",<GPIO><电平>"。
  * @param buffer
  * @param size
  */
@@ -0,0 +1,250 @@
+/**
+ * @brief   网络健康监测，代替原来的 PING 守护任务。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_wifi.h"
+#include "driver/gpio.h"
+#include "mqtt_client.h"
+
+#include "app_config.h"
+#include "app_health.h"
+#include "app_deamon.h"
+#include "app_mqtt.h"
+#include "app_ping.h"
+#include "app_ppp.h"
+#include "app_wifi.h"
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_health";
+
+/**
+ * @brief 恢复级别。
+ */
+enum {
+    APP_HEALTH_LEVEL_OK = 0,
+    APP_HEALTH_LEVEL_MQTT,      // 重连 MQTT。
+    APP_HEALTH_LEVEL_WIFI,      // 重连 WIFI。
+    APP_HEALTH_LEVEL_RESTART,   // 重启。
+};
+
+/**
+ * @brief 互斥锁，推送统计在 MQTT 任务和发送任务写入，监测任务和指标任务读取。
+ */
+static pthread_mutex_t app_health_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 健康状态，score、level、ping_ms 由监测任务写入。
+ */
+static app_health_t app_health = {
+    .ok_permille = 1000,
+};
+
+/**
+ * @brief 是否已经收到过 PUBACK，之前不计算往返时间分数。
+ */
+static bool app_health_rtt_valid = false;
+
+/**
+ * @brief 推送完成。
+ *        往返时间按 TCP 的方法平滑：avg += (rtt - avg) / 8，var += (|rtt - avg| - var) / 4。
+ * @param acked
+ * @param rtt_us
+ */
+void app_health_on_pub(bool acked, int64_t rtt_us) {
+    pthread_mutex_lock(&app_health_mutex);
+    app_health.ok_permille = (app_health.ok_permille * 7 + (acked ? 1000 : 0)) / 8;
+    if (acked) {
+        uint32_t rtt_ms = (uint32_t)(rtt_us / 1000);
+        if (!app_health_rtt_valid) {
+            app_health.rtt_avg_ms = rtt_ms;
+            app_health.rtt_var_ms = rtt_ms / 2;
+            app_health_rtt_valid = true;
+        } else {
+            int32_t diff = (int32_t)rtt_ms - (int32_t)app_health.rtt_avg_ms;
+            app_health.rtt_avg_ms = (uint32_t)((int32_t)app_health.rtt_avg_ms + diff / 8);
+            app_health.rtt_var_ms = (uint32_t)((int32_t)app_health.rtt_var_ms + (abs(diff) - (int32_t)app_health.rtt_var_ms) / 4);
+        }
+        app_health.rtt_last_ms = rtt_ms;
+        if (rtt_ms > app_health.rtt_max_ms) {
+            app_health.rtt_max_ms = rtt_ms;
+        }
+    }
+    pthread_mutex_unlock(&app_health_mutex);
+}
+
+/**
+ * @brief 读取健康状态。
+ * @param health
+ * @param reset
+ */
+void app_health_get(app_health_t* health, bool reset) {
+    pthread_mutex_lock(&app_health_mutex);
+    *health = app_health;
+    if (reset) {
+        app_health.rtt_max_ms = 0;
+    }
+    pthread_mutex_unlock(&app_health_mutex);
+}
+
+/**
+ * @brief 计算健康分数。
+ *        链路 20 分，MQTT 连接 30 分，推送成功率 30 分，往返时间 20 分（按成功率折算）。
+ *        后两项只在 MQTT 已连接时计算；启用 PING 且超时扣 20 分。
+ * @param link WIFI 或者 PPP 已连接。
+ * @param mqtt MQTT 已连接。
+ * @return
+ */
+static int app_health_score(bool link, bool mqtt) {
+    int score = 0;
+    if (link) {
+        score += 20;
+    }
+    pthread_mutex_lock(&app_health_mutex);
+    if (mqtt) {
+        uint32_t ok = app_health.ok_permille;
+        uint32_t rtt = app_health.rtt_avg_ms > APP_HEALTH_RTT_WARN_MS ? app_health.rtt_avg_ms : APP_HEALTH_RTT_WARN_MS;
+        score += 30;
+        score += 30 * ok / 1000;
+        score += app_health_rtt_valid ? 20 * APP_HEALTH_RTT_WARN_MS / rtt * ok / 1000 : 20 * ok / 1000;
+    }
+    if (APP_HEALTH_PING_ENABLE && app_health.ping_ms < 0) {
+        score -= 20;
+    }
+    pthread_mutex_unlock(&app_health_mutex);
+    return score < 0 ? 0 : score;
+}
+
+/**
+ * @brief 允许的最高恢复级别。
+ *        PPP 正在接管上行时不重启，PPP 的切换、拨号和协商需要 APP_PPP_FAILOVER_MS 加上最长 30 秒的拨号，比逐级恢复慢；
+ *        链路正常（启用 PING 时 PING 也正常），只是 MQTT 不正常时，重启没有帮助，也不重启。
+ * @param link WIFI 或者 PPP 已连接。
+ * @return
+ */
+static int app_health_max_level(bool link) {
+    if (app_ppp_failover()) {
+        return APP_HEALTH_LEVEL_WIFI;
+    }
+    pthread_mutex_lock(&app_health_mutex);
+    bool ping_ok = !APP_HEALTH_PING_ENABLE || app_health.ping_ms >= 0;
+    pthread_mutex_unlock(&app_health_mutex);
+    if (link && ping_ok) {
+        return APP_HEALTH_LEVEL_WIFI;
+    }
+    return APP_HEALTH_LEVEL_RESTART;
+}
+
+/**
+ * @brief 执行一级恢复。
+ * @param level
+ */
+static void app_health_recover(int level) {
+    if (level == APP_HEALTH_LEVEL_MQTT) {
+        ESP_LOGW(TAG, "------ 网络不健康，恢复级别 1：重连 MQTT。");
+        if (app_mqtt_5_client != NULL) {
+            esp_mqtt_client_disconnect(app_mqtt_5_client);
+            esp_mqtt_client_reconnect(app_mqtt_5_client);
+        }
+    } else if (level == APP_HEALTH_LEVEL_WIFI) {
+        ESP_LOGW(TAG, "------ 网络不健康，恢复级别 2：重连 WIFI。");
+        esp_wifi_disconnect();// 断开事件中按退避时间重连。
+    } else {
+        int ble_level = gpio_get_level(APP_GPIO_NUM_BLE);
+        if (ble_level == 1) {
+            ESP_LOGE(TAG, "------ 网络不健康，恢复级别 3：重启。蓝牙开关状态：打开，暂不重启。");
+        } else {
+            ESP_LOGE(TAG, "------ 网络不健康，恢复级别 3：重启。执行：esp_restart()");
+            esp_restart();
+        }
+    }
+}
+
+/**
+ * @brief 网络健康监测任务。
+ * @param param
+ */
+static void app_health_task(void* param) {
+    uint32_t count = 0;
+    uint32_t bad_ts = 0;// 开始不健康或者最后一次执行恢复的时间，0 = 健康。
+    uint32_t ping_ts = 0;
+    int level = APP_HEALTH_LEVEL_OK;
+    while (1) {
+        uint32_t cur_ts = esp_log_timestamp();
+
+        if (APP_HEALTH_PING_ENABLE) {
+            int ping_ret = atomic_load(&app_ping_ret);
+            if (ping_ret != 0) {// 上次 PING 已经有结果。
+                pthread_mutex_lock(&app_health_mutex);
+                app_health.ping_ms = ping_ret;
+                pthread_mutex_unlock(&app_health_mutex);
+            }
+            if (cur_ts - ping_ts >= APP_HEALTH_PING_INTERVAL_MS) {
+                ping_ts = cur_ts;
+                app_ping_start();// 不等待结果，下次检查时读取。
+            }
+        }
+
+        bool link = app_wifi_is_connected() || app_ppp_active();
+        bool mqtt = atomic_load(&app_mqtt_connected);
+        int score = app_health_score(link, mqtt);
+
+        if (app_status == 1) {
+            if (score >= APP_HEALTH_SCORE_MIN) {
+                if (level != APP_HEALTH_LEVEL_OK) {
+                    ESP_LOGI(TAG, "------ 网络已恢复健康，分数：%d。", score);
+                }
+                level = APP_HEALTH_LEVEL_OK;
+                bad_ts = 0;
+            } else if (bad_ts == 0) {
+                ESP_LOGW(TAG, "------ 网络不健康，分数：%d，链路：%d，MQTT：%d。", score, link, mqtt);
+                bad_ts = cur_ts;
+            } else if (cur_ts - bad_ts >= APP_HEALTH_STEP_MS) {// 每级之间等待，给上一级恢复留出时间。
+                int max_level = app_health_max_level(link);
+                if (level < max_level) {
+                    level++;
+                    app_health_recover(level);
+                } else {// 不重启，继续重连 MQTT。
+                    app_health_recover(APP_HEALTH_LEVEL_MQTT);
+                }
+                bad_ts = cur_ts;
+            }
+        }
+
+        pthread_mutex_lock(&app_health_mutex);
+        app_health.score = (uint8_t)score;
+        app_health.level = (uint8_t)level;
+        pthread_mutex_unlock(&app_health_mutex);
+
+        if (count % 30 == 0) {
+            app_health_t health;
+            app_health_get(&health, false);
+            ESP_LOGI(TAG, "------ 网络健康：分数 %u，级别 %u，成功率 %u‰，RTT %lu/%lu/%lu 毫秒（最后/平均/偏差），PING %ld。",
+                health.score, health.level, health.ok_permille, health.rtt_last_ms, health.rtt_avg_ms, health.rtt_var_ms, health.ping_ms);
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(APP_HEALTH_CHECK_MS));
+        count++;
+    }
+}
+
+/**
+ * @brief 初始化函数。
+ * @return
+ */
+esp_err_t app_health_init(void) {
+    xTaskCreate(app_health_task, "app_health_task", 4096, NULL, 2, NULL);// 优先级 2，与原来的网络守护任务相同。
+    return ESP_OK;
+}
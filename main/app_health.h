@@ -0,0 +1,49 @@
+/**
+ * @brief   网络健康监测，代替原来的 PING 守护任务。
+ *
+ *          综合 WIFI/PPP 链路状态、MQTT 连接状态、PUBACK 往返时间、推送成功率和可选的 PING 探测，计算健康分数（0 ~ 100）。
+ *          分数持续低于 APP_HEALTH_SCORE_MIN 时逐级恢复：重连 MQTT -> 重连 WIFI -> 重启，每级之间等待 APP_HEALTH_STEP_MS。
+ *          PPP 正在接管上行，或者链路正常只是 MQTT 不正常时不重启，只重连 MQTT。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/**
+ * @brief 健康状态。
+ */
+typedef struct {
+    uint8_t score;          // 健康分数，0 ~ 100。
+    uint8_t level;          // 当前恢复级别，0 = 正常。
+    uint16_t ok_permille;   // 推送成功率，千分比，指数平滑。
+    uint32_t rtt_last_ms;   // 最后一次 PUBACK 往返时间。
+    uint32_t rtt_avg_ms;    // 平滑往返时间。
+    uint32_t rtt_var_ms;    // 往返时间偏差。
+    uint32_t rtt_max_ms;    // 上次读取之后的最大往返时间。
+    int32_t ping_ms;        // 最后一次 PING 结果，-1 = 超时，0 = 未启用或者无结果。
+} app_health_t;
+
+/**
+ * @brief 推送完成，由 app_pub 在释放窗口位置时调用，不能阻塞。
+ * @param acked true = 已确认，false = 失败。
+ * @param rtt_us 发送到确认的时间，失败时忽略。
+ */
+void app_health_on_pub(bool acked, int64_t rtt_us);
+
+/**
+ * @brief 读取健康状态。
+ * @param health
+ * @param reset true = 读取后清零 rtt_max_ms。
+ */
+void app_health_get(app_health_t* health, bool reset);
+
+/**
+ * @brief 初始化函数，WIFI 和 MQTT 初始化之后调用，启动监测任务。
+ * @return
+ */
+esp_err_t app_health_init(void);
@@ -0,0 +1,135 @@
+/**
+ * @brief   HTTP 批量上传积压数据。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+
+#include "app_http.h"
+#include "app_main.h"
+#include "app_config.h"
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_http";
+
+/**
+ * @brief 从文件读取、写入连接的缓冲区字节数。
+ */
+#define APP_HTTP_IO_SIZE            4096
+
+/**
+ * @brief 当前上传使用的连接和缓冲区，只在积压数据任务中使用。
+ */
+static esp_http_client_handle_t app_http_client = NULL;
+static char* app_http_buffer = NULL;
+
+/**
+ * @brief 最近一次失败的时间，用于暂停重试。
+ */
+static int64_t app_http_fail_ms = 0;
+static bool app_http_failed = false;
+
+/**
+ * @brief 上传一个分片：块头 + 数据，Content-Length 已知，边读边写，不占用大块内存。
+ * @return 服务器已保存的偏移，失败返回 -1。
+ */
+static int64_t app_http_upload_part(const app_seg_chunk_header_t* header, FILE* file, uint32_t len) {
+    esp_err_t ret = esp_http_client_open(app_http_client, sizeof(app_seg_chunk_header_t) + len);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "------ HTTP 上传：连接失败！%s", esp_err_to_name(ret));
+        return -1;
+    }
+    if (esp_http_client_write(app_http_client, (const char*)header, sizeof(app_seg_chunk_header_t)) != sizeof(app_seg_chunk_header_t)) {
+        esp_http_client_close(app_http_client);
+        return -1;
+    }
+    uint32_t left = len;
+    while (left > 0) {
+        size_t read_len = fread(app_http_buffer, 1, left < APP_HTTP_IO_SIZE ? left : APP_HTTP_IO_SIZE, file);
+        if (read_len == 0 || esp_http_client_write(app_http_client, app_http_buffer, read_len) != (int)read_len) {
+            ESP_LOGE(TAG, "------ HTTP 上传：发送失败！seq：%lu，偏移：%lu", header->seq, header->offset + (len - left));
+            esp_http_client_close(app_http_client);
+            return -1;
+        }
+        left -= read_len;
+    }
+    if (esp_http_client_fetch_headers(app_http_client) < 0) {
+        esp_http_client_close(app_http_client);
+        return -1;
+    }
+    int status = esp_http_client_get_status_code(app_http_client);
+    int64_t next = -1;
+    if (status >= 200 && status < 300) {
+        next = (int64_t)header->offset + len;
+    } else if (status == 409) {// 偏移不一致，响应体是服务器已保存的偏移，从该偏移继续。
+        char body[16];
+        int body_len = esp_http_client_read(app_http_client, body, sizeof(body) - 1);
+        if (body_len > 0) {
+            body[body_len] = '\0';
+            next = strtoul(body, NULL, 10);
+        }
+        ESP_LOGW(TAG, "------ HTTP 上传：偏移不一致。seq：%lu，发送偏移：%lu，服务器偏移：%lld", header->seq, header->offset, next);
+    } else {
+        ESP_LOGE(TAG, "------ HTTP 上传：服务器返回 %d", status);
+    }
+    esp_http_client_flush_response(app_http_client, NULL);// 读完响应，连接可以复用。
+    return next;
+}
+
+/**
+ * @brief 上传一个分段存储中所有已压缩、未上传的段。
+ * @param store
+ * @return 上传字节数，没有配置、暂停重试或者失败返回 -1，调用者改用 MQTT。
+ */
+int64_t app_http_upload(app_seg_store_t* store) {
+    if (APP_HTTP_BULK_URL[0] == '\0') {
+        return -1;
+    }
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    if (app_http_failed && now_ms - app_http_fail_ms < APP_HTTP_BULK_RETRY_MS) {
+        return -1;
+    }
+
+    esp_http_client_config_t config = {
+        .url = APP_HTTP_BULK_URL,
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = APP_HTTP_BULK_TIMEOUT_MS,
+        .keep_alive_enable = true,
+    };
+    app_http_client = esp_http_client_init(&config);
+    app_http_buffer = malloc(APP_HTTP_IO_SIZE);
+    if (app_http_client == NULL || app_http_buffer == NULL) {
+        ESP_LOGE(TAG, "------ HTTP 上传：初始化失败！");
+        if (app_http_client != NULL) {
+            esp_http_client_cleanup(app_http_client);
+        }
+        free(app_http_buffer);
+        app_http_client = NULL;
+        app_http_buffer = NULL;
+        return -1;
+    }
+    esp_http_client_set_header(app_http_client, "Content-Type", "application/octet-stream");
+    esp_http_client_set_header(app_http_client, "X-Dev-Addr", app_main_data.dev_addr);
+
+    int64_t ret = app_seg_upload(store, APP_HTTP_BULK_PART_SIZE, app_http_upload_part);
+
+    esp_http_client_cleanup(app_http_client);
+    free(app_http_buffer);
+    app_http_client = NULL;
+    app_http_buffer = NULL;
+
+    app_http_failed = ret < 0;
+    if (app_http_failed) {
+        app_http_fail_ms = now_ms;
+        ESP_LOGW(TAG, "------ HTTP 上传失败，%d 秒内改用 MQTT 推送。", APP_HTTP_BULK_RETRY_MS / 1000);
+    }
+    return ret;
+}
@@ -0,0 +1,23 @@
+/**
+ * @brief   HTTP 批量上传积压数据。
+ *
+ *          已压缩的段按分片 POST 到 APP_HTTP_BULK_URL，同一个连接连续上传。
+ *          服务器返回 2xx 表示已保存；返回 409 时响应体是已保存的偏移（十进制），从该偏移继续。
+ *          上传失败后一段时间内不再尝试，由调用者改用 MQTT 推送。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#include "app_seg.h"
+
+/**
+ * @brief 上传一个分段存储中所有已压缩、未上传的段。
+ * @param store
+ * @return 上传字节数，没有配置、暂停重试或者失败返回 -1，调用者改用 MQTT。
+ */
+int64_t app_http_upload(app_seg_store_t* store);
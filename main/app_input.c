@@ -0,0 +1,338 @@
+/**
+ * @brief   输入通道，点火、车门、取力器等开关量输入，中断检测，不轮询。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "driver/gpio.h"
+#include "hal/gpio_ll.h"
+
+#include "app_input.h"
+#include "app_outbox.h"
+#include "app_config.h"
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_input";
+
+/**
+ * @brief 通道配置，中断中读取 GPIO 编号，放在 DRAM 中，写闪存时中断也能执行。
+ */
+static const DRAM_ATTR app_input_cfg_t app_input_cfgs[] = APP_INPUT_CHANNELS;
+#define APP_INPUT_COUNT     (sizeof(app_input_cfgs) / sizeof(app_input_cfgs[0]))
+
+/**
+ * @brief 中断中记录的一个边沿。
+ */
+typedef struct {
+    int64_t ts_us;              // esp_timer_get_time()。
+    uint8_t channel;
+    uint8_t level;              // 中断时读取的电平。
+} app_input_edge_t;
+
+/**
+ * @brief 无锁环形队列，单生产者（GPIO 中断服务，所有引脚在同一个中断中依次处理）、单消费者（输入任务）。
+ *        head 只由中断写入，tail 只由任务写入，序号一直递增，取余得到位置。
+ */
+static app_input_edge_t app_input_ring[APP_INPUT_QUEUE_LEN];
+static _Atomic uint32_t app_input_head = ATOMIC_VAR_INIT(0);
+static _Atomic uint32_t app_input_tail = ATOMIC_VAR_INIT(0);
+static _Atomic uint32_t app_input_overflow = ATOMIC_VAR_INIT(0);
+
+/**
+ * @brief 输入任务句柄。
+ */
+static TaskHandle_t app_input_task_handle = NULL;
+
+/**
+ * @brief 消抖状态，只在输入任务中使用。
+ */
+typedef struct {
+    int64_t lockout_until_us;   // 消抖结束时间，0 = 不在消抖期间。
+    int64_t pending_us;         // 消抖期间最后一个边沿的时间，0 = 没有。
+    uint8_t pending_level;      // 消抖期间最后一个边沿的电平。
+    int64_t active_us;          // 有效电平开始的时间，0 = 未知。
+} app_input_debounce_t;
+
+static app_input_debounce_t app_input_debounces[APP_INPUT_COUNT];
+
+/**
+ * @brief 通道状态，输入任务写入，其他任务读取。
+ */
+static app_input_state_t app_input_states[APP_INPUT_COUNT];
+static pthread_mutex_t app_input_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief GPIO 中断，记录时间戳和电平，放入环形队列，通知输入任务。
+ *        放在 IRAM 中，写闪存（NVS、SPIFFS）期间缓存关闭时也能响应，不丢边沿；
+ *        只调用 IRAM 中的函数，电平直接读寄存器。
+ * @param arg 通道下标。
+ */
+static void IRAM_ATTR app_input_isr(void* arg) {
+    int64_t ts_us = esp_timer_get_time();
+    uint8_t channel = (uint8_t)(intptr_t)arg;
+    uint32_t head = atomic_load_explicit(&app_input_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&app_input_tail, memory_order_acquire);
+    if (head - tail >= APP_INPUT_QUEUE_LEN) {// 队列已满，丢弃，消抖结束时按实际电平补正。
+        atomic_fetch_add_explicit(&app_input_overflow, 1, memory_order_relaxed);
+    } else {
+        app_input_edge_t* edge = &app_input_ring[head % APP_INPUT_QUEUE_LEN];
+        edge->ts_us = ts_us;
+        edge->channel = channel;
+        edge->level = gpio_ll_get_level(&GPIO, app_input_cfgs[channel].gpio);
+        atomic_store_explicit(&app_input_head, head + 1, memory_order_release);
+    }
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(app_input_task_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * @brief 中断时间换算为 UTC 微秒。
+ * @param ts_us
+ * @return
+ */
+static int64_t app_input_utc_us(int64_t ts_us) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t now_us = esp_timer_get_time();
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - (now_us - ts_us);
+}
+
+/**
+ * @brief 生成一条事件记录，放入发件箱。
+ * @param channel
+ * @param state
+ */
+static void app_input_publish(int channel, const app_input_state_t* state) {
+    const app_input_cfg_t* cfg = &app_input_cfgs[channel];
+    int64_t utc_us = app_input_utc_us(state->change_us);
+    time_t sec = utc_us / 1000000;
+    struct tm timeinfo;
+    gmtime_r(&sec, &timeinfo);
+    char dev_time[24];
+    strftime(dev_time, sizeof(dev_time), "%Y%m%d%H%M%S", &timeinfo);
+
+    char json[256];// 写入缓存时会追加换行符，保留 2 个字节。
+    int len = snprintf(json, sizeof(json) - 2,
+        "{\"devTime\":\"%s%03d\",\"evt\":\"%s\",\"gpio\":%d,\"level\":%u,\"active\":%d,\"evtUs\":%lld,\"pulseUs\":%lld,\"rise\":%lu,\"fall\":%lu,\"raw\":%lu,\"f\":0}",
+        dev_time, (int)(utc_us / 1000 % 1000), cfg->name, cfg->gpio, state->level, state->active, utc_us,
+        state->active ? 0LL : state->pulse_us, state->rise_count, state->fall_count, state->raw_count);
+    if (len >= sizeof(json) - 2) {
+        ESP_LOGE(TAG, "------ 事件记录被截断：%s", cfg->name);
+        return;
+    }
+    app_metrics_trace_t trace = {0};// 序号只用于定位记录，事件记录为 0。
+    app_outbox_put(json, &trace);
+}
+
+/**
+ * @brief 电平变化生效，更新计数和脉冲宽度，生成事件记录。
+ * @param channel
+ * @param ts_us 变化的中断时间。
+ * @param level
+ */
+static void app_input_accept(int channel, int64_t ts_us, uint8_t level) {
+    const app_input_cfg_t* cfg = &app_input_cfgs[channel];
+    app_input_debounce_t* debounce = &app_input_debounces[channel];
+    bool active = (level != 0) != cfg->active_low;
+    app_input_state_t state;
+    pthread_mutex_lock(&app_input_mutex);
+    app_input_state_t* cur = &app_input_states[channel];
+    cur->level = level;
+    cur->active = active;
+    cur->change_us = ts_us;
+    if (level) {
+        cur->rise_count++;
+    } else {
+        cur->fall_count++;
+    }
+    if (active) {
+        debounce->active_us = ts_us;
+    } else if (debounce->active_us != 0) {
+        cur->pulse_us = ts_us - debounce->active_us;
+        debounce->active_us = 0;
+    }
+    state = *cur;
+    pthread_mutex_unlock(&app_input_mutex);
+
+    ESP_LOGI(TAG, "------ 输入 %s：%s，脉冲宽度：%lld 微秒。", cfg->name, active ? "有效" : "无效", active ? 0LL : state.pulse_us);
+    app_input_publish(channel, &state);
+}
+
+/**
+ * @brief 消抖结束，最后的电平与生效的电平不同时补一次变化。
+ * @param channel
+ * @param level 实际电平。
+ */
+static void app_input_settle(int channel, uint8_t level) {
+    app_input_debounce_t* debounce = &app_input_debounces[channel];
+    int64_t pending_us = debounce->pending_us;
+    debounce->lockout_until_us = 0;
+    debounce->pending_us = 0;
+    pthread_mutex_lock(&app_input_mutex);
+    bool changed = app_input_states[channel].level != level;
+    pthread_mutex_unlock(&app_input_mutex);
+    if (changed) {
+        int64_t ts_us = pending_us != 0 ? pending_us : esp_timer_get_time();// 队列溢出时没有边沿，使用当前时间。
+        app_input_accept(channel, ts_us, level);
+        debounce->lockout_until_us = ts_us + app_input_cfgs[channel].debounce_us;
+    }
+}
+
+/**
+ * @brief 处理一个边沿。
+ * @param edge
+ */
+static void app_input_on_edge(const app_input_edge_t* edge) {
+    int channel = edge->channel;
+    app_input_debounce_t* debounce = &app_input_debounces[channel];
+    pthread_mutex_lock(&app_input_mutex);
+    app_input_states[channel].raw_count++;
+    uint8_t level = app_input_states[channel].level;
+    pthread_mutex_unlock(&app_input_mutex);
+
+    if (debounce->lockout_until_us != 0 && edge->ts_us >= debounce->lockout_until_us) {// 上一次消抖已经结束，按消抖期间最后的电平补正。
+        if (debounce->pending_us != 0) {
+            app_input_settle(channel, debounce->pending_level);
+            pthread_mutex_lock(&app_input_mutex);
+            level = app_input_states[channel].level;
+            pthread_mutex_unlock(&app_input_mutex);
+        } else {
+            debounce->lockout_until_us = 0;
+        }
+    }
+    if (debounce->lockout_until_us != 0) {// 消抖期间，只记录。
+        debounce->pending_us = edge->ts_us;
+        debounce->pending_level = edge->level;
+        return;
+    }
+    if (edge->level == level) {// 抖动已经恢复，或者重复的边沿。
+        return;
+    }
+    app_input_accept(channel, edge->ts_us, edge->level);
+    debounce->lockout_until_us = edge->ts_us + app_input_cfgs[channel].debounce_us;
+    debounce->pending_us = 0;
+}
+
+/**
+ * @brief 输入任务，处理中断放入的边沿，消抖结束时读取实际电平补正。
+ * @param param
+ */
+static void app_input_task(void* param) {
+    while (1) {
+        TickType_t wait = portMAX_DELAY;// 没有消抖中的通道时，只等待中断。
+        int64_t now_us = esp_timer_get_time();
+        for (int i = 0; i < APP_INPUT_COUNT; i++) {
+            if (app_input_debounces[i].lockout_until_us != 0) {
+                int64_t left_us = app_input_debounces[i].lockout_until_us - now_us;
+                TickType_t ticks = left_us > 0 ? pdMS_TO_TICKS(left_us / 1000) + 1 : 0;
+                if (ticks < wait) {
+                    wait = ticks;
+                }
+            }
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        uint32_t tail = atomic_load_explicit(&app_input_tail, memory_order_relaxed);
+        uint32_t head = atomic_load_explicit(&app_input_head, memory_order_acquire);
+        while (tail != head) {
+            app_input_edge_t edge = app_input_ring[tail % APP_INPUT_QUEUE_LEN];
+            atomic_store_explicit(&app_input_tail, ++tail, memory_order_release);
+            app_input_on_edge(&edge);
+            head = atomic_load_explicit(&app_input_head, memory_order_acquire);
+        }
+
+        now_us = esp_timer_get_time();
+        for (int i = 0; i < APP_INPUT_COUNT; i++) {
+            if (app_input_debounces[i].lockout_until_us != 0 && now_us >= app_input_debounces[i].lockout_until_us) {
+                app_input_settle(i, gpio_get_level(app_input_cfgs[i].gpio));// 读取实际电平，中断之后的抖动也能补正。
+            }
+        }
+
+        uint32_t overflow = atomic_exchange(&app_input_overflow, 0);
+        if (overflow > 0) {
+            ESP_LOGW(TAG, "------ 边沿队列已满，丢弃：%lu", overflow);
+        }
+    }
+}
+
+/**
+ * @brief 通道数。
+ * @return
+ */
+int app_input_count(void) {
+    return APP_INPUT_COUNT;
+}
+
+/**
+ * @brief 读取通道配置和状态。
+ * @param channel
+ * @param cfg
+ * @param state
+ * @return
+ */
+bool app_input_get(int channel, app_input_cfg_t* cfg, app_input_state_t* state) {
+    if (channel < 0 || channel >= APP_INPUT_COUNT) {
+        return false;
+    }
+    if (cfg != NULL) {
+        *cfg = app_input_cfgs[channel];
+    }
+    if (state != NULL) {
+        pthread_mutex_lock(&app_input_mutex);
+        *state = app_input_states[channel];
+        pthread_mutex_unlock(&app_input_mutex);
+    }
+    return true;
+}
+
+/**
+ * @brief 初始化函数。
+ * @return
+ */
+esp_err_t app_input_init(void) {
+    if (xTaskCreate(app_input_task, "app_input_task", 3072, NULL, 5, &app_input_task_handle) != pdPASS) {// 优先级高于发件箱任务。
+        return ESP_FAIL;
+    }
+    esp_err_t ret = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);// 中断服务在 IRAM 中，处理函数也必须在 IRAM 中。
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {// 已经安装过不是错误。
+        return ret;
+    }
+    for (int i = 0; i < APP_INPUT_COUNT; i++) {
+        const app_input_cfg_t* cfg = &app_input_cfgs[i];
+        gpio_config_t gpio_conf = {
+            .intr_type = GPIO_INTR_ANYEDGE,
+            .mode = GPIO_MODE_INPUT,
+            .pin_bit_mask = 1ULL << cfg->gpio,
+            .pull_down_en = 0,
+            .pull_up_en = cfg->active_low,
+        };
+        ret = gpio_config(&gpio_conf);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        uint8_t level = gpio_get_level(cfg->gpio);
+        app_input_states[i].level = level;// 初始电平不产生事件。
+        app_input_states[i].active = (level != 0) != cfg->active_low;
+        app_input_states[i].change_us = esp_timer_get_time();
+        ret = gpio_isr_handler_add(cfg->gpio, app_input_isr, (void*)(intptr_t)i);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        ESP_LOGI(TAG, "------ 输入 %s：GPIO %d，%s。", cfg->name, cfg->gpio, app_input_states[i].active ? "有效" : "无效");
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,68 @@
+/**
+ * @brief   输入通道，点火、车门、取力器等开关量输入，中断检测，不轮询。
+ *
+ *          通道在 APP_INPUT_CHANNELS 中配置。每个通道使用 GPIO 双边沿中断，中断中记录 esp_timer 时间戳（微秒），
+ *          放入无锁环形队列（中断写入，输入任务读取，不使用互斥锁和 FreeRTOS 队列），再通知输入任务。
+ *          消抖：电平变化立即生效，时间戳就是第一个边沿的时间；之后 debounce_us 内的边沿不生效，
+ *          结束时按实际电平补一次变化，保证最终状态正确。
+ *          每个通道统计上升沿、下降沿、原始边沿（包括抖动）次数，有效电平结束时记录脉冲宽度。
+ *
+ *          每次生效的变化立即生成一条记录放入发件箱（与定位记录同一主题），不等待主循环采样：
+ *          {"devTime":"20240711024955148","evt":"ign","gpio":4,"level":0,"active":1,"evtUs":1720666195148123,
+ *           "pulseUs":0,"rise":3,"fall":4,"raw":9,"f":0}
+ *          evtUs 是中断时间换算的 UTC 微秒；pulseUs 是刚结束的有效脉冲宽度，active = 1 时为 0。
+ *          定位记录的 gpios 字段也追加各通道的电平，格式与蓝牙接近开关相同：",<GPIO><电平>"。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+ /**
+  * @brief 通道配置。
+  */
+typedef struct {
+    const char* name;           // 记录中的名称。
+    gpio_num_t gpio;
+    bool active_low;            // 低电平有效，同时打开内部上拉（干接点接地）。
+    uint32_t debounce_us;       // 消抖时间。
+} app_input_cfg_t;
+
+/**
+ * @brief 通道状态。
+ */
+typedef struct {
+    uint8_t level;              // 消抖后的电平。
+    bool active;                // 是否有效。
+    int64_t change_us;          // 最后一次变化的中断时间，esp_timer_get_time()。
+    uint32_t rise_count;        // 上升沿次数，消抖后。
+    uint32_t fall_count;        // 下降沿次数，消抖后。
+    uint32_t raw_count;         // 原始边沿次数，包括抖动。
+    int64_t pulse_us;           // 最近一次有效脉冲的宽度，点火可能持续数小时，32 位约 71 分钟溢出。
+} app_input_state_t;
+
+/**
+ * @brief 通道数。
+ * @return
+ */
+int app_input_count(void);
+
+/**
+ * @brief 读取通道配置和状态。
+ * @param channel
+ * @param cfg 可以为 NULL。
+ * @param state 可以为 NULL。
+ * @return 通道不存在返回 false。
+ */
+bool app_input_get(int channel, app_input_cfg_t* cfg, app_input_state_t* state);
+
+/**
+ * @brief 初始化函数，GPIO 初始化之后调用。
+ * @return
+ */
+esp_err_t app_input_init(void);
@@ -11,10 +11,9 @@
 
 void app_json_serialize(char* buffer, size_t buffer_size, const app_main_data_t* data) {
 
-    char fmt[] = "{\"devAddr\":\"%s\",\"devTime\":\"%s\",\"logTs\":%d,\"bleTs\":%d,\"gpios\":\"%s\",\"gnssTime\":\"%s\",\"gnssValid\":%d,\"sat\":%d,\"alt\":%f,\"lat\":%f,\"lon\":%f,\"spd\":%f,\"trk\":%f,\"mag\":%f,\"f\":0}";
+    char fmt[] = "{\"devTime\":\"%s\",\"logTs\":%d,\"bleTs\":%d,\"gpios\":\"%s\",\"gnssTime\":\"%s\",\"gnssValid\":%d,\"sat\":%d,\"alt\":%f,\"lat\":%f,\"lon\":%f,\"spd\":%f,\"trk\":%f,\"mag\":%f,\"seq\":%lu,\"f\":0}";
 
     snprintf(buffer, buffer_size, fmt,
-        data->dev_addr,
         data->dev_time,
         data->log_ts,
         data->ble_ts,
@@ -27,6 +26,7 @@ void app_json_serialize(char* buffer, size_t buffer_size, const app_main_data_t*
         data->lon,
         data->spd,
         data->trk,
-        data->mag
+        data->mag,
+        data->seq
     );
 }
\ No newline at end of file
@@ -0,0 +1,262 @@
+/**
+ * @brief   本地实时数据，WebSocket。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include "esp_log.h"
+#include "esp_http_server.h"
+
+#include "app_config.h"
+#include "app_live.h"
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_live";
+
+/**
+ * @brief 帧长度和版本，格式见 app_live.h。
+ */
+#define APP_LIVE_FRAME_LEN          28
+#define APP_LIVE_FRAME_VERSION      1
+
+/**
+ * @brief 客户端。
+ */
+typedef struct {
+    int fd;                                                 // -1 = 空位置。
+    uint8_t queue[APP_LIVE_QUEUE_LEN][APP_LIVE_FRAME_LEN];  // 环形队列。
+    uint8_t head;
+    uint8_t count;
+    uint32_t dropped;                                       // 上一帧之后丢弃的帧数。
+    bool pending;                                           // 已经提交发送任务，还没有执行完。
+} app_live_client_t;
+
+/**
+ * @brief 客户端列表，GNSS 任务写入队列，HTTP 服务器任务发送。
+ */
+static app_live_client_t app_live_clients[APP_LIVE_CLIENT_MAX];
+static pthread_mutex_t app_live_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief HTTP 服务器句柄。
+ */
+static httpd_handle_t app_live_server = NULL;
+
+/**
+ * @brief 帧序号。
+ */
+static uint32_t app_live_seq = 0;
+
+/**
+ * @brief 写入小端整数。
+ */
+static void app_live_put_u16(uint8_t* p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void app_live_put_u32(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+/**
+ * @brief 编码一帧。
+ * @param gnss
+ * @param frame
+ */
+static void app_live_encode(const app_gnss_data_t* gnss, uint8_t* frame) {
+    struct tm tm = gnss->date_time;
+    frame[0] = APP_LIVE_FRAME_VERSION;
+    frame[1] = gnss->valid ? 1 : 0;
+    frame[2] = gnss->sat > 255 ? 255 : (uint8_t)gnss->sat;
+    frame[3] = 0;// 发送时按客户端填写。
+    app_live_put_u32(frame + 4, ++app_live_seq);
+    app_live_put_u32(frame + 8, gnss->valid ? (uint32_t)mktime(&tm) : 0);// 没有设置 TZ，mktime() 按 UTC 计算。
+    app_live_put_u32(frame + 12, (uint32_t)(int32_t)lround(gnss->lat * 1e7));
+    app_live_put_u32(frame + 16, (uint32_t)(int32_t)lround(gnss->lon * 1e7));
+    app_live_put_u32(frame + 20, (uint32_t)(int32_t)lround(gnss->alt * 100));
+    app_live_put_u16(frame + 24, (uint16_t)lround(fmin(gnss->spd * 100, UINT16_MAX)));
+    app_live_put_u16(frame + 26, (uint16_t)lround(gnss->trk * 100));
+}
+
+/**
+ * @brief 等待 socket 可写。
+ *        可写时发送缓冲区至少有 TCP_SNDLOWAT 字节空闲，远大于一帧，发送不会阻塞；
+ *        不可写说明客户端很久没有读取，发送缓冲区已满。
+ * @param fd
+ * @return
+ */
+static bool app_live_writable(int fd) {
+    fd_set writeset;
+    FD_ZERO(&writeset);
+    FD_SET(fd, &writeset);
+    struct timeval timeout = {.tv_sec = APP_LIVE_SEND_TIMEOUT_MS / 1000, .tv_usec = (APP_LIVE_SEND_TIMEOUT_MS % 1000) * 1000};
+    return select(fd + 1, NULL, &writeset, NULL, &timeout) > 0;
+}
+
+/**
+ * @brief 发送任务，在 HTTP 服务器任务中执行，发送客户端队列中所有的帧。
+ *        每帧发送前最多等待 APP_LIVE_SEND_TIMEOUT_MS，第一次超时或者发送失败就关闭连接，
+ *        慢客户端不会长时间占用 HTTP 服务器任务，也不会拖慢其他客户端。
+ * @param arg 客户端。
+ */
+static void app_live_send_work(void* arg) {
+    app_live_client_t* client = (app_live_client_t*)arg;
+    uint8_t frame[APP_LIVE_FRAME_LEN];
+    while (1) {
+        pthread_mutex_lock(&app_live_mutex);
+        int fd = client->fd;
+        if (fd < 0 || client->count == 0) {
+            client->pending = false;
+            pthread_mutex_unlock(&app_live_mutex);
+            return;
+        }
+        memcpy(frame, client->queue[client->head], sizeof(frame));
+        frame[3] = client->dropped > 255 ? 255 : (uint8_t)client->dropped;
+        client->dropped = 0;
+        client->head = (client->head + 1) % APP_LIVE_QUEUE_LEN;
+        client->count--;
+        pthread_mutex_unlock(&app_live_mutex);
+
+        httpd_ws_frame_t ws_frame = {
+            .type = HTTPD_WS_TYPE_BINARY,
+            .payload = frame,
+            .len = sizeof(frame),
+        };
+        bool writable = app_live_writable(fd);
+        if (!writable || httpd_ws_send_frame_async(app_live_server, fd, &ws_frame) != ESP_OK) {
+            ESP_LOGW(TAG, "------ %s，关闭客户端：%d", writable ? "发送失败" : "发送超时", fd);
+            pthread_mutex_lock(&app_live_mutex);
+            client->fd = -1;
+            client->pending = false;
+            pthread_mutex_unlock(&app_live_mutex);
+            httpd_sess_trigger_close(app_live_server, fd);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief 推送一条定位数据。
+ * @param gnss
+ */
+void app_live_push(const app_gnss_data_t* gnss) {
+    if (app_live_server == NULL) {
+        return;
+    }
+    uint8_t frame[APP_LIVE_FRAME_LEN];
+    pthread_mutex_lock(&app_live_mutex);
+    app_live_encode(gnss, frame);
+    for (int i = 0; i < APP_LIVE_CLIENT_MAX; i++) {
+        app_live_client_t* client = &app_live_clients[i];
+        if (client->fd < 0) {
+            continue;
+        }
+        if (client->count == APP_LIVE_QUEUE_LEN) {// 队列已满，丢弃最早的。
+            client->head = (client->head + 1) % APP_LIVE_QUEUE_LEN;
+            client->count--;
+            client->dropped++;
+        }
+        memcpy(client->queue[(client->head + client->count) % APP_LIVE_QUEUE_LEN], frame, sizeof(frame));
+        client->count++;
+        if (!client->pending) {
+            client->pending = httpd_queue_work(app_live_server, app_live_send_work, client) == ESP_OK;// 不阻塞，失败下一帧再提交。
+        }
+    }
+    pthread_mutex_unlock(&app_live_mutex);
+}
+
+/**
+ * @brief HTTP 服务器关闭连接时调用。
+ * @param sockfd
+ */
+void app_live_on_close(int sockfd) {
+    pthread_mutex_lock(&app_live_mutex);
+    for (int i = 0; i < APP_LIVE_CLIENT_MAX; i++) {
+        if (app_live_clients[i].fd == sockfd) {
+            app_live_clients[i].fd = -1;
+            ESP_LOGI(TAG, "------ 客户端断开：%d", sockfd);
+        }
+    }
+    pthread_mutex_unlock(&app_live_mutex);
+}
+
+/**
+ * @brief WebSocket 接口，GET /live。
+ *        握手时分配客户端位置，已满返回失败，连接关闭；之后收到的数据帧读取后丢弃。
+ * @param req
+ * @return
+ */
+static esp_err_t app_live_handler(httpd_req_t* req) {
+    if (req->method == HTTP_GET) {
+        int fd = httpd_req_to_sockfd(req);
+        app_live_client_t* client = NULL;
+        pthread_mutex_lock(&app_live_mutex);
+        for (int i = 0; i < APP_LIVE_CLIENT_MAX && client == NULL; i++) {
+            if (app_live_clients[i].fd < 0 && !app_live_clients[i].pending) {// 等待上一个连接的发送任务结束。
+                client = &app_live_clients[i];
+                client->fd = fd;
+                client->head = 0;
+                client->count = 0;
+                client->dropped = 0;
+            }
+        }
+        pthread_mutex_unlock(&app_live_mutex);
+        if (client == NULL) {
+            ESP_LOGW(TAG, "------ 客户端已满：%d，拒绝：%d", APP_LIVE_CLIENT_MAX, fd);
+            return ESP_FAIL;
+        }
+        ESP_LOGI(TAG, "------ 客户端连接：%d", fd);
+        return ESP_OK;
+    }
+
+    uint8_t buf[32];
+    httpd_ws_frame_t ws_frame = {0};
+    esp_err_t ret = httpd_ws_recv_frame(req, &ws_frame, 0);// 先读取长度。
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (ws_frame.len > sizeof(buf)) {// 客户端不需要发送数据，太长的帧直接关闭连接。
+        return ESP_FAIL;
+    }
+    ws_frame.payload = buf;
+    ret = httpd_ws_recv_frame(req, &ws_frame, sizeof(buf));// 读取后丢弃。
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief 注册 WebSocket 接口。
+ * @param server
+ * @return
+ */
+esp_err_t app_live_register(httpd_handle_t server) {
+    for (int i = 0; i < APP_LIVE_CLIENT_MAX; i++) {
+        app_live_clients[i].fd = -1;
+    }
+    static const httpd_uri_t uri = {
+        .uri = "/live",
+        .method = HTTP_GET,
+        .handler = app_live_handler,
+        .is_websocket = true,
+    };
+    esp_err_t ret = httpd_register_uri_handler(server, &uri);
+    if (ret == ESP_OK) {
+        app_live_server = server;
+    }
+    return ret;
+}
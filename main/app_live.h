@@ -0,0 +1,53 @@
+/**
+ * @brief   本地实时数据，WebSocket（ws://<热点 IP>/live），每条 RMC 推送一帧，不经过 MQTT 服务器。
+ *
+ *          GNSS 任务只编码一次，复制到每个客户端的队列（APP_LIVE_QUEUE_LEN 帧，满了丢弃最早的），
+ *          然后由 HTTP 服务器任务异步发送，慢客户端不会阻塞 GNSS 任务和主循环；第一次发送超时或者失败就关闭连接。
+ *
+ *          二进制帧，小端，28 字节：
+ *          偏移  类型      内容
+ *          0     uint8     版本，1。
+ *          1     uint8     标志，bit0 = 定位有效。
+ *          2     uint8     卫星数。
+ *          3     uint8     上一帧之后本客户端丢弃的帧数，最大 255。
+ *          4     uint32    序号，每帧加 1。
+ *          8     uint32    UTC 时间，秒。
+ *          12    int32     纬度 * 1e7。
+ *          16    int32     经度 * 1e7。
+ *          20    int32     高度，厘米。
+ *          24    uint16    速度，0.01 节。
+ *          26    uint16    航向，0.01 度。
+ *
+ *          压力测试：连接设备热点，运行 tools/live_load.py，多个客户端检查帧长度、版本和序号，
+ *          统计每个客户端的缺失帧数（应该等于帧中的丢弃数）和扇出延迟；慢客户端握手后不读取，
+ *          发送缓冲区满后设备等待可写超过 APP_LIVE_SEND_TIMEOUT_MS 就关闭连接，空位可以重新连接。
+ *          python3 tools/live_load.py --clients 7 --slow 1 --seconds 600
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#include "app_gnss.h"
+
+/**
+ * @brief 推送一条定位数据，GNSS 任务在 RMC 解析后调用，不阻塞。
+ * @param gnss 数据副本，调用时不持有 gnss->mutex。
+ */
+void app_live_push(const app_gnss_data_t* gnss);
+
+/**
+ * @brief HTTP 服务器关闭连接时调用，释放客户端位置。
+ * @param sockfd
+ */
+void app_live_on_close(int sockfd);
+
+/**
+ * @brief 注册 WebSocket 接口，app_web_init() 中调用，在静态文件的通配符之前注册。
+ * @param server
+ * @return
+ */
+esp_err_t app_live_register(httpd_handle_t server);
@@ -0,0 +1,201 @@
+/**
+ * @brief   LZSS 流式压缩，内存占用小，用于压缩 SD 卡封存段。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "esp_rom_crc.h"
+
+#include "app_lz.h"
+
+ /**
+ * @brief 空链表节点。
+ */
+#define APP_LZ_NIL                  0xFFFF
+
+ /**
+ * @brief 最多比较的候选位置数，限制最坏情况的 CPU 时间。
+ */
+#define APP_LZ_MAX_CHAIN            32
+
+/**
+ * @brief 3 字节哈希。
+ */
+static uint32_t app_lz_hash(const uint8_t* p) {
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - APP_LZ_HASH_BITS);
+}
+
+/**
+ * @brief 把位置加入哈希链表。
+ */
+static void app_lz_insert(app_lz_t* lz, size_t pos, size_t avail) {
+    if (pos + APP_LZ_MIN_MATCH > avail) {
+        return;
+    }
+    uint32_t h = app_lz_hash(lz->buf + pos);
+    lz->prev[pos] = lz->head[h];
+    lz->head[h] = (uint16_t)pos;
+}
+
+/**
+ * @brief 滑动窗口，丢弃前 APP_LZ_WINDOW_SIZE 字节，链表中的位置同步减小。
+ */
+static void app_lz_slide(app_lz_t* lz, size_t avail) {
+    memmove(lz->buf, lz->buf + APP_LZ_WINDOW_SIZE, avail - APP_LZ_WINDOW_SIZE);
+    for (int i = 0; i < APP_LZ_HASH_SIZE; i++) {
+        uint16_t v = lz->head[i];
+        lz->head[i] = (v == APP_LZ_NIL || v < APP_LZ_WINDOW_SIZE) ? APP_LZ_NIL : v - APP_LZ_WINDOW_SIZE;
+    }
+    for (int i = 0; i < APP_LZ_WINDOW_SIZE; i++) {
+        uint16_t v = lz->prev[i + APP_LZ_WINDOW_SIZE];
+        lz->prev[i] = (v == APP_LZ_NIL || v < APP_LZ_WINDOW_SIZE) ? APP_LZ_NIL : v - APP_LZ_WINDOW_SIZE;
+        lz->prev[i + APP_LZ_WINDOW_SIZE] = APP_LZ_NIL;
+    }
+}
+
+/**
+ * @brief 写出当前数据组。
+ */
+static int app_lz_flush_group(app_lz_t* lz, FILE* out) {
+    if (lz->group_items == 0) {
+        return 0;
+    }
+    if (fwrite(lz->group, 1, lz->group_len, out) != lz->group_len) {
+        return -1;
+    }
+    int len = lz->group_len;
+    lz->group[0] = 0;
+    lz->group_len = 1;
+    lz->group_items = 0;
+    return len;
+}
+
+/**
+ * @brief 输出字面量。
+ */
+static int app_lz_emit_literal(app_lz_t* lz, FILE* out, uint8_t c) {
+    lz->group[0] |= 1 << lz->group_items;
+    lz->group[lz->group_len++] = c;
+    lz->group_items++;
+    return lz->group_items == 8 ? app_lz_flush_group(lz, out) : 0;
+}
+
+/**
+ * @brief 输出匹配。
+ */
+static int app_lz_emit_match(app_lz_t* lz, FILE* out, size_t dist, size_t len) {
+    uint32_t d = dist - 1;
+    lz->group[lz->group_len++] = (uint8_t)(d >> 4);
+    lz->group[lz->group_len++] = (uint8_t)(((d & 0x0F) << 4) | (len - APP_LZ_MIN_MATCH));
+    lz->group_items++;
+    return lz->group_items == 8 ? app_lz_flush_group(lz, out) : 0;
+}
+
+/**
+ * @brief 压缩文件，in 从当前位置读到文件结尾，out 从当前位置写入。
+ * @param lz
+ * @param in
+ * @param out
+ * @return 压缩后的字节数（含文件头），失败返回 -1。
+ */
+int app_lz_compress_file(app_lz_t* lz, FILE* in, FILE* out) {
+    memset(lz->head, 0xFF, sizeof(lz->head));
+    memset(lz->prev, 0xFF, sizeof(lz->prev));
+    lz->group[0] = 0;
+    lz->group_len = 1;
+    lz->group_items = 0;
+
+    long header_pos = ftell(out);
+    uint8_t header[APP_LZ_HEADER_SIZE] = {'L', 'Z', 'S', '1'};
+    if (fwrite(header, 1, sizeof(header), out) != sizeof(header)) {// 先占位，压缩完成后回填。
+        return -1;
+    }
+    int total = sizeof(header);
+
+    size_t avail = fread(lz->buf, 1, sizeof(lz->buf), in);
+    if (ferror(in)) {// 读取错误不能当作文件结尾，否则生成文件头有效的截断数据，原文件随后被删除。
+        return -1;
+    }
+    int eof = avail < sizeof(lz->buf);
+    uint32_t raw_size = avail;
+    uint32_t crc = esp_rom_crc32_le(0, lz->buf, avail);
+
+    size_t pos = 0;
+    while (pos < avail) {
+        if (!eof && pos >= sizeof(lz->buf) - APP_LZ_MAX_MATCH) {// 预读数据不足一个最长匹配，滑动窗口。
+            app_lz_slide(lz, avail);
+            avail -= APP_LZ_WINDOW_SIZE;
+            pos -= APP_LZ_WINDOW_SIZE;
+            size_t read_len = fread(lz->buf + avail, 1, sizeof(lz->buf) - avail, in);
+            if (ferror(in)) {
+                return -1;
+            }
+            crc = esp_rom_crc32_le(crc, lz->buf + avail, read_len);
+            eof = read_len < sizeof(lz->buf) - avail;
+            avail += read_len;
+            raw_size += read_len;
+        }
+
+        size_t best_len = 0;
+        size_t best_dist = 0;
+        size_t max_len = avail - pos < APP_LZ_MAX_MATCH ? avail - pos : APP_LZ_MAX_MATCH;
+        if (max_len >= APP_LZ_MIN_MATCH) {
+            uint16_t cand = lz->head[app_lz_hash(lz->buf + pos)];
+            for (int chain = 0; cand != APP_LZ_NIL && chain < APP_LZ_MAX_CHAIN; chain++) {
+                size_t dist = pos - cand;
+                if (dist > APP_LZ_WINDOW_SIZE) {
+                    break;
+                }
+                size_t len = 0;
+                while (len < max_len && lz->buf[cand + len] == lz->buf[pos + len]) {
+                    len++;
+                }
+                if (len > best_len) {
+                    best_len = len;
+                    best_dist = dist;
+                    if (len == max_len) {
+                        break;
+                    }
+                }
+                cand = lz->prev[cand];
+            }
+        }
+
+        int ret;
+        if (best_len >= APP_LZ_MIN_MATCH) {
+            ret = app_lz_emit_match(lz, out, best_dist, best_len);
+            for (size_t i = 0; i < best_len; i++) {
+                app_lz_insert(lz, pos + i, avail);
+            }
+            pos += best_len;
+        } else {
+            ret = app_lz_emit_literal(lz, out, lz->buf[pos]);
+            app_lz_insert(lz, pos, avail);
+            pos++;
+        }
+        if (ret < 0) {
+            return -1;
+        }
+        total += ret;
+    }
+    int ret = app_lz_flush_group(lz, out);
+    if (ret < 0) {
+        return -1;
+    }
+    total += ret;
+
+    for (int i = 0; i < 4; i++) {// 回填原始字节数和 CRC。
+        header[4 + i] = (uint8_t)(raw_size >> (8 * i));
+        header[8 + i] = (uint8_t)(crc >> (8 * i));
+    }
+    long end_pos = ftell(out);
+    if (fseek(out, header_pos, SEEK_SET) != 0 || fwrite(header, 1, sizeof(header), out) != sizeof(header)) {
+        return -1;
+    }
+    fseek(out, end_pos, SEEK_SET);
+    return ferror(out) ? -1 : total;
+}
@@ -0,0 +1,52 @@
+/**
+ * @brief   LZSS 流式压缩，内存占用小，用于压缩 SD 卡封存段。
+ *
+ *          压缩文件格式（小端）：
+ *          [0..3]   魔数 "LZS1"
+ *          [4..7]   原始字节数。
+ *          [8..11]  原始数据 CRC32（esp_rom_crc32_le，初值 0）。
+ *          [12..]   数据组：1 个标志字节 + 最多 8 项，标志位从低位开始，
+ *                   1 = 字面量，1 字节；0 = 匹配，2 字节：
+ *                   距离 - 1 占 12 位（高 8 位在第 1 字节），长度 - 3 占 4 位。
+ *                   解压到原始字节数即结束，最后一组多余的标志位忽略。
+ *          参考解压程序：tools/lz_decode.py。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+ /**
+  * @brief 压缩参数：4 KB 滑动窗口，匹配长度 3~18 字节。
+  */
+#define APP_LZ_WINDOW_BITS          12
+#define APP_LZ_WINDOW_SIZE          (1 << APP_LZ_WINDOW_BITS)
+#define APP_LZ_MIN_MATCH            3
+#define APP_LZ_MAX_MATCH            (APP_LZ_MIN_MATCH + 15)
+#define APP_LZ_HASH_BITS            12
+#define APP_LZ_HASH_SIZE            (1 << APP_LZ_HASH_BITS)
+#define APP_LZ_HEADER_SIZE          12
+
+ /**
+  * @brief 压缩上下文，约 32 KB，使用时从堆中申请。
+  */
+typedef struct {
+    uint8_t buf[2 * APP_LZ_WINDOW_SIZE];        // 滑动窗口 + 预读数据。
+    uint16_t head[APP_LZ_HASH_SIZE];            // 哈希链表头。
+    uint16_t prev[2 * APP_LZ_WINDOW_SIZE];      // 哈希链表。
+    uint8_t group[1 + 8 * 2];                   // 当前数据组。
+    int group_len;                              // 当前数据组字节数。
+    int group_items;                            // 当前数据组项数。
+} app_lz_t;
+
+/**
+ * @brief 压缩文件，in 从当前位置读到文件结尾，out 从当前位置写入。
+ * @param lz
+ * @param in
+ * @param out
+ * @return 压缩后的字节数（含文件头），失败返回 -1。
+ */
+int app_lz_compress_file(app_lz_t* lz, FILE* in, FILE* out);
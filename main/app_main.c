@@ -7,6 +7,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
+#include <time.h>
 #include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
@@ -22,15 +24,23 @@
 
 #include "app_led.h"
 #include "app_deamon.h"
+#include "app_health.h"
 #include "app_sd.h"
 #include "app_wifi.h"
 #include "app_sntp.h"
 #include "app_mqtt.h"
+#include "app_outbox.h"
+#include "app_metrics.h"
+#include "app_ppp.h"
+#include "app_web.h"
 #include "app_gpio.h"
+#include "app_input.h"
 #include "app_ble.h"
 #include "app_gnss.h"
 #include "app_json.h"
 #include "app_ping.h"
+#include "app_track.h"
+#include "app_param.h"
 #include "app_main.h"
 #include "app_config.h"
 
@@ -61,6 +71,7 @@ app_main_data_t app_main_data = {
     .lon = 0.0,                             // 经度。
     .spd = 0.0,                             // 速度。
     .trk = 0.0,                             // 航向角度。
+    .seq = 0,                               // 记录序号。
     .f = 0,                                 // 初始化标记为 0。
 };
 
@@ -88,6 +99,78 @@ void get_gnss_utc_time(char* buffer, size_t buffer_size) {
     strftime(buffer, buffer_size, "%Y%m%d%H%M%S000", &timeinfo);// GNSS 时间没有毫秒数。
 }
 
+/**
+ * @brief 当前数据写入轨迹存储，只放入 SD 卡写入任务的队列，不在主循环中访问 SD 卡。
+ * @param gnss_tm GNSS UTC 时间。
+ */
+static void app_main_track_append(struct tm* gnss_tm) {
+    app_track_record_t record = {
+        .ts_ms = (int64_t)mktime(gnss_tm) * 1000,// 没有设置 TZ，mktime() 按 UTC 计算。
+        .lat_e7 = (int32_t)llround(app_main_data.lat * 10000000),
+        .lon_e7 = (int32_t)llround(app_main_data.lon * 10000000),
+        .alt_cm = (int32_t)llround(app_main_data.alt * 100),
+        .spd_cknot = (uint16_t)llround(app_main_data.spd * 100),
+        .trk_cdeg = (uint16_t)llround(app_main_data.trk * 100),
+        .mag_cdeg = (int16_t)llround(app_main_data.mag * 100),
+        .sat = (uint8_t)app_main_data.sat,
+        .flags = APP_TRACK_FLAG_VALID | (gpio_get_level(APP_GPIO_NUM_BLE) ? APP_TRACK_FLAG_BLE : 0),
+    };
+    app_sd_write_track(&record);
+}
+
+/**
+ * @brief 死区判断：定位有效、移动距离小于死区、GPIO 不变，并且距离上次推送不超过最长秒数时，不推送。
+ * @param now_ms
+ * @return
+ */
+static bool app_main_in_deadband(uint32_t now_ms) {
+    static bool last_valid = false;
+    static double last_lat = 0.0;
+    static double last_lon = 0.0;
+    static char last_gpios[sizeof(app_main_data.gpios)];
+    static uint32_t last_ms = 0;
+
+    app_param_t param;
+    app_param_get(&param);
+    bool skip = false;
+    if (param.deadband_m > 0 && app_main_data.gnss_valid && last_valid &&
+        now_ms - last_ms < param.deadband_max_s * 1000 && strcmp(app_main_data.gpios, last_gpios) == 0) {
+        double dy = (app_main_data.lat - last_lat) * 111320.0;// 每度约 111320 米，距离很短，按平面计算。
+        double dx = (app_main_data.lon - last_lon) * 111320.0 * cos(app_main_data.lat * M_PI / 180.0);
+        skip = dx * dx + dy * dy < (double)param.deadband_m * param.deadband_m;
+    }
+    if (!skip) {
+        last_valid = app_main_data.gnss_valid;
+        last_lat = app_main_data.lat;
+        last_lon = app_main_data.lon;
+        strcpy(last_gpios, app_main_data.gpios);
+        last_ms = now_ms;
+    }
+    return skip;
+}
+
+/**
+ * @brief 蓝牙钥匙进入或者离开，生成一条事件记录放入发件箱（与定位记录同一主题），格式与输入通道的事件记录相同：
+ *        {"devTime":"20240711024955148","evt":"ble","gpio":21,"key":"df:90:78:01:b0:37","active":1,"rssi":-70,"present":1,"f":0}
+ *        在 BLE 任务或者定时器任务中执行，发件箱只移动指针，不阻塞。
+ * @param event
+ */
+static void app_main_ble_event(const app_ble_event_t* event) {
+    char dev_time[24];
+    get_cur_utc_time(dev_time, sizeof(dev_time));
+    char json[192];// 写入缓存时会追加换行符，保留 2 个字节。
+    int len = snprintf(json, sizeof(json) - 2,
+        "{\"devTime\":\"%s\",\"evt\":\"ble\",\"gpio\":%d,\"key\":\"%02x:%02x:%02x:%02x:%02x:%02x\",\"active\":%d,\"rssi\":%d,\"present\":%u,\"f\":0}",
+        dev_time, APP_GPIO_NUM_BLE, event->key.val[5], event->key.val[4], event->key.val[3], event->key.val[2], event->key.val[1], event->key.val[0],
+        event->present, event->rssi, event->present_count);
+    if (len >= sizeof(json) - 2) {
+        ESP_LOGE(TAG, "------ 蓝牙事件记录被截断。");
+        return;
+    }
+    app_metrics_trace_t trace = {0};// 序号只用于定位记录，事件记录为 0。
+    app_outbox_put(json, &trace);
+}
+
 /**
  * @brief 循环任务。
  * @param
@@ -102,6 +185,7 @@ void app_main_loop_task(void) {
     app_gpio_get_string(app_main_data.gpios, sizeof(app_main_data.gpios));
 
     pthread_mutex_lock(&app_gnss_data.mutex);
+    struct tm gnss_tm = app_gnss_data.date_time;
     get_gnss_utc_time(app_main_data.gnss_time, sizeof(app_main_data.gnss_time));// GNSS 时间。
     app_main_data.gnss_valid = app_gnss_data.valid;// 有效性。
     app_main_data.sat = app_gnss_data.sat;// 卫星数。
@@ -111,21 +195,37 @@ void app_main_loop_task(void) {
     app_main_data.spd = app_gnss_data.spd;// 速度，默认单位：节。
     app_main_data.trk = app_gnss_data.trk;// 航向角度。
     app_main_data.mag = app_gnss_data.mag;// 磁偏角度。
+    app_metrics_trace_t trace = {
+        .rx_us = app_gnss_data.rx_us,// 收到 RMC 语句的时间。
+        .parse_us = app_gnss_data.parse_us,// RMC 语句解析完成的时间。
+    };
     pthread_mutex_unlock(&app_gnss_data.mutex);
 
+    if (app_main_data.gnss_valid) {// 有效定位写入轨迹存储。
+        app_main_track_append(&gnss_tm);
+    }
+
+    if (app_main_in_deadband(esp_log_ts)) {// 在死区内不推送，也不写入缓存，轨迹存储不受影响。
+        app_sd_fsync_log_file();
+        return;
+    }
+
+    trace.seq = ++app_main_data.seq;// 死区内不推送的记录不占用序号。
     char json[512];
     app_json_serialize(json, sizeof(json), &app_main_data);
 
-    // 如果有 MQTT，则 MQTT 推送到服务器。
+    // 如果有 MQTT，则放入发件箱，由发件箱任务推送到服务器，不等待网络。
     if (app_mqtt_5_client != NULL) {
 
-        int pub_ret = app_mqtt_publish_msg(json);
-        if (pub_ret >= 0) {// 推送成功。
+        app_outbox_status_t pub_status = app_outbox_put(json, &trace);
+        if (pub_status == APP_OUTBOX_QUEUED) {// 已放入发件箱。
             app_led_set_value(0, 10, 0, 0, 10, 0, app_main_data.gnss_valid);// 只闪绿色。
 
-        } else {// 推送失败，写入缓存。
-            app_sd_write_cache_file(json);
+        } else if (pub_status == APP_OUTBOX_SPILLED) {// 未连接，由发件箱任务写入缓存。
             app_led_set_value(10, 0, 0, 0, 10, 0, app_main_data.gnss_valid);// 红绿交替闪烁。
+
+        } else {// 内存不足，数据丢弃。
+            app_led_set_value(10, 0, 0, 10, 0, 0, app_main_data.gnss_valid);// 只闪红色。
         }
 
     } else {// 没有 MQTT，直接写入缓存文件。
@@ -160,6 +260,27 @@ void app_main(void) {
 
     app_sd_fsync_log_file();// 把日志写入 SD 卡。
 
+    // 初始化轨迹存储，依赖 SD 卡。
+    if (sd_ret == ESP_OK) {
+        esp_err_t track_ret = app_track_init();
+        if (track_ret != ESP_OK) {
+            ESP_LOGE(TAG, "------ 初始化轨迹存储：失败！");
+        } else {
+            ESP_LOGI(TAG, "------ 初始化轨迹存储：OK。");
+        }
+    }
+
+    // 初始化发件箱，在输入通道和蓝牙之前，事件记录由发件箱任务写入缓存，回调中不写 SD 卡。不依赖 MQTT，MQTT 连接之前全部写入缓存。
+    esp_err_t outbox_ret = app_outbox_init();
+    if (outbox_ret != ESP_OK) {
+        app_led_set_value(10, 10, 0, 10, 0, 0, 0);// 黄红交替闪烁。
+        ESP_LOGE(TAG, "------ 初始化发件箱：失败！");
+    } else {
+        ESP_LOGI(TAG, "------ 初始化发件箱：OK。");
+    }
+
+    app_sd_fsync_log_file();// 把日志写入 SD 卡。
+
     // 初始化守护任务。
     esp_err_t deamon_ret = app_deamon_init();
     if (deamon_ret != ESP_OK) {
@@ -182,6 +303,19 @@ void app_main(void) {
 
     app_sd_fsync_log_file();// 把日志写入 SD 卡。
 
+    // 初始化输入通道，失败不终止运行。事件在 MQTT 连接之前写入缓存。
+    if (APP_INPUT_ENABLE && gpio_ret == ESP_OK) {
+        esp_err_t input_ret = app_input_init();
+        if (input_ret != ESP_OK) {
+            app_led_set_value(10, 10, 0, 10, 0, 0, 0);// 黄红交替闪烁。
+            ESP_LOGE(TAG, "------ 初始化输入通道：失败！");
+        } else {
+            ESP_LOGI(TAG, "------ 初始化输入通道：OK。");
+        }
+    }
+
+    app_sd_fsync_log_file();// 把日志写入 SD 卡。
+
     // 初始化 NVS，失败则终止运行。因为其它功能依赖于 NVS。
     esp_err_t nvs_ret = nvs_flash_init();
     if (nvs_ret == ESP_ERR_NVS_NO_FREE_PAGES || nvs_ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {// 如果 NVS 分区空间不足或者发现新版本，需要擦除 NVS 分区并重试初始化。
@@ -201,6 +335,24 @@ void app_main(void) {
         ESP_LOGI(TAG, "------ 初始化 NVS：OK。");
     }
 
+    // 设备密码，第一次启动时生成，必须在蓝牙和 WIFI 启动之前。
+    esp_err_t key_ret = app_wifi_device_key_init();
+    if (key_ret != ESP_OK) {
+        ESP_LOGE(TAG, "------ 初始化设备密码：失败！");
+    } else {
+        ESP_LOGI(TAG, "------ 初始化设备密码：OK。");
+    }
+
+    app_sd_fsync_log_file();// 把日志写入 SD 卡。
+
+    // 初始化运行参数，失败时使用默认值。
+    esp_err_t param_ret = app_param_init();
+    if (param_ret != ESP_OK) {
+        ESP_LOGE(TAG, "------ 初始化运行参数：失败！");
+    } else {
+        ESP_LOGI(TAG, "------ 初始化运行参数：OK。");
+    }
+
     app_sd_fsync_log_file();// 把日志写入 SD 卡。
 
     // 初始化事件循环，主要用于网络接口。
@@ -230,6 +382,7 @@ void app_main(void) {
 
     // 初始化 BLE，失败不终止运行。
     if (gpio_ret == ESP_OK) {
+        app_ble_set_event_cb(app_main_ble_event);// 先设置回调，启动后的第一次进入也生成事件记录。
         esp_err_t ble_ret = app_ble_init();
         if (ble_ret != ESP_OK) {
             app_led_set_value(10, 10, 0, 10, 0, 0, 0);// 黄红交替闪烁。
@@ -255,6 +408,36 @@ void app_main(void) {
 
     app_sd_fsync_log_file();// 把日志写入 SD 卡。
 
+#if APP_PPP_ENABLE
+    // 初始化 4G 备用上行，失败不终止运行。
+    if (wifi_ret == ESP_OK) {
+        esp_err_t ppp_ret = app_ppp_init();
+        if (ppp_ret != ESP_OK) {
+            app_led_set_value(10, 10, 0, 10, 0, 0, 0);// 黄红交替闪烁。
+            ESP_LOGE(TAG, "------ 初始化 PPP：失败！");
+        } else {
+            ESP_LOGI(TAG, "------ 初始化 PPP：OK。");
+        }
+    }
+
+    app_sd_fsync_log_file();// 把日志写入 SD 卡。
+#endif
+
+#if APP_WIFI_AP_ENABLE
+    // 初始化本地网页服务器，失败不终止运行。
+    if (wifi_ret == ESP_OK) {
+        esp_err_t web_ret = app_web_init();
+        if (web_ret != ESP_OK) {
+            app_led_set_value(10, 10, 0, 10, 0, 0, 0);// 黄红交替闪烁。
+            ESP_LOGE(TAG, "------ 初始化网页服务器：失败！");
+        } else {
+            ESP_LOGI(TAG, "------ 初始化网页服务器：OK。");
+        }
+    }
+
+    app_sd_fsync_log_file();// 把日志写入 SD 卡。
+#endif
+
     // 初始化 SNTP。
     esp_err_t sntp_ret = ESP_FAIL;
     if (wifi_ret == ESP_OK) {
@@ -272,7 +455,7 @@ void app_main(void) {
     // 初始化 MQTT，失败不终止运行。可以写数据到本地。
     esp_err_t mqtt_ret = ESP_FAIL;
     if (wifi_ret == ESP_OK) {
-        mqtt_ret = app_mqtt_init(app_main_data.dev_addr, strlen(app_main_data.dev_addr));
+        mqtt_ret = app_mqtt_init(app_main_data.dev_addr);
         if (mqtt_ret != ESP_OK) {
             app_led_set_value(10, 10, 0, 10, 0, 0, 0);// 黄红交替闪烁。
             ESP_LOGE(TAG, "------ 初始化 MQTT：失败！");
@@ -283,8 +466,15 @@ void app_main(void) {
 
     app_sd_fsync_log_file();// 把日志写入 SD 卡。
 
-    // 初始化 PING 功能。
-    if (wifi_ret == ESP_OK) {
+    // 初始化推送统计。
+    if (mqtt_ret == ESP_OK) {
+        app_metrics_init();// 推送延迟和投递统计。
+    }
+
+    app_sd_fsync_log_file();// 把日志写入 SD 卡。
+
+    // 初始化 PING 功能，网络健康监测的可选探测。
+    if (APP_HEALTH_PING_ENABLE && wifi_ret == ESP_OK) {
         esp_err_t ping_ret = app_ping_init();
         if (ping_ret != ESP_OK) {
             app_led_set_value(10, 10, 0, 10, 0, 0, 0);// 黄红交替闪烁。
@@ -294,6 +484,15 @@ void app_main(void) {
         }
     }
 
+    // 初始化网络健康监测。
+    esp_err_t health_ret = app_health_init();
+    if (health_ret != ESP_OK) {
+        app_led_set_value(10, 10, 0, 10, 0, 0, 0);// 黄红交替闪烁。
+        ESP_LOGE(TAG, "------ 初始化网络健康监测：失败！");
+    } else {
+        ESP_LOGI(TAG, "------ 初始化网络健康监测：OK。");
+    }
+
     app_sd_fsync_log_file();// 把日志写入 SD 卡。
 
     // 初始化 GNSS。
@@ -314,7 +513,6 @@ void app_main(void) {
     }
 
     ESP_LOGI(TAG, "------ APP MAIN 启动主任务循环......");
-    const TickType_t task_period = pdMS_TO_TICKS(1000);
     while (1) {
         TickType_t start_tick = xTaskGetTickCount();// 开始时间。
 
@@ -324,6 +522,26 @@ void app_main(void) {
         // vTaskGetRunTimeStats(buffer);
         // printf("---------------------------------------------\n%s", buffer);
 
+        app_param_t param;// 采样间隔可以远程调整。
+        app_param_get(&param);
+        uint32_t period_ms;
+        if (app_param_burst()) {// 突发模式。
+            period_ms = param.burst_ms;
+        } else if (app_main_data.gnss_valid == false || app_main_data.spd < param.spd_mid) {// 数据无效，或者停止未移动。
+            period_ms = param.sample_slow_ms;
+        } else if (app_main_data.spd < param.spd_fast) {// 低速移动。
+            period_ms = param.sample_mid_ms;
+        } else {
+            period_ms = param.sample_fast_ms;
+        }
+        if (!app_param_burst() && app_ppp_active()) {// 蜂窝网络按流量计费，降低采样频率。
+            period_ms *= APP_PPP_SAMPLE_FACTOR;
+        }
+        if (period_ms > APP_SAMPLE_MAX_MS) {// 乘以倍数后可能超过守护任务的超时时间。
+            period_ms = APP_SAMPLE_MAX_MS;
+        }
+        const TickType_t task_period = pdMS_TO_TICKS(period_ms);
+
         TickType_t end_tick = xTaskGetTickCount();// 结束时间。
         TickType_t task_duration = end_tick - start_tick;
         if (task_duration > task_period) {// 是否需要延时至下一个周期。
@@ -331,12 +549,5 @@ void app_main(void) {
         } else {
             vTaskDelay(task_period - task_duration);
         }
-        if (app_main_data.gnss_valid == false) {// 如果数据无效，延迟 4 秒，5 秒一次。
-            vTaskDelay(pdMS_TO_TICKS(4000));
-        } else if (app_main_data.spd < 5) {// 停止未移动，速度小于 9.26 公里，5 秒一次。
-            vTaskDelay(pdMS_TO_TICKS(4000));
-        } else if (app_main_data.spd < 30) {// 低速移动，速度小于 55.56 公里，2 秒一次。
-            vTaskDelay(pdMS_TO_TICKS(1000));
-        }
     }
 }
@@ -6,6 +6,7 @@
  */
 #pragma once
 
+#include <stdint.h>
 #include <stdbool.h>
 
  /**
@@ -33,6 +34,7 @@ typedef struct {
     double spd;             // 速度，默认单位：节。
     double trk;             // 航向角度。
     double mag;             // 磁偏角度。
+    uint32_t seq;           // 记录序号，启动后递增，服务器端按序号统计丢失和乱序。
 
     // 温度。
     // 湿度。
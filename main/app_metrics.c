@@ -0,0 +1,234 @@
+/**
+ * @brief   端到端推送延迟和投递统计，定期发布到指标主题。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_metrics.h"
+#include "app_mqtt.h"
+#include "app_health.h"
+#include "app_ble.h"
+#include "app_config.h"
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_metrics";
+
+/**
+ * @brief 统计的阶段。
+ */
+typedef enum {
+    APP_METRICS_STAGE_PARSE = 0,    // UART 收到 -> 解析完成。
+    APP_METRICS_STAGE_ENQUEUE,      // 解析完成 -> 放入发件箱。
+    APP_METRICS_STAGE_PUBLISH,      // 放入发件箱 -> 交给 MQTT 客户端。
+    APP_METRICS_STAGE_ACK,          // 交给 MQTT 客户端 -> 服务器确认。
+    APP_METRICS_STAGE_E2E,          // UART 收到 -> 服务器确认。
+    APP_METRICS_STAGE_OFFLINE,      // MQTT 断开 -> 重新连接。
+    APP_METRICS_STAGE_RESUME,       // MQTT 重新连接 -> 第一次发布。
+    APP_METRICS_STAGE_TLS,          // TLS 握手。
+    APP_METRICS_STAGE_WIFI,         // WIFI 断开 -> 重新获取 IP。
+    APP_METRICS_STAGE_COUNT,
+} app_metrics_stage_t;
+
+static const char* app_metrics_stage_names[APP_METRICS_STAGE_COUNT] = {"parse", "enqueue", "publish", "ack", "e2e", "offline", "resume", "tls", "wifi"};
+
+static const char* app_metrics_counter_names[APP_METRICS_COUNTER_COUNT] = {"queued", "acked", "failed", "spilled", "dropped", "reconnects", "resumed", "tlsFull", "tlsTicket", "wifiRetries", "wifiRoams"};
+
+static const uint32_t app_metrics_buckets_ms[APP_METRICS_BUCKET_COUNT - 1] = APP_METRICS_BUCKETS_MS;
+
+/**
+ * @brief 一个统计周期的数据。
+ */
+typedef struct {
+    uint32_t hist[APP_METRICS_STAGE_COUNT][APP_METRICS_BUCKET_COUNT];   // 各阶段耗时分布。
+    uint32_t max_ms[APP_METRICS_STAGE_COUNT];                           // 各阶段最大耗时。
+    uint32_t counters[APP_METRICS_COUNTER_COUNT];                       // 计数器。
+    uint32_t outbox_max;                                                // 发件箱最大深度。
+    uint32_t last_seq;                                                  // 最近确认的记录序号。
+} app_metrics_data_t;
+
+static app_metrics_data_t app_metrics_data;
+
+/**
+ * @brief 互斥锁。
+ */
+static pthread_mutex_t app_metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 计数器加 1。
+ * @param counter
+ */
+void app_metrics_count(app_metrics_counter_t counter) {
+    pthread_mutex_lock(&app_metrics_mutex);
+    app_metrics_data.counters[counter]++;
+    pthread_mutex_unlock(&app_metrics_mutex);
+}
+
+/**
+ * @brief 记录发件箱深度，统计周期内的最大值。
+ * @param depth
+ */
+void app_metrics_outbox_depth(uint32_t depth) {
+    pthread_mutex_lock(&app_metrics_mutex);
+    if (depth > app_metrics_data.outbox_max) {
+        app_metrics_data.outbox_max = depth;
+    }
+    pthread_mutex_unlock(&app_metrics_mutex);
+}
+
+/**
+ * @brief 记录一个阶段的耗时，任一端为 0 时不记录。
+ *        调用前必须持有互斥锁。
+ */
+static void app_metrics_stage(app_metrics_stage_t stage, int64_t from_us, int64_t to_us) {
+    if (from_us == 0 || to_us == 0 || to_us < from_us) {
+        return;
+    }
+    uint32_t ms = (to_us - from_us) / 1000;
+    int bucket = 0;
+    while (bucket < APP_METRICS_BUCKET_COUNT - 1 && ms > app_metrics_buckets_ms[bucket]) {
+        bucket++;
+    }
+    app_metrics_data.hist[stage][bucket]++;
+    if (ms > app_metrics_data.max_ms[stage]) {
+        app_metrics_data.max_ms[stage] = ms;
+    }
+}
+
+/**
+ * @brief 服务器已确认，统计各阶段耗时。
+ * @param trace
+ * @param ack_us
+ */
+void app_metrics_acked(const app_metrics_trace_t* trace, int64_t ack_us) {
+    pthread_mutex_lock(&app_metrics_mutex);
+    app_metrics_data.counters[APP_METRICS_ACKED]++;
+    if (trace->seq != 0) {// 事件记录没有序号。
+        app_metrics_data.last_seq = trace->seq;
+    }
+    app_metrics_stage(APP_METRICS_STAGE_PARSE, trace->rx_us, trace->parse_us);
+    app_metrics_stage(APP_METRICS_STAGE_ENQUEUE, trace->parse_us, trace->enqueue_us);
+    app_metrics_stage(APP_METRICS_STAGE_PUBLISH, trace->enqueue_us, trace->publish_us);
+    app_metrics_stage(APP_METRICS_STAGE_ACK, trace->publish_us, ack_us);
+    app_metrics_stage(APP_METRICS_STAGE_E2E, trace->rx_us, ack_us);
+    pthread_mutex_unlock(&app_metrics_mutex);
+}
+
+/**
+ * @brief MQTT 重连后第一次发布，统计断开时长和连接到第一次发布的耗时。
+ * @param disconnected_us 断开连接的时间，0 表示启动后第一次连接。
+ * @param connected_us
+ * @param first_pub_us
+ */
+void app_metrics_reconnect(int64_t disconnected_us, int64_t connected_us, int64_t first_pub_us) {
+    pthread_mutex_lock(&app_metrics_mutex);
+    app_metrics_stage(APP_METRICS_STAGE_OFFLINE, disconnected_us, connected_us);
+    app_metrics_stage(APP_METRICS_STAGE_RESUME, connected_us, first_pub_us);
+    pthread_mutex_unlock(&app_metrics_mutex);
+}
+
+/**
+ * @brief TLS 握手完成，统计握手耗时。
+ * @param start_us
+ * @param done_us
+ * @param resumed true = 服务器接受会话票据，恢复了会话。
+ */
+void app_metrics_tls_handshake(int64_t start_us, int64_t done_us, bool resumed) {
+    pthread_mutex_lock(&app_metrics_mutex);
+    app_metrics_data.counters[resumed ? APP_METRICS_TLS_TICKET : APP_METRICS_TLS_FULL]++;
+    app_metrics_stage(APP_METRICS_STAGE_TLS, start_us, done_us);
+    pthread_mutex_unlock(&app_metrics_mutex);
+}
+
+/**
+ * @brief WIFI 重新获取 IP，统计断开时长。
+ * @param disconnected_us
+ * @param connected_us
+ */
+void app_metrics_wifi_reconnect(int64_t disconnected_us, int64_t connected_us) {
+    pthread_mutex_lock(&app_metrics_mutex);
+    app_metrics_stage(APP_METRICS_STAGE_WIFI, disconnected_us, connected_us);
+    pthread_mutex_unlock(&app_metrics_mutex);
+}
+
+/**
+ * @brief 统计数据转换为 JSON，格式：
+ *        {"intervalS":60,"lastSeq":123,"queued":60,...,"outboxMax":3,"lat":{"parse":{"max":1,"hist":[...]},...},"health":{"score":100,...},"radio":{...}}
+ * @return 字节数，缓冲区不够返回 -1。
+ */
+static int app_metrics_to_json(const app_metrics_data_t* data, const app_health_t* health, const app_ble_radio_t* radio, char* buffer, size_t size) {
+    size_t len = snprintf(buffer, size, "{\"intervalS\":%d,\"lastSeq\":%lu", APP_METRICS_INTERVAL_MS / 1000, data->last_seq);
+    for (int i = 0; i < APP_METRICS_COUNTER_COUNT && len < size; i++) {
+        len += snprintf(buffer + len, size - len, ",\"%s\":%lu", app_metrics_counter_names[i], data->counters[i]);
+    }
+    if (len < size) {
+        len += snprintf(buffer + len, size - len, ",\"outboxMax\":%lu,\"lat\":{", data->outbox_max);
+    }
+    for (int i = 0; i < APP_METRICS_STAGE_COUNT && len < size; i++) {
+        len += snprintf(buffer + len, size - len, "%s\"%s\":{\"max\":%lu,\"hist\":[", i == 0 ? "" : ",", app_metrics_stage_names[i], data->max_ms[i]);
+        for (int j = 0; j < APP_METRICS_BUCKET_COUNT && len < size; j++) {
+            len += snprintf(buffer + len, size - len, "%s%lu", j == 0 ? "" : ",", data->hist[i][j]);
+        }
+        if (len < size) {
+            len += snprintf(buffer + len, size - len, "]}");
+        }
+    }
+    if (len < size) {
+        len += snprintf(buffer + len, size - len, "},\"health\":{\"score\":%u,\"level\":%u,\"okPermille\":%u,\"rttAvg\":%lu,\"rttVar\":%lu,\"rttMax\":%lu,\"ping\":%ld}",
+            health->score, health->level, health->ok_permille, health->rtt_avg_ms, health->rtt_var_ms, health->rtt_max_ms, health->ping_ms);
+    }
+    if (len < size) {// 射频时间：蓝牙扫描窗口，其余留给 WIFI。
+        len += snprintf(buffer + len, size - len, ",\"radio\":{\"totalMs\":%lu,\"bleMs\":%lu,\"wifiMs\":%lu,\"fastMs\":%lu,\"slowMs\":%lu,\"yieldMs\":%lu,\"switches\":%lu}}",
+            radio->total_ms, radio->scan_ms, radio->total_ms - radio->scan_ms,
+            radio->mode_ms[APP_BLE_SCAN_FAST], radio->mode_ms[APP_BLE_SCAN_SLOW], radio->mode_ms[APP_BLE_SCAN_YIELD], radio->switches);
+    }
+    return len < size ? (int)len : -1;
+}
+
+/**
+ * @brief 定期发布任务，发布后清零。未连接时只输出日志。
+ * @param param
+ */
+static void app_metrics_task(void* param) {
+    static char buffer[2048];
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(APP_METRICS_INTERVAL_MS));
+        pthread_mutex_lock(&app_metrics_mutex);
+        app_metrics_data_t data = app_metrics_data;
+        memset(&app_metrics_data, 0, sizeof(app_metrics_data));
+        pthread_mutex_unlock(&app_metrics_mutex);
+        app_health_t health;
+        app_health_get(&health, true);
+        app_ble_radio_t radio;
+        app_ble_get_radio(&radio, true);
+
+        int len = app_metrics_to_json(&data, &health, &radio, buffer, sizeof(buffer));
+        if (len < 0) {
+            ESP_LOGE(TAG, "------ 指标 JSON 缓冲区不足！");
+            continue;
+        }
+        ESP_LOGI(TAG, "------ 推送指标：%s", buffer);
+        if (atomic_load(&app_mqtt_connected)) {
+            app_mqtt_publish(APP_MQTT_TOPIC_METRICS, buffer, len, 0);// 指标丢失不重要，QoS 0。
+        }
+    }
+}
+
+/**
+ * @brief 初始化函数，MQTT 初始化之后调用，启动定期发布任务。
+ * @return
+ */
+esp_err_t app_metrics_init(void) {
+    xTaskCreate(app_metrics_task, "app_metrics_task", 3072, NULL, 2, NULL);
+    return ESP_OK;
+}
@@ -0,0 +1,97 @@
+/**
+ * @brief   端到端推送延迟和投递统计，定期发布到指标主题。
+ *
+ *          每条实时记录带序号和各阶段时间：UART 收到定位语句、解析完成、放入发件箱、交给 MQTT 客户端、服务器确认。
+ *          相邻阶段的耗时和端到端耗时按固定区间统计，区间上限见 APP_METRICS_BUCKETS_MS。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+ /**
+  * @brief 延迟区间上限，单位：毫秒；最后一个区间不设上限。
+  */
+#define APP_METRICS_BUCKETS_MS      {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000}
+#define APP_METRICS_BUCKET_COUNT    13
+
+/**
+ * @brief 一条记录各阶段的时间，esp_timer_get_time()，0 表示没有经过该阶段。
+ */
+typedef struct {
+    uint32_t seq;               // 记录序号。
+    int64_t rx_us;              // UART 收到定位语句。
+    int64_t parse_us;           // 解析完成。
+    int64_t enqueue_us;         // 放入发件箱。
+    int64_t publish_us;         // 交给 MQTT 客户端。
+} app_metrics_trace_t;
+
+/**
+ * @brief 计数器。
+ */
+typedef enum {
+    APP_METRICS_QUEUED = 0,     // 放入发件箱。
+    APP_METRICS_ACKED,          // 服务器已确认。
+    APP_METRICS_FAILED,         // 发送失败或者未确认。
+    APP_METRICS_SPILLED,        // 写入缓存。
+    APP_METRICS_DROPPED,        // 丢弃。
+    APP_METRICS_RECONNECTS,     // MQTT 重连次数。
+    APP_METRICS_RESUMED,        // 重连时服务器保留了会话。
+    APP_METRICS_TLS_FULL,       // TLS 完整握手。
+    APP_METRICS_TLS_TICKET,     // TLS 使用会话票据恢复会话，服务器未接受票据时计入完整握手。
+    APP_METRICS_WIFI_RETRIES,   // WIFI 重连尝试次数。
+    APP_METRICS_WIFI_ROAMS,     // WIFI 信号弱时切换 AP 次数。
+    APP_METRICS_COUNTER_COUNT,
+} app_metrics_counter_t;
+
+/**
+ * @brief 计数器加 1。
+ * @param counter
+ */
+void app_metrics_count(app_metrics_counter_t counter);
+
+/**
+ * @brief 记录发件箱深度，统计周期内的最大值。
+ * @param depth
+ */
+void app_metrics_outbox_depth(uint32_t depth);
+
+/**
+ * @brief 服务器已确认，统计各阶段耗时。
+ * @param trace
+ * @param ack_us
+ */
+void app_metrics_acked(const app_metrics_trace_t* trace, int64_t ack_us);
+
+/**
+ * @brief MQTT 重连后第一次发布，统计断开时长和连接到第一次发布的耗时。
+ * @param disconnected_us 断开连接的时间，0 表示启动后第一次连接。
+ * @param connected_us
+ * @param first_pub_us
+ */
+void app_metrics_reconnect(int64_t disconnected_us, int64_t connected_us, int64_t first_pub_us);
+
+/**
+ * @brief TLS 握手完成，统计握手耗时。
+ * @param start_us
+ * @param done_us
+ * @param resumed true = 服务器接受会话票据，恢复了会话。
+ */
+void app_metrics_tls_handshake(int64_t start_us, int64_t done_us, bool resumed);
+
+/**
+ * @brief WIFI 重新获取 IP，统计断开时长。
+ * @param disconnected_us
+ * @param connected_us
+ */
+void app_metrics_wifi_reconnect(int64_t disconnected_us, int64_t connected_us);
+
+/**
+ * @brief 初始化函数，MQTT 初始化之后调用，启动定期发布任务。
+ * @return
+ */
+esp_err_t app_metrics_init(void);
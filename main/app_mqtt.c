@@ -12,9 +12,14 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "mqtt_client.h"
 
 #include "app_sd.h"
+#include "app_pub.h"
+#include "app_param.h"
+#include "app_metrics.h"
+#include "app_tls.h"
 #include "app_config.h"
 
  /**
@@ -32,47 +37,124 @@ static int app_mqtt_init_status = 0;
  */
 _Atomic uint32_t app_mqtt_last_ts = ATOMIC_VAR_INIT(0);
 
+/**
+ * @brief MQTT 是否已连接。
+ */
+_Atomic int app_mqtt_connected = ATOMIC_VAR_INIT(0);
+
 /**
  * @brief MQTT 客户端。
  */
 esp_mqtt_client_handle_t app_mqtt_5_client;
 
 /**
- * @brief 是否推送日志备份文件。
+ * @brief 本设备的主题名称，初始化时按模板生成。
+ */
+static char app_mqtt_topics[APP_MQTT_TOPIC_COUNT][64];
+
+/**
+ * @brief 连接序号，连接和断开时加 1，别名只在一次连接内有效。
+ *        MQTT 任务只修改序号，不等待发布互斥锁：发布者持有互斥锁时会等待 MQTT 客户端的锁。
+ */
+static _Atomic uint32_t app_mqtt_conn_seq = ATOMIC_VAR_INIT(0);
+
+/**
+ * @brief 已经建立别名的主题（按位）和建立时的连接序号，由发布互斥锁保护。
+ */
+static uint32_t app_mqtt_alias_ready = 0;
+static uint32_t app_mqtt_alias_seq = 0;
+
+/**
+ * @brief 重连统计：断开时间、连接时间，连接后第一次发布时计入统计，见 app_metrics_reconnect()。
+ *        时间只在 MQTT 任务中写入，写入后才设置 app_mqtt_first_pub。
+ */
+static int64_t app_mqtt_disconnected_us = 0;
+static int64_t app_mqtt_offline_us = 0;
+static int64_t app_mqtt_connected_us = 0;
+static _Atomic int app_mqtt_first_pub = ATOMIC_VAR_INIT(0);
+
+/**
+ * @brief 发布互斥锁。发布属性只对下一次发布有效，设置属性和发布不能被其它任务打断。
+ */
+static pthread_mutex_t app_mqtt_pub_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 主题别名，0 表示不使用别名。
+ *        只有 QoS 0 的消息只发送别名：QoS 1 的消息断开后由 outbox 在新连接中原样重发，新连接没有这个别名，
+ *        服务器按协议错误断开，所以 QoS 1 的消息总是发送完整主题名称。指标固定 QoS 0，日志按 APP_MQTT_LOG_QOS。
+ */
+static uint16_t app_mqtt_topic_alias(app_mqtt_topic_t topic, int qos) {
+#if APP_MQTT_TOPIC_ALIAS
+    if (qos == 0 && topic == APP_MQTT_TOPIC_METRICS) {
+        return 1;
+    }
+    if (qos == 0 && topic == APP_MQTT_TOPIC_LOG) {
+        return 2;
+    }
+#endif
+    return 0;
+}
+
+/**
+ * @brief 本设备的主题名称。
+ * @param topic
+ * @return
  */
-static int app_mqtt_pub_bak_count = 0;
+const char* app_mqtt_topic(app_mqtt_topic_t topic) {
+    return app_mqtt_topics[topic];
+}
 
 /**
  * @brief MQTT 发消息给服务器。
- * @param msg
+ *        使用别名的主题，本次连接第一次发布时同时发送完整名称和别名，建立别名，之后只发送别名。
+ * @param topic
+ * @param data
+ * @param len
+ * @param qos
  * @return message_id of the publish message (for QoS 0 message_id will always
- *          be zero) on success. -1 on failure, -2 in case of full outbox.
+ *          be zero) on success. -1 on failure.
  */
-int app_mqtt_publish_msg(char* msg) {
+int app_mqtt_publish(app_mqtt_topic_t topic, const char* data, size_t len, int qos) {
     if (app_mqtt_init_status == 0) {
         ESP_LOGE(TAG, "------ MQTT 初始化失败，MQTT 客户端状态：不可用！");
         return -1;
     }
-    int ret = esp_mqtt_client_publish(app_mqtt_5_client, APP_MQTT_PUB_MGS_TOPIC, msg, strlen(msg), APP_MQTT_QOS, 0);
-    if (ret >= 0) {
-        atomic_store(&app_mqtt_last_ts, esp_log_timestamp());
+    pthread_mutex_lock(&app_mqtt_pub_mutex);
+    uint32_t conn_seq = atomic_load(&app_mqtt_conn_seq);
+    if (app_mqtt_alias_seq != conn_seq) {// 新的连接，别名全部重新建立。
+        app_mqtt_alias_seq = conn_seq;
+        app_mqtt_alias_ready = 0;
+    }
+    const char* name = app_mqtt_topics[topic];
+    esp_mqtt5_publish_property_config_t property = {
+        .topic_alias = app_mqtt_topic_alias(topic, qos),
+    };
+    if (property.topic_alias != 0 && esp_mqtt5_client_set_publish_property(app_mqtt_5_client, &property) != ESP_OK) {
+        property.topic_alias = 0;
+    }
+    if (property.topic_alias != 0 && (app_mqtt_alias_ready & (1 << topic))) {
+        name = "";// 只发送别名。
+    }
+    int ret = esp_mqtt_client_publish(app_mqtt_5_client, name, data, len, qos, 0);
+    if (ret >= 0 && property.topic_alias != 0) {// 已经发送过完整名称和别名。
+        app_mqtt_alias_ready |= 1 << topic;
+    }
+    pthread_mutex_unlock(&app_mqtt_pub_mutex);
+    if (ret >= 0 && atomic_exchange(&app_mqtt_first_pub, 0)) {// 连接后第一次发布。
+        int64_t now_us = esp_timer_get_time();
+        app_metrics_reconnect(app_mqtt_offline_us, app_mqtt_connected_us, now_us);
+        ESP_LOGI(TAG, "------ MQTT 连接后第一次发布：%lld 毫秒。", (now_us - app_mqtt_connected_us) / 1000);
     }
     return ret;
 }
 
 /**
  * @brief MQTT 发日志给服务器。
- * @param topic
- * @param msg
+ * @param log
  * @return
  */
-int app_mqtt_publish_log(char* topic, char* log) {
-    if (app_mqtt_init_status == 0) {
-        ESP_LOGE(TAG, "------ MQTT 初始化失败，MQTT 客户端状态：不可用！");
-        return -1;
-    }
-    int ret = esp_mqtt_client_publish(app_mqtt_5_client, topic, log, strlen(log), APP_MQTT_QOS, 0);
-    return ret;
+int app_mqtt_publish_log(char* log) {
+    return app_mqtt_publish(APP_MQTT_TOPIC_LOG, log, strlen(log), APP_MQTT_LOG_QOS);
 }
 
 /**
@@ -84,20 +166,48 @@ int app_mqtt_publish_log(char* topic, char* log) {
  * @return
  */
 static void app_mqtt_event_handler(void* handler_args, esp_event_base_t base, int32_t event_id, void* event_data) {
+    esp_mqtt_event_handle_t event = event_data;
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
-            ESP_LOGI(TAG, "------ MQTT 事件：已连接。");
-            if (app_mqtt_pub_bak_count == 0) {
-                app_sd_pub_log_bak_file();
-                app_sd_pub_cache_bak_file();
-                app_mqtt_pub_bak_count = 1;
+            ESP_LOGI(TAG, "------ MQTT 事件：已连接。保留会话：%d", event->session_present);
+            app_mqtt_offline_us = app_mqtt_disconnected_us;
+            app_mqtt_connected_us = esp_timer_get_time();
+            atomic_store(&app_mqtt_first_pub, 1);
+            if (app_mqtt_disconnected_us != 0) {
+                app_metrics_count(APP_METRICS_RECONNECTS);
+            }
+            atomic_fetch_add(&app_mqtt_conn_seq, 1);// 别名不属于会话，每次连接在第一次发布时重新建立。
+            if (event->session_present) {// 服务器保留了会话，订阅仍然有效，离线期间的命令随后下发。
+                app_metrics_count(APP_METRICS_RESUMED);
+            } else {
+                esp_mqtt_client_subscribe(app_mqtt_5_client, app_mqtt_topics[APP_MQTT_TOPIC_CMD], 1);
             }
+            atomic_store(&app_mqtt_connected, 1);
+            app_sd_pub_log_bak_file();// 每次连接都唤醒积压数据推送，不阻塞 MQTT 任务。
+            app_sd_pub_cache_bak_file();
             break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "------ MQTT 事件：断开连接！");
+            atomic_store(&app_mqtt_connected, 0);
+            atomic_store(&app_mqtt_first_pub, 0);
+            app_mqtt_disconnected_us = esp_timer_get_time();
+            atomic_fetch_add(&app_mqtt_conn_seq, 1);// 别名只在本次连接有效。
+            app_pub_on_disconnect();// 未确认的消息回调失败，由发送者重发。
             break;
         case MQTT_EVENT_PUBLISHED:
-            ESP_LOGI(TAG, "------ MQTT 事件：发布完成！");
+            ESP_LOGD(TAG, "------ MQTT 事件：发布完成！MSG ID：%d", event->msg_id);
+            app_pub_on_ack(event->msg_id, true);
+            break;
+        case MQTT_EVENT_DELETED:
+            ESP_LOGW(TAG, "------ MQTT 事件：outbox 超时删除！MSG ID：%d", event->msg_id);
+            app_pub_on_ack(event->msg_id, false);
+            break;
+        case MQTT_EVENT_DATA:
+            if (event->current_data_offset == 0 && event->data_len == event->total_data_len &&
+                event->topic_len == strlen(app_mqtt_topics[APP_MQTT_TOPIC_CMD]) &&
+                strncmp(event->topic, app_mqtt_topics[APP_MQTT_TOPIC_CMD], event->topic_len) == 0) {// 命令都很短，分片的消息不处理。
+                app_param_on_command(event->data, event->data_len);
+            }
             break;
         case MQTT_EVENT_BEFORE_CONNECT:
             ESP_LOGI(TAG, "------ MQTT 事件：连接之前！");
@@ -110,30 +220,53 @@ static void app_mqtt_event_handler(void* handler_args, esp_event_base_t base, in
 
 /**
  * @brief 初始化函数。
- * @param will_msg
- * @param msg_len
+ * @param dev_addr 设备地址，用于生成主题名称，也是遗嘱消息。
  * @return
  */
-esp_err_t app_mqtt_init(char* will_msg, size_t will_msg_len) {
+esp_err_t app_mqtt_init(const char* dev_addr) {
+    snprintf(app_mqtt_topics[APP_MQTT_TOPIC_MSG], sizeof(app_mqtt_topics[0]), APP_MQTT_TOPIC_MSG_FMT, dev_addr);
+    snprintf(app_mqtt_topics[APP_MQTT_TOPIC_LOG], sizeof(app_mqtt_topics[0]), APP_MQTT_TOPIC_LOG_FMT, dev_addr);
+    snprintf(app_mqtt_topics[APP_MQTT_TOPIC_BULK], sizeof(app_mqtt_topics[0]), APP_MQTT_TOPIC_BULK_FMT, dev_addr);
+    snprintf(app_mqtt_topics[APP_MQTT_TOPIC_WILL], sizeof(app_mqtt_topics[0]), APP_MQTT_TOPIC_WILL_FMT, dev_addr);
+    snprintf(app_mqtt_topics[APP_MQTT_TOPIC_CMD], sizeof(app_mqtt_topics[0]), APP_MQTT_TOPIC_CMD_FMT, dev_addr);
+    snprintf(app_mqtt_topics[APP_MQTT_TOPIC_RESP], sizeof(app_mqtt_topics[0]), APP_MQTT_TOPIC_RESP_FMT, dev_addr);
+    snprintf(app_mqtt_topics[APP_MQTT_TOPIC_METRICS], sizeof(app_mqtt_topics[0]), APP_MQTT_TOPIC_METRICS_FMT, dev_addr);
 
     esp_mqtt_client_config_t mqtt5_cfg = {
         .session.protocol_ver = MQTT_PROTOCOL_V_5,
         .broker.address.uri = APP_MQTT_URI,
         .credentials.username = APP_MQTT_USERNAME,
         .credentials.authentication.password = APP_MQTT_PASSWORD,
+        .credentials.client_id = dev_addr,// 持久会话按客户端 ID 保存，使用固定的设备地址。
+        .session.disable_clean_session = APP_MQTT_SESSION_PERSIST,
 
         .network.timeout_ms = 2000,// 网络操作超时为 2 秒。MQTT_NETWORK_TIMEOUT_MS 默认 10 秒。
         .network.reconnect_timeout_ms = 2000,// 设置重连间隔为 2 秒。MQTT_RECON_DEFAULT_MS 默认 10 秒。
         .network.disable_auto_reconnect = false,    // 自动连接！
 
-        .session.last_will.topic = APP_MQTT_WILL_TOPIC,
-        .session.last_will.msg = will_msg,
-        .session.last_will.msg_len = will_msg_len,
-        .session.last_will.qos = APP_MQTT_QOS,
+        .session.last_will.topic = app_mqtt_topics[APP_MQTT_TOPIC_WILL],
+        .session.last_will.msg = dev_addr,
+        .session.last_will.msg_len = strlen(dev_addr),
+        .session.last_will.qos = APP_MQTT_LOG_QOS,
         .session.last_will.retain = true,
     };
 
+    esp_err_t pub_ret = app_pub_init();
+    if (pub_ret != ESP_OK) {
+        return pub_ret;
+    }
+    if (strncmp(APP_MQTT_URI, "mqtts://", 8) == 0) {// TLS 使用自己的传输层，重连时恢复 TLS 会话。
+        mqtt5_cfg.network.transport = app_tls_transport_init();
+        if (mqtt5_cfg.network.transport == NULL) {
+            return ESP_FAIL;
+        }
+    }
     app_mqtt_5_client = esp_mqtt_client_init(&mqtt5_cfg);
+    esp_mqtt5_connection_property_config_t connect_property = {
+        .session_expiry_interval = APP_MQTT_SESSION_PERSIST ? APP_MQTT_SESSION_EXPIRY_S : 0,
+        .receive_maximum = APP_MQTT_RECEIVE_MAX,
+    };
+    esp_mqtt5_client_set_connect_property(app_mqtt_5_client, &connect_property);
     esp_mqtt_client_register_event(app_mqtt_5_client, ESP_EVENT_ANY_ID, app_mqtt_event_handler, NULL);
     esp_err_t mqtt_ret = esp_mqtt_client_start(app_mqtt_5_client);
     if (mqtt_ret == ESP_OK) {
@@ -13,31 +13,58 @@
   */
 extern _Atomic uint32_t app_mqtt_last_ts;
 
+/**
+ * @brief MQTT 是否已连接。
+ */
+extern _Atomic int app_mqtt_connected;
+
 /**
  * @brief MQTT 5 客户端。
  */
 extern esp_mqtt_client_handle_t app_mqtt_5_client;
 
 /**
- * @brief MQTT 发消息给服务器。
- * @param msg
+ * @brief 本设备的主题。
+ */
+typedef enum {
+    APP_MQTT_TOPIC_MSG = 0,     // 实时数据。
+    APP_MQTT_TOPIC_LOG,         // 日志。
+    APP_MQTT_TOPIC_BULK,        // 积压数据。
+    APP_MQTT_TOPIC_WILL,        // 遗嘱。
+    APP_MQTT_TOPIC_CMD,         // 命令，订阅。
+    APP_MQTT_TOPIC_RESP,        // 命令执行结果。
+    APP_MQTT_TOPIC_METRICS,     // 推送延迟和投递统计。
+    APP_MQTT_TOPIC_COUNT,
+} app_mqtt_topic_t;
+
+/**
+ * @brief 本设备的主题名称。
+ * @param topic
+ * @return
+ */
+const char* app_mqtt_topic(app_mqtt_topic_t topic);
+
+/**
+ * @brief MQTT 发消息给服务器，QoS 0 的消息在本次连接建立别名后只发送别名。
+ * @param topic
+ * @param data
+ * @param len
+ * @param qos
  * @return message_id of the publish message (for QoS 0 message_id will always
- *          be zero) on success. -1 on failure, -2 in case of full outbox.
+ *          be zero) on success. -1 on failure.
  */
-int app_mqtt_publish_msg(char* msg);
+int app_mqtt_publish(app_mqtt_topic_t topic, const char* data, size_t len, int qos);
 
 /**
  * @brief MQTT 发日志给服务器。
- * @param topic
- * @param msg
+ * @param log
  * @return
  */
-int app_mqtt_publish_log(char* topic, char* log);
+int app_mqtt_publish_log(char* log);
 
 /**
  * @brief 初始化函数。
- * @param will_msg
- * @param msg_len
+ * @param dev_addr 设备地址，用于生成主题名称，也是遗嘱消息。
  * @return
  */
-esp_err_t app_mqtt_init(char* will_msg, size_t will_msg_len);
+esp_err_t app_mqtt_init(const char* dev_addr);
@@ -0,0 +1,331 @@
+/**
+ * @brief   实时数据发件箱，主循环只放入队列，不等待网络。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "mqtt_client.h"
+
+#include "app_outbox.h"
+#include "app_pub.h"
+#include "app_mqtt.h"
+#include "app_sd.h"
+#include "app_metrics.h"
+#include "app_config.h"
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_outbox";
+
+/**
+ * @brief 发件箱统计。
+ */
+typedef struct {
+    uint32_t queued;            // 放入队列数。
+    uint32_t spilled;           // 写入缓存数。
+    uint32_t dropped;           // 丢弃数。
+    uint32_t high;              // 超过高水位次数。
+    uint32_t count_max;         // 队列最大条数。
+    uint32_t bytes_max;         // 队列最大字节数。
+} app_outbox_stats_t;
+
+/**
+ * @brief 队列中的一条消息，和消息副本一起 malloc()。
+ */
+typedef struct app_outbox_item {
+    struct app_outbox_item* next;   // 待写入缓存的链表。
+    app_metrics_trace_t trace;      // 各阶段时间。
+    uint16_t len;                   // 消息字节数。
+    char msg[];                     // 消息，写缓存时要追加换行符，多分配 2 个字节。
+} app_outbox_item_t;
+
+/**
+ * @brief 消息队列，环形数组。
+ */
+static app_outbox_item_t* app_outbox_queue[APP_OUTBOX_MAX_COUNT];
+static uint32_t app_outbox_head = 0;
+static uint32_t app_outbox_count = 0;
+static uint32_t app_outbox_bytes = 0;
+
+/**
+ * @brief 待写入缓存的消息，按时间顺序，由发件箱任务写入，其他任务只放入链表，不做文件操作。
+ */
+static app_outbox_item_t* app_outbox_spill_head = NULL;
+static app_outbox_item_t* app_outbox_spill_tail = NULL;
+static uint32_t app_outbox_spill_count = 0;
+
+/**
+ * @brief 有消息写入过缓存，需要唤醒积压数据任务补发。
+ */
+static bool app_outbox_refill = false;
+static int64_t app_outbox_refill_ms = 0;
+
+/**
+ * @brief 发件箱统计。
+ */
+static app_outbox_stats_t app_outbox_stats;
+
+/**
+ * @brief 互斥锁，放入在主循环，取出在发件箱任务，确认回调在 MQTT 任务。
+ */
+static pthread_mutex_t app_outbox_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 有新消息时唤醒发件箱任务。
+ */
+static SemaphoreHandle_t app_outbox_sem = NULL;
+
+/**
+ * @brief 写入缓存。
+ * @param json
+ * @return
+ */
+static app_outbox_status_t app_outbox_spill(char* json) {
+    app_outbox_status_t status = app_sd_write_cache_file(json) > 0 ? APP_OUTBOX_SPILLED : APP_OUTBOX_DROPPED;
+    pthread_mutex_lock(&app_outbox_mutex);
+    if (status == APP_OUTBOX_SPILLED) {
+        app_outbox_stats.spilled++;
+        app_outbox_refill = true;
+    } else {
+        app_outbox_stats.dropped++;
+    }
+    pthread_mutex_unlock(&app_outbox_mutex);
+    app_metrics_count(status == APP_OUTBOX_SPILLED ? APP_METRICS_SPILLED : APP_METRICS_DROPPED);
+    return status;
+}
+
+/**
+ * @brief 放入待写入缓存的链表。
+ *        调用前必须持有互斥锁。
+ */
+static void app_outbox_spill_push_locked(app_outbox_item_t* item) {
+    item->next = NULL;
+    if (app_outbox_spill_tail != NULL) {
+        app_outbox_spill_tail->next = item;
+    } else {
+        app_outbox_spill_head = item;
+    }
+    app_outbox_spill_tail = item;
+    app_outbox_spill_count++;
+}
+
+/**
+ * @brief 把待写入缓存的消息全部写入缓存，只在发件箱任务中调用。
+ */
+static void app_outbox_spill_drain(void) {
+    pthread_mutex_lock(&app_outbox_mutex);
+    app_outbox_item_t* item = app_outbox_spill_head;
+    app_outbox_spill_head = NULL;
+    app_outbox_spill_tail = NULL;
+    app_outbox_spill_count = 0;
+    pthread_mutex_unlock(&app_outbox_mutex);
+    while (item != NULL) {
+        app_outbox_item_t* next = item->next;
+        app_outbox_spill(item->msg);
+        free(item);
+        item = next;
+    }
+}
+
+/**
+ * @brief 消息确认回调，在 MQTT 任务中执行，不能阻塞。
+ *        未确认的消息放入待写入缓存的链表，由发件箱任务写入缓存，之后随缓存重发。
+ */
+static void app_outbox_ack(void* arg, uint64_t record_id, bool acked) {
+    app_outbox_item_t* item = arg;
+    if (acked) {
+        app_metrics_acked(&item->trace, esp_timer_get_time());
+        free(item);
+        return;
+    }
+    app_metrics_count(APP_METRICS_FAILED);
+    pthread_mutex_lock(&app_outbox_mutex);
+    app_outbox_spill_push_locked(item);
+    pthread_mutex_unlock(&app_outbox_mutex);
+    xSemaphoreGive(app_outbox_sem);
+}
+
+/**
+ * @brief 取出最早的一条消息。
+ *        调用前必须持有互斥锁。
+ * @return 队列为空返回 NULL。
+ */
+static app_outbox_item_t* app_outbox_pop_locked(void) {
+    if (app_outbox_count == 0) {
+        return NULL;
+    }
+    app_outbox_item_t* item = app_outbox_queue[app_outbox_head];
+    app_outbox_head = (app_outbox_head + 1) % APP_OUTBOX_MAX_COUNT;
+    app_outbox_count--;
+    app_outbox_bytes -= item->len;
+    return item;
+}
+
+/**
+ * @brief 取出最早的一条消息。
+ * @return 队列为空返回 NULL。
+ */
+static app_outbox_item_t* app_outbox_pop(void) {
+    pthread_mutex_lock(&app_outbox_mutex);
+    app_outbox_item_t* item = app_outbox_pop_locked();
+    pthread_mutex_unlock(&app_outbox_mutex);
+    return item;
+}
+
+/**
+ * @brief 放入一条消息，不等待网络，也不做文件操作，只移动指针。
+ *        未连接时放入待写入缓存的链表；超过高水位或者剩余堆内存不足时，最早的消息移到待写入缓存的链表，新消息始终放入队列。
+ *        写入缓存由发件箱任务执行。发件箱任务创建失败时只能直接写入缓存。
+ * @param json 写入缓存时会追加换行符，缓冲区至少比字符串多 2 个字节。
+ * @param trace 各阶段时间，放入时记录 enqueue_us。
+ * @return
+ */
+app_outbox_status_t app_outbox_put(char* json, const app_metrics_trace_t* trace) {
+    if (app_outbox_sem == NULL) {
+        return app_outbox_spill(json);
+    }
+    size_t len = strlen(json);
+    app_outbox_item_t* item = malloc(sizeof(app_outbox_item_t) + len + 2);// 写缓存时要追加换行符。
+    if (item == NULL) {// 堆内存耗尽，不在调用者中写文件，丢弃。
+        pthread_mutex_lock(&app_outbox_mutex);
+        app_outbox_stats.dropped++;
+        pthread_mutex_unlock(&app_outbox_mutex);
+        app_metrics_count(APP_METRICS_DROPPED);
+        return APP_OUTBOX_DROPPED;
+    }
+    item->trace = *trace;
+    item->trace.enqueue_us = esp_timer_get_time();
+    item->len = len;
+    memcpy(item->msg, json, len + 1);
+
+    app_outbox_status_t status = APP_OUTBOX_QUEUED;
+    int moved = 0;
+    uint32_t depth = 0;
+    bool connected = atomic_load(&app_mqtt_connected);
+    bool heap_low = esp_get_free_heap_size() < APP_OUTBOX_HEAP_MIN;
+    pthread_mutex_lock(&app_outbox_mutex);
+    if (!connected) {// 未连接，写入缓存，连接后由积压数据任务推送。
+        if (app_outbox_spill_count >= APP_OUTBOX_MAX_COUNT) {// 发件箱任务来不及写入，丢弃新消息，限制内存。
+            app_outbox_stats.dropped++;
+            status = APP_OUTBOX_DROPPED;
+        } else {
+            app_outbox_spill_push_locked(item);
+            status = APP_OUTBOX_SPILLED;
+        }
+    } else {
+        if (heap_low || app_outbox_count >= APP_OUTBOX_MAX_COUNT || app_outbox_bytes + len > APP_OUTBOX_HIGH_BYTES) {
+            app_outbox_stats.high++;
+            uint32_t low_bytes = heap_low ? 0 : APP_OUTBOX_LOW_BYTES;// 堆内存不足时全部写入缓存。
+            while (app_outbox_count > 0 && (app_outbox_count >= APP_OUTBOX_MAX_COUNT / 2 || app_outbox_bytes + len > low_bytes)) {
+                app_outbox_spill_push_locked(app_outbox_pop_locked());
+                moved++;
+            }
+        }
+        app_outbox_queue[(app_outbox_head + app_outbox_count) % APP_OUTBOX_MAX_COUNT] = item;
+        app_outbox_count++;
+        app_outbox_bytes += len;
+        app_outbox_stats.queued++;
+        if (app_outbox_count > app_outbox_stats.count_max) {
+            app_outbox_stats.count_max = app_outbox_count;
+        }
+        if (app_outbox_bytes > app_outbox_stats.bytes_max) {
+            app_outbox_stats.bytes_max = app_outbox_bytes;
+        }
+        depth = app_outbox_count;
+    }
+    pthread_mutex_unlock(&app_outbox_mutex);
+
+    if (status == APP_OUTBOX_DROPPED) {
+        free(item);
+        app_metrics_count(APP_METRICS_DROPPED);
+        return status;
+    }
+    xSemaphoreGive(app_outbox_sem);
+    if (status == APP_OUTBOX_QUEUED) {
+        app_metrics_count(APP_METRICS_QUEUED);
+        app_metrics_outbox_depth(depth);
+    }
+    if (moved > 0) {
+        ESP_LOGW(TAG, "------ 发件箱超过高水位：%d 条最早的消息写入缓存。", moved);
+    }
+    return status;
+}
+
+/**
+ * @brief 输出发件箱统计，输出后清零。
+ */
+void app_outbox_log_stats(void) {
+    pthread_mutex_lock(&app_outbox_mutex);
+    app_outbox_stats_t stats = app_outbox_stats;
+    uint32_t count = app_outbox_count;
+    uint32_t bytes = app_outbox_bytes;
+    memset(&app_outbox_stats, 0, sizeof(app_outbox_stats));
+    pthread_mutex_unlock(&app_outbox_mutex);
+    int mqtt_outbox = app_mqtt_5_client != NULL ? esp_mqtt_client_get_outbox_size(app_mqtt_5_client) : 0;
+    ESP_LOGI(TAG, "------ 发件箱统计：放入 %lu，写入缓存 %lu，丢弃 %lu，超过高水位 %lu，当前 %lu 条 %lu 字节，最大 %lu 条 %lu 字节（高水位 %d 字节），MQTT outbox %d 字节，剩余堆内存 %lu 字节",
+        stats.queued, stats.spilled, stats.dropped, stats.high, count, bytes, stats.count_max, stats.bytes_max,
+        APP_OUTBOX_HIGH_BYTES, mqtt_outbox, esp_get_free_heap_size());
+}
+
+/**
+ * @brief 发件箱任务，逐条推送，窗口已满时在这里等待，不影响主循环。
+ *        断开连接时发送失败，队列中的消息全部写入缓存；所有写入缓存的文件操作都在这个任务中执行。
+ * @param param
+ */
+static void app_outbox_task(void* param) {
+    while (1) {
+        xSemaphoreTake(app_outbox_sem, portMAX_DELAY);
+        app_outbox_spill_drain();// 未确认的消息比队列中的早，先写入缓存。
+        app_outbox_item_t* item;
+        while ((item = app_outbox_pop()) != NULL) {
+            item->trace.publish_us = esp_timer_get_time();// 确认回调可能先于 app_pub_send() 返回，在发送前记录。
+            if (app_pub_send(APP_MQTT_TOPIC_MSG, item->msg, item->len, APP_PUB_TIMEOUT_PARAM, app_outbox_ack, item, 0) < 0) {
+                app_metrics_count(APP_METRICS_FAILED);
+                app_outbox_spill(item->msg);// 发送失败没有回调，在这里写入缓存。
+                free(item);
+            }
+        }
+
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        pthread_mutex_lock(&app_outbox_mutex);
+        bool refill = app_outbox_refill && atomic_load(&app_mqtt_connected) && now_ms - app_outbox_refill_ms >= APP_OUTBOX_REFILL_MS;
+        if (refill) {
+            app_outbox_refill = false;
+            app_outbox_refill_ms = now_ms;
+        }
+        pthread_mutex_unlock(&app_outbox_mutex);
+        if (refill) {// 队列已清空，封存缓存段，唤醒积压数据任务补发写入过缓存的消息。
+            app_sd_pub_cache_bak_file();
+        }
+    }
+}
+
+/**
+ * @brief 初始化函数，SD 卡初始化之后、输入通道和蓝牙启动之前调用，不依赖 MQTT。
+ *        MQTT 没有初始化或者没有连接时，消息都放入待写入缓存的链表，由发件箱任务写入缓存。
+ * @return
+ */
+esp_err_t app_outbox_init(void) {
+    app_outbox_sem = xSemaphoreCreateBinary();
+    if (app_outbox_sem == NULL) {
+        return ESP_FAIL;
+    }
+    if (xTaskCreate(app_outbox_task, "app_outbox_task", 4096, NULL, 4, NULL) != pdPASS) {// 发件箱任务，优先级高于积压数据任务。
+        vSemaphoreDelete(app_outbox_sem);
+        app_outbox_sem = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,46 @@
+/**
+ * @brief   实时数据发件箱，主循环只放入队列，不等待网络。
+ *
+ *          主循环调用 app_outbox_put() 立即返回：放入队列、交给发件箱任务写入缓存或者丢弃，调用者中不做文件操作。
+ *          发件箱任务从队列取出消息，通过 app_pub 推送；推送失败或者未确认的消息写入缓存。
+ *          队列超过高水位或者剩余堆内存不足时，把最早的消息写入缓存，直到低水位，长时间断网也不占用更多内存。
+ *          写入过缓存的消息，在队列清空后唤醒积压数据任务，从缓存补发。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#include "app_metrics.h"
+
+ /**
+  * @brief 放入发件箱的结果。
+  */
+typedef enum {
+    APP_OUTBOX_QUEUED = 0,      // 已放入队列，等待推送。
+    APP_OUTBOX_SPILLED,         // 未连接，由发件箱任务写入缓存。
+    APP_OUTBOX_DROPPED,         // 申请内存失败或者待写入缓存的消息太多，已丢弃。写入缓存失败只计入统计。
+} app_outbox_status_t;
+
+/**
+ * @brief 放入一条消息，不等待网络。
+ * @param json 写入缓存时会追加换行符，缓冲区至少比字符串多 2 个字节。
+ * @param trace 各阶段时间，服务器确认后计入延迟统计。
+ * @return
+ */
+app_outbox_status_t app_outbox_put(char* json, const app_metrics_trace_t* trace);
+
+/**
+ * @brief 输出发件箱统计，输出后清零。
+ */
+void app_outbox_log_stats(void);
+
+/**
+ * @brief 初始化函数，SD 卡初始化之后、输入通道和蓝牙启动之前调用，不依赖 MQTT。
+ * @return
+ */
+esp_err_t app_outbox_init(void);
@@ -0,0 +1,503 @@
+/**
+ * @brief   运行参数，通过 MQTT 命令远程调整，保存到 NVS。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "cJSON.h"
+
+#include "app_param.h"
+#include "app_mqtt.h"
+#include "app_wifi.h"
+#include "app_ble.h"
+#include "app_config.h"
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_param";
+
+/**
+ * @brief 参数结构版本，结构变化时加 1，旧的保存值不再使用。
+ */
+#define APP_PARAM_VERSION           1
+
+/**
+ * @brief NVS 命名空间和键。
+ */
+#define APP_PARAM_NVS_NAMESPACE     "app_param"
+#define APP_PARAM_NVS_KEY           "param"
+
+/**
+ * @brief 命令队列长度，命令消息最大字节数。
+ */
+#define APP_PARAM_QUEUE_LEN         4
+#define APP_PARAM_CMD_MAX_LEN       1024
+
+/**
+ * @brief 可以设置的数值参数，按名称、位置、取值范围校验。
+ */
+typedef struct {
+    const char* name;           // JSON 字段名。
+    size_t offset;              // 在 app_param_t 中的位置。
+    uint8_t size;               // 字节数。
+    uint32_t min;               // 最小值。
+    uint32_t max;               // 最大值。
+} app_param_field_t;
+
+static const app_param_field_t app_param_fields[] = {
+    {"sampleFastMs", offsetof(app_param_t, sample_fast_ms), 2, 200, APP_SAMPLE_MAX_MS},// 主循环守护任务 60 秒超时。
+    {"sampleMidMs", offsetof(app_param_t, sample_mid_ms), 2, 200, APP_SAMPLE_MAX_MS},
+    {"sampleSlowMs", offsetof(app_param_t, sample_slow_ms), 2, 200, APP_SAMPLE_MAX_MS},
+    {"burstMs", offsetof(app_param_t, burst_ms), 2, 200, APP_SAMPLE_MAX_MS},
+    {"spdMid", offsetof(app_param_t, spd_mid), 1, 0, 100},
+    {"spdFast", offsetof(app_param_t, spd_fast), 1, 0, 200},
+    {"deadbandM", offsetof(app_param_t, deadband_m), 2, 0, 1000},
+    {"deadbandMaxS", offsetof(app_param_t, deadband_max_s), 2, 1, 3600},
+    {"pubWindow", offsetof(app_param_t, pub_window), 1, 1, APP_PUB_WINDOW},
+    {"pubTimeoutMs", offsetof(app_param_t, pub_timeout_ms), 4, 0, 60000},
+};
+
+/**
+ * @brief 当前参数，读写时加锁。
+ */
+static app_param_t app_param = {
+    .version = APP_PARAM_VERSION,
+    .sample_fast_ms = APP_SAMPLE_FAST_MS,
+    .sample_mid_ms = APP_SAMPLE_MID_MS,
+    .sample_slow_ms = APP_SAMPLE_SLOW_MS,
+    .burst_ms = APP_SAMPLE_BURST_MS,
+    .spd_mid = APP_SAMPLE_SPD_MID,
+    .spd_fast = APP_SAMPLE_SPD_FAST,
+    .deadband_m = APP_SAMPLE_DEADBAND_M,
+    .deadband_max_s = APP_SAMPLE_DEADBAND_MAX_S,
+    .pub_window = APP_PUB_WINDOW,
+    .pub_timeout_ms = APP_PUB_SEND_TIMEOUT_MS,
+};
+
+/**
+ * @brief 突发模式结束的时间，不保存，重启后恢复正常采样。
+ */
+static int64_t app_param_burst_until_ms = 0;
+
+/**
+ * @brief 互斥锁。
+ */
+static pthread_mutex_t app_param_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 命令队列，保存 malloc() 的命令字符串。
+ */
+static QueueHandle_t app_param_queue = NULL;
+
+/**
+ * @brief 复制当前参数。
+ * @param out
+ */
+void app_param_get(app_param_t* out) {
+    pthread_mutex_lock(&app_param_mutex);
+    *out = app_param;
+    pthread_mutex_unlock(&app_param_mutex);
+}
+
+/**
+ * @brief 是否处于突发模式。
+ * @return
+ */
+bool app_param_burst(void) {
+    pthread_mutex_lock(&app_param_mutex);
+    bool burst = esp_timer_get_time() / 1000 < app_param_burst_until_ms;
+    pthread_mutex_unlock(&app_param_mutex);
+    return burst;
+}
+
+/**
+ * @brief 读写数值参数。
+ */
+static uint32_t app_param_field_get(const app_param_t* param, const app_param_field_t* field) {
+    const uint8_t* p = (const uint8_t*)param + field->offset;
+    return field->size == 1 ? *p : field->size == 2 ? *(const uint16_t*)p : *(const uint32_t*)p;
+}
+
+static void app_param_field_set(app_param_t* param, const app_param_field_t* field, uint32_t value) {
+    uint8_t* p = (uint8_t*)param + field->offset;
+    if (field->size == 1) {
+        *p = value;
+    } else if (field->size == 2) {
+        *(uint16_t*)p = value;
+    } else {
+        *(uint32_t*)p = value;
+    }
+}
+
+/**
+ * @brief 解析日志级别，支持 0 - 5 或者 "N"、"E"、"W"、"I"、"D"、"V"。
+ * @return 失败返回 -1。
+ */
+static int app_param_parse_level(const cJSON* item) {
+    if (cJSON_IsNumber(item)) {
+        return item->valueint >= ESP_LOG_NONE && item->valueint <= ESP_LOG_VERBOSE ? item->valueint : -1;
+    }
+    if (cJSON_IsString(item) && item->valuestring[0] != '\0') {
+        const char* p = strchr("NEWIDV", item->valuestring[0]);
+        return p != NULL ? p - "NEWIDV" : -1;
+    }
+    return -1;
+}
+
+/**
+ * @brief 日志级别写入参数，已有的 TAG 覆盖，新 TAG 使用空位。
+ * @return 失败返回 -1。
+ */
+static int app_param_set_log(app_param_t* param, const char* tag, int level) {
+    if (tag[0] == '\0' || strlen(tag) >= sizeof(param->logs[0].tag)) {
+        return -1;
+    }
+    app_param_log_t* free_slot = NULL;
+    for (int i = 0; i < APP_PARAM_LOG_COUNT; i++) {
+        if (strcmp(param->logs[i].tag, tag) == 0) {
+            param->logs[i].level = level;
+            return 0;
+        }
+        if (free_slot == NULL && param->logs[i].tag[0] == '\0') {
+            free_slot = &param->logs[i];
+        }
+    }
+    if (free_slot == NULL) {
+        return -1;
+    }
+    strcpy(free_slot->tag, tag);
+    free_slot->level = level;
+    return 0;
+}
+
+/**
+ * @brief 校验 set 对象并写入参数副本。
+ * @param set
+ * @param param
+ * @param burst_min 突发模式分钟数，没有设置时不变。
+ * @return 成功返回 NULL，失败返回出错的字段名。
+ */
+static const char* app_param_parse_set(const cJSON* set, app_param_t* param, int* burst_min) {
+    if (!cJSON_IsObject(set)) {
+        return "set";
+    }
+    const cJSON* item;
+    cJSON_ArrayForEach(item, set) {
+        if (strcmp(item->string, "burstMin") == 0) {
+            if (!cJSON_IsNumber(item) || item->valuedouble < 0 || item->valuedouble > APP_SAMPLE_BURST_MAX_MIN) {
+                return item->string;
+            }
+            *burst_min = item->valueint;
+            continue;
+        }
+        if (strcmp(item->string, "logLevel") == 0) {
+            if (!cJSON_IsObject(item)) {
+                return item->string;
+            }
+            const cJSON* log;
+            cJSON_ArrayForEach(log, item) {
+                int level = app_param_parse_level(log);
+                if (level < 0 || app_param_set_log(param, log->string, level) < 0) {
+                    return item->string;
+                }
+            }
+            continue;
+        }
+        const app_param_field_t* field = NULL;
+        for (int i = 0; i < sizeof(app_param_fields) / sizeof(app_param_fields[0]); i++) {
+            if (strcmp(item->string, app_param_fields[i].name) == 0) {
+                field = &app_param_fields[i];
+                break;
+            }
+        }
+        if (field == NULL || !cJSON_IsNumber(item) || item->valuedouble < field->min || item->valuedouble > field->max) {
+            return item->string;// 未知字段也拒绝，避免拼写错误被忽略。
+        }
+        app_param_field_set(param, field, (uint32_t)item->valuedouble);
+    }
+    if (param->spd_mid > param->spd_fast) {
+        return "spdMid";
+    }
+    return NULL;
+}
+
+/**
+ * @brief 应用日志级别。
+ */
+static void app_param_apply_logs(const app_param_t* param) {
+    for (int i = 0; i < APP_PARAM_LOG_COUNT; i++) {
+        if (param->logs[i].tag[0] != '\0') {
+            esp_log_level_set(param->logs[i].tag, param->logs[i].level);
+        }
+    }
+}
+
+/**
+ * @brief 保存参数到 NVS。
+ */
+static esp_err_t app_param_save(const app_param_t* param) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(APP_PARAM_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = nvs_set_blob(handle, APP_PARAM_NVS_KEY, param, sizeof(app_param_t));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return ret;
+}
+
+/**
+ * @brief 解析已知网络列表：[{"ssid":"a","pass":"b","prio":1}]，prio 可以省略。
+ * @return 校验失败的字段名，成功返回 NULL。
+ */
+static const char* app_param_parse_wifi(const cJSON* wifi, app_wifi_net_t* nets, int* count) {
+    if (!cJSON_IsArray(wifi) || cJSON_GetArraySize(wifi) > APP_WIFI_NET_COUNT) {
+        return "wifi";
+    }
+    *count = 0;
+    const cJSON* item;
+    cJSON_ArrayForEach(item, wifi) {
+        const cJSON* ssid = cJSON_GetObjectItemCaseSensitive(item, "ssid");
+        const cJSON* pass = cJSON_GetObjectItemCaseSensitive(item, "pass");
+        const cJSON* prio = cJSON_GetObjectItemCaseSensitive(item, "prio");
+        if (!cJSON_IsString(ssid) || strlen(ssid->valuestring) == 0 || strlen(ssid->valuestring) >= sizeof(nets[0].ssid) ||
+            !cJSON_IsString(pass) || strlen(pass->valuestring) >= sizeof(nets[0].password) ||
+            (prio != NULL && (!cJSON_IsNumber(prio) || prio->valuedouble < 0 || prio->valuedouble > 10))) {
+            return "wifi";
+        }
+        app_wifi_net_t* net = &nets[(*count)++];
+        memset(net, 0, sizeof(app_wifi_net_t));
+        strcpy(net->ssid, ssid->valuestring);
+        strcpy(net->password, pass->valuestring);
+        net->priority = prio != NULL ? prio->valueint : 0;
+    }
+    return NULL;
+}
+
+/**
+ * @brief 解析蓝牙钥匙列表：["DF:90:78:01:B0:37","C0:11:22:33:44:55/r"]，高字节在前，/r = 随机地址。
+ * @return 校验失败的字段名，成功返回 NULL。
+ */
+static const char* app_param_parse_ble(const cJSON* ble, app_ble_key_t* keys, int* count) {
+    if (!cJSON_IsArray(ble) || cJSON_GetArraySize(ble) > APP_BLE_KEY_MAX) {
+        return "ble";
+    }
+    *count = 0;
+    const cJSON* item;
+    cJSON_ArrayForEach(item, ble) {
+        unsigned int b[6];
+        int len = 0;
+        if (!cJSON_IsString(item) ||
+            sscanf(item->valuestring, "%2x:%2x:%2x:%2x:%2x:%2x%n", &b[5], &b[4], &b[3], &b[2], &b[1], &b[0], &len) != 6) {
+            return "ble";
+        }
+        const char* suffix = item->valuestring + len;
+        if (strcmp(suffix, "") != 0 && strcmp(suffix, "/r") != 0) {
+            return "ble";
+        }
+        app_ble_key_t* key = &keys[(*count)++];
+        key->type = suffix[0] == '\0' ? 0 : 1;
+        for (int i = 0; i < 6; i++) {
+            key->val[i] = b[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 当前参数转换为 JSON 对象。
+ */
+static cJSON* app_param_to_json(const app_param_t* param) {
+    cJSON* obj = cJSON_CreateObject();
+    for (int i = 0; i < sizeof(app_param_fields) / sizeof(app_param_fields[0]); i++) {
+        cJSON_AddNumberToObject(obj, app_param_fields[i].name, app_param_field_get(param, &app_param_fields[i]));
+    }
+    pthread_mutex_lock(&app_param_mutex);
+    int64_t burst_left_ms = app_param_burst_until_ms - esp_timer_get_time() / 1000;
+    pthread_mutex_unlock(&app_param_mutex);
+    cJSON_AddNumberToObject(obj, "burstLeftS", burst_left_ms > 0 ? burst_left_ms / 1000 : 0);
+    cJSON* logs = cJSON_AddObjectToObject(obj, "logLevel");
+    for (int i = 0; i < APP_PARAM_LOG_COUNT; i++) {
+        if (param->logs[i].tag[0] != '\0') {
+            cJSON_AddNumberToObject(logs, param->logs[i].tag, param->logs[i].level);
+        }
+    }
+    app_wifi_net_t nets[APP_WIFI_NET_COUNT];
+    int net_count = app_wifi_get_networks(nets);
+    cJSON* wifi = cJSON_AddArrayToObject(obj, "wifi");
+    for (int i = 0; i < net_count; i++) {// 不回复密码。
+        cJSON* net = cJSON_CreateObject();
+        cJSON_AddStringToObject(net, "ssid", nets[i].ssid);
+        cJSON_AddNumberToObject(net, "prio", nets[i].priority);
+        cJSON_AddItemToArray(wifi, net);
+    }
+    app_ble_key_t keys[APP_BLE_KEY_MAX];
+    int key_count = app_ble_get_keys(keys);
+    cJSON* ble = cJSON_AddArrayToObject(obj, "ble");
+    for (int i = 0; i < key_count; i++) {
+        char text[24];
+        snprintf(text, sizeof(text), "%02X:%02X:%02X:%02X:%02X:%02X%s", keys[i].val[5], keys[i].val[4], keys[i].val[3],
+            keys[i].val[2], keys[i].val[1], keys[i].val[0], keys[i].type == 0 ? "" : "/r");
+        cJSON_AddItemToArray(ble, cJSON_CreateString(text));
+    }
+    return obj;
+}
+
+/**
+ * @brief 处理一条命令，校验、生效、保存，在响应主题回复结果。
+ * @param cmd
+ */
+static void app_param_handle(const char* cmd) {
+    cJSON* root = cJSON_Parse(cmd);
+    const char* err = NULL;
+    app_param_t param;
+    app_param_get(&param);
+    int burst_min = -1;
+    const cJSON* set = root != NULL ? cJSON_GetObjectItemCaseSensitive(root, "set") : NULL;
+    const cJSON* wifi = root != NULL ? cJSON_GetObjectItemCaseSensitive(root, "wifi") : NULL;
+    app_wifi_net_t nets[APP_WIFI_NET_COUNT];
+    int net_count = 0;
+    const cJSON* ble = root != NULL ? cJSON_GetObjectItemCaseSensitive(root, "ble") : NULL;
+    app_ble_key_t keys[APP_BLE_KEY_MAX];
+    int key_count = 0;
+    if (root == NULL) {
+        err = "json";
+    } else if (set != NULL) {
+        err = app_param_parse_set(set, &param, &burst_min);
+    }
+    if (err == NULL && wifi != NULL) {
+        err = app_param_parse_wifi(wifi, nets, &net_count);
+    }
+    if (err == NULL && ble != NULL) {
+        err = app_param_parse_ble(ble, keys, &key_count);
+    }
+    // 全部校验通过后才修改：先 WIFI 和蓝牙，最后保存、生效运行参数，前面失败时运行参数不变。
+    bool wifi_done = false;
+    bool ble_done = false;
+    if (err == NULL && wifi != NULL) {
+        wifi_done = app_wifi_set_networks(nets, net_count) == ESP_OK;
+        err = wifi_done ? NULL : "nvs";
+    }
+    if (err == NULL && ble != NULL) {
+        ble_done = app_ble_set_keys(keys, key_count) == ESP_OK;
+        err = ble_done ? NULL : "nvs";
+    }
+    if (err == NULL && set != NULL && app_param_save(&param) != ESP_OK) {
+        err = "nvs";
+    }
+    if (set != NULL && err == NULL) {
+        pthread_mutex_lock(&app_param_mutex);
+        app_param = param;
+        if (burst_min >= 0) {
+            app_param_burst_until_ms = esp_timer_get_time() / 1000 + (int64_t)burst_min * 60000;
+        }
+        pthread_mutex_unlock(&app_param_mutex);
+        app_param_apply_logs(&param);
+        ESP_LOGI(TAG, "------ 运行参数已修改：%s", wifi == NULL ? cmd : "");// 包含 WIFI 密码时不输出命令。
+    } else if (err != NULL) {
+        ESP_LOGW(TAG, "------ 运行参数命令无效，字段：%s，命令：%s", err, wifi == NULL ? cmd : "");
+    }
+    if (wifi_done) {// 后面的修改失败时已经生效，回复中的 param 是实际状态。
+        ESP_LOGI(TAG, "------ WIFI 已知网络已修改：%d 个。", net_count);
+    }
+    if (ble_done) {
+        ESP_LOGI(TAG, "------ 蓝牙钥匙已修改：%d 把。", key_count);
+    }
+
+    cJSON* resp = cJSON_CreateObject();
+    const cJSON* id = root != NULL ? cJSON_GetObjectItemCaseSensitive(root, "id") : NULL;
+    if (id != NULL) {
+        cJSON_AddItemToObject(resp, "id", cJSON_Duplicate(id, true));
+    }
+    cJSON_AddNumberToObject(resp, "ok", err == NULL);
+    if (err != NULL) {
+        cJSON_AddStringToObject(resp, "err", err);
+    }
+    app_param_get(&param);
+    cJSON_AddItemToObject(resp, "param", app_param_to_json(&param));
+    char* text = cJSON_PrintUnformatted(resp);
+    if (text != NULL) {
+        app_mqtt_publish(APP_MQTT_TOPIC_RESP, text, strlen(text), 1);
+        cJSON_free(text);
+    }
+    cJSON_Delete(resp);
+    cJSON_Delete(root);
+}
+
+/**
+ * @brief 命令处理任务。不在 MQTT 任务中处理，NVS 写入和回复不阻塞 MQTT 任务。
+ * @param param
+ */
+static void app_param_task(void* param) {
+    char* cmd;
+    while (1) {
+        if (xQueueReceive(app_param_queue, &cmd, portMAX_DELAY) == pdTRUE) {
+            app_param_handle(cmd);
+            free(cmd);
+        }
+    }
+}
+
+/**
+ * @brief 收到命令主题的消息，在 MQTT 任务中调用，只放入队列，不阻塞。
+ * @param data
+ * @param len
+ */
+void app_param_on_command(const char* data, size_t len) {
+    if (app_param_queue == NULL || len == 0 || len > APP_PARAM_CMD_MAX_LEN) {
+        ESP_LOGW(TAG, "------ 运行参数命令忽略，字节数：%d", len);
+        return;
+    }
+    char* cmd = malloc(len + 1);
+    if (cmd == NULL) {
+        return;
+    }
+    memcpy(cmd, data, len);
+    cmd[len] = '\0';
+    if (xQueueSend(app_param_queue, &cmd, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "------ 运行参数命令队列已满，忽略。");
+        free(cmd);
+    }
+}
+
+/**
+ * @brief 初始化函数，NVS 初始化之后调用。读取保存的参数，应用日志级别，启动命令处理任务。
+ * @return
+ */
+esp_err_t app_param_init(void) {
+    nvs_handle_t handle;
+    if (nvs_open(APP_PARAM_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        app_param_t saved;
+        size_t size = sizeof(saved);
+        if (nvs_get_blob(handle, APP_PARAM_NVS_KEY, &saved, &size) == ESP_OK && size == sizeof(saved) && saved.version == APP_PARAM_VERSION) {
+            pthread_mutex_lock(&app_param_mutex);
+            app_param = saved;
+            pthread_mutex_unlock(&app_param_mutex);
+            ESP_LOGI(TAG, "------ 读取保存的运行参数：OK。");
+        }
+        nvs_close(handle);
+    }
+    app_param_apply_logs(&app_param);
+
+    app_param_queue = xQueueCreate(APP_PARAM_QUEUE_LEN, sizeof(char*));
+    if (app_param_queue == NULL) {
+        return ESP_FAIL;
+    }
+    xTaskCreate(app_param_task, "app_param_task", 4096, NULL, 2, NULL);
+    return ESP_OK;
+}
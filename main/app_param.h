@@ -0,0 +1,74 @@
+/**
+ * @brief   运行参数，通过 MQTT 命令远程调整，保存到 NVS。
+ *
+ *          订阅本设备的命令主题，校验通过后立即生效并保存，在响应主题回复结果。
+ *          命令格式：{"id":"1","set":{"sampleFastMs":1000,"burstMin":10,"logLevel":{"app_sd":"D"}}}
+ *          已知 WIFI 网络：{"id":"1","wifi":[{"ssid":"a","pass":"b","prio":1}]}，整体替换，空数组恢复默认，回复中不包含密码。
+ *          蓝牙钥匙：{"id":"1","ble":["DF:90:78:01:B0:37","C0:11:22:33:44:55/r"]}，高字节在前，/r = 随机地址，整体替换，空数组恢复默认。
+ *          只查询：{"id":"1"}。任何一个参数校验失败，整条命令都不生效。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+ /**
+  * @brief 最多保存的日志级别设置数。
+  */
+#define APP_PARAM_LOG_COUNT         8
+
+/**
+ * @brief 单个 TAG 的日志级别。
+ */
+typedef struct {
+    char tag[20];               // 日志 TAG，"*" 表示默认级别，空字符串表示未使用。
+    uint8_t level;              // esp_log_level_t。
+} app_param_log_t;
+
+/**
+ * @brief 运行参数，整体保存到 NVS。
+ */
+typedef struct {
+    uint32_t version;           // 结构版本，不一致时使用默认值。
+    uint16_t sample_fast_ms;    // 高速移动时的采样间隔。
+    uint16_t sample_mid_ms;     // 低速移动时的采样间隔。
+    uint16_t sample_slow_ms;    // 静止或者定位无效时的采样间隔。
+    uint16_t burst_ms;          // 突发模式的采样间隔。
+    uint8_t spd_mid;            // 低速移动的速度下限，单位：节。
+    uint8_t spd_fast;           // 高速移动的速度下限，单位：节。
+    uint16_t deadband_m;        // 移动距离小于此值、GPIO 不变时不推送，0 = 不使用。
+    uint16_t deadband_max_s;    // 不推送的最长秒数，超过后推送一次。
+    uint8_t pub_window;         // 在途消息数，不超过 APP_PUB_WINDOW。
+    uint32_t pub_timeout_ms;    // 等待窗口空位的时间。
+    app_param_log_t logs[APP_PARAM_LOG_COUNT]; // 日志级别。
+} app_param_t;
+
+/**
+ * @brief 复制当前参数。
+ * @param out
+ */
+void app_param_get(app_param_t* out);
+
+/**
+ * @brief 是否处于突发模式。
+ * @return
+ */
+bool app_param_burst(void);
+
+/**
+ * @brief 收到命令主题的消息，在 MQTT 任务中调用，只放入队列，不阻塞。
+ * @param data
+ * @param len
+ */
+void app_param_on_command(const char* data, size_t len);
+
+/**
+ * @brief 初始化函数，NVS 初始化之后调用。读取保存的参数，应用日志级别，启动命令处理任务。
+ * @return
+ */
+esp_err_t app_param_init(void);
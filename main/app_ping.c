@@ -19,11 +19,6 @@
 #include "app_deamon.h"
 #include "app_gnss.h"
 
- /*
- * PING 网络地址。
- */
-#define APP_PING_ADDRESS    "8.8.8.8"
-
  /**
   * @brief 日志 TAG。
   */
@@ -85,7 +80,7 @@ esp_err_t app_ping_start() {
  * @return
  */
 esp_err_t app_ping_init(void) {
-    char ip_str[] = APP_PING_ADDRESS;
+    char ip_str[] = APP_HEALTH_PING_ADDRESS;
     ip_addr_t ip_addr;
     ipaddr_aton(ip_str, &ip_addr);
 
@@ -0,0 +1,338 @@
+/**
+ * @brief   4G 蜂窝网络备用上行，PPPoS（esp_netif PPP + UART）。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_netif_ppp.h"
+#include "driver/uart.h"
+
+#include "app_ppp.h"
+#include "app_wifi.h"
+#include "app_mqtt.h"
+#include "app_config.h"
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_ppp";
+
+/**
+ * @brief PPP 状态。
+ */
+typedef enum {
+    APP_PPP_IDLE = 0,           // 未拨号。
+    APP_PPP_DIALING,            // AT 命令拨号中，UART 数据是 AT 应答。
+    APP_PPP_STARTED,            // PPP 协商中或者已连接，UART 数据交给 esp_netif。
+} app_ppp_state_t;
+
+static _Atomic int app_ppp_state = ATOMIC_VAR_INIT(APP_PPP_IDLE);
+
+/**
+ * @brief PPP 已获取 IP。
+ */
+static _Atomic int app_ppp_got_ip = ATOMIC_VAR_INIT(0);
+
+/**
+ * @brief PPP 协商失败或链路断开，需要由切换任务挂断（停止 esp_netif、+++、ATH）后再重新拨号。
+ */
+static _Atomic int app_ppp_need_hangup = ATOMIC_VAR_INIT(0);
+
+/**
+ * @brief WIFI 断开后 PPP 正在接管上行，由切换任务每秒更新。
+ */
+static _Atomic int app_ppp_failover_flag = ATOMIC_VAR_INIT(0);
+
+/**
+ * @brief PPP 网络接口。
+ */
+static esp_netif_t* app_ppp_netif = NULL;
+
+/**
+ * @brief esp_netif 驱动，第一个成员必须是 esp_netif_driver_base_t。
+ */
+typedef struct {
+    esp_netif_driver_base_t base;
+} app_ppp_driver_t;
+
+static app_ppp_driver_t app_ppp_driver;
+
+/**
+ * @brief 拨号时的 AT 应答缓冲区，接收任务写入，拨号函数读取。
+ */
+static char app_ppp_at_buf[256];
+static size_t app_ppp_at_len = 0;
+static pthread_mutex_t app_ppp_at_mutex = PTHREAD_MUTEX_INITIALIZER;
+static SemaphoreHandle_t app_ppp_at_sem = NULL;
+
+/**
+ * @brief esp_netif 发送 PPP 帧，写入 UART。
+ */
+static esp_err_t app_ppp_transmit(void* handle, void* buffer, size_t len) {
+    int written = uart_write_bytes(APP_PPP_UART_PORT_NUM, buffer, len);
+    return written == (int)len ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief 绑定到 esp_netif 之后，设置驱动的发送函数。
+ */
+static esp_err_t app_ppp_post_attach(esp_netif_t* netif, void* args) {
+    app_ppp_driver_t* driver = args;
+    driver->base.netif = netif;
+    const esp_netif_driver_ifconfig_t ifconfig = {
+        .handle = driver,
+        .transmit = app_ppp_transmit,
+    };
+    return esp_netif_set_driver_config(netif, &ifconfig);
+}
+
+/**
+ * @brief UART 接收任务：拨号时数据放入 AT 应答缓冲区，PPP 启动后交给 esp_netif。
+ * @param param
+ */
+static void app_ppp_rx_task(void* param) {
+    static uint8_t buffer[APP_PPP_UART_BUF_SIZE];
+    while (1) {
+        int len = uart_read_bytes(APP_PPP_UART_PORT_NUM, buffer, sizeof(buffer), pdMS_TO_TICKS(100));
+        if (len <= 0) {
+            continue;
+        }
+        int state = atomic_load(&app_ppp_state);
+        if (state == APP_PPP_STARTED) {
+            esp_netif_receive(app_ppp_netif, buffer, len, NULL);
+        } else if (state == APP_PPP_DIALING) {
+            pthread_mutex_lock(&app_ppp_at_mutex);
+            size_t copy = len < sizeof(app_ppp_at_buf) - 1 - app_ppp_at_len ? len : sizeof(app_ppp_at_buf) - 1 - app_ppp_at_len;
+            memcpy(app_ppp_at_buf + app_ppp_at_len, buffer, copy);
+            app_ppp_at_len += copy;
+            app_ppp_at_buf[app_ppp_at_len] = '\0';
+            pthread_mutex_unlock(&app_ppp_at_mutex);
+            xSemaphoreGive(app_ppp_at_sem);
+        }
+    }
+}
+
+/**
+ * @brief 发送一条 AT 命令，等待应答中出现 expect。
+ * @param cmd 不包含 \r。
+ * @param expect
+ * @param timeout_ms
+ * @return
+ */
+static esp_err_t app_ppp_at(const char* cmd, const char* expect, uint32_t timeout_ms) {
+    pthread_mutex_lock(&app_ppp_at_mutex);
+    app_ppp_at_len = 0;
+    app_ppp_at_buf[0] = '\0';
+    pthread_mutex_unlock(&app_ppp_at_mutex);
+    xSemaphoreTake(app_ppp_at_sem, 0);
+    uart_write_bytes(APP_PPP_UART_PORT_NUM, cmd, strlen(cmd));
+    uart_write_bytes(APP_PPP_UART_PORT_NUM, "\r", 1);
+
+    int64_t deadline_ms = esp_timer_get_time() / 1000 + timeout_ms;
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+    while (ret == ESP_ERR_TIMEOUT) {
+        pthread_mutex_lock(&app_ppp_at_mutex);
+        if (strstr(app_ppp_at_buf, expect) != NULL) {
+            ret = ESP_OK;
+        } else if (strstr(app_ppp_at_buf, "ERROR") != NULL || strstr(app_ppp_at_buf, "NO CARRIER") != NULL) {
+            ret = ESP_FAIL;
+        }
+        pthread_mutex_unlock(&app_ppp_at_mutex);
+        int64_t left_ms = deadline_ms - esp_timer_get_time() / 1000;
+        if (ret != ESP_ERR_TIMEOUT || left_ms <= 0) {
+            break;
+        }
+        xSemaphoreTake(app_ppp_at_sem, pdMS_TO_TICKS(left_ms));
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "------ PPP AT 命令失败：%s，应答：%s", cmd, app_ppp_at_buf);
+    }
+    return ret;
+}
+
+/**
+ * @brief 拨号并启动 PPP 协商。
+ * @return
+ */
+static esp_err_t app_ppp_start(void) {
+    ESP_LOGI(TAG, "------ PPP 拨号。");
+    uart_flush_input(APP_PPP_UART_PORT_NUM);
+    atomic_store(&app_ppp_state, APP_PPP_DIALING);
+    char cgdcont[64];
+    snprintf(cgdcont, sizeof(cgdcont), "AT+CGDCONT=1,\"IP\",\"%s\"", APP_PPP_APN);
+    esp_err_t ret = app_ppp_at("AT", "OK", 1000);
+    if (ret == ESP_OK) {
+        ret = app_ppp_at(cgdcont, "OK", 3000);
+    }
+    if (ret == ESP_OK) {
+        ret = app_ppp_at("ATD*99#", "CONNECT", 30000);
+    }
+    if (ret != ESP_OK) {
+        atomic_store(&app_ppp_state, APP_PPP_IDLE);
+        return ret;
+    }
+    atomic_store(&app_ppp_state, APP_PPP_STARTED);
+    esp_netif_action_start(app_ppp_netif, 0, 0, 0);
+    return ESP_OK;
+}
+
+/**
+ * @brief 停止 PPP，模块退出数据模式并挂断。
+ */
+static void app_ppp_stop(void) {
+    ESP_LOGI(TAG, "------ PPP 挂断。");
+    esp_netif_action_stop(app_ppp_netif, 0, 0, 0);
+    vTaskDelay(pdMS_TO_TICKS(1000));// LCP 终止，+++ 前后需要 1 秒静默。
+    atomic_store(&app_ppp_state, APP_PPP_DIALING);
+    uart_write_bytes(APP_PPP_UART_PORT_NUM, "+++", 3);
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    app_ppp_at("ATH", "OK", 3000);
+    atomic_store(&app_ppp_state, APP_PPP_IDLE);
+    atomic_store(&app_ppp_got_ip, 0);
+}
+
+/**
+ * @brief PPP 事件：获取 IP、失去 IP、PPP 协商失败。
+ */
+static void app_ppp_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
+    if (event_base == IP_EVENT && event_id == IP_EVENT_PPP_GOT_IP) {
+        ip_event_got_ip_t* event = (ip_event_got_ip_t*)event_data;
+        ESP_LOGI(TAG, "------ PPP 已连接。获取 IP：" IPSTR, IP2STR(&event->ip_info.ip));
+        atomic_store(&app_ppp_got_ip, 1);
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_PPP_LOST_IP) {
+        ESP_LOGW(TAG, "------ PPP 失去 IP！");
+        atomic_store(&app_ppp_got_ip, 0);
+    } else if (event_base == NETIF_PPP_STATUS && event_id != NETIF_PPP_ERRORNONE && event_id < NETIF_PP_PHASE_OFFSET) {
+        ESP_LOGW(TAG, "------ PPP 断开，错误：%ld", event_id);
+        atomic_store(&app_ppp_got_ip, 0);
+        if (atomic_load(&app_ppp_state) == APP_PPP_STARTED) {// 模块可能还在数据模式，事件循环中不挂断，由切换任务挂断后重新拨号。
+            atomic_store(&app_ppp_need_hangup, 1);
+        }
+    }
+}
+
+/**
+ * @brief PPP 是否已获取 IP，作为当前的上行。
+ * @return
+ */
+bool app_ppp_active(void) {
+    return atomic_load(&app_ppp_got_ip) != 0;
+}
+
+/**
+ * @brief WIFI 断开后 PPP 是否正在接管上行：等待切换、拨号、协商或者已连接。
+ *        最近一次拨号或者协商失败、等待重试时返回 false。
+ * @return
+ */
+bool app_ppp_failover(void) {
+    return atomic_load(&app_ppp_failover_flag) != 0;
+}
+
+/**
+ * @brief 故障切换任务：WIFI 断开一段时间后拨号，WIFI 恢复一段时间后挂断。
+ *        拨号和挂断都在这个任务中执行，不阻塞事件循环。
+ * @param param
+ */
+static void app_ppp_task(void* param) {
+    int64_t wifi_change_ms = esp_timer_get_time() / 1000;
+    bool wifi_last = app_wifi_is_connected();
+    int64_t fail_ms = 0;
+    bool failed = false;
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        bool wifi = app_wifi_is_connected();
+        if (wifi != wifi_last) {
+            wifi_last = wifi;
+            wifi_change_ms = now_ms;
+        }
+        if (atomic_exchange(&app_ppp_need_hangup, 0) != 0 && atomic_load(&app_ppp_state) == APP_PPP_STARTED) {
+            app_ppp_stop();// 先挂断，模块回到命令模式，按重试间隔重新拨号。
+            failed = true;
+            fail_ms = now_ms;
+        }
+        int state = atomic_load(&app_ppp_state);
+        if (state == APP_PPP_IDLE && !wifi && now_ms - wifi_change_ms >= APP_PPP_FAILOVER_MS &&
+            (!failed || now_ms - fail_ms >= APP_PPP_RETRY_MS)) {
+            failed = app_ppp_start() != ESP_OK;
+            fail_ms = now_ms;
+        } else if (state == APP_PPP_STARTED && wifi && now_ms - wifi_change_ms >= APP_PPP_FAILBACK_MS) {
+            app_ppp_stop();
+            failed = false;
+            if (app_mqtt_5_client != NULL) {// PPP 上的连接已经失效，立即通过 WIFI 重连。
+                esp_mqtt_client_disconnect(app_mqtt_5_client);
+                esp_mqtt_client_reconnect(app_mqtt_5_client);
+            }
+        } else if (state == APP_PPP_STARTED && !wifi && !app_ppp_active() && now_ms - fail_ms >= APP_PPP_RETRY_MS) {
+            app_ppp_stop();// 协商一直没有完成，挂断后重新拨号。
+            failed = true;
+            fail_ms = now_ms;
+        }
+        atomic_store(&app_ppp_failover_flag, !wifi && !(failed && atomic_load(&app_ppp_state) == APP_PPP_IDLE));
+    }
+}
+
+/**
+ * @brief 初始化函数，WIFI 初始化之后调用，启动 UART 和故障切换任务。
+ * @return
+ */
+esp_err_t app_ppp_init(void) {
+    uart_config_t uart_config = {
+        .baud_rate = APP_PPP_UART_BAUD_RATE,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE
+    };
+    esp_err_t ret = uart_param_config(APP_PPP_UART_PORT_NUM, &uart_config);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = uart_set_pin(APP_PPP_UART_PORT_NUM, APP_PPP_UART_TX_PIN, APP_PPP_UART_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = uart_driver_install(APP_PPP_UART_PORT_NUM, APP_PPP_UART_BUF_SIZE * 2, APP_PPP_UART_BUF_SIZE * 2, 0, NULL, 0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    esp_netif_config_t netif_config = ESP_NETIF_DEFAULT_PPP();// 路由优先级低于 WIFI，WIFI 恢复后默认路由自动回到 WIFI。
+    app_ppp_netif = esp_netif_new(&netif_config);
+    app_ppp_at_sem = xSemaphoreCreateBinary();
+    if (app_ppp_netif == NULL || app_ppp_at_sem == NULL) {
+        return ESP_FAIL;
+    }
+    app_ppp_driver.base.post_attach = app_ppp_post_attach;
+    ret = esp_netif_attach(app_ppp_netif, &app_ppp_driver);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    esp_netif_ppp_config_t ppp_config = {
+        .ppp_phase_event_enabled = false,
+        .ppp_error_event_enabled = true,
+    };
+    esp_netif_ppp_set_params(app_ppp_netif, &ppp_config);
+    ret = esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, app_ppp_event_handler, NULL);
+    if (ret == ESP_OK) {
+        ret = esp_event_handler_register(NETIF_PPP_STATUS, ESP_EVENT_ANY_ID, app_ppp_event_handler, NULL);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    xTaskCreate(app_ppp_rx_task, "app_ppp_rx_task", 4096, NULL, 6, NULL);// 优先级高于发件箱任务，避免 UART 缓冲区溢出。
+    xTaskCreate(app_ppp_task, "app_ppp_task", 3072, NULL, 3, NULL);
+    return ESP_OK;
+}
@@ -0,0 +1,38 @@
+/**
+ * @brief   4G 蜂窝网络备用上行，PPPoS（esp_netif PPP + UART）。
+ *
+ *          WIFI 断开超过 APP_PPP_FAILOVER_MS 后，在模块的 UART 上拨号（AT 命令 + ATD*99#），建立 PPP 连接；
+ *          WIFI 恢复超过 APP_PPP_FAILBACK_MS 后挂断 PPP，回到 WIFI。默认路由由 esp_netif 按优先级选择，WIFI 优先。
+ *          GNSS 已经占用 APP_UART_PORT_NUM，PPP 使用单独的 UART（APP_PPP_UART_PORT_NUM）。
+ *
+ *          在 Linux 上测试：USB 串口接到 PPP 的 UART，用 chat 模拟模块应答 AT 命令，pppd 作为对端：
+ *          pppd /dev/ttyUSB0 115200 local noauth nodetach passive 192.168.254.1:192.168.254.2 ms-dns 8.8.8.8 \
+ *              connect 'chat -v AT OK AT+CGDCONT OK ATD*99# CONNECT'
+ *          Linux 端需要开启 IP 转发和 NAT。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+/**
+ * @brief PPP 是否已获取 IP，作为当前的上行。
+ * @return
+ */
+bool app_ppp_active(void);
+
+/**
+ * @brief WIFI 断开后 PPP 是否正在接管上行：等待切换、拨号、协商或者已连接。
+ *        最近一次拨号或者协商失败、等待重试时返回 false。没有启用 PPP 时返回 false。
+ * @return
+ */
+bool app_ppp_failover(void);
+
+/**
+ * @brief 初始化函数，WIFI 初始化之后调用，启动 UART 和故障切换任务。
+ * @return
+ */
+esp_err_t app_ppp_init(void);
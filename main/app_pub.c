@@ -0,0 +1,405 @@
+/**
+ * @brief   QoS 1 流水线推送，限制在途消息数，按 msg_id 匹配 PUBACK。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mqtt_client.h"
+
+#include "app_pub.h"
+#include "app_mqtt.h"
+#include "app_param.h"
+#include "app_health.h"
+#include "app_config.h"
+
+ /**
+ * @brief 先于 msg_id 登记收到的确认，最多保存的条数。
+ *        esp_mqtt_client_publish() 返回之前，MQTT 任务可能已经收到 PUBACK。只在有正在发送的消息时保存。
+ */
+#define APP_PUB_EARLY_COUNT         (APP_PUB_WINDOW * 2)
+
+ /**
+ * @brief 窗口位置状态。
+ */
+#define APP_PUB_SLOT_FREE           0
+#define APP_PUB_SLOT_RESERVED       1   // 已占用，正在发送，还没有 msg_id。
+#define APP_PUB_SLOT_INFLIGHT       2   // 已发送，等待确认。
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_pub";
+
+/**
+ * @brief 在途消息。
+ */
+typedef struct {
+    uint8_t state;              // 状态。
+    int msg_id;                 // MQTT 消息 ID。
+    uint32_t len;               // 字节数。
+    int64_t send_us;            // 发送时间。
+    app_pub_ack_cb_t ack_cb;    // 确认回调。
+    void* arg;                  // 回调参数。
+    uint64_t record_id;         // 记录 ID。
+} app_pub_slot_t;
+
+/**
+ * @brief 待执行的回调，在锁外执行。
+ */
+typedef struct {
+    app_pub_ack_cb_t ack_cb;
+    void* arg;
+    uint64_t record_id;
+    bool acked;
+} app_pub_done_t;
+
+/**
+ * @brief 推送统计。
+ */
+typedef struct {
+    uint32_t sent;              // 发送数。
+    uint32_t acked;             // 确认数。
+    uint32_t failed;            // 失败数。
+    uint32_t window_full;       // 窗口已满次数。
+    uint32_t inflight_max;      // 最大在途数。
+    int64_t ack_us_total;       // 确认耗时合计。
+    int64_t ack_us_max;         // 最大确认耗时。
+} app_pub_stats_t;
+
+/**
+ * @brief 窗口。
+ */
+static app_pub_slot_t app_pub_slots[APP_PUB_WINDOW];
+
+/**
+ * @brief 在途消息数和字节数，包括正在发送的。
+ */
+static uint32_t app_pub_inflight = 0;
+static uint32_t app_pub_inflight_bytes = 0;
+
+/**
+ * @brief 先于 msg_id 登记收到的确认，环形覆盖。
+ */
+static struct {
+    int msg_id;
+    bool acked;
+} app_pub_early[APP_PUB_EARLY_COUNT];
+static int app_pub_early_next = 0;
+
+/**
+ * @brief 推送统计。
+ */
+static app_pub_stats_t app_pub_stats;
+
+/**
+ * @brief 互斥锁，发送在主循环和积压数据任务，确认在 MQTT 任务。
+ */
+static pthread_mutex_t app_pub_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 窗口有空位时通知等待的发送者。
+ */
+static SemaphoreHandle_t app_pub_release_sem = NULL;
+
+/**
+ * @brief 释放窗口位置，记录回调。
+ *        调用前必须持有互斥锁。
+ */
+static void app_pub_release(app_pub_slot_t* slot, bool acked, app_pub_done_t* done) {
+    if (done != NULL) {
+        done->ack_cb = slot->ack_cb;
+        done->arg = slot->arg;
+        done->record_id = slot->record_id;
+        done->acked = acked;
+    }
+    if (slot->state == APP_PUB_SLOT_INFLIGHT) {
+        if (acked) {
+            int64_t cost_us = esp_timer_get_time() - slot->send_us;
+            app_pub_stats.acked++;
+            app_pub_stats.ack_us_total += cost_us;
+            if (cost_us > app_pub_stats.ack_us_max) {
+                app_pub_stats.ack_us_max = cost_us;
+            }
+            app_health_on_pub(true, cost_us);
+        } else {
+            app_pub_stats.failed++;
+            app_health_on_pub(false, 0);
+        }
+    }
+    slot->state = APP_PUB_SLOT_FREE;
+    app_pub_inflight--;
+    app_pub_inflight_bytes -= slot->len;
+}
+
+/**
+ * @brief 执行回调，并通知等待的发送者。
+ */
+static void app_pub_complete(const app_pub_done_t* done, int count) {
+    for (int i = 0; i < count; i++) {
+        if (done[i].ack_cb != NULL) {
+            done[i].ack_cb(done[i].arg, done[i].record_id, done[i].acked);
+        }
+    }
+    if (count > 0) {
+        xSemaphoreGive(app_pub_release_sem);
+    }
+}
+
+/**
+ * @brief 是否有正在发送、还没有登记 msg_id 的消息。
+ *        调用前必须持有互斥锁。
+ */
+static bool app_pub_reserved_locked(void) {
+    for (int i = 0; i < APP_PUB_WINDOW; i++) {
+        if (app_pub_slots[i].state == APP_PUB_SLOT_RESERVED) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 没有正在发送的消息时，清除先到的确认。
+ *        超时或者断开时已经失败的消息，之后才到的确认不能保留，否则 msg_id 循环后会匹配到新消息。
+ *        调用前必须持有互斥锁。
+ */
+static void app_pub_early_clear_locked(void) {
+    if (app_pub_reserved_locked()) {
+        return;
+    }
+    for (int i = 0; i < APP_PUB_EARLY_COUNT; i++) {
+        app_pub_early[i].msg_id = -1;
+    }
+}
+
+/**
+ * @brief 是否属于指定的发送者，ack_cb 为 NULL 表示所有发送者。
+ *        调用前必须持有互斥锁。
+ */
+static bool app_pub_owned(const app_pub_slot_t* slot, app_pub_ack_cb_t ack_cb, void* arg) {
+    return ack_cb == NULL || (slot->ack_cb == ack_cb && slot->arg == arg);
+}
+
+/**
+ * @brief 指定发送者已发送的在途消息回调失败。
+ * @param ack_cb NULL 表示所有发送者。
+ * @param arg
+ * @return 失败的消息数。
+ */
+static int app_pub_fail_inflight(app_pub_ack_cb_t ack_cb, void* arg) {
+    app_pub_done_t done[APP_PUB_WINDOW];
+    int count = 0;
+    pthread_mutex_lock(&app_pub_mutex);
+    for (int i = 0; i < APP_PUB_WINDOW; i++) {
+        if (app_pub_slots[i].state == APP_PUB_SLOT_INFLIGHT && app_pub_owned(&app_pub_slots[i], ack_cb, arg)) {
+            app_pub_release(&app_pub_slots[i], false, &done[count++]);
+        }
+    }
+    app_pub_early_clear_locked();
+    pthread_mutex_unlock(&app_pub_mutex);
+    app_pub_complete(done, count);
+    return count;
+}
+
+/**
+ * @brief 占用一个窗口位置，窗口已满时最多等待 timeout_ms。
+ *        在途字节数超过 APP_PUB_WINDOW_BYTES 也算已满，限制 outbox 占用的内存。
+ *        发送者在持有互斥锁时写入，app_pub_flush() 按 ack_cb 和 arg 识别发送者，不能读到上一个使用者的值。
+ */
+static app_pub_slot_t* app_pub_reserve(size_t len, uint32_t timeout_ms, app_pub_ack_cb_t ack_cb, void* arg, uint64_t record_id) {
+    app_param_t param;
+    app_param_get(&param);// 窗口大小和超时可以远程调整，窗口不超过 APP_PUB_WINDOW。
+    if (timeout_ms == APP_PUB_TIMEOUT_PARAM) {
+        timeout_ms = param.pub_timeout_ms;
+    }
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (1) {
+        pthread_mutex_lock(&app_pub_mutex);
+        if (app_pub_inflight < param.pub_window && (app_pub_inflight == 0 || app_pub_inflight_bytes + len <= APP_PUB_WINDOW_BYTES)) {
+            for (int i = 0; i < APP_PUB_WINDOW; i++) {
+                app_pub_slot_t* slot = &app_pub_slots[i];
+                if (slot->state == APP_PUB_SLOT_FREE) {
+                    slot->state = APP_PUB_SLOT_RESERVED;
+                    slot->len = len;
+                    slot->ack_cb = ack_cb;
+                    slot->arg = arg;
+                    slot->record_id = record_id;
+                    app_pub_inflight++;
+                    app_pub_inflight_bytes += len;
+                    if (app_pub_inflight > app_pub_stats.inflight_max) {
+                        app_pub_stats.inflight_max = app_pub_inflight;
+                    }
+                    pthread_mutex_unlock(&app_pub_mutex);
+                    return slot;
+                }
+            }
+        }
+        pthread_mutex_unlock(&app_pub_mutex);
+        int64_t left_us = deadline_us - esp_timer_get_time();
+        if (left_us <= 0) {
+            return NULL;
+        }
+        xSemaphoreTake(app_pub_release_sem, pdMS_TO_TICKS(left_us / 1000) + 1);
+    }
+}
+
+/**
+ * @brief 发送一条 QoS 1 消息，不等待确认。窗口已满时最多等待 timeout_ms。
+ * @param topic
+ * @param data
+ * @param len
+ * @param timeout_ms APP_PUB_TIMEOUT_PARAM 表示使用运行参数。
+ * @param ack_cb 可以为 NULL。
+ * @param arg
+ * @param record_id
+ * @return msg_id，失败返回 -1，窗口已满返回 -2。
+ */
+int app_pub_send(app_mqtt_topic_t topic, const char* data, size_t len, uint32_t timeout_ms, app_pub_ack_cb_t ack_cb, void* arg, uint64_t record_id) {
+    if (app_pub_release_sem == NULL || !atomic_load(&app_mqtt_connected)) {
+        return -1;
+    }
+    app_pub_slot_t* slot = app_pub_reserve(len, timeout_ms, ack_cb, arg, record_id);
+    if (slot == NULL) {
+        pthread_mutex_lock(&app_pub_mutex);
+        app_pub_stats.window_full++;
+        pthread_mutex_unlock(&app_pub_mutex);
+        return -2;
+    }
+
+    int msg_id = app_mqtt_publish(topic, data, len, 1);// 不持有锁，MQTT 任务回调时会加锁。
+
+    app_pub_done_t done;
+    int done_count = 0;
+    pthread_mutex_lock(&app_pub_mutex);
+    if (msg_id < 0) {// 发送失败直接释放，不回调，由调用者处理返回值。
+        app_pub_release(slot, false, NULL);
+        done.ack_cb = NULL;
+        done_count = 1;
+    } else {
+        slot->msg_id = msg_id;
+        slot->send_us = esp_timer_get_time();
+        slot->state = APP_PUB_SLOT_INFLIGHT;
+        app_pub_stats.sent++;
+        for (int i = 0; i < APP_PUB_EARLY_COUNT; i++) {// 确认可能已经先到了。
+            if (app_pub_early[i].msg_id == msg_id) {
+                app_pub_early[i].msg_id = -1;
+                app_pub_release(slot, app_pub_early[i].acked, &done);
+                done_count = 1;
+                break;
+            }
+        }
+    }
+    app_pub_early_clear_locked();// 最后一个正在发送的消息已经登记，剩下的都是过期的确认。
+    pthread_mutex_unlock(&app_pub_mutex);
+    app_pub_complete(&done, done_count);
+
+    if (msg_id >= 0) {
+        atomic_store(&app_mqtt_last_ts, esp_log_timestamp());
+    }
+    return msg_id;
+}
+
+/**
+ * @brief 等待指定发送者的在途消息确认，超时未确认的回调失败，不影响其他发送者的消息。
+ * @param ack_cb 发送时传入的回调，与 arg 一起识别发送者。
+ * @param arg
+ * @param timeout_ms
+ * @return 失败的消息数。
+ */
+int app_pub_flush(app_pub_ack_cb_t ack_cb, void* arg, uint32_t timeout_ms) {
+    if (app_pub_release_sem == NULL) {
+        return 0;
+    }
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (1) {
+        int inflight = 0;
+        pthread_mutex_lock(&app_pub_mutex);
+        for (int i = 0; i < APP_PUB_WINDOW; i++) {
+            if (app_pub_slots[i].state != APP_PUB_SLOT_FREE && app_pub_owned(&app_pub_slots[i], ack_cb, arg)) {
+                inflight++;
+            }
+        }
+        pthread_mutex_unlock(&app_pub_mutex);
+        int64_t left_us = deadline_us - esp_timer_get_time();
+        if (inflight == 0 || left_us <= 0) {
+            break;
+        }
+        xSemaphoreTake(app_pub_release_sem, pdMS_TO_TICKS(left_us < 100000 ? left_us / 1000 : 100) + 1);// 信号可能被其他发送者取走，最多 100 毫秒检查一次。
+    }
+    int failed = app_pub_fail_inflight(ack_cb, arg);
+    if (failed > 0) {
+        ESP_LOGW(TAG, "------ 推送等待确认超时：%d 条。", failed);
+    }
+    return failed;
+}
+
+/**
+ * @brief 收到 MQTT_EVENT_PUBLISHED（acked = true）或者 MQTT_EVENT_DELETED（acked = false）。
+ * @param msg_id
+ * @param acked
+ */
+void app_pub_on_ack(int msg_id, bool acked) {
+    app_pub_done_t done;
+    int done_count = 0;
+    pthread_mutex_lock(&app_pub_mutex);
+    for (int i = 0; i < APP_PUB_WINDOW; i++) {
+        if (app_pub_slots[i].state == APP_PUB_SLOT_INFLIGHT && app_pub_slots[i].msg_id == msg_id) {
+            app_pub_release(&app_pub_slots[i], acked, &done);
+            done_count = 1;
+            break;
+        }
+    }
+    if (done_count == 0 && app_pub_reserved_locked()) {// 发送者还没有登记 msg_id，先保存；没有正在发送的消息时是已经失败的消息的确认，丢弃。
+        app_pub_early[app_pub_early_next].msg_id = msg_id;
+        app_pub_early[app_pub_early_next].acked = acked;
+        app_pub_early_next = (app_pub_early_next + 1) % APP_PUB_EARLY_COUNT;
+    }
+    pthread_mutex_unlock(&app_pub_mutex);
+    app_pub_complete(&done, done_count);
+}
+
+/**
+ * @brief 断开连接，所有在途消息回调失败。
+ */
+void app_pub_on_disconnect(void) {
+    int failed = app_pub_fail_inflight(NULL, NULL);
+    if (failed > 0) {
+        ESP_LOGW(TAG, "------ 断开连接，未确认的消息：%d 条。", failed);
+    }
+}
+
+/**
+ * @brief 输出推送统计，输出后清零。
+ */
+void app_pub_log_stats(void) {
+    pthread_mutex_lock(&app_pub_mutex);
+    app_pub_stats_t stats = app_pub_stats;
+    memset(&app_pub_stats, 0, sizeof(app_pub_stats));
+    pthread_mutex_unlock(&app_pub_mutex);
+    if (stats.sent == 0 && stats.failed == 0 && stats.window_full == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "------ 推送统计：发送 %lu，确认 %lu，失败 %lu，窗口已满 %lu，最大在途 %lu，平均确认 %lld ms，最大确认 %lld ms",
+        stats.sent, stats.acked, stats.failed, stats.window_full, stats.inflight_max,
+        stats.acked > 0 ? stats.ack_us_total / stats.acked / 1000 : 0, stats.ack_us_max / 1000);
+}
+
+/**
+ * @brief 初始化函数，MQTT 客户端启动之前调用。
+ * @return
+ */
+esp_err_t app_pub_init(void) {
+    for (int i = 0; i < APP_PUB_EARLY_COUNT; i++) {
+        app_pub_early[i].msg_id = -1;
+    }
+    app_pub_release_sem = xSemaphoreCreateBinary();
+    return app_pub_release_sem == NULL ? ESP_FAIL : ESP_OK;
+}
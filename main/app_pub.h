@@ -0,0 +1,76 @@
+/**
+ * @brief   QoS 1 流水线推送，限制在途消息数，按 msg_id 匹配 PUBACK。
+ *
+ *          发送时不等待 PUBACK，在途消息不超过窗口大小。
+ *          收到 PUBACK 后回调，调用者在回调中把对应的记录标记为已推送；
+ *          断开连接或者超时未确认的消息回调失败，由调用者重发。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#include "app_mqtt.h"
+
+ /**
+  * @brief 发送超时使用运行参数 pub_timeout_ms，见 app_param.h。
+  */
+#define APP_PUB_TIMEOUT_PARAM       UINT32_MAX
+
+ /**
+  * @brief 确认回调函数，在 MQTT 任务或者调用 app_pub_flush() 的任务中执行，不能阻塞。
+  * @param arg 发送时传入的参数。
+  * @param record_id 发送时传入的记录 ID。
+  * @param acked true = 服务器已确认，false = 失败。
+  */
+typedef void (*app_pub_ack_cb_t)(void* arg, uint64_t record_id, bool acked);
+
+/**
+ * @brief 发送一条 QoS 1 消息，不等待确认。窗口已满时最多等待 timeout_ms。
+ * @param topic
+ * @param data
+ * @param len
+ * @param timeout_ms APP_PUB_TIMEOUT_PARAM 表示使用运行参数。
+ * @param ack_cb 可以为 NULL。
+ * @param arg
+ * @param record_id
+ * @return msg_id，失败返回 -1，窗口已满返回 -2。
+ */
+int app_pub_send(app_mqtt_topic_t topic, const char* data, size_t len, uint32_t timeout_ms, app_pub_ack_cb_t ack_cb, void* arg, uint64_t record_id);
+
+/**
+ * @brief 等待指定发送者的在途消息确认，超时未确认的回调失败，不影响其他发送者的消息。
+ * @param ack_cb 发送时传入的回调，与 arg 一起识别发送者。
+ * @param arg
+ * @param timeout_ms
+ * @return 失败的消息数。
+ */
+int app_pub_flush(app_pub_ack_cb_t ack_cb, void* arg, uint32_t timeout_ms);
+
+/**
+ * @brief 收到 MQTT_EVENT_PUBLISHED（acked = true）或者 MQTT_EVENT_DELETED（acked = false）。
+ * @param msg_id
+ * @param acked
+ */
+void app_pub_on_ack(int msg_id, bool acked);
+
+/**
+ * @brief 断开连接，所有在途消息回调失败。
+ */
+void app_pub_on_disconnect(void);
+
+/**
+ * @brief 输出推送统计，输出后清零。
+ */
+void app_pub_log_stats(void);
+
+/**
+ * @brief 初始化函数，MQTT 客户端启动之前调用。
+ * @return
+ */
+esp_err_t app_pub_init(void);
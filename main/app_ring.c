@@ -0,0 +1,464 @@
+/**
+ * @brief   闪存环形存储，SD 卡不可用时保存缓存数据。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#include "app_ring.h"
+#include "app_config.h"
+
+ /**
+ * @brief 分区类型和名称，见 partitions.csv。
+ */
+#define APP_RING_PARTITION_TYPE     0x40
+#define APP_RING_PARTITION_SUBTYPE  0x00
+#define APP_RING_PARTITION_LABEL    "ring"
+
+ /**
+ * @brief 扇区大小，擦除的最小单位。
+ */
+#define APP_RING_SECTOR_SIZE        4096
+
+ /**
+ * @brief 记录魔数。
+ */
+#define APP_RING_MAGIC              0x5247      // "RG"
+#define APP_RING_ERASED             0xFFFF
+
+ /**
+ * @brief 记录占用的字节数，4 字节对齐。
+ */
+#define APP_RING_RECORD_SIZE(len)   ((sizeof(app_ring_record_header_t) + (len) + 3) & ~3)
+
+ /**
+ * @brief 已确认、未写入 done 标记的记录数上限。
+ *        积压数据任务每推送一条就写入一次，未写入的不超过在途窗口；超出时丢弃确认，下次重复推送这条记录。
+ */
+#define APP_RING_ACK_SIZE           (2 * APP_PUB_WINDOW)
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_ring";
+
+/**
+ * @brief 环形存储分区。
+ */
+static const esp_partition_t* app_ring_partition = NULL;
+
+/**
+ * @brief 扇区数。
+ */
+static uint32_t app_ring_sector_count = 0;
+
+/**
+ * @brief 写入位置：当前扇区和扇区内已用字节数。
+ */
+static uint32_t app_ring_head_sector = 0;
+static uint32_t app_ring_head_used = 0;
+
+/**
+ * @brief 读取位置：最早的未推送记录。
+ */
+static uint32_t app_ring_tail_sector = 0;
+static uint32_t app_ring_tail_used = 0;
+
+/**
+ * @brief 下一条记录的序号。
+ */
+static uint32_t app_ring_next_seq = 1;
+
+/**
+ * @brief 未推送的记录数。
+ */
+static uint32_t app_ring_pending = 0;
+
+/**
+ * @brief 推送结束后的回退位置：最早的未确认记录。由确认锁保护。
+ */
+static bool app_ring_rewind_valid = false;
+static uint32_t app_ring_rewind_pos = 0;
+static uint32_t app_ring_rewind_seq = 0;
+
+/**
+ * @brief 已确认、未写入 done 标记的记录 ID。由确认锁保护。
+ */
+static uint64_t app_ring_acks[APP_RING_ACK_SIZE];
+static int app_ring_ack_count = 0;
+
+/**
+ * @brief 写入缓冲区，记录头 + 数据。
+ */
+static uint8_t app_ring_buffer[APP_RING_RECORD_SIZE(APP_RING_MAX_LEN)];
+
+/**
+ * @brief 互斥锁，追加在主循环，推送在积压数据任务。
+ */
+static pthread_mutex_t app_ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 确认锁，只保护内存中的确认记录和回退位置，持有期间不读写闪存。
+ *        确认回调在 MQTT 事件任务中执行，不能等待 app_ring_mutex（追加时持有，包括擦除扇区）。
+ */
+static pthread_mutex_t app_ring_ack_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 计算记录 CRC。
+ */
+static uint32_t app_ring_crc(const app_ring_record_header_t* header, const uint8_t* data) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*)header, offsetof(app_ring_record_header_t, crc));
+    return esp_rom_crc32_le(crc, data, header->len);
+}
+
+/**
+ * @brief 读取记录头。
+ * @return 有效返回 1，未写入返回 0，无效返回 -1。
+ */
+static int app_ring_read_header(uint32_t sector, uint32_t used, app_ring_record_header_t* header) {
+    if (used + sizeof(app_ring_record_header_t) > APP_RING_SECTOR_SIZE) {
+        return 0;
+    }
+    if (esp_partition_read(app_ring_partition, sector * APP_RING_SECTOR_SIZE + used, header, sizeof(app_ring_record_header_t)) != ESP_OK) {
+        return -1;
+    }
+    if (header->magic == APP_RING_ERASED && header->len == 0xFFFF) {
+        return 0;
+    }
+    if (header->magic != APP_RING_MAGIC || header->len > APP_RING_MAX_LEN ||
+        used + APP_RING_RECORD_SIZE(header->len) > APP_RING_SECTOR_SIZE) {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief 统计扇区内未推送的记录数。
+ */
+static uint32_t app_ring_sector_pending(uint32_t sector, uint32_t from) {
+    uint32_t count = 0;
+    app_ring_record_header_t header;
+    uint32_t used = from;
+    while (app_ring_read_header(sector, used, &header) > 0) {
+        if (header.done == 0xFFFFFFFF) {
+            count++;
+        }
+        used += APP_RING_RECORD_SIZE(header.len);
+    }
+    return count;
+}
+
+/**
+ * @brief 读取位置移到下一个扇区。
+ *        调用前必须持有互斥锁。
+ */
+static void app_ring_tail_next_sector(void) {
+    if (app_ring_tail_sector == app_ring_head_sector) {
+        app_ring_tail_used = app_ring_head_used;
+        return;
+    }
+    app_ring_tail_sector = (app_ring_tail_sector + 1) % app_ring_sector_count;
+    app_ring_tail_used = 0;
+}
+
+/**
+ * @brief 是否有未推送的记录。
+ *        调用前必须持有互斥锁。
+ */
+static bool app_ring_empty(void) {
+    return app_ring_tail_sector == app_ring_head_sector && app_ring_tail_used >= app_ring_head_used;
+}
+
+/**
+ * @brief 追加一条记录。写满时覆盖最早的扇区。
+ * @param data
+ * @param len
+ * @return 写入字节数，失败返回 -1。
+ */
+int app_ring_append(const char* data, size_t len) {
+    if (app_ring_partition == NULL || len > APP_RING_MAX_LEN) {
+        return -1;
+    }
+    uint32_t size = APP_RING_RECORD_SIZE(len);
+    uint32_t dropped = 0;
+    pthread_mutex_lock(&app_ring_mutex);
+    if (app_ring_head_used + size > APP_RING_SECTOR_SIZE) {// 当前扇区写满，擦除下一个扇区。
+        uint32_t next = (app_ring_head_sector + 1) % app_ring_sector_count;
+        if (next == app_ring_tail_sector && !app_ring_empty()) {// 环形区已满，覆盖最早的扇区。
+            dropped = app_ring_sector_pending(next, app_ring_tail_used);
+            app_ring_pending -= dropped < app_ring_pending ? dropped : app_ring_pending;
+            app_ring_tail_sector = (next + 1) % app_ring_sector_count;
+            app_ring_tail_used = 0;
+        }
+        if (esp_partition_erase_range(app_ring_partition, next * APP_RING_SECTOR_SIZE, APP_RING_SECTOR_SIZE) != ESP_OK) {
+            pthread_mutex_unlock(&app_ring_mutex);
+            ESP_LOGE(TAG, "------ 闪存缓存擦除扇区：失败！扇区：%lu", next);
+            return -1;
+        }
+        if (app_ring_empty() || app_ring_tail_sector == next) {
+            app_ring_tail_sector = next;
+            app_ring_tail_used = 0;
+        }
+        app_ring_head_sector = next;
+        app_ring_head_used = 0;
+    }
+
+    app_ring_record_header_t* header = (app_ring_record_header_t*)app_ring_buffer;
+    memset(app_ring_buffer, 0xFF, size);
+    header->magic = APP_RING_MAGIC;
+    header->len = (uint16_t)len;
+    header->seq = app_ring_next_seq;
+    memcpy(app_ring_buffer + sizeof(app_ring_record_header_t), data, len);
+    header->crc = app_ring_crc(header, app_ring_buffer + sizeof(app_ring_record_header_t));
+    esp_err_t ret = esp_partition_write(app_ring_partition, app_ring_head_sector * APP_RING_SECTOR_SIZE + app_ring_head_used, app_ring_buffer, size);
+    app_ring_head_used += size;// 写入失败也跳过这个位置，不能在已写过的位置再写。
+    if (ret == ESP_OK) {
+        app_ring_next_seq++;
+        app_ring_pending++;
+    }
+    pthread_mutex_unlock(&app_ring_mutex);
+
+    if (dropped > 0) {
+        ESP_LOGW(TAG, "------ 闪存缓存已满，覆盖最早的记录：%lu 条。", dropped);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "------ 闪存缓存写入：失败！%s", esp_err_to_name(ret));
+        return -1;
+    }
+    return (int)len;
+}
+
+/**
+ * @brief 记录确认回调，在 MQTT 事件任务中执行，只记录在内存中，由积压数据任务写入闪存。
+ *        失败的记录保存为回退位置。
+ */
+static void app_ring_pub_ack(void* arg, uint64_t record_id, bool acked) {
+    uint32_t seq = (uint32_t)(record_id >> 32);
+    uint32_t pos = (uint32_t)record_id;
+    bool overflow = false;
+    pthread_mutex_lock(&app_ring_ack_mutex);
+    if (acked) {
+        if (app_ring_ack_count < APP_RING_ACK_SIZE) {
+            app_ring_acks[app_ring_ack_count++] = record_id;
+        } else {
+            overflow = true;
+        }
+    } else if (!app_ring_rewind_valid || seq < app_ring_rewind_seq) {
+        app_ring_rewind_valid = true;
+        app_ring_rewind_pos = pos;
+        app_ring_rewind_seq = seq;
+    }
+    pthread_mutex_unlock(&app_ring_ack_mutex);
+    if (overflow) {
+        ESP_LOGW(TAG, "------ 闪存缓存确认记录已满，这条记录下次重复推送。序号：%lu", seq);
+    }
+}
+
+/**
+ * @brief 把已确认的记录的 done 改写为 0，在积压数据任务中执行。
+ *        记录可能已经被覆盖，用序号核对。
+ */
+static void app_ring_apply_acks(void) {
+    uint64_t acks[APP_RING_ACK_SIZE];
+    pthread_mutex_lock(&app_ring_ack_mutex);
+    int count = app_ring_ack_count;
+    memcpy(acks, app_ring_acks, count * sizeof(acks[0]));
+    app_ring_ack_count = 0;
+    pthread_mutex_unlock(&app_ring_ack_mutex);
+    if (count == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&app_ring_mutex);
+    for (int i = 0; i < count; i++) {
+        uint32_t seq = (uint32_t)(acks[i] >> 32);
+        uint32_t pos = (uint32_t)acks[i];
+        app_ring_record_header_t header;
+        if (app_ring_read_header(pos / APP_RING_SECTOR_SIZE, pos % APP_RING_SECTOR_SIZE, &header) > 0 &&
+            header.seq == seq && header.done == 0xFFFFFFFF) {
+            uint32_t done = 0;
+            esp_partition_write(app_ring_partition, pos + offsetof(app_ring_record_header_t, done), &done, sizeof(done));
+            app_ring_pending -= app_ring_pending > 0;
+        }
+    }
+    pthread_mutex_unlock(&app_ring_mutex);
+}
+
+/**
+ * @brief 按顺序推送所有未推送的记录，不等待确认；服务器确认一条标记一条。
+ *        未确认的记录，下次从最早的一条重新推送。
+ * @param pub_cb
+ * @return 推送的记录数，中断返回 -1。
+ */
+int app_ring_pub(app_ring_pub_cb_t pub_cb) {
+    if (app_ring_partition == NULL) {
+        return 0;
+    }
+    char* data = malloc(APP_RING_MAX_LEN);
+    if (data == NULL) {
+        ESP_LOGE(TAG, "------ 闪存缓存推送：申请内存失败！");
+        return -1;
+    }
+    int count = 0;
+    int ret = 0;
+    while (1) {
+        pthread_mutex_lock(&app_ring_mutex);
+        if (app_ring_empty()) {
+            pthread_mutex_unlock(&app_ring_mutex);
+            break;
+        }
+        uint32_t sector = app_ring_tail_sector;
+        uint32_t used = app_ring_tail_used;
+        app_ring_record_header_t header;
+        if (app_ring_read_header(sector, used, &header) <= 0) {// 扇区结尾或者断电写坏的记录，跳到下一个扇区。
+            app_ring_tail_next_sector();
+            pthread_mutex_unlock(&app_ring_mutex);
+            continue;
+        }
+        if (header.done != 0xFFFFFFFF) {// 已推送，跳过。
+            app_ring_tail_used += APP_RING_RECORD_SIZE(header.len);
+            pthread_mutex_unlock(&app_ring_mutex);
+            continue;
+        }
+        if (esp_partition_read(app_ring_partition, sector * APP_RING_SECTOR_SIZE + used + sizeof(header), data, header.len) != ESP_OK ||
+            header.crc != app_ring_crc(&header, (const uint8_t*)data)) {// 数据损坏，跳过。
+            app_ring_tail_used += APP_RING_RECORD_SIZE(header.len);
+            app_ring_pending -= app_ring_pending > 0;
+            pthread_mutex_unlock(&app_ring_mutex);
+            continue;
+        }
+        app_ring_tail_used += APP_RING_RECORD_SIZE(header.len);// 先前进，未确认的记录推送结束后回退。
+        pthread_mutex_unlock(&app_ring_mutex);
+
+        uint64_t record_id = ((uint64_t)header.seq << 32) | (sector * APP_RING_SECTOR_SIZE + used);
+        if (pub_cb(data, header.len, app_ring_pub_ack, NULL, record_id) < 0) {
+            app_ring_pub_ack(NULL, record_id, false);
+            ret = -1;
+            break;
+        }
+        count++;
+        app_ring_apply_acks();// 未写入的确认不超过在途窗口。
+    }
+    free(data);
+
+    app_pub_flush(app_ring_pub_ack, NULL, APP_PUB_FLUSH_TIMEOUT_MS);// 等待本任务推送的记录全部确认，超时按失败处理。
+    app_ring_apply_acks();
+    pthread_mutex_lock(&app_ring_ack_mutex);
+    bool rewind_valid = app_ring_rewind_valid;
+    uint32_t rewind_pos = app_ring_rewind_pos;
+    uint32_t rewind_seq = app_ring_rewind_seq;
+    app_ring_rewind_valid = false;
+    pthread_mutex_unlock(&app_ring_ack_mutex);
+    pthread_mutex_lock(&app_ring_mutex);
+    if (rewind_valid) {// 回退到最早的未确认记录，已确认的记录下次跳过。
+        uint32_t sector = rewind_pos / APP_RING_SECTOR_SIZE;
+        uint32_t used = rewind_pos % APP_RING_SECTOR_SIZE;
+        app_ring_record_header_t header;
+        if (app_ring_read_header(sector, used, &header) > 0 && header.seq == rewind_seq) {
+            app_ring_tail_sector = sector;
+            app_ring_tail_used = used;
+        }
+    }
+    uint32_t pending = app_ring_pending;
+    pthread_mutex_unlock(&app_ring_mutex);
+    if (count > 0) {
+        ESP_LOGI(TAG, "------ 闪存缓存推送：%d 条，剩余：%lu 条。", count, pending);
+    }
+    return ret < 0 ? -1 : count;
+}
+
+/**
+ * @brief 是否有未推送的记录。
+ * @return
+ */
+bool app_ring_has_data(void) {
+    if (app_ring_partition == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&app_ring_mutex);
+    bool has_data = app_ring_pending > 0;
+    pthread_mutex_unlock(&app_ring_mutex);
+    return has_data;
+}
+
+/**
+ * @brief 初始化函数，扫描分区找到写入位置和最早的未推送记录。
+ *        每个扇区只读第一条记录头，再扫描写入扇区和未推送的记录头，不读数据。
+ * @return
+ */
+esp_err_t app_ring_init(void) {
+    const esp_partition_t* partition = esp_partition_find_first(APP_RING_PARTITION_TYPE, APP_RING_PARTITION_SUBTYPE, APP_RING_PARTITION_LABEL);
+    if (partition == NULL) {
+        ESP_LOGE(TAG, "------ 闪存缓存分区不存在！");
+        return ESP_FAIL;
+    }
+    app_ring_partition = partition;
+    app_ring_sector_count = partition->size / APP_RING_SECTOR_SIZE;
+    app_ring_head_sector = 0;
+    app_ring_head_used = 0;
+    app_ring_tail_sector = 0;
+    app_ring_tail_used = 0;
+    app_ring_next_seq = 1;
+    app_ring_pending = 0;
+
+    int head = -1;// 序号最大的扇区。
+    uint32_t max_seq = 0;
+    app_ring_record_header_t header;
+    for (uint32_t sector = 0; sector < app_ring_sector_count; sector++) {
+        if (app_ring_read_header(sector, 0, &header) > 0 && (head < 0 || header.seq > max_seq)) {
+            head = sector;
+            max_seq = header.seq;
+        }
+    }
+
+    if (head < 0) {// 空分区。
+        if (esp_partition_erase_range(partition, 0, APP_RING_SECTOR_SIZE) != ESP_OK) {
+            app_ring_partition = NULL;
+            ESP_LOGE(TAG, "------ 闪存缓存擦除扇区：失败！");
+            return ESP_FAIL;
+        }
+        ESP_LOGI(TAG, "------ 闪存缓存初始化：完成。空分区，扇区数：%lu", app_ring_sector_count);
+        return ESP_OK;
+    }
+
+    app_ring_head_sector = head;
+    app_ring_head_used = 0;
+    int ret;
+    while ((ret = app_ring_read_header(head, app_ring_head_used, &header)) > 0) {
+        app_ring_next_seq = header.seq + 1;
+        app_ring_head_used += APP_RING_RECORD_SIZE(header.len);
+    }
+    if (ret < 0) {// 断电写坏的记录，后面不能再写，下次追加从下一个扇区开始。
+        app_ring_head_used = APP_RING_SECTOR_SIZE;
+    }
+
+    app_ring_tail_sector = app_ring_head_sector;
+    app_ring_tail_used = app_ring_head_used;
+    bool found = false;
+    for (uint32_t i = 1; i <= app_ring_sector_count; i++) {// 从最早的扇区开始，找第一条未推送的记录。
+        uint32_t sector = (head + i) % app_ring_sector_count;
+        uint32_t used = 0;
+        while (app_ring_read_header(sector, used, &header) > 0) {
+            if (header.done == 0xFFFFFFFF) {
+                if (!found) {
+                    app_ring_tail_sector = sector;
+                    app_ring_tail_used = used;
+                    found = true;
+                }
+                app_ring_pending++;
+            }
+            used += APP_RING_RECORD_SIZE(header.len);
+        }
+    }
+    ESP_LOGI(TAG, "------ 闪存缓存初始化：完成。扇区数：%lu，写入扇区：%lu，下一条序号：%lu，未推送：%lu 条。",
+        app_ring_sector_count, app_ring_head_sector, app_ring_next_seq, app_ring_pending);
+    return ESP_OK;
+}
@@ -0,0 +1,68 @@
+/**
+ * @brief   闪存环形存储，SD 卡不可用时保存缓存数据。
+ *
+ *          使用独立的 ring 分区，直接用 esp_partition 读写，不经过文件系统。
+ *          记录按顺序追加写入，写满一个扇区再擦除下一个扇区，所有扇区轮流擦写，磨损均衡。
+ *          推送完成的记录把 done 字段改写为 0（只把 1 写成 0，不需要擦除）。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#include "app_pub.h"
+
+ /**
+  * @brief 单条记录的最大数据字节数。
+  */
+#define APP_RING_MAX_LEN            1008
+
+ /**
+  * @brief 记录头，16 字节，后面紧跟数据，按 4 字节对齐，记录不跨扇区。
+  */
+typedef struct {
+    uint16_t magic;             // 魔数，0xFFFF 表示未写入。
+    uint16_t len;               // 数据字节数。
+    uint32_t seq;               // 记录序号，整个分区内递增。
+    uint32_t crc;               // magic、len、seq 和数据的 CRC32。
+    uint32_t done;              // 0xFFFFFFFF = 未推送，0 = 已推送。
+} app_ring_record_header_t;
+
+/**
+ * @brief 推送一条记录的回调函数，返回负数表示失败。
+ *        服务器确认后调用 ack_cb(arg, record_id, acked)。
+ */
+typedef int (*app_ring_pub_cb_t)(const char* data, size_t len, app_pub_ack_cb_t ack_cb, void* arg, uint64_t record_id);
+
+/**
+ * @brief 追加一条记录。写满时覆盖最早的扇区。
+ * @param data
+ * @param len
+ * @return 写入字节数，失败返回 -1。
+ */
+int app_ring_append(const char* data, size_t len);
+
+/**
+ * @brief 按顺序推送所有未推送的记录，不等待确认；服务器确认一条标记一条。
+ *        未确认的记录，下次从最早的一条重新推送。
+ * @param pub_cb
+ * @return 推送的记录数，中断返回 -1。
+ */
+int app_ring_pub(app_ring_pub_cb_t pub_cb);
+
+/**
+ * @brief 是否有未推送的记录。
+ * @return
+ */
+bool app_ring_has_data(void);
+
+/**
+ * @brief 初始化函数，扫描分区找到写入位置和最早的未推送记录。
+ * @return
+ */
+esp_err_t app_ring_init(void);
@@ -5,15 +5,34 @@
  * @date    2024-06-28
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
 #include <string.h>
 #include <dirent.h>
 #include <errno.h>
 #include <unistd.h>
+#include <stdatomic.h>
+#include <time.h>
 #include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/ringbuf.h"
 #include "esp_vfs_fat.h"
+#include "esp_timer.h"
+#include "ff.h"
 #include "sdmmc_cmd.h"
 #include "driver/sdmmc_host.h"
 
+#include "app_seg.h"
+#include "app_ring.h"
+#include "app_pub.h"
+#include "app_outbox.h"
+#include "app_http.h"
+#include "app_ppp.h"
+#include "app_ble.h"
+#include "app_track.h"
 #include "app_main.h"
 #include "app_mqtt.h"
 #include "app_config.h"
@@ -31,6 +50,11 @@
  */
 #define APP_SD_MOUNT_POINT   "/sdcard"
 
+ /**
+ * @brief FATFS 驱动器号，只有一个 FAT 卷。
+ */
+#define APP_SD_FAT_DRIVE     "0:"
+
  /**
  * @brief 日志目录。
  *        必须大写！为啥啊！
@@ -39,40 +63,27 @@
  */
 #define APP_SD_LOG_DIR              APP_SD_MOUNT_POINT"/LOG"
 
- /**
- * @brief 日志文件名。
- */
-#define APP_SD_LOG_TXT              APP_SD_LOG_DIR"/LOG.TXT"
-
- /**
- * @brief 日志备份文件名，稍后按时间复制为文件。
- */
-#define APP_SD_LOG_FILE_TXT         APP_SD_LOG_DIR"/FILE.TXT"
-
- /**
- * @brief 日志备份文件名，稍后推送给 MQTT 服务器。
- */
-#define APP_SD_LOG_MQTT_TXT         APP_SD_LOG_DIR"/MQTT.TXT"
-
  /**
  * @brief 缓存目录。
  */
 #define APP_SD_CACHE_DIR            APP_SD_MOUNT_POINT"/CACHE"
 
  /**
- * @brief 缓存文件名。
+ * @brief 日志和缓存目录的 FATFS 路径，活动段直接用 FATFS 读写。
  */
-#define APP_SD_CACHE_TXT            APP_SD_CACHE_DIR"/CACHE.TXT"
+#define APP_SD_LOG_FAT_DIR          APP_SD_FAT_DRIVE"/LOG"
+#define APP_SD_CACHE_FAT_DIR        APP_SD_FAT_DRIVE"/CACHE"
 
  /**
- * @brief 缓存备份文件名，稍后按时间复制为文件。
+ * @brief 输出段写入耗时分布和推送统计的间隔，毫秒。
  */
-#define APP_SD_CACHE_FILE_TXT       APP_SD_CACHE_DIR"/FILE.TXT"
+#define APP_SD_LATENCY_LOG_MS       (10 * 60 * 1000)
 
  /**
- * @brief 缓存备份文件名，稍后推送给 MQTT 服务器。
+ * @brief 存储类型，写入批量推送的块头。
  */
-#define APP_SD_CACHE_MQTT_TXT       APP_SD_CACHE_DIR"/MQTT.TXT"
+#define APP_SD_KIND_LOG             0
+#define APP_SD_KIND_CACHE           1
 
  /**
  * @brief 日志 TAG。
@@ -85,333 +96,591 @@ static const char* TAG = "app_sd";
 static int app_sd_init_status = 0;
 
 /**
-* @brief 日志文件。
+* @brief 日志分段存储。
+*/
+static app_seg_store_t app_sd_log_store;
+
+/**
+* @brief 缓存分段存储。
+*/
+static app_seg_store_t app_sd_cache_store;
+
+/**
+* @brief 日志分段存储是否可用。
+*/
+static int app_sd_log_status = 0;
+
+/**
+* @brief 缓存分段存储是否可用。
+*/
+static int app_sd_cache_status = 0;
+
+/**
+* @brief 积压数据任务句柄，压缩和推送封存段。
+*/
+static TaskHandle_t app_sd_backlog_task_handle = NULL;
+
+/**
+* @brief 日志队列，日志输出函数只把一行日志放入队列，由 SD 卡写入任务写入日志段，调用日志的任务不访问 SD 卡。
 */
-static FILE* app_sd_log_file = NULL;
+static RingbufHandle_t app_sd_log_queue = NULL;
 
 /**
-* @brief 缓存文件。
+* @brief 日志队列已满时丢弃的行数，由 SD 卡写入任务输出后清零。
 */
-static FILE* app_sd_cache_file = NULL;
+static _Atomic uint32_t app_sd_log_dropped = ATOMIC_VAR_INIT(0);
 
 /**
-* @brief 日志文件写入计数。
+* @brief 轨迹记录队列，主循环只放入队列，由 SD 卡写入任务写入轨迹存储，采样周期不受 SD 卡延迟影响。
 */
-static uint32_t app_sd_log_file_write_count = 0;
+static QueueHandle_t app_sd_track_queue = NULL;
 
 /**
-* @brief 缓存 MQTT 已推送行数。
+* @brief 轨迹记录队列已满时丢弃的条数，由 SD 卡写入任务输出后清零。
 */
-static int app_sd_cache_mqtt_pub_line = 0;
+static _Atomic uint32_t app_sd_track_dropped = ATOMIC_VAR_INIT(0);
+
+/**
+* @brief 请求 SD 卡写入任务立即 fsync，不等 APP_SD_FSYNC_MS。
+*/
+static _Atomic int app_sd_fsync_req = ATOMIC_VAR_INIT(0);
+
+/**
+* @brief 请求积压数据任务封存缓存活动段，MQTT 任务和发件箱任务只设置标志，不操作 SD 卡。
+*/
+static _Atomic int app_sd_cache_rotate_req = ATOMIC_VAR_INIT(0);
 
 /**
 * @brief 输出数据到缓存文件。
+*        SD 卡不可用或者写入失败时，写入闪存环形存储。
+* @return 写入字节数，失败返回 -1。
 */
-void app_sd_write_cache_file(char* json) {
-    if (app_sd_init_status == 0) {
-        ESP_LOGE(TAG, "------ SD 卡初始化失败，SD 卡状态：不可用！");
-        return;
-    }
-    if (app_sd_cache_file == NULL) {
-        ESP_LOGE(TAG, "------ SD 卡写入缓存文件：失败！app_sd_cache_file == NULL");
-        return;
-    }
+int app_sd_write_cache_file(char* json) {
     size_t len = strlen(json);
     json[len - 2] = '1';// 替换 json 中标记字段值为 1，标记为缓存数据。
-    json[len] = '\n';// 追加换行符。
-    json[len + 1] = '\0'; // 添加字符串终止符。
-    size_t write_len = fwrite(json, 1, strlen(json), app_sd_cache_file);
-    fflush(app_sd_cache_file);
-    fsync(fileno(app_sd_cache_file));
-    ESP_LOGI(TAG, "------ SD 卡写入缓存，字节数：%d --> %s", write_len, json);
+    if (app_sd_init_status == 1 && app_sd_cache_status == 1) {
+        json[len] = '\n';// 追加换行符。
+        json[len + 1] = '\0'; // 添加字符串终止符。
+        int write_len = app_seg_append(&app_sd_cache_store, json, len + 1);// 由 SD 卡写入任务批量 fsync。
+        if (write_len > 0) {
+            ESP_LOGI(TAG, "------ SD 卡写入缓存，字节数：%d --> %s", write_len, json);
+            return write_len;
+        }
+        app_sd_cache_status = 0;// SD 卡松动或者损坏，之后全部写入闪存，重启后再检查 SD 卡。
+        ESP_LOGE(TAG, "------ SD 卡写入缓存文件：失败！改为写入闪存缓存。");
+        json[len] = '\0';
+    }
+    int write_len = app_ring_append(json, len);
+    ESP_LOGI(TAG, "------ 闪存写入缓存，字节数：%d --> %s", write_len, json);
+    return write_len;
+}
+
+/**
+* @brief 轨迹记录放入队列，由 SD 卡写入任务写入轨迹存储，不阻塞调用者。
+* @return 放入队列返回 1，队列已满或者 SD 卡不可用返回 -1。
+*/
+int app_sd_write_track(const app_track_record_t* record) {
+    if (app_sd_track_queue == NULL) {
+        return -1;
+    }
+    if (xQueueSend(app_sd_track_queue, record, 0) != pdTRUE) {
+        atomic_fetch_add(&app_sd_track_dropped, 1);
+        return -1;
+    }
+    return 1;
 }
 
 /**
 * @brief 确保写出日志内容到 SD 卡。
-*        fsync() 执行比较消耗性能，所以由外部调用，隔一段时间执行一次。
+*        只请求 SD 卡写入任务在写完队列中的日志后 fsync，不阻塞调用者。
 */
 void app_sd_fsync_log_file(void) {
     if (app_sd_init_status == 0) {
         ESP_LOGE(TAG, "------ SD 卡初始化失败，SD 卡状态：不可用！");
         return;
     }
-    if (app_sd_log_file != NULL && app_sd_log_file_write_count > 0) {
-        fsync(fileno(app_sd_log_file));
+    atomic_store(&app_sd_fsync_req, 1);
+}
+
+/**
+* @brief 一行日志放入日志队列，不等待，队列已满时丢弃并计数。
+*/
+static void app_sd_log_enqueue(const char* line, size_t len) {
+    if (xRingbufferSend(app_sd_log_queue, line, len, 0) != pdTRUE) {
+        atomic_fetch_add(&app_sd_log_dropped, 1);
     }
 }
 
 /**
 * @brief 增加写日志到文件的功能，保留日志输出到 UART。
+*        此函数在调用日志的任务中执行，只放入日志队列，不访问 SD 卡。
 */
 static int app_sd_write_log_file(const char* fmt, va_list args) {
+    va_list file_args;
+    va_list long_args;
+    va_copy(file_args, args);// vprintf() 之后 args 不能再使用，先复制两份：一份写 line，一份超长时重新格式化。
+    va_copy(long_args, args);
     int ret_uart = vprintf(fmt, args);// 先写 UART。
     int ret_file = 0;
-    if (app_sd_log_file != NULL) {
-        ret_file = vfprintf(app_sd_log_file, fmt, args);// 再写文件。
-        fflush(app_sd_log_file);
-        app_sd_log_file_write_count++;
+    if (app_sd_log_status == 1 && app_sd_log_queue != NULL) {
+        char line[256];
+        ret_file = vsnprintf(line, sizeof(line), fmt, file_args);
+        if (ret_file >= (int)sizeof(line)) {// 超长日志，按实际长度申请内存。
+            char* long_line = malloc(ret_file + 1);
+            if (long_line != NULL) {
+                vsnprintf(long_line, ret_file + 1, fmt, long_args);
+                app_sd_log_enqueue(long_line, ret_file);// 再写文件。
+                free(long_line);
+            }
+        } else if (ret_file > 0) {
+            app_sd_log_enqueue(line, ret_file);// 再写文件。
+        }
     }
+    va_end(long_args);
+    va_end(file_args);
     return ret_uart < 0 ? ret_uart : ret_file;
 }
 
 /**
-* @brief 计算备份文件数量。
+* @brief 轮换已满的活动段，只在 SD 卡写入任务中调用。
+*        清单已满时 app_seg_rotate() 不轮换，等积压数据任务清理最早的段。
+*/
+static void app_sd_rotate_pending(app_seg_store_t* store, int status) {
+    if (status == 1 && app_seg_rotate_pending(store)) {
+        app_seg_rotate(store);
+    }
+}
+
+/**
+* @brief SD 卡写入任务：把日志队列写入日志段，把轨迹记录队列写入轨迹存储，
+*        按时间或行数批量 fsync 日志段和缓存段，轮换已满的活动段。
+*        日志段和缓存段的轮换都在这个任务中执行。轨迹记录最多延迟 APP_SD_FSYNC_MS 写入。
+* @param param
+*/
+static void app_sd_log_task(void* param) {
+    int64_t fsync_ms = esp_timer_get_time() / 1000;
+    uint32_t unsynced = 0;
+    while (1) {
+        size_t len = 0;
+        TickType_t wait = atomic_load(&app_sd_fsync_req) != 0 ? 0 : pdMS_TO_TICKS(APP_SD_FSYNC_MS);// 有 fsync 请求时只取已在队列中的日志。
+        char* line = NULL;
+        if (app_sd_log_queue != NULL) {
+            line = xRingbufferReceive(app_sd_log_queue, &len, wait);
+        } else {
+            vTaskDelay(wait > 0 ? wait : 1);// 日志段不可用，只写轨迹。
+        }
+        if (line != NULL) {
+            if (app_sd_log_status == 1) {
+                app_seg_append(&app_sd_log_store, line, len);
+            }
+            vRingbufferReturnItem(app_sd_log_queue, line);
+            unsynced++;
+        }
+        app_track_record_t record;
+        while (app_sd_track_queue != NULL && xQueueReceive(app_sd_track_queue, &record, 0) == pdTRUE) {// 块满或者超过 APP_TRACK_FLUSH_MS 才写 SD 卡。
+            app_track_append(&record);
+        }
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        bool fsync_req = atomic_load(&app_sd_fsync_req) != 0;
+        if (fsync_req && line != NULL && unsynced < APP_SD_FSYNC_COUNT) {// 先写完队列中的日志。
+            continue;
+        }
+        if (fsync_req || unsynced >= APP_SD_FSYNC_COUNT || now_ms - fsync_ms >= APP_SD_FSYNC_MS) {
+            atomic_store(&app_sd_fsync_req, 0);
+            if (app_sd_log_status == 1) {
+                app_seg_fsync(&app_sd_log_store);
+            }
+            if (app_sd_cache_status == 1) {
+                app_seg_fsync(&app_sd_cache_store);
+            }
+            fsync_ms = now_ms;
+            unsynced = 0;
+            app_sd_rotate_pending(&app_sd_log_store, app_sd_log_status);
+            app_sd_rotate_pending(&app_sd_cache_store, app_sd_cache_status);
+        }
+        uint32_t dropped = atomic_exchange(&app_sd_log_dropped, 0);
+        if (dropped > 0) {
+            ESP_LOGW(TAG, "------ 日志队列已满，丢弃日志：%lu 行。", dropped);
+        }
+        dropped = atomic_exchange(&app_sd_track_dropped, 0);
+        if (dropped > 0) {
+            ESP_LOGW(TAG, "------ 轨迹记录队列已满，丢弃记录：%lu 条。", dropped);
+        }
+    }
+}
+
+/**
+* @brief 是否是旧版本按时间备份的文件，文件名格式：月日时分.TXT
+*        d_name 只有文件名，不包含目录。
+*/
+static bool app_sd_is_bak_file(const char* name) {
+    if (strlen(name) != 12 || strcmp(name + 8, ".TXT") != 0) {
+        return false;
+    }
+    for (int i = 0; i < 8; i++) {
+        if (name[i] < '0' || name[i] > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+* @brief 淘汰候选文件。
+*/
+typedef struct {
+    uint32_t ts;                // 创建时间，UTC 秒数，越小越先删除。
+    uint32_t size;              // 字节数。
+    app_seg_store_t* store;     // 分段存储的段，其它文件为 NULL。
+    uint32_t seq;               // 段序号。
+    char path[64];              // 其它文件的文件名。
+} app_sd_retain_item_t;
+
+/**
+* @brief 清理中，直到剩余空间达到高水位。
+*/
+static int app_sd_retain_evicting = 0;
+
+/**
+* @brief 上次检查剩余空间的时间，毫秒。
+*/
+static int64_t app_sd_retain_check_ms = 0;
+
+/**
+* @brief 读取 SD 卡总容量和剩余空间。
+*/
+static int app_sd_get_free(uint64_t* total_bytes, uint64_t* free_bytes) {
+    FATFS* fs;
+    DWORD free_clust;
+    if (f_getfree(APP_SD_FAT_DRIVE, &free_clust, &fs) != FR_OK) {
+        return -1;
+    }
+#if FF_MAX_SS != FF_MIN_SS
+    uint64_t clust_size = (uint64_t)fs->csize * fs->ssize;
+#else
+    uint64_t clust_size = (uint64_t)fs->csize * FF_MAX_SS;
+#endif
+    *total_bytes = (uint64_t)(fs->n_fatent - 2) * clust_size;
+    *free_bytes = (uint64_t)free_clust * clust_size;
+    return 1;
+}
+
+/**
+* @brief 是否已有候选文件。
+*/
+static bool app_sd_retain_found(const app_sd_retain_item_t* item) {
+    return item->store != NULL || item->path[0] != 0;
+}
+
+/**
+* @brief 候选文件比较，时间更早的替换 item。
 */
-static int app_sd_count_bak_files(const char* path) {
+static void app_sd_retain_pick(app_sd_retain_item_t* item, const app_sd_retain_item_t* cand) {
+    if (!app_sd_retain_found(item) || cand->ts < item->ts) {
+        *item = *cand;
+    }
+}
+
+/**
+* @brief 最早的已推送段。
+*/
+static void app_sd_retain_find_seg(app_seg_store_t* store, int status, app_sd_retain_item_t* item) {
+    app_seg_entry_t entry;
+    if (status == 0 || !app_seg_find(store, APP_SEG_STATE_SEALED | APP_SEG_STATE_UPLOADED, 0, &entry)) {
+        return;
+    }
+    app_sd_retain_item_t cand = {
+        .ts = entry.create_ts,
+        .size = (entry.state & APP_SEG_STATE_COMPRESSED) ? entry.zsize : entry.size,
+        .store = store,
+        .seq = entry.seq,
+    };
+    app_sd_retain_pick(item, &cand);
+}
+
+/**
+* @brief 最早的旧版本备份文件，按修改时间。
+*        d_name 只有文件名，不包含目录。
+*/
+static void app_sd_retain_find_bak(const char* path, app_sd_retain_item_t* item) {
     DIR* dp = opendir(path);
     if (dp == NULL) {
-        ESP_LOGE(TAG, "------ SD 卡打开目录：失败！目录：%s", path);
-        return -1;
+        return;
     }
-    int file_count = 0;
+    app_sd_retain_item_t cand = { 0 };
+    int found = 0;
     struct dirent* entry;
-    while ((entry = readdir(dp))) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+    while ((entry = readdir(dp)) != NULL) {
+        if (!app_sd_is_bak_file(entry->d_name)) {// 只处理备份文件，排除分段存储的文件。
             continue;
         }
-        if (strcmp(entry->d_name, APP_SD_LOG_TXT) == 0 || // 排除文件名。
-            strcmp(entry->d_name, APP_SD_LOG_FILE_TXT) == 0 ||
-            strcmp(entry->d_name, APP_SD_LOG_MQTT_TXT) == 0 ||
-            strcmp(entry->d_name, APP_SD_CACHE_TXT) == 0 ||
-            strcmp(entry->d_name, APP_SD_CACHE_FILE_TXT) == 0 ||
-            strcmp(entry->d_name, APP_SD_CACHE_MQTT_TXT) == 0
-            ) {
+        char file_path[64];
+        struct stat st;
+        snprintf(file_path, sizeof(file_path), "%s/%s", path, entry->d_name);
+        if (stat(file_path, &st) != 0) {
             continue;
         }
-        file_count++;
+        if (found == 0 || (uint32_t)st.st_mtime < cand.ts) {
+            cand.ts = (uint32_t)st.st_mtime;
+            cand.size = (uint32_t)st.st_size;
+            strcpy(cand.path, file_path);
+            found = 1;
+        }
     }
     closedir(dp);
-    return file_count;
+    if (found) {
+        app_sd_retain_pick(item, &cand);
+    }
 }
 
 /**
- * @brief 删除全部备份文件。
- */
-static void app_sd_delete_bak_files(const char* path) {
-    DIR* log_dir = opendir(path);
-    if (log_dir == NULL) {
-        ESP_LOGE(TAG, "------ SD 卡打开目录：失败！目录：%s", path);
-        return;
+* @brief 删除候选文件。
+* @return 释放的字节数，失败返回 -1。
+*/
+static int app_sd_retain_delete(const app_sd_retain_item_t* item, const char* reason) {
+    int freed;
+    if (item->store != NULL) {
+        freed = app_seg_delete(item->store, item->seq);
+        if (freed >= 0) {
+            ESP_LOGW(TAG, "------ SD 卡清理%s：%s/%08lu，%d 字节。", reason, item->store->dir, item->seq, freed);
+        }
+    } else {
+        freed = remove(item->path) == 0 ? (int)item->size : -1;
+        if (freed >= 0) {
+            ESP_LOGW(TAG, "------ SD 卡清理%s：%s，%d 字节。", reason, item->path, freed);
+        }
     }
-    struct dirent* entry;
-    while ((entry = readdir(log_dir)) != NULL) {// 遍历目录。
-        char file_path[256];
-        if (strlen(path) + strlen(entry->d_name) + 1 < sizeof(file_path)) {
-            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {// 忽略 "." 和 ".."
-                continue;
-            }
-            if (strcmp(entry->d_name, APP_SD_LOG_TXT) == 0 ||// 排除文件名。
-                strcmp(entry->d_name, APP_SD_LOG_FILE_TXT) == 0 ||
-                strcmp(entry->d_name, APP_SD_LOG_MQTT_TXT) == 0 ||
-                strcmp(entry->d_name, APP_SD_CACHE_TXT) == 0 ||
-                strcmp(entry->d_name, APP_SD_CACHE_FILE_TXT) == 0 ||
-                strcmp(entry->d_name, APP_SD_CACHE_MQTT_TXT) == 0
-                ) {
-                continue;
-            }
-            int path_length = snprintf(file_path, sizeof(file_path), "%s/%s", path, entry->d_name);
-            if (path_length < 0 || path_length >= sizeof(file_path)) {
-                continue; // 文件名长度超过缓冲区，跳过这个文件。
-            }
-            remove(file_path);// 删除文件。 
+    return freed;
+}
+
+/**
+* @brief 删除最早的未推送段，只在剩余空间严重不足时调用，日志优先于缓存。
+*/
+static int app_sd_retain_delete_unsent(void) {
+    app_seg_store_t* stores[] = { &app_sd_log_store, &app_sd_cache_store };
+    int status[] = { app_sd_log_status, app_sd_cache_status };
+    for (int i = 0; i < 2; i++) {
+        app_seg_entry_t entry;
+        if (status[i] == 0 || !app_seg_find(stores[i], APP_SEG_STATE_SEALED, APP_SEG_STATE_UPLOADED, &entry)) {
+            continue;
         }
+        app_sd_retain_item_t item = { .ts = entry.create_ts, .store = stores[i], .seq = entry.seq };
+        return app_sd_retain_delete(&item, "（空间不足，未推送）") >= 0;
     }
-    closedir(log_dir);
+    return 0;
 }
 
 /**
- * @brief 复制文件，追加模式。
- * @param source
- * @param destination
- */
-static void app_sd_copy_file(const char* source, const char* destination) {
-    FILE* src = fopen(source, "rb");
-    if (src == NULL) {
-        ESP_LOGE(TAG, "------ SD 卡复制文件，无法打开源文件！文件名：%s", source);
-        return;
+* @brief 段清单已满时删除最早的段，给推迟的轮换腾出条目，SD 卡写入任务随后补做轮换。
+*        只删除已推送的段；最早的段未推送时继续写活动段，等推送完成，
+*        剩余空间严重不足时由 app_sd_retain_delete_unsent() 删除。
+* @return 删除的文件数。
+*/
+static int app_sd_retain_manifest(app_seg_store_t* store, int status) {
+    if (status == 0) {
+        return 0;
     }
-    FILE* dest = fopen(destination, "a");// 追加模式。
-    if (dest == NULL) {
-        ESP_LOGE(TAG, "------ SD 卡复制文件，无法打开目标文件！文件名：%s", destination);
-        fclose(src);
-        return;
+    app_seg_entry_t head;
+    if (!app_seg_full(store, &head)) {
+        return 0;
+    }
+    if (!(head.state & APP_SEG_STATE_SEALED) || !(head.state & APP_SEG_STATE_UPLOADED)) {
+        return 0;
+    }
+    app_sd_retain_item_t item = { .ts = head.create_ts, .store = store, .seq = head.seq };
+    return app_sd_retain_delete(&item, "（段清单已满）") >= 0;
+}
+
+/**
+* @brief 按剩余空间和保存天数清理 SD 卡，每次最多删除一个文件，在积压数据任务中循环调用。
+*        剩余空间低于 APP_SD_FREE_LOW_PCT 开始按时间从早到晚删除已推送的数据，
+*        达到 APP_SD_FREE_HIGH_PCT 停止；超过 APP_SD_RETAIN_DAYS 的已推送数据随时删除。
+*        未推送的数据只在剩余空间低于 APP_SD_FREE_CRITICAL_PCT 时删除。
+*        段清单已满时每次循环都检查，不等 APP_SD_RETAIN_CHECK_MS。
+* @return 删除的文件数。
+*/
+static int app_sd_retain_step(void) {
+    int deleted = app_sd_retain_manifest(&app_sd_log_store, app_sd_log_status) +
+        app_sd_retain_manifest(&app_sd_cache_store, app_sd_cache_status);
+    if (deleted > 0) {
+        return deleted;
+    }
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    if (app_sd_retain_evicting == 0 && now_ms - app_sd_retain_check_ms < APP_SD_RETAIN_CHECK_MS) {
+        return 0;
+    }
+    app_sd_retain_check_ms = now_ms;
+
+    uint64_t total_bytes, free_bytes;
+    if (app_sd_get_free(&total_bytes, &free_bytes) < 0 || total_bytes == 0) {
+        return 0;
+    }
+    uint32_t free_pct = (uint32_t)(free_bytes * 100 / total_bytes);
+    if (app_sd_retain_evicting == 0 && free_pct < APP_SD_FREE_LOW_PCT) {
+        app_sd_retain_evicting = 1;
+        ESP_LOGW(TAG, "------ SD 卡剩余空间：%lu%%，开始清理。", free_pct);
+    } else if (app_sd_retain_evicting == 1 && free_pct >= APP_SD_FREE_HIGH_PCT) {
+        app_sd_retain_evicting = 0;
+        ESP_LOGI(TAG, "------ SD 卡剩余空间：%lu%%，停止清理。", free_pct);
+    }
+
+    time_t now = time(NULL);
+    uint32_t expire_ts = now > APP_SEG_TIME_VALID_TS ? (uint32_t)now - APP_SD_RETAIN_DAYS * 86400 : 0;// 时间未同步不按天数清理。
+
+    app_sd_retain_item_t item = { 0 };
+    app_sd_retain_find_seg(&app_sd_log_store, app_sd_log_status, &item);
+    app_sd_retain_find_seg(&app_sd_cache_store, app_sd_cache_status, &item);
+    app_sd_retain_find_bak(APP_SD_LOG_DIR, &item);
+    app_sd_retain_find_bak(APP_SD_CACHE_DIR, &item);
+    app_sd_retain_item_t track = { 0 };
+    if (app_track_oldest(&track.ts, &track.size, track.path, sizeof(track.path))) {
+        app_sd_retain_pick(&item, &track);
+    }
+
+    bool found = app_sd_retain_found(&item);
+    if (found && app_sd_retain_evicting == 1) {
+        if (app_sd_retain_delete(&item, "（空间不足）") >= 0) {
+            return 1;
+        }
+    } else if (found && expire_ts > 0 && item.ts > 0 && item.ts < expire_ts) {
+        if (app_sd_retain_delete(&item, "（超过保存天数）") >= 0) {
+            app_sd_retain_check_ms = 0;// 可能还有过期文件，下次循环继续检查。
+            return 1;
+        }
     }
-    char buffer[1024];
-    size_t bytesRead;
-    while ((bytesRead = fread(buffer, 1, sizeof(buffer), src)) > 0) {
-        fwrite(buffer, 1, bytesRead, dest);
+    if (free_pct < APP_SD_FREE_CRITICAL_PCT) {
+        return app_sd_retain_delete_unsent();
     }
-    fclose(src);
-    fclose(dest);
+    return 0;
 }
 
 /**
 * @brief 备份日志文件。
+*        分段存储不再复制文件，只在清单中记录归档时间。
 */
 void app_sd_bak_log_file(void) {
     if (app_sd_init_status == 0) {
         ESP_LOGE(TAG, "------ SD 卡初始化失败，SD 卡状态：不可用！");
         return;
     }
-    ESP_LOGI(TAG, "------ SD 卡备份日志文件：开始。");
-    if (access(APP_SD_LOG_FILE_TXT, F_OK) == -1) {
-        ESP_LOGE(TAG, "------ SD 卡备份日志文件：失败。文件不存在，文件名：%s", APP_SD_LOG_FILE_TXT);
-        return;
+    if (app_sd_log_status == 1) {
+        app_seg_archive(&app_sd_log_store);
     }
-    time_t now;
-    time(&now); // 获取当前时间（秒）。
-    struct tm timeinfo;
-    gmtime_r(&now, &timeinfo); // 将时间转换为 UTC 时间。
-    char new_bak_name[64];
-    strftime(new_bak_name, sizeof(new_bak_name), APP_SD_LOG_DIR"/%m%d%H%M.TXT", &timeinfo);// 月日时分.TXT
-    app_sd_copy_file(APP_SD_LOG_FILE_TXT, new_bak_name);
-    ESP_LOGI(TAG, "------ SD 卡备份日志文件：完成。文件名：%s", new_bak_name);
-    remove(APP_SD_LOG_FILE_TXT);// 文件备份完，删除 FILE.TXT
 }
 
 /**
 * @brief 备份缓存文件。
+*        分段存储不再复制文件，只在清单中记录归档时间。
 */
 void app_sd_bak_cache_file(void) {
     if (app_sd_init_status == 0) {
         ESP_LOGE(TAG, "------ SD 卡初始化失败，SD 卡状态：不可用！");
         return;
     }
-    ESP_LOGI(TAG, "------ SD 卡备份缓存文件：开始。");
-    if (access(APP_SD_CACHE_FILE_TXT, F_OK) == -1) {
-        ESP_LOGE(TAG, "------ SD 卡备份缓存文件：失败。文件不存在，文件名：%s", APP_SD_CACHE_FILE_TXT);
-        return;
+    if (app_sd_cache_status == 1) {
+        app_seg_archive(&app_sd_cache_store);
     }
-    time_t now;
-    time(&now); // 获取当前时间（秒）。
-    struct tm timeinfo;
-    gmtime_r(&now, &timeinfo); // 将时间转换为 UTC 时间。
-    char new_bak_name[64];
-    strftime(new_bak_name, sizeof(new_bak_name), APP_SD_CACHE_DIR"/%m%d%H%M.TXT", &timeinfo);// 月日时分.TXT
-    app_sd_copy_file(APP_SD_CACHE_FILE_TXT, new_bak_name);
-    ESP_LOGI(TAG, "------ SD 卡备份缓存文件：完成。文件名：%s", new_bak_name);
-    remove(APP_SD_CACHE_FILE_TXT);// 文件备份完，删除 FILE.TXT
 }
 
+/**
+* @brief 推送一块积压数据。
+*/
+static int app_sd_pub_chunk(const char* data, size_t len, app_pub_ack_cb_t ack_cb, void* arg, uint64_t record_id) {
+    return app_pub_send(APP_MQTT_TOPIC_BULK, data, len, APP_PUB_TIMEOUT_PARAM, ack_cb, arg, record_id);
+}
 
 /**
 * @brief 推送日志备份文件。
+*        只唤醒积压数据任务，不阻塞调用者（MQTT 事件任务）。
 */
 void app_sd_pub_log_bak_file(void) {
     if (app_sd_init_status == 0) {
         ESP_LOGE(TAG, "------ SD 卡初始化失败，SD 卡状态：不可用！");
         return;
     }
-    ESP_LOGI(TAG, "------ SD 卡推送日志备份文件：开始。文件名：%s", APP_SD_LOG_MQTT_TXT);
-    if (access(APP_SD_LOG_MQTT_TXT, F_OK) == -1) {// 检查 LOG.BAK 是否存在，存在则发送给服务器。
-        ESP_LOGE(TAG, "------ SD 卡推送日志备份文件：失败。文件不存在，文件名：%s", APP_SD_LOG_MQTT_TXT);
-        return;
-    }
-    FILE* file = fopen(APP_SD_LOG_MQTT_TXT, "r");
-    if (file == NULL) {
-        ESP_LOGE(TAG, "------ SD 卡推送日志备份文件：失败。打开文件失败，文件名：%s", APP_SD_LOG_MQTT_TXT);
-        return;
-    }
-    int line_count = 0;
-    char line[1000];
-    while (fgets(line, sizeof(line), file) != NULL) {// 逐行读取文件内容。
-        size_t len = strlen(line);// 去除行尾的换行符。
-        if (len > 0 && line[len - 1] == '\n') {
-            line[len - 1] = '\0'; // 将换行符替换为 NULL 终止符。
-        }
-        char topic[100];
-        snprintf(topic, sizeof(topic), "%s/%s", APP_MQTT_PUB_LOG_TOPIC, app_main_data.dev_addr);
-        int pub_ret = app_mqtt_publish_log(topic, line);
-        if (pub_ret < 0) {// 只要有一次发送失败，就跳出循环，不再继续执行。
-            ESP_LOGW(TAG, "------ SD 卡推送日志备份文件：中断。文件名：%s，推送行数：%d", APP_SD_LOG_MQTT_TXT, line_count);
-            break;
-        }
-        line_count++;
-
+    if (app_sd_backlog_task_handle != NULL) {
+        xTaskNotifyGive(app_sd_backlog_task_handle);
     }
-    fclose(file);
-    remove(APP_SD_LOG_MQTT_TXT);// 推送完成，删除 MQTT.TXT
-    ESP_LOGI(TAG, "------ SD 卡推送日志备份文件：完成。文件名：%s，推送行数：%d", APP_SD_LOG_MQTT_TXT, line_count);
 }
 
 /**
-* @brief 推送缓存备份文件。
+* @brief 推送闪存缓存中的一条记录。
 */
-void app_sd_pub_cache_bak_file(void) {
-    if (app_sd_init_status == 0) {
-        ESP_LOGE(TAG, "------ SD 卡初始化失败，SD 卡状态：不可用！");
-        return;
-    }
-    ESP_LOGI(TAG, "------ SD 卡推送缓存备份文件：开始。文件名：%s", APP_SD_CACHE_MQTT_TXT);
-    if (access(APP_SD_CACHE_MQTT_TXT, F_OK) == -1) {// 检查 LOG.BAK 是否存在，存在则发送给服务器。
-        ESP_LOGE(TAG, "------ SD 卡推送缓存备份文件：失败。文件不存在，文件名：%s", APP_SD_CACHE_MQTT_TXT);
-        return;
-    }
-    FILE* file = fopen(APP_SD_CACHE_MQTT_TXT, "r");
-    if (file == NULL) {
-        ESP_LOGE(TAG, "------ SD 卡推送缓存备份文件：失败。打开文件失败，文件名：%s", APP_SD_CACHE_MQTT_TXT);
-        return;
-    }
-
-    char line[1024];
-    ESP_LOGI(TAG, "------ SD 卡推送缓存文件：开始。文件名：%s，跳过行数：%d", APP_SD_CACHE_MQTT_TXT, app_sd_cache_mqtt_pub_line);
-    for (int i = 0; i < app_sd_cache_mqtt_pub_line; ++i) {
-        fgets(line, sizeof(line), file);// 跳过 N 行。
-    }
-    while (fgets(line, sizeof(line), file) != NULL) {// 逐行读取文件内容。
-        size_t len = strlen(line);// 去除行尾的换行符。
-        if (len > 0 && line[len - 1] == '\n') {
-            line[len - 1] = '\0'; // 将换行符替换为 NULL 终止符。
-        }
-        int pub_ret = app_mqtt_publish_msg(line);
-        if (pub_ret < 0) {// 只要有一次发送失败，就跳出循环，不再继续执行。
-            ESP_LOGW(TAG, "------ SD 卡推送缓存备份文件：中断。下次启动时重试。文件名：%s，推送行数：%d", APP_SD_CACHE_MQTT_TXT, app_sd_cache_mqtt_pub_line);
-            return;
-        }
-        app_sd_cache_mqtt_pub_line++;// 记录已发条数。
-    }
-    fclose(file);// 关闭文件。
-    remove(APP_SD_CACHE_MQTT_TXT);// 推送完成，删除 MQTT.TXT
-    app_sd_cache_mqtt_pub_line = 0;
-    ESP_LOGI(TAG, "------ SD 卡推送缓存备份文件：完成。文件名：%s，推送行数：%d", APP_SD_CACHE_MQTT_TXT, app_sd_cache_mqtt_pub_line);
+static int app_sd_pub_ring(const char* data, size_t len, app_pub_ack_cb_t ack_cb, void* arg, uint64_t record_id) {
+    return app_pub_send(APP_MQTT_TOPIC_MSG, data, len, APP_PUB_TIMEOUT_PARAM, ack_cb, arg, record_id);
 }
 
 /**
-* @brief 创建日志文件。
+* @brief 推送缓存备份文件。
+*        只请求封存断网期间写入的活动段并唤醒积压数据任务，封存（写文件头、截断、重命名、保存清单、预分配新段）在积压数据任务中执行，
+*        MQTT_EVENT_CONNECTED 处理中不做 SD 卡操作。SD 卡不可用时也要唤醒，推送闪存缓存。
 */
-static void app_sd_create_log_file(void) {
-    if (access(APP_SD_LOG_TXT, F_OK) != -1) {// 检查文件是否存在。
-        app_sd_copy_file(APP_SD_LOG_TXT, APP_SD_LOG_MQTT_TXT);// 先复制一份到 MQTT.TXT
-        if (access(APP_SD_LOG_FILE_TXT, F_OK) != -1) {// 检查 FILE.TXT 文件是否存在，存在则删除。
-            remove(APP_SD_LOG_FILE_TXT);
-        }
-        rename(APP_SD_LOG_TXT, APP_SD_LOG_FILE_TXT);// 再重命名为 FILE.TXT
-    }
-    app_sd_log_file = fopen(APP_SD_LOG_TXT, "a");
-    if (app_sd_log_file == NULL) {
-        ESP_LOGE(TAG, "------ SD 卡创建日志文件：失败！文件名：%s", APP_SD_LOG_TXT);
-    } else {
-        ESP_LOGI(TAG, "------ SD 卡创建日志文件：完成。文件名：%s", APP_SD_LOG_TXT);
-        esp_log_set_vprintf(app_sd_write_log_file);// 重定向输出 LOG 到文件。
+void app_sd_pub_cache_bak_file(void) {
+    atomic_store(&app_sd_cache_rotate_req, 1);
+    if (app_sd_backlog_task_handle != NULL) {
+        xTaskNotifyGive(app_sd_backlog_task_handle);
     }
 }
 
 /**
-* @brief 创建缓存文件。
+* @brief 积压数据任务，运行在第二个核心（APP CPU）上。
+*        先压缩已封存的段，再按剩余空间清理，MQTT 连接时推送闪存缓存，再上传已压缩的段（优先 HTTP，失败改用 MQTT）。
+* @param param
 */
-static void app_sd_create_cache_file(void) {
-    if (access(APP_SD_CACHE_TXT, F_OK) != -1) {// 检查文件是否存在。
-        app_sd_copy_file(APP_SD_CACHE_TXT, APP_SD_CACHE_MQTT_TXT);// 先复制一份到 MQTT.TXT
-        if (access(APP_SD_CACHE_FILE_TXT, F_OK) != -1) {// 检查 FILE.TXT 文件是否存在，存在则删除。
-            remove(APP_SD_CACHE_FILE_TXT);
+static void app_sd_backlog_task(void* param) {
+    int64_t latency_log_ms = esp_timer_get_time() / 1000;
+    while (1) {
+        if (atomic_exchange(&app_sd_cache_rotate_req, 0) != 0 &&
+            app_sd_init_status == 1 && app_sd_cache_status == 1 && app_seg_active_has_data(&app_sd_cache_store)) {
+            app_seg_rotate(&app_sd_cache_store);// 封存断网期间写入的缓存，随后压缩、推送。
+        }
+        int compressed = 0;
+        if (app_sd_cache_status == 1) {// 缓存优先。
+            compressed += app_seg_compress(&app_sd_cache_store) > 0;
+        }
+        if (app_sd_log_status == 1 && compressed == 0) {
+            compressed += app_seg_compress(&app_sd_log_store) > 0;
+        }
+        if (app_sd_init_status == 1) {
+            compressed += app_sd_retain_step();// 每次最多删除一个文件，不阻塞压缩和推送。
+        }
+        if (atomic_load(&app_mqtt_connected)) {
+            bool wifi = !app_ppp_active();// 蜂窝网络不占用 2.4G 射频，不需要蓝牙让出。
+            bool transferred = false;
+            if (wifi) {
+                app_ble_yield_begin();
+            }
+            if (app_ring_has_data()) {// 闪存缓存最早，先推送。
+                transferred |= app_ring_pub(app_sd_pub_ring) > 0;
+            }
+            bool bulk = APP_PPP_BULK || wifi;// 蜂窝网络上不推送大量积压数据。
+            if (bulk && app_sd_cache_status == 1) {
+                int64_t uploaded = app_http_upload(&app_sd_cache_store);
+                transferred |= uploaded < 0 ? app_seg_pub(&app_sd_cache_store, app_sd_pub_chunk) > 0 : uploaded > 0;// HTTP 不可用时改用 MQTT，推送偏移共用。
+            }
+            if (bulk && app_sd_log_status == 1) {
+                int64_t uploaded = app_http_upload(&app_sd_log_store);
+                transferred |= uploaded < 0 ? app_seg_pub(&app_sd_log_store, app_sd_pub_chunk) > 0 : uploaded > 0;
+            }
+            if (wifi) {
+                app_ble_yield_end(transferred);
+            }
+        }
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        if (now_ms - latency_log_ms >= APP_SD_LATENCY_LOG_MS) {
+            latency_log_ms = now_ms;
+            if (app_sd_log_status == 1) {
+                app_seg_log_latency(&app_sd_log_store);
+            }
+            if (app_sd_cache_status == 1) {
+                app_seg_log_latency(&app_sd_cache_store);
+            }
+            app_pub_log_stats();
+            app_outbox_log_stats();
+        }
+        if (compressed == 0) {// 没有需要压缩或清理的文件，等待唤醒或者 1 秒后再检查。
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
         }
-        rename(APP_SD_CACHE_TXT, APP_SD_CACHE_FILE_TXT);// 再重命名为 FILE.TXT
-    }
-    app_sd_cache_file = fopen(APP_SD_CACHE_TXT, "a");// 创建一个新文件。
-    if (app_sd_cache_file == NULL) {
-        ESP_LOGE(TAG, "------ SD 卡创建缓存文件：失败！文件名：%s", APP_SD_CACHE_TXT);
-    } else {
-        ESP_LOGI(TAG, "------ SD 卡创建缓存文件：完成。文件名：%s", APP_SD_CACHE_TXT);
     }
 }
 
@@ -429,11 +698,10 @@ static int app_sd_mkdir(const char* path) {
 }
 
 /**
- * @brief 初始化函数。
- * @param
+ * @brief 挂载 SD 卡，打开日志和缓存的分段存储。
  * @return
  */
-esp_err_t app_sd_init(void) {
+static esp_err_t app_sd_mount(void) {
 
     const char mount_point[] = APP_SD_MOUNT_POINT;
 
@@ -469,17 +737,35 @@ esp_err_t app_sd_init(void) {
         return ESP_FAIL;
     }
 
-    int log_bak_count = app_sd_count_bak_files(APP_SD_LOG_DIR);// 清理多余的日志备份文件。
-    if (log_bak_count > 100) {
-        app_sd_delete_bak_files(APP_SD_LOG_DIR);
+    if (app_seg_open(&app_sd_log_store, APP_SD_LOG_DIR, APP_SD_LOG_FAT_DIR, APP_SD_KIND_LOG) > 0) {// 封存上次的日志段，只重命名。
+        app_sd_log_status = 1;
+        app_sd_log_queue = xRingbufferCreate(APP_SD_LOG_QUEUE_SIZE, RINGBUF_TYPE_NOSPLIT);
+        if (app_sd_log_queue != NULL) {
+            esp_log_set_vprintf(app_sd_write_log_file);// 重定向输出 LOG 到文件，SD 卡写入任务启动前的日志先留在队列中。
+        }
     }
-    int cache_bak_count = app_sd_count_bak_files(APP_SD_CACHE_DIR);// 清理多余的缓存备份文件。
-    if (cache_bak_count > 100) {
-        app_sd_delete_bak_files(APP_SD_CACHE_DIR);
+    if (app_seg_open(&app_sd_cache_store, APP_SD_CACHE_DIR, APP_SD_CACHE_FAT_DIR, APP_SD_KIND_CACHE) > 0) {// 封存上次的缓存段，只重命名。
+        app_sd_cache_status = 1;
     }
-
-    app_sd_create_log_file();
-    app_sd_create_cache_file();
+    app_sd_track_queue = xQueueCreate(APP_SD_TRACK_QUEUE_LEN, sizeof(app_track_record_t));
     app_sd_init_status = 1;
     return ESP_OK;
+}
+
+/**
+ * @brief 初始化函数。
+ *        SD 卡挂载失败也启动积压数据任务，推送闪存缓存。
+ * @param
+ * @return
+ */
+esp_err_t app_sd_init(void) {
+    if (app_ring_init() != ESP_OK) {
+        ESP_LOGE(TAG, "------ 闪存缓存初始化：失败！SD 卡不可用时缓存数据将丢失。");
+    }
+    esp_err_t ret = app_sd_mount();
+    if (app_sd_init_status == 1) {
+        xTaskCreatePinnedToCore(app_sd_log_task, "app_sd_log_task", 4096, NULL, 4, NULL, 1);// 优先级高于积压数据任务，日志队列不积压。
+    }
+    xTaskCreatePinnedToCore(app_sd_backlog_task, "app_sd_backlog_task", 6144, NULL, 3, &app_sd_backlog_task_handle, 1);// 积压数据任务，运行在 APP CPU。
+    return ret;
 }
\ No newline at end of file
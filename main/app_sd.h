@@ -6,14 +6,26 @@
  */
 #pragma once
 
+#include "esp_err.h"
+#include "app_track.h"
+
  /**
-  * @brief 写入缓存文件。
+  * @brief 写入缓存文件，SD 卡不可用时写入闪存缓存。
+  * @param json 会追加换行符，缓冲区至少比字符串多 2 个字节。
+  * @return 写入字节数，失败返回 -1。
   */
-void app_sd_write_cache_file(char* json);
+int app_sd_write_cache_file(char* json);
+
+/**
+ * @brief 轨迹记录放入队列，由 SD 卡写入任务写入轨迹存储，不阻塞调用者。
+ * @param record
+ * @return 放入队列返回 1，队列已满或者 SD 卡不可用返回 -1。
+ */
+int app_sd_write_track(const app_track_record_t* record);
 
 /**
 * @brief 确保写出日志内容到 SD 卡。
-*        fsync() 执行比较消耗性能，所以由外部调用，隔一段时间执行一次。
+*        只请求 SD 卡写入任务写完队列中的日志后 fsync，不阻塞调用者；写入任务也按时间和行数定期 fsync。
 */
 void app_sd_fsync_log_file(void);
 /**
@@ -27,12 +39,12 @@ void app_sd_bak_log_file(void);
 void app_sd_bak_cache_file(void);
 
 /**
-* @brief 推送日志备份文件。
+* @brief 推送日志备份文件。唤醒积压数据任务，压缩段按块推送，不阻塞调用者。
 */
 void app_sd_pub_log_bak_file(void);
 
 /**
-* @brief 推送缓存备份文件。
+* @brief 推送缓存备份文件。唤醒积压数据任务，由任务封存活动段，不阻塞调用者。
 */
 void app_sd_pub_cache_bak_file(void);
 
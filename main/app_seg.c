@@ -0,0 +1,1023 @@
+/**
+ * @brief   SD 卡分段存储，只追加写入，按重命名轮换。
+ *
+ *          目录结构（以 LOG 目录为例）：
+ *          /sdcard/LOG/ACTIVE.SEG      当前活动段，只追加写入。
+ *          /sdcard/LOG/00000001.SEG    已封存的段，文件名是段序号。
+ *          /sdcard/LOG/00000001.LZS    已压缩的段，压缩后删除 .SEG 文件。
+ *          /sdcard/LOG/MANIFEST.DAT    段清单，记录每个段的推送和归档状态。
+ *
+ *          启动时只把 ACTIVE.SEG 重命名为序号文件，不复制任何数据，
+ *          每个字节只写入 SD 卡一次。
+ *
+ *          ACTIVE.SEG 创建时用 f_expand() 预分配连续簇，第一个扇区是文件头，记录数据长度。
+ *          追加数据先放入扇区缓冲区，满一个扇区按对齐地址整扇区写入，
+ *          不经过 FATFS 的文件缓冲区，也不更新 FAT 表和目录项，写入耗时稳定。
+ *          封存时按数据长度截断，释放未用的预分配空间。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "esp_heap_caps.h"
+
+#include "app_lz.h"
+#include "app_seg.h"
+#include "app_config.h"
+
+ /**
+ * @brief 清单魔数和版本。
+ */
+#define APP_SEG_MAGIC               0x53454731  // "SEG1"
+#define APP_SEG_VERSION             1
+
+ /**
+ * @brief 块头魔数。
+ */
+#define APP_SEG_CHUNK_MAGIC         0x314B4C42  // "BLK1"
+
+ /**
+ * @brief 段文件头魔数。
+ */
+#define APP_SEG_FILE_MAGIC          0x46474553  // "SEGF"
+
+ /**
+ * @brief 文件名，必须是 8.3 格式的大写文件名。
+ */
+#define APP_SEG_ACTIVE_NAME         "ACTIVE.SEG"
+#define APP_SEG_MANIFEST_NAME       "MANIFEST.DAT"
+#define APP_SEG_MANIFEST_TMP_NAME   "MANIFEST.TMP"
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_seg";
+
+/**
+ * @brief 旧版本的文件名，启动时重命名为封存段。
+ *        FILE.TXT 的内容已经复制到 MQTT.TXT，所以标记为已推送。
+ */
+static const struct {
+    const char* name;
+    uint8_t state;
+} app_seg_legacy_files[] = {
+    {"FILE.TXT", APP_SEG_STATE_UPLOADED},
+    {"MQTT.TXT", 0},
+    {"LOG.TXT", 0},
+    {"CACHE.TXT", 0},
+};
+
+/**
+ * @brief 生成目录下的文件路径。
+ */
+static void app_seg_file(const app_seg_store_t* store, const char* name, char* buffer, size_t size) {
+    snprintf(buffer, size, "%s/%s", store->dir, name);
+}
+
+/**
+ * @brief 生成段文件名。
+ * @param store
+ * @param seq
+ * @param buffer
+ * @param size
+ */
+void app_seg_path(const app_seg_store_t* store, uint32_t seq, char* buffer, size_t size) {
+    snprintf(buffer, size, "%s/%08lu.SEG", store->dir, (unsigned long)seq);
+}
+
+/**
+ * @brief 生成压缩段文件名。
+ * @param store
+ * @param seq
+ * @param buffer
+ * @param size
+ */
+void app_seg_zpath(const app_seg_store_t* store, uint32_t seq, char* buffer, size_t size) {
+    snprintf(buffer, size, "%s/%08lu.LZS", store->dir, (unsigned long)seq);
+}
+
+/**
+ * @brief 返回段序号对应的清单条目。
+ */
+static app_seg_entry_t* app_seg_entry(app_seg_store_t* store, uint32_t seq) {
+    return &store->manifest.entries[seq % APP_SEG_MAX_COUNT];
+}
+
+/**
+ * @brief 当前 UTC 秒数，时间未同步返回 0。
+ */
+static uint32_t app_seg_now(void) {
+    time_t now = time(NULL);
+    return now > APP_SEG_TIME_VALID_TS ? (uint32_t)now : 0;
+}
+
+/**
+ * @brief 计算清单 CRC。
+ */
+static uint32_t app_seg_manifest_crc(const app_seg_manifest_t* manifest) {
+    return esp_rom_crc32_le(0, (const uint8_t*)manifest, offsetof(app_seg_manifest_t, crc));
+}
+
+/**
+ * @brief 从文件读取清单，并校验。
+ */
+static int app_seg_read_manifest(const char* path, app_seg_manifest_t* manifest) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    size_t read_len = fread(manifest, 1, sizeof(app_seg_manifest_t), file);
+    fclose(file);
+    if (read_len != sizeof(app_seg_manifest_t) ||
+        manifest->magic != APP_SEG_MAGIC ||
+        manifest->version != APP_SEG_VERSION ||
+        manifest->crc != app_seg_manifest_crc(manifest)) {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief 保存清单。先写 MANIFEST.TMP，再重命名为 MANIFEST.DAT，断电不会损坏清单。
+ *        调用前必须持有互斥锁，函数内部不能输出日志。
+ */
+static int app_seg_save_manifest(app_seg_store_t* store) {
+    char tmp_path[64];
+    char path[64];
+    app_seg_file(store, APP_SEG_MANIFEST_TMP_NAME, tmp_path, sizeof(tmp_path));
+    app_seg_file(store, APP_SEG_MANIFEST_NAME, path, sizeof(path));
+
+    store->manifest.crc = app_seg_manifest_crc(&store->manifest);
+    FILE* file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+    size_t write_len = fwrite(&store->manifest, 1, sizeof(app_seg_manifest_t), file);
+    fflush(file);
+    fsync(fileno(file));
+    fclose(file);
+    if (write_len != sizeof(app_seg_manifest_t)) {
+        return -1;
+    }
+    remove(path);// FAT 的 rename() 不能覆盖已存在的文件。
+    return rename(tmp_path, path) == 0 ? 1 : -1;
+}
+
+/**
+ * @brief 加载清单。MANIFEST.DAT 不可用时尝试 MANIFEST.TMP，都不可用则新建。
+ */
+static void app_seg_load_manifest(app_seg_store_t* store) {
+    char path[64];
+    app_seg_file(store, APP_SEG_MANIFEST_NAME, path, sizeof(path));
+    if (app_seg_read_manifest(path, &store->manifest) > 0) {
+        return;
+    }
+    app_seg_file(store, APP_SEG_MANIFEST_TMP_NAME, path, sizeof(path));
+    if (app_seg_read_manifest(path, &store->manifest) > 0) {
+        ESP_LOGW(TAG, "------ 段清单从临时文件恢复。目录：%s", store->dir);
+        return;
+    }
+    ESP_LOGW(TAG, "------ 段清单不存在或已损坏，新建清单。目录：%s", store->dir);
+    memset(&store->manifest, 0, sizeof(app_seg_manifest_t));
+    store->manifest.magic = APP_SEG_MAGIC;
+    store->manifest.version = APP_SEG_VERSION;
+    store->manifest.head_seq = 1;
+    store->manifest.active_seq = 0;
+}
+
+/**
+ * @brief 清单环形区是否已满，已满时新段会占用最早的段的条目。
+ *        最早的段只由积压数据任务按清理策略删除（见 app_sd_retain_step），这里不删除任何段。
+ *        调用前必须持有互斥锁，函数内部不能输出日志。
+ */
+static bool app_seg_full_locked(app_seg_store_t* store) {
+    app_seg_manifest_t* manifest = &store->manifest;
+    return manifest->active_seq + 1 - manifest->head_seq >= APP_SEG_MAX_COUNT;
+}
+
+/**
+ * @brief 分配一个新的段序号，并初始化清单条目。
+ *        调用前必须持有互斥锁，函数内部不能输出日志。
+ * @return 清单已满返回 NULL。
+ */
+static app_seg_entry_t* app_seg_alloc(app_seg_store_t* store) {
+    if (app_seg_full_locked(store)) {
+        return NULL;
+    }
+    uint32_t seq = ++store->manifest.active_seq;
+    app_seg_entry_t* entry = app_seg_entry(store, seq);
+    memset(entry, 0, sizeof(app_seg_entry_t));
+    entry->seq = seq;
+    entry->create_ts = app_seg_now();
+    entry->state = APP_SEG_STATE_USED;
+    return entry;
+}
+
+/**
+ * @brief 段数据在文件中的起始偏移。
+ */
+static long app_seg_data_offset(const app_seg_entry_t* entry) {
+    return (entry->state & APP_SEG_STATE_HEADER) ? APP_SEG_FILE_HEADER_SIZE : 0;
+}
+
+/**
+ * @brief 计算段文件头 CRC。
+ */
+static uint32_t app_seg_file_header_crc(const app_seg_file_header_t* header) {
+    return esp_rom_crc32_le(0, (const uint8_t*)header, offsetof(app_seg_file_header_t, crc));
+}
+
+/**
+ * @brief 读取段文件的数据长度。
+ * @return 有文件头返回 1，旧版本的纯文本文件返回 0，文件不存在返回 -1。
+ */
+static int app_seg_read_length(const char* path, uint32_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    app_seg_file_header_t header;
+    size_t read_len = fread(&header, 1, sizeof(header), file);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    if (read_len != sizeof(header) || header.magic != APP_SEG_FILE_MAGIC) {
+        *length = size > 0 ? (uint32_t)size : 0;
+        return 0;
+    }
+    long max_length = size - APP_SEG_FILE_HEADER_SIZE;
+    if (header.crc != app_seg_file_header_crc(&header) || max_length <= 0) {// 文件头损坏，数据长度未知。
+        *length = 0;
+    } else {
+        *length = header.length < max_length ? header.length : (uint32_t)max_length;
+    }
+    return 1;
+}
+
+/**
+ * @brief 按对齐地址写入一个整扇区。
+ *        整扇区写入直接写卡，不经过 FATFS 文件缓冲区；文件大小不变，不需要 f_sync() 更新目录项。
+ *        调用前必须持有互斥锁，函数内部不能输出日志。
+ */
+static int app_seg_write_sector(app_seg_store_t* store, uint32_t offset, const uint8_t* sector) {
+    UINT write_len;
+    if (f_lseek(&store->fil, offset) != FR_OK ||
+        f_write(&store->fil, sector, APP_SEG_SECTOR_SIZE, &write_len) != FR_OK ||
+        write_len != APP_SEG_SECTOR_SIZE) {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief 写入活动段末尾未写满的扇区和文件头。
+ *        调用前必须持有互斥锁，函数内部不能输出日志。
+ */
+static int app_seg_write_tail(app_seg_store_t* store) {
+    uint8_t* tail = store->sector_buf + APP_SEG_SECTOR_SIZE;
+    uint32_t fill = store->active_size % APP_SEG_SECTOR_SIZE;
+    if (fill > 0 && app_seg_write_sector(store, APP_SEG_FILE_HEADER_SIZE + store->active_size - fill, tail) < 0) {
+        return -1;
+    }
+    app_seg_file_header_t* header = (app_seg_file_header_t*)store->sector_buf;
+    header->magic = APP_SEG_FILE_MAGIC;
+    header->seq = store->manifest.active_seq;
+    header->length = store->active_size;
+    header->create_ts = app_seg_entry(store, header->seq)->create_ts;
+    header->crc = app_seg_file_header_crc(header);
+    return app_seg_write_sector(store, 0, store->sector_buf);
+}
+
+/**
+ * @brief 封存活动段：写入文件头，截断预分配空间，关闭文件，ACTIVE.SEG 重命名为序号文件。
+ *        调用前必须持有互斥锁，函数内部不能输出日志。
+ */
+static void app_seg_seal_active(app_seg_store_t* store) {
+    if (store->fil_open) {
+        app_seg_write_tail(store);
+        if (f_lseek(&store->fil, APP_SEG_FILE_HEADER_SIZE + store->active_size) == FR_OK) {
+            f_truncate(&store->fil);
+        }
+        f_close(&store->fil);
+        store->fil_open = false;
+    }
+    uint32_t seq = store->manifest.active_seq;
+    if (seq == 0) {
+        return;
+    }
+    app_seg_entry_t* entry = app_seg_entry(store, seq);
+    if (entry->seq != seq || (entry->state & APP_SEG_STATE_SEALED)) {
+        return;
+    }
+
+    char active_path[64];
+    char seg_path[64];
+    app_seg_file(store, APP_SEG_ACTIVE_NAME, active_path, sizeof(active_path));
+    app_seg_path(store, seq, seg_path, sizeof(seg_path));
+
+    uint32_t length = 0;
+    int has_header = app_seg_read_length(active_path, &length);
+    if (has_header >= 0) {
+        if (length == 0) {// 空段直接删除。
+            remove(active_path);
+            memset(entry, 0, sizeof(app_seg_entry_t));
+            return;
+        }
+        if (has_header == 1) {
+            truncate(active_path, APP_SEG_FILE_HEADER_SIZE + length);// 断电时未截断的预分配空间。
+        }
+        remove(seg_path);
+        rename(active_path, seg_path);
+    } else if ((has_header = app_seg_read_length(seg_path, &length)) < 0) {// 序号文件存在，说明上次重命名之后、保存清单之前断电；都不存在则此段无数据。
+        memset(entry, 0, sizeof(app_seg_entry_t));
+        return;
+    }
+    entry->size = length;
+    entry->state |= APP_SEG_STATE_SEALED | (has_header == 1 ? APP_SEG_STATE_HEADER : 0);
+}
+
+/**
+ * @brief 创建新的活动段，预分配连续簇，写入空的文件头。
+ *        调用前必须持有互斥锁，函数内部不能输出日志。
+ */
+static int app_seg_open_active(app_seg_store_t* store) {
+    if (app_seg_alloc(store) == NULL) {
+        store->rotate_pending = true;
+        return 0;
+    }
+    store->rotate_pending = false;
+    app_seg_save_manifest(store);
+
+    store->active_size = 0;
+    store->write_count = 0;
+    if (store->sector_buf == NULL) {
+        return -1;
+    }
+    memset(store->sector_buf, 0, APP_SEG_SECTOR_SIZE * 2);
+
+    char active_path[64];
+    snprintf(active_path, sizeof(active_path), "%s/%s", store->fat_dir, APP_SEG_ACTIVE_NAME);
+    if (f_open(&store->fil, active_path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+        return -1;
+    }
+#if FF_USE_EXPAND
+    if (f_expand(&store->fil, APP_SEG_PREALLOC_SIZE, 1) != FR_OK) {// 没有足够的连续空间，改为普通预分配。
+        f_lseek(&store->fil, APP_SEG_PREALLOC_SIZE);
+    }
+#else
+    f_lseek(&store->fil, APP_SEG_PREALLOC_SIZE);// 向后 seek 扩展文件，一次分配全部簇。
+#endif
+    if (app_seg_write_tail(store) < 0 || f_sync(&store->fil) != FR_OK) {// 只在创建时更新一次 FAT 表和目录项。
+        f_close(&store->fil);
+        return -1;
+    }
+    store->fil_open = true;
+    return 1;
+}
+
+/**
+ * @brief 重新打开上次的活动段继续追加，只在启动时清单已满、不能封存轮换时调用。
+ *        数据长度以文件头为准，读回末尾未写满的扇区。
+ *        调用前必须持有互斥锁，函数内部不能输出日志。
+ * @return 成功返回 1，没有可用的活动段返回 -1。
+ */
+static int app_seg_resume_active(app_seg_store_t* store) {
+    uint32_t seq = store->manifest.active_seq;
+    app_seg_entry_t* entry = app_seg_entry(store, seq);
+    if (store->sector_buf == NULL || seq == 0 || entry->seq != seq || (entry->state & APP_SEG_STATE_SEALED)) {
+        return -1;
+    }
+    memset(store->sector_buf, 0, APP_SEG_SECTOR_SIZE * 2);
+
+    char active_path[64];
+    snprintf(active_path, sizeof(active_path), "%s/%s", store->fat_dir, APP_SEG_ACTIVE_NAME);
+    if (f_open(&store->fil, active_path, FA_OPEN_EXISTING | FA_READ | FA_WRITE) != FR_OK) {
+        return -1;
+    }
+    app_seg_file_header_t* header = (app_seg_file_header_t*)store->sector_buf;
+    UINT read_len;
+    if (f_read(&store->fil, store->sector_buf, APP_SEG_SECTOR_SIZE, &read_len) != FR_OK || read_len != APP_SEG_SECTOR_SIZE ||
+        header->magic != APP_SEG_FILE_MAGIC || header->crc != app_seg_file_header_crc(header) || header->seq != seq ||
+        f_size(&store->fil) < APP_SEG_FILE_HEADER_SIZE + header->length) {
+        f_close(&store->fil);
+        return -1;
+    }
+    uint32_t fill = header->length % APP_SEG_SECTOR_SIZE;
+    if (fill > 0 && (f_lseek(&store->fil, APP_SEG_FILE_HEADER_SIZE + header->length - fill) != FR_OK ||
+        f_read(&store->fil, store->sector_buf + APP_SEG_SECTOR_SIZE, fill, &read_len) != FR_OK || read_len != fill)) {
+        f_close(&store->fil);
+        return -1;
+    }
+    store->active_size = header->length;
+    store->write_count = 0;
+    store->fil_open = true;
+    return 1;
+}
+
+/**
+ * @brief 旧版本的 LOG.TXT、CACHE.TXT、MQTT.TXT、FILE.TXT 重命名为封存段，只执行一次。
+ *        调用前必须持有互斥锁。
+ */
+static void app_seg_migrate_legacy(app_seg_store_t* store) {
+    for (int i = 0; i < sizeof(app_seg_legacy_files) / sizeof(app_seg_legacy_files[0]); i++) {
+        char legacy_path[64];
+        app_seg_file(store, app_seg_legacy_files[i].name, legacy_path, sizeof(legacy_path));
+        struct stat st;
+        if (stat(legacy_path, &st) != 0) {
+            continue;
+        }
+        if (st.st_size == 0) {
+            remove(legacy_path);
+            continue;
+        }
+        app_seg_entry_t* entry = app_seg_alloc(store);
+        if (entry == NULL) {// 清单已满，下次启动再转换。
+            break;
+        }
+        char seg_path[64];
+        app_seg_path(store, entry->seq, seg_path, sizeof(seg_path));
+        remove(seg_path);
+        if (rename(legacy_path, seg_path) != 0) {
+            memset(entry, 0, sizeof(app_seg_entry_t));
+            continue;
+        }
+        entry->size = (uint32_t)st.st_size;
+        entry->state |= APP_SEG_STATE_SEALED | app_seg_legacy_files[i].state;
+        if (entry->state & APP_SEG_STATE_UPLOADED) {
+            entry->pub_offset = entry->size;
+        }
+        ESP_LOGI(TAG, "------ 旧文件转换为段：%s --> %s", legacy_path, seg_path);
+    }
+}
+
+/**
+ * @brief 打开分段存储。封存上次的活动段（只重命名，不复制），并创建新的活动段。
+ *        启动耗时与积压数据大小无关。
+ * @param store
+ * @param dir
+ * @param fat_dir
+ * @param kind
+ * @return
+ */
+int app_seg_open(app_seg_store_t* store, const char* dir, const char* fat_dir, uint8_t kind) {
+    store->dir = dir;
+    store->fat_dir = fat_dir;
+    store->kind = kind;
+    store->fil_open = false;
+    store->active_size = 0;
+    store->write_count = 0;
+    memset(store->latency_hist, 0, sizeof(store->latency_hist));
+    store->latency_max_us = 0;
+    store->rotate_pending = false;
+    store->sector_buf = heap_caps_malloc(APP_SEG_SECTOR_SIZE * 2, MALLOC_CAP_DMA);// SDMMC 直接 DMA，不需要驱动再复制一次。
+    pthread_mutex_init(&store->mutex, NULL);
+
+    pthread_mutex_lock(&store->mutex);
+    app_seg_load_manifest(store);
+    int ret;
+    bool resumed = app_seg_full_locked(store) && app_seg_resume_active(store) > 0;
+    if (resumed) {// 清单已满，继续写上次的活动段，等最早的段推送、清理后再轮换。
+        store->rotate_pending = true;
+        ret = 1;
+    } else {
+        app_seg_seal_active(store);// 上次运行的活动段。
+        app_seg_migrate_legacy(store);
+        ret = app_seg_open_active(store);
+    }
+    uint32_t head_seq = store->manifest.head_seq;
+    uint32_t active_seq = store->manifest.active_seq;
+    pthread_mutex_unlock(&store->mutex);
+
+    if (ret < 0) {
+        ESP_LOGE(TAG, "------ 段存储打开活动段：失败！目录：%s", dir);
+        return -1;
+    }
+    if (resumed || ret == 0) {
+        ESP_LOGW(TAG, "------ 段清单已满：%s活动段，等待最早的段推送后清理。目录：%s，最早段：%lu，活动段：%lu",
+            resumed ? "继续写上次的" : "暂不创建", dir, head_seq, active_seq);
+        return 1;
+    }
+    ESP_LOGI(TAG, "------ 段存储打开：完成。目录：%s，最早段：%lu，活动段：%lu", dir, head_seq, active_seq);
+    return 1;
+}
+
+/**
+ * @brief 记录一次追加写入的耗时。
+ *        调用前必须持有互斥锁。
+ */
+static void app_seg_add_latency(app_seg_store_t* store, int64_t cost_us) {
+    int i = 0;
+    int64_t bound = 64;
+    while (i < APP_SEG_LATENCY_BUCKETS - 1 && cost_us >= bound) {
+        i++;
+        bound *= 4;
+    }
+    store->latency_hist[i]++;
+    if (cost_us > store->latency_max_us) {
+        store->latency_max_us = (uint32_t)cost_us;
+    }
+}
+
+/**
+ * @brief 追加数据到活动段。超过 APP_SEG_MAX_SIZE 不在这里轮换（封存、保存清单、预分配新段耗时不定），
+ *        继续追加到活动段，由 app_seg_rotate_pending() 报告，调用者在自己的任务中调用 app_seg_rotate()。
+ *        此函数会在日志输出中被调用，函数内部不能输出日志。
+ * @param store
+ * @param data
+ * @param len
+ * @return 写入字节数，失败返回 -1。
+ */
+int app_seg_append(app_seg_store_t* store, const char* data, size_t len) {
+    int64_t start_us = esp_timer_get_time();
+    pthread_mutex_lock(&store->mutex);
+    if (store->fil_open && store->active_size > 0 && store->active_size + len > APP_SEG_MAX_SIZE) {// 只标记，由 SD 卡写入任务轮换，超出预分配的部分按普通写入扩展文件。
+        store->rotate_pending = true;
+    }
+    if (!store->fil_open) {
+        pthread_mutex_unlock(&store->mutex);
+        return -1;
+    }
+    uint8_t* tail = store->sector_buf + APP_SEG_SECTOR_SIZE;
+    size_t write_len = 0;
+    while (write_len < len) {
+        uint32_t fill = store->active_size % APP_SEG_SECTOR_SIZE;
+        size_t copy_len = len - write_len < APP_SEG_SECTOR_SIZE - fill ? len - write_len : APP_SEG_SECTOR_SIZE - fill;
+        memcpy(tail + fill, data + write_len, copy_len);
+        if (fill + copy_len == APP_SEG_SECTOR_SIZE) {// 满一个扇区，写卡。
+            if (app_seg_write_sector(store, APP_SEG_FILE_HEADER_SIZE + store->active_size - fill, tail) < 0) {
+                pthread_mutex_unlock(&store->mutex);
+                return -1;
+            }
+            memset(tail, 0, APP_SEG_SECTOR_SIZE);
+        }
+        store->active_size += copy_len;
+        write_len += copy_len;
+    }
+    store->write_count++;
+    app_seg_add_latency(store, esp_timer_get_time() - start_us);
+    pthread_mutex_unlock(&store->mutex);
+    return (int)write_len;
+}
+
+/**
+ * @brief 确保活动段写入 SD 卡：写入末尾未写满的扇区，更新文件头中的数据长度。
+ * @param store
+ */
+void app_seg_fsync(app_seg_store_t* store) {
+    pthread_mutex_lock(&store->mutex);
+    if (store->fil_open && store->write_count > 0) {
+        app_seg_write_tail(store);
+        if (store->active_size > APP_SEG_MAX_SIZE) {// 超出预分配空间，扩展的簇链和文件大小需要写入 FAT 表和目录项。
+            f_sync(&store->fil);
+        }
+        store->write_count = 0;
+    }
+    pthread_mutex_unlock(&store->mutex);
+}
+
+/**
+ * @brief 封存活动段并开启新段。
+ * @param store
+ * @return 清单已满时不轮换，返回 0。
+ */
+int app_seg_rotate(app_seg_store_t* store) {
+    pthread_mutex_lock(&store->mutex);
+    if (app_seg_full_locked(store)) {
+        store->rotate_pending = true;
+        pthread_mutex_unlock(&store->mutex);
+        return 0;
+    }
+    app_seg_seal_active(store);
+    int ret = app_seg_open_active(store);
+    pthread_mutex_unlock(&store->mutex);
+    return ret;
+}
+
+/**
+ * @brief 清单是否已满，并复制最早的段的条目。
+ * @param store
+ * @param head 可以为 NULL。
+ * @return
+ */
+bool app_seg_full(app_seg_store_t* store, app_seg_entry_t* head) {
+    pthread_mutex_lock(&store->mutex);
+    bool full = app_seg_full_locked(store);
+    if (full && head != NULL) {
+        *head = *app_seg_entry(store, store->manifest.head_seq);
+    }
+    pthread_mutex_unlock(&store->mutex);
+    return full;
+}
+
+/**
+ * @brief 是否需要轮换：活动段超过 APP_SEG_MAX_SIZE，或者清单已满时推迟的轮换。
+ * @param store
+ * @return
+ */
+bool app_seg_rotate_pending(app_seg_store_t* store) {
+    pthread_mutex_lock(&store->mutex);
+    bool pending = store->rotate_pending;
+    pthread_mutex_unlock(&store->mutex);
+    return pending;
+}
+
+/**
+ * @brief 按时间归档：给时间同步之前创建的段补记 UTC 时间，并标记为已归档。
+ * @param store
+ */
+void app_seg_archive(app_seg_store_t* store) {
+    uint32_t now = app_seg_now();
+    if (now == 0) {
+        ESP_LOGW(TAG, "------ 段归档：跳过，系统时间未同步。目录：%s", store->dir);
+        return;
+    }
+    int count = 0;
+    pthread_mutex_lock(&store->mutex);
+    app_seg_manifest_t* manifest = &store->manifest;
+    for (uint32_t seq = manifest->head_seq; seq <= manifest->active_seq; seq++) {
+        app_seg_entry_t* entry = app_seg_entry(store, seq);
+        if (entry->seq != seq || !(entry->state & APP_SEG_STATE_USED)) {
+            continue;
+        }
+        if (entry->create_ts == 0) {
+            entry->create_ts = now;
+        }
+        if ((entry->state & APP_SEG_STATE_SEALED) && !(entry->state & APP_SEG_STATE_ARCHIVED)) {
+            entry->archive_ts = now;
+            entry->state |= APP_SEG_STATE_ARCHIVED;
+            count++;
+        }
+    }
+    app_seg_save_manifest(store);
+    pthread_mutex_unlock(&store->mutex);
+    ESP_LOGI(TAG, "------ 段归档：完成。目录：%s，归档段数：%d", store->dir, count);
+}
+
+/**
+ * @brief 输出追加写入的耗时分布，输出后清零。
+ * @param store
+ */
+void app_seg_log_latency(app_seg_store_t* store) {
+    uint32_t hist[APP_SEG_LATENCY_BUCKETS];
+    pthread_mutex_lock(&store->mutex);
+    memcpy(hist, store->latency_hist, sizeof(hist));
+    uint32_t max_us = store->latency_max_us;
+    memset(store->latency_hist, 0, sizeof(store->latency_hist));
+    store->latency_max_us = 0;
+    pthread_mutex_unlock(&store->mutex);
+    ESP_LOGI(TAG, "------ 段写入耗时分布。目录：%s，<64us：%lu，<256us：%lu，<1ms：%lu，<4ms：%lu，<16ms：%lu，<64ms：%lu，<256ms：%lu，>=256ms：%lu，最大：%lu us",
+        store->dir, hist[0], hist[1], hist[2], hist[3], hist[4], hist[5], hist[6], hist[7], max_us);
+}
+
+/**
+ * @brief 活动段是否有数据。
+ * @param store
+ * @return
+ */
+bool app_seg_active_has_data(app_seg_store_t* store) {
+    pthread_mutex_lock(&store->mutex);
+    bool has_data = store->fil_open && store->active_size > 0;
+    pthread_mutex_unlock(&store->mutex);
+    return has_data;
+}
+
+/**
+ * @brief 查找最早的符合条件的已封存段，复制条目。
+ * @param store
+ * @param want 必须具有的状态位。
+ * @param skip 必须没有的状态位。
+ * @param out
+ * @return 找到返回 1，否则返回 0。
+ */
+int app_seg_find(app_seg_store_t* store, uint8_t want, uint8_t skip, app_seg_entry_t* out) {
+    int found = 0;
+    pthread_mutex_lock(&store->mutex);
+    app_seg_manifest_t* manifest = &store->manifest;
+    for (uint32_t seq = manifest->head_seq; seq < manifest->active_seq; seq++) {
+        app_seg_entry_t* entry = app_seg_entry(store, seq);
+        if (entry->seq == seq && (entry->state & want) == want && (entry->state & skip) == 0) {
+            *out = *entry;
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&store->mutex);
+    return found;
+}
+
+/**
+ * @brief 删除一个已封存的段，返回释放的字节数。
+ * @param store
+ * @param seq
+ * @return 释放的字节数，段不存在返回 -1。
+ */
+int app_seg_delete(app_seg_store_t* store, uint32_t seq) {
+    pthread_mutex_lock(&store->mutex);
+    app_seg_entry_t* entry = app_seg_entry(store, seq);
+    if (entry->seq != seq || !(entry->state & APP_SEG_STATE_SEALED)) {
+        pthread_mutex_unlock(&store->mutex);
+        return -1;
+    }
+    int freed = (entry->state & APP_SEG_STATE_COMPRESSED) ? entry->zsize : entry->size;
+    char path[64];
+    app_seg_path(store, seq, path, sizeof(path));
+    remove(path);
+    app_seg_zpath(store, seq, path, sizeof(path));
+    remove(path);
+    memset(entry, 0, sizeof(app_seg_entry_t));
+    app_seg_manifest_t* manifest = &store->manifest;
+    while (manifest->head_seq < manifest->active_seq && app_seg_entry(store, manifest->head_seq)->seq != manifest->head_seq) {
+        manifest->head_seq++;// 跳过已删除的段。
+    }
+    app_seg_save_manifest(store);
+    pthread_mutex_unlock(&store->mutex);
+    return freed;
+}
+
+/**
+ * @brief 更新段的压缩大小、推送偏移和状态位，并保存清单。
+ *        状态位只增加不清除，不会覆盖其它任务（例如归档）同时做的修改。
+ */
+static void app_seg_update(app_seg_store_t* store, const app_seg_entry_t* update) {
+    pthread_mutex_lock(&store->mutex);
+    app_seg_entry_t* entry = app_seg_entry(store, update->seq);
+    if (entry->seq == update->seq) {// 处理期间此段可能已被删除。
+        entry->zsize = update->zsize;
+        entry->pub_offset = update->pub_offset;
+        entry->state |= update->state;
+        app_seg_save_manifest(store);
+    }
+    pthread_mutex_unlock(&store->mutex);
+}
+
+/**
+ * @brief 压缩一个已封存、未压缩的段，压缩完成后删除原文件。
+ *        耗时较长，在后台任务中调用。
+ * @param store
+ * @return 压缩的段数，0 = 没有需要压缩的段，-1 = 失败。
+ */
+int app_seg_compress(app_seg_store_t* store) {
+    app_seg_entry_t entry;
+    if (!app_seg_find(store, APP_SEG_STATE_SEALED, APP_SEG_STATE_COMPRESSED | APP_SEG_STATE_RAW, &entry)) {
+        return 0;
+    }
+    char path[64];
+    char zpath[64];
+    app_seg_path(store, entry.seq, path, sizeof(path));
+    app_seg_zpath(store, entry.seq, zpath, sizeof(zpath));
+
+    if (entry.pub_offset > 0) {// 已经按原始数据推送了一部分，不再压缩。
+        entry.state |= APP_SEG_STATE_RAW;
+        app_seg_update(store, &entry);
+        return 1;
+    }
+
+    app_lz_t* lz = malloc(sizeof(app_lz_t));
+    if (lz == NULL) {
+        ESP_LOGE(TAG, "------ 段压缩：申请内存失败！字节数：%d", sizeof(app_lz_t));
+        return -1;
+    }
+    FILE* in = fopen(path, "rb");
+    FILE* out = fopen(zpath, "wb");
+    int64_t start_us = esp_timer_get_time();
+    int zsize = -1;
+    if (in != NULL && out != NULL && fseek(in, app_seg_data_offset(&entry), SEEK_SET) == 0) {// 跳过文件头扇区，封存时已截断，读到文件结尾就是全部数据。
+        zsize = app_lz_compress_file(lz, in, out);
+        if (fflush(out) != 0 || fsync(fileno(out)) != 0) {// 压缩文件没有完整写入，不能删除原文件。
+            zsize = -1;
+        }
+    }
+    int64_t cost_us = esp_timer_get_time() - start_us;
+    if (in != NULL) {
+        fclose(in);
+    }
+    if (out != NULL) {
+        fclose(out);
+    }
+    free(lz);
+
+    if (zsize < 0) {// 压缩失败，按原始数据推送。
+        remove(zpath);
+        entry.state |= APP_SEG_STATE_RAW;
+        app_seg_update(store, &entry);
+        ESP_LOGE(TAG, "------ 段压缩：失败！按原始数据推送。文件名：%s", path);
+        return -1;
+    }
+    entry.zsize = (uint32_t)zsize;
+    entry.state |= APP_SEG_STATE_COMPRESSED;
+    app_seg_update(store, &entry);
+    remove(path);// 清单保存之后再删除原文件。
+    ESP_LOGI(TAG, "------ 段压缩：完成。文件名：%s，原始字节：%lu，压缩字节：%d，压缩率：%.2f，耗时：%lld ms",
+        zpath, entry.size, zsize, entry.size > 0 ? (double)zsize / entry.size : 0.0, cost_us / 1000);
+    return 1;
+}
+
+/**
+ * @brief 块确认回调，记录最早的失败块。
+ */
+static void app_seg_pub_ack(void* arg, uint64_t record_id, bool acked) {
+    if (acked) {
+        return;
+    }
+    app_seg_store_t* store = arg;
+    uint32_t seq = (uint32_t)(record_id >> 32);
+    uint32_t offset = (uint32_t)record_id;
+    pthread_mutex_lock(&store->mutex);
+    if (seq == store->pub_seq && offset < store->pub_fail_offset) {
+        store->pub_fail_offset = offset;
+    }
+    pthread_mutex_unlock(&store->mutex);
+}
+
+/**
+ * @brief 按块推送所有已压缩、未推送的段，每块一条 MQTT 消息，支持断点续传。
+ *        每段的块连续发送，全部确认后才提交推送偏移；未确认的块从最早的一块重发。
+ *        未压缩的段等待压缩完成后再推送。
+ * @param store
+ * @param pub_cb
+ * @return 推送块数，中断返回 -1。
+ */
+int app_seg_pub(app_seg_store_t* store, app_seg_pub_cb_t pub_cb) {
+    int total_chunks = 0;
+    uint32_t total_bytes = 0;
+    uint32_t total_raw = 0;
+    int64_t start_us = esp_timer_get_time();
+    char* buffer = NULL;
+    app_seg_entry_t entry;
+    while (app_seg_find(store, APP_SEG_STATE_SEALED, APP_SEG_STATE_UPLOADED, &entry)) {
+        bool raw = (entry.state & APP_SEG_STATE_RAW) != 0;
+        if (!raw && !(entry.state & APP_SEG_STATE_COMPRESSED)) {
+            break;// 等待压缩。
+        }
+        if (buffer == NULL) {
+            buffer = malloc(sizeof(app_seg_chunk_header_t) + APP_SEG_CHUNK_SIZE);
+            if (buffer == NULL) {
+                ESP_LOGE(TAG, "------ 段推送：申请内存失败！");
+                return -1;
+            }
+        }
+        char path[64];
+        if (raw) {
+            app_seg_path(store, entry.seq, path, sizeof(path));
+        } else {
+            app_seg_zpath(store, entry.seq, path, sizeof(path));
+        }
+        uint32_t total = raw ? entry.size : entry.zsize;
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) {
+            ESP_LOGE(TAG, "------ 段推送：打开文件失败，跳过此段。文件名：%s", path);
+            entry.state |= APP_SEG_STATE_UPLOADED;
+            app_seg_update(store, &entry);
+            continue;
+        }
+        long seek_offset = (raw ? app_seg_data_offset(&entry) : 0) + entry.pub_offset;
+        if (seek_offset > 0) {
+            fseek(file, seek_offset, SEEK_SET);
+        }
+        ESP_LOGI(TAG, "------ 段推送：开始。文件名：%s，起始偏移：%lu，总字节：%lu", path, entry.pub_offset, total);
+
+        pthread_mutex_lock(&store->mutex);
+        store->pub_seq = entry.seq;
+        store->pub_fail_offset = UINT32_MAX;
+        pthread_mutex_unlock(&store->mutex);
+
+        app_seg_chunk_header_t* header = (app_seg_chunk_header_t*)buffer;
+        char* data = buffer + sizeof(app_seg_chunk_header_t);
+        uint32_t offset = entry.pub_offset;
+        bool interrupted = false;
+        size_t read_len;
+        while (offset < total && (read_len = fread(data, 1, APP_SEG_CHUNK_SIZE, file)) > 0) {
+            header->magic = APP_SEG_CHUNK_MAGIC;
+            header->kind = store->kind;
+            header->flags = (raw ? APP_SEG_CHUNK_RAW : 0) | (offset + read_len >= total ? APP_SEG_CHUNK_LAST : 0);
+            header->header_len = sizeof(app_seg_chunk_header_t);
+            header->seq = entry.seq;
+            header->offset = offset;
+            header->total = total;
+            header->raw_size = entry.size;
+            if (pub_cb(buffer, sizeof(app_seg_chunk_header_t) + read_len, app_seg_pub_ack, store, ((uint64_t)entry.seq << 32) | offset) < 0) {// 只要有一次发送失败，就中断。
+                interrupted = true;
+                break;
+            }
+            offset += read_len;
+            total_bytes += read_len;
+            total_chunks++;
+        }
+        fclose(file);
+
+        app_pub_flush(app_seg_pub_ack, store, APP_PUB_FLUSH_TIMEOUT_MS);// 等待本段全部确认，只提交连续确认的部分。
+        pthread_mutex_lock(&store->mutex);
+        uint32_t fail_offset = store->pub_fail_offset;
+        pthread_mutex_unlock(&store->mutex);
+        entry.pub_offset = fail_offset < offset ? fail_offset : offset;
+        if (!interrupted && fail_offset == UINT32_MAX) {// 全部确认，包括文件比清单记录短的情况。
+            entry.state |= APP_SEG_STATE_UPLOADED;
+        }
+        app_seg_update(store, &entry);
+        if (!(entry.state & APP_SEG_STATE_UPLOADED)) {
+            free(buffer);
+            ESP_LOGW(TAG, "------ 段推送：中断。文件名：%s，已确认偏移：%lu", path, entry.pub_offset);
+            return -1;
+        }
+        total_raw += entry.size;
+        ESP_LOGI(TAG, "------ 段推送：完成。文件名：%s", path);
+    }
+    free(buffer);
+    if (total_chunks > 0) {
+        ESP_LOGI(TAG, "------ 段推送统计。目录：%s，块数：%d，推送字节：%lu，原始字节：%lu，耗时：%lld ms",
+            store->dir, total_chunks, total_bytes, total_raw, (esp_timer_get_time() - start_us) / 1000);
+    }
+    return total_chunks;
+}
+
+/**
+ * @brief 按分片同步上传所有已压缩、未上传的段，每个分片确认后提交偏移，支持断点续传。
+ *        与 app_seg_pub() 共用推送偏移，可以交替使用。
+ * @param store
+ * @param part_size 每个分片的最大字节数。
+ * @param upload_cb
+ * @return 上传字节数，中断返回 -1。
+ */
+int64_t app_seg_upload(app_seg_store_t* store, uint32_t part_size, app_seg_upload_cb_t upload_cb) {
+    int64_t total_bytes = 0;
+    uint32_t total_raw = 0;
+    int64_t start_us = esp_timer_get_time();
+    app_seg_entry_t entry;
+    while (app_seg_find(store, APP_SEG_STATE_SEALED, APP_SEG_STATE_UPLOADED, &entry)) {
+        bool raw = (entry.state & APP_SEG_STATE_RAW) != 0;
+        if (!raw && !(entry.state & APP_SEG_STATE_COMPRESSED)) {
+            break;// 等待压缩。
+        }
+        char path[64];
+        if (raw) {
+            app_seg_path(store, entry.seq, path, sizeof(path));
+        } else {
+            app_seg_zpath(store, entry.seq, path, sizeof(path));
+        }
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) {
+            ESP_LOGE(TAG, "------ 段上传：打开文件失败，跳过此段。文件名：%s", path);
+            entry.state |= APP_SEG_STATE_UPLOADED;
+            app_seg_update(store, &entry);
+            continue;
+        }
+        long data_offset = raw ? app_seg_data_offset(&entry) : 0;
+        uint32_t total = raw ? entry.size : entry.zsize;
+        if (fseek(file, 0, SEEK_END) == 0 && ftell(file) - data_offset < (long)total) {// 文件比清单记录短，只上传实际的数据，避免每次都失败。
+            total = ftell(file) > data_offset ? ftell(file) - data_offset : 0;
+        }
+        ESP_LOGI(TAG, "------ 段上传：开始。文件名：%s，起始偏移：%lu，总字节：%lu", path, entry.pub_offset, total);
+
+        int64_t next = entry.pub_offset;
+        bool rewound = false;
+        while (entry.pub_offset < total) {
+            uint32_t len = total - entry.pub_offset < part_size ? total - entry.pub_offset : part_size;
+            app_seg_chunk_header_t header = {
+                .magic = APP_SEG_CHUNK_MAGIC,
+                .kind = store->kind,
+                .flags = (raw ? APP_SEG_CHUNK_RAW : 0) | (entry.pub_offset + len >= total ? APP_SEG_CHUNK_LAST : 0),
+                .header_len = sizeof(app_seg_chunk_header_t),
+                .seq = entry.seq,
+                .offset = entry.pub_offset,
+                .total = total,
+                .raw_size = entry.size,
+            };
+            next = fseek(file, data_offset + entry.pub_offset, SEEK_SET) == 0 ? upload_cb(&header, file, len) : -1;
+            if (next <= entry.pub_offset) {// 服务器要求回退，每段只允许一次，避免死循环。
+                if (next < 0 || rewound) {
+                    next = -1;
+                    break;
+                }
+                rewound = true;
+            } else {
+                total_bytes += next - entry.pub_offset;
+            }
+            entry.pub_offset = next < total ? next : total;// 服务器可以要求从其它偏移继续。
+            app_seg_update(store, &entry);
+        }
+        fclose(file);
+        if (next < 0) {
+            ESP_LOGW(TAG, "------ 段上传：中断。文件名：%s，已确认偏移：%lu", path, entry.pub_offset);
+            return -1;
+        }
+        entry.state |= APP_SEG_STATE_UPLOADED;
+        app_seg_update(store, &entry);
+        total_raw += entry.size;
+        ESP_LOGI(TAG, "------ 段上传：完成。文件名：%s", path);
+    }
+    if (total_bytes > 0) {
+        ESP_LOGI(TAG, "------ 段上传统计。目录：%s，上传字节：%lld，原始字节：%lu，耗时：%lld ms",
+            store->dir, total_bytes, total_raw, (esp_timer_get_time() - start_us) / 1000);
+    }
+    return total_bytes;
+}
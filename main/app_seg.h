@@ -0,0 +1,289 @@
+/**
+ * @brief   SD 卡分段存储，只追加写入，按重命名轮换。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "ff.h"
+
+#include "app_pub.h"
+
+ /**
+  * @brief 清单中最多记录的段数，按 seq % APP_SEG_MAX_COUNT 环形存放。
+  */
+#define APP_SEG_MAX_COUNT           128
+
+ /**
+  * @brief 单个段的最大字节数，超过后封存并开启新段。
+  */
+#define APP_SEG_MAX_SIZE            (512 * 1024)
+
+ /**
+  * @brief 扇区大小，与 FATFS 扇区大小一致。
+  *        段文件第一个扇区是文件头，数据从第二个扇区开始，按整扇区写入。
+  */
+#define APP_SEG_SECTOR_SIZE         4096
+#define APP_SEG_FILE_HEADER_SIZE    APP_SEG_SECTOR_SIZE
+
+ /**
+  * @brief 活动段创建时预分配的字节数，连续簇，写入时不再扩展簇链、更新 FAT 表。
+  */
+#define APP_SEG_PREALLOC_SIZE       (APP_SEG_FILE_HEADER_SIZE + APP_SEG_MAX_SIZE)
+
+ /**
+  * @brief 写入耗时分布的区间数，第 i 个区间的上限是 64us * 4^i，最后一个区间不设上限。
+  */
+#define APP_SEG_LATENCY_BUCKETS     8
+
+ /**
+  * @brief 段状态位。
+  */
+#define APP_SEG_STATE_USED          0x01    // 清单条目有效。
+#define APP_SEG_STATE_SEALED        0x02    // 已封存，不再写入。
+#define APP_SEG_STATE_UPLOADED      0x04    // 已全部推送。
+#define APP_SEG_STATE_ARCHIVED      0x08    // 已按时间归档。
+#define APP_SEG_STATE_COMPRESSED    0x10    // 已压缩为 .LZS 文件，原 .SEG 文件已删除。
+#define APP_SEG_STATE_RAW           0x20    // 压缩失败，按原始数据推送。
+#define APP_SEG_STATE_HEADER        0x40    // 段文件有文件头扇区，旧版本的纯文本文件没有。
+
+ /**
+  * @brief 批量推送时每条 MQTT 消息的数据字节数，不含块头。
+  */
+#define APP_SEG_CHUNK_SIZE          (16 * 1024)
+
+ /**
+  * @brief 大于此 UTC 秒数（2024-01-01）才认为系统时间已同步。
+  */
+#define APP_SEG_TIME_VALID_TS       1704067200
+
+ /**
+  * @brief 块头标志位。
+  */
+#define APP_SEG_CHUNK_LAST          0x01    // 段的最后一块。
+#define APP_SEG_CHUNK_RAW           0x02    // 数据未压缩。
+
+ /**
+  * @brief 清单中的段条目。
+  */
+typedef struct {
+    uint32_t seq;               // 段序号。
+    uint32_t size;              // 封存时的字节数。
+    uint32_t zsize;             // 压缩后的字节数。
+    uint32_t pub_offset;        // 已推送的字节偏移（压缩文件内），用于断点续传。
+    uint32_t create_ts;         // 创建时的 UTC 秒数，时间未同步时为 0。
+    uint32_t archive_ts;        // 归档时的 UTC 秒数。
+    uint8_t state;              // 段状态位。
+    uint8_t reserved[3];
+} app_seg_entry_t;
+
+/**
+ * @brief 段清单，保存为 MANIFEST.DAT。
+ */
+typedef struct {
+    uint32_t magic;                             // 魔数。
+    uint32_t version;                           // 版本。
+    uint32_t head_seq;                          // 最早的未删除段。
+    uint32_t active_seq;                        // 当前活动段，对应 ACTIVE.SEG
+    app_seg_entry_t entries[APP_SEG_MAX_COUNT]; // 段条目。
+    uint32_t crc;                               // 以上内容的 CRC32。
+} app_seg_manifest_t;
+
+/**
+ * @brief 段文件头，位于文件第一个扇区，小端。
+ *        文件是预分配的，文件大小不是数据长度，数据长度以文件头为准。
+ */
+typedef struct {
+    uint32_t magic;             // 魔数 "SEGF"。
+    uint32_t seq;               // 段序号。
+    uint32_t length;            // 数据字节数，不含文件头扇区。
+    uint32_t create_ts;         // 创建时的 UTC 秒数。
+    uint32_t crc;               // 以上内容的 CRC32。
+} app_seg_file_header_t;
+
+/**
+ * @brief 批量推送的块头，后面紧跟块数据，小端。
+ *        服务器按（设备、kind、seq、offset）重组压缩文件，格式见 app_lz.h。
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             // 魔数 "BLK1"。
+    uint8_t kind;               // 存储类型，0 = 日志，1 = 缓存。
+    uint8_t flags;              // 块头标志位。
+    uint16_t header_len;        // 块头字节数。
+    uint32_t seq;               // 段序号。
+    uint32_t offset;            // 本块在文件中的偏移。
+    uint32_t total;             // 文件总字节数。
+    uint32_t raw_size;          // 原始字节数。
+} app_seg_chunk_header_t;
+
+/**
+ * @brief 分段存储。
+ */
+typedef struct {
+    const char* dir;                // 目录，必须大写。
+    const char* fat_dir;            // FATFS 路径，例如 "0:/LOG"，活动段直接用 FATFS 读写。
+    uint8_t kind;                   // 存储类型，写入块头。
+    FIL fil;                        // 活动段文件。
+    bool fil_open;                  // 活动段文件是否已打开。
+    uint8_t* sector_buf;            // 文件头扇区 + 末尾未写满的数据扇区，DMA 可用。
+    uint32_t active_size;           // 活动段当前字节数。
+    uint32_t write_count;           // 未 fsync 的写入次数。
+    bool rotate_pending;            // 需要轮换：活动段已满，或者清单已满推迟到最早的段被清理之后。
+    uint32_t latency_hist[APP_SEG_LATENCY_BUCKETS]; // 追加写入耗时分布。
+    uint32_t latency_max_us;        // 追加写入最大耗时。
+    uint32_t pub_seq;               // 正在推送的段。
+    uint32_t pub_fail_offset;       // 正在推送的段中，最早的未确认块的偏移。
+    app_seg_manifest_t manifest;    // 内存中的清单。
+    pthread_mutex_t mutex;          // 互斥锁。
+} app_seg_store_t;
+
+/**
+ * @brief 推送一块数据（块头 + 数据）的回调函数，返回负数表示失败。
+ *        服务器确认后调用 ack_cb(arg, record_id, acked)。
+ */
+typedef int (*app_seg_pub_cb_t)(const char* data, size_t len, app_pub_ack_cb_t ack_cb, void* arg, uint64_t record_id);
+
+/**
+ * @brief 同步上传一个分片的回调函数。file 已定位到 header->offset，分片数据是之后的 len 字节。
+ *        返回服务器已保存的偏移，下次从这里继续；失败返回 -1。
+ */
+typedef int64_t (*app_seg_upload_cb_t)(const app_seg_chunk_header_t* header, FILE* file, uint32_t len);
+
+/**
+ * @brief 打开分段存储。封存上次的活动段（只重命名，不复制），并创建新的活动段。
+ *        启动耗时与积压数据大小无关。
+ * @param store
+ * @param dir
+ * @param fat_dir
+ * @param kind
+ * @return
+ */
+int app_seg_open(app_seg_store_t* store, const char* dir, const char* fat_dir, uint8_t kind);
+
+/**
+ * @brief 追加数据到活动段。超过 APP_SEG_MAX_SIZE 不在这里轮换，继续追加到活动段，
+ *        由 app_seg_rotate_pending() 报告，调用者在自己的任务中调用 app_seg_rotate()。
+ *        此函数会在日志输出中被调用，函数内部不能输出日志。
+ * @param store
+ * @param data
+ * @param len
+ * @return 写入字节数，失败返回 -1。
+ */
+int app_seg_append(app_seg_store_t* store, const char* data, size_t len);
+
+/**
+ * @brief 确保活动段写入 SD 卡。
+ * @param store
+ */
+void app_seg_fsync(app_seg_store_t* store);
+
+/**
+ * @brief 封存活动段并开启新段。
+ * @param store
+ * @return 清单已满时不轮换，返回 0。
+ */
+int app_seg_rotate(app_seg_store_t* store);
+
+/**
+ * @brief 清单是否已满，并复制最早的段的条目。
+ *        已满时删除最早的段才能轮换，由调用者按清理策略决定是否删除。
+ * @param store
+ * @param head 可以为 NULL。
+ * @return
+ */
+bool app_seg_full(app_seg_store_t* store, app_seg_entry_t* head);
+
+/**
+ * @brief 是否需要轮换：活动段超过 APP_SEG_MAX_SIZE，或者清单已满时推迟的轮换。
+ * @param store
+ * @return
+ */
+bool app_seg_rotate_pending(app_seg_store_t* store);
+
+/**
+ * @brief 按时间归档：给时间同步之前创建的段补记 UTC 时间，并标记为已归档。
+ * @param store
+ */
+void app_seg_archive(app_seg_store_t* store);
+
+/**
+ * @brief 输出追加写入的耗时分布，输出后清零。
+ * @param store
+ */
+void app_seg_log_latency(app_seg_store_t* store);
+
+/**
+ * @brief 活动段是否有数据。
+ * @param store
+ * @return
+ */
+bool app_seg_active_has_data(app_seg_store_t* store);
+
+/**
+ * @brief 压缩一个已封存、未压缩的段，压缩完成后删除原文件。
+ *        耗时较长，在后台任务中调用。
+ * @param store
+ * @return 压缩的段数，0 = 没有需要压缩的段，-1 = 失败。
+ */
+int app_seg_compress(app_seg_store_t* store);
+
+/**
+ * @brief 按块推送所有已压缩、未推送的段，每块一条 MQTT 消息，支持断点续传。
+ *        每段的块连续发送，全部确认后才提交推送偏移；未确认的块从最早的一块重发。
+ *        未压缩的段等待压缩完成后再推送。
+ * @param store
+ * @param pub_cb
+ * @return 推送块数，中断返回 -1。
+ */
+int app_seg_pub(app_seg_store_t* store, app_seg_pub_cb_t pub_cb);
+
+/**
+ * @brief 按分片同步上传所有已压缩、未上传的段，每个分片确认后提交偏移，支持断点续传。
+ *        与 app_seg_pub() 共用推送偏移，可以交替使用。
+ * @param store
+ * @param part_size 每个分片的最大字节数。
+ * @param upload_cb
+ * @return 上传字节数，中断返回 -1。
+ */
+int64_t app_seg_upload(app_seg_store_t* store, uint32_t part_size, app_seg_upload_cb_t upload_cb);
+
+/**
+ * @brief 查找最早的符合条件的已封存段，复制条目。
+ * @param store
+ * @param want 必须具有的状态位。
+ * @param skip 必须没有的状态位。
+ * @param out
+ * @return 找到返回 1，否则返回 0。
+ */
+int app_seg_find(app_seg_store_t* store, uint8_t want, uint8_t skip, app_seg_entry_t* out);
+
+/**
+ * @brief 删除一个已封存的段。
+ * @param store
+ * @param seq
+ * @return 释放的字节数，段不存在返回 -1。
+ */
+int app_seg_delete(app_seg_store_t* store, uint32_t seq);
+
+/**
+ * @brief 生成段文件名。
+ * @param store
+ * @param seq
+ * @param buffer
+ * @param size
+ */
+void app_seg_path(const app_seg_store_t* store, uint32_t seq, char* buffer, size_t size);
+
+/**
+ * @brief 生成压缩段文件名。
+ * @param store
+ * @param seq
+ * @param buffer
+ * @param size
+ */
+void app_seg_zpath(const app_seg_store_t* store, uint32_t seq, char* buffer, size_t size);
@@ -0,0 +1,241 @@
+/**
+ * @brief   MQTT 的 TLS 传输层，重连时恢复 TLS 会话。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "esp_transport.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/sha256.h"
+
+#include "app_tls.h"
+#include "app_metrics.h"
+#include "app_config.h"
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_tls";
+
+/**
+ * @brief 当前连接，只在 MQTT 任务中使用。
+ */
+static esp_tls_t* app_tls = NULL;
+
+/**
+ * @brief 最近一次握手的会话票据，断开后保留，下次连接时使用。
+ */
+static esp_tls_client_session_t* app_tls_session = NULL;
+
+/**
+ * @brief 会话票据对应的会话 ID。恢复会话时服务器在 ServerHello 中原样返回，完整握手时是新的 ID。
+ */
+static unsigned char app_tls_session_id[32];
+static size_t app_tls_session_id_len = 0;
+
+/**
+ * @brief 校验服务器证书 DER 的 SHA-256，APP_MQTT_TLS_PIN_SHA256 为空时不校验。
+ *        恢复会话时服务器不发送证书，校验的是会话中保存的证书。
+ * @return
+ */
+static bool app_tls_check_pin(void) {
+    if (strlen(APP_MQTT_TLS_PIN_SHA256) == 0) {
+        return true;
+    }
+    const mbedtls_x509_crt* crt = mbedtls_ssl_get_peer_cert(esp_tls_get_ssl_context(app_tls));
+    if (crt == NULL) {
+        return false;
+    }
+    unsigned char hash[32];
+    mbedtls_sha256(crt->raw.p, crt->raw.len, hash, 0);
+    char hex[65];
+    for (int i = 0; i < 32; i++) {
+        sprintf(hex + i * 2, "%02x", hash[i]);
+    }
+    return strcasecmp(hex, APP_MQTT_TLS_PIN_SHA256) == 0;
+}
+
+/**
+ * @brief 复制当前连接的会话 ID。
+ * @return 会话 ID 字节数，失败返回 0。
+ */
+static size_t app_tls_get_session_id(unsigned char id[32]) {
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    size_t len = 0;
+    if (mbedtls_ssl_get_session(esp_tls_get_ssl_context(app_tls), &session) == 0) {
+        len = mbedtls_ssl_session_get_id_len(&session);
+        memcpy(id, mbedtls_ssl_session_get_id(&session), len);
+    }
+    mbedtls_ssl_session_free(&session);
+    return len;
+}
+
+/**
+ * @brief 关闭连接，保留会话票据。
+ */
+static int app_tls_close(esp_transport_handle_t t) {
+    if (app_tls != NULL) {
+        esp_tls_conn_destroy(app_tls);
+        app_tls = NULL;
+    }
+    return 0;
+}
+
+/**
+ * @brief 连接并握手，有会话票据时先尝试恢复会话。
+ *        服务器可能不接受票据而完整握手，握手后比较会话 ID 判断是否真的恢复了会话。
+ *        保存的会话 ID 不是 32 字节时，mbedtls 发送随机 ID，无法判断，按完整握手统计。
+ */
+static int app_tls_connect(esp_transport_handle_t t, const char* host, int port, int timeout_ms) {
+    app_tls_close(t);
+    esp_tls_cfg_t cfg = {
+        .cacert_buf = (const unsigned char*)APP_MQTT_TLS_CA_PEM,
+        .cacert_bytes = sizeof(APP_MQTT_TLS_CA_PEM),
+        .timeout_ms = timeout_ms,
+        .client_session = app_tls_session,
+    };
+    bool offered = app_tls_session != NULL;
+    int64_t start_us = esp_timer_get_time();
+    app_tls = esp_tls_init();
+    if (app_tls == NULL) {
+        return -1;
+    }
+    if (esp_tls_conn_new_sync(host, strlen(host), port, &cfg, app_tls) != 1) {
+        ESP_LOGE(TAG, "------ TLS 握手失败！%s:%d", host, port);
+        if (offered) {// 票据可能已经过期，下次完整握手。
+            esp_tls_free_client_session(app_tls_session);
+            app_tls_session = NULL;
+            app_tls_session_id_len = 0;
+        }
+        app_tls_close(t);
+        return -1;
+    }
+    int64_t done_us = esp_timer_get_time();
+    if (!app_tls_check_pin()) {
+        ESP_LOGE(TAG, "------ TLS 服务器证书指纹不匹配！");
+        app_tls_close(t);
+        return -1;
+    }
+
+    unsigned char id[32];
+    size_t id_len = app_tls_get_session_id(id);
+    bool resumed = offered && id_len == sizeof(id) && app_tls_session_id_len == id_len && memcmp(id, app_tls_session_id, id_len) == 0;
+
+    esp_tls_client_session_t* session = esp_tls_get_client_session(app_tls);// 服务器可能下发了新票据，每次都更新。
+    if (session != NULL) {
+        if (app_tls_session != NULL) {
+            esp_tls_free_client_session(app_tls_session);
+        }
+        app_tls_session = session;
+        memcpy(app_tls_session_id, id, id_len);
+        app_tls_session_id_len = id_len;
+    }
+    app_metrics_tls_handshake(start_us, done_us, resumed);
+    ESP_LOGI(TAG, "------ TLS 握手：%lld 毫秒，%s。", (done_us - start_us) / 1000,
+        resumed ? "恢复会话" : (offered ? "服务器未接受会话票据，完整握手" : "完整握手"));
+    return 0;
+}
+
+/**
+ * @brief 等待可读，esp_tls 缓冲区中有数据时直接返回。
+ */
+static int app_tls_poll_read(esp_transport_handle_t t, int timeout_ms) {
+    if (app_tls == NULL) {
+        return -1;
+    }
+    if (esp_tls_get_bytes_avail(app_tls) > 0) {
+        return 1;
+    }
+    int sockfd;
+    if (esp_tls_get_conn_sockfd(app_tls, &sockfd) != ESP_OK) {
+        return -1;
+    }
+    fd_set readset;
+    FD_ZERO(&readset);
+    FD_SET(sockfd, &readset);
+    struct timeval timeout = {.tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000};
+    return select(sockfd + 1, &readset, NULL, NULL, timeout_ms < 0 ? NULL : &timeout);
+}
+
+/**
+ * @brief 等待可写。
+ */
+static int app_tls_poll_write(esp_transport_handle_t t, int timeout_ms) {
+    int sockfd;
+    if (app_tls == NULL || esp_tls_get_conn_sockfd(app_tls, &sockfd) != ESP_OK) {
+        return -1;
+    }
+    fd_set writeset;
+    FD_ZERO(&writeset);
+    FD_SET(sockfd, &writeset);
+    struct timeval timeout = {.tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000};
+    return select(sockfd + 1, NULL, &writeset, NULL, timeout_ms < 0 ? NULL : &timeout);
+}
+
+/**
+ * @brief 读取，超时返回 0，对方关闭连接返回 ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN。
+ */
+static int app_tls_read(esp_transport_handle_t t, char* buffer, int len, int timeout_ms) {
+    int poll = app_tls_poll_read(t, timeout_ms);
+    if (poll <= 0) {
+        return poll;
+    }
+    int ret = esp_tls_conn_read(app_tls, buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE) {
+        return 0;
+    }
+    if (ret == 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+    return ret < 0 ? -1 : ret;
+}
+
+/**
+ * @brief 写入，超时返回 0。
+ */
+static int app_tls_write(esp_transport_handle_t t, const char* buffer, int len, int timeout_ms) {
+    int poll = app_tls_poll_write(t, timeout_ms);
+    if (poll <= 0) {
+        return poll;
+    }
+    int ret = esp_tls_conn_write(app_tls, buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE) {
+        return 0;
+    }
+    return ret < 0 ? -1 : ret;
+}
+
+/**
+ * @brief 释放传输层，MQTT 客户端销毁时调用。
+ */
+static int app_tls_destroy(esp_transport_handle_t t) {
+    app_tls_close(t);
+    if (app_tls_session != NULL) {
+        esp_tls_free_client_session(app_tls_session);
+        app_tls_session = NULL;
+        app_tls_session_id_len = 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief 创建传输层，设置到 esp_mqtt_client_config_t 的 network.transport。
+ * @return 失败返回 NULL。
+ */
+esp_transport_handle_t app_tls_transport_init(void) {
+    esp_transport_handle_t t = esp_transport_init();
+    if (t == NULL) {
+        return NULL;
+    }
+    esp_transport_set_func(t, app_tls_connect, app_tls_read, app_tls_write, app_tls_close, app_tls_poll_read, app_tls_poll_write, app_tls_destroy);
+    esp_transport_set_default_port(t, 8883);
+    return t;
+}
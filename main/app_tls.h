@@ -0,0 +1,20 @@
+/**
+ * @brief   MQTT 的 TLS 传输层，重连时恢复 TLS 会话。
+ *
+ *          esp-mqtt 自带的 SSL 传输层每次连接都完整握手，这里基于 esp_tls 实现同样的传输层接口，
+ *          握手成功后保存会话票据（RAM），下次连接带上票据，服务器接受时省去证书交换和密钥协商。
+ *          只信任 APP_MQTT_TLS_CA_PEM 中的证书；APP_MQTT_TLS_PIN_SHA256 不为空时，还要校验服务器证书的指纹。
+ *          需要开启 CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include "esp_transport.h"
+
+/**
+ * @brief 创建传输层，设置到 esp_mqtt_client_config_t 的 network.transport。
+ * @return 失败返回 NULL。
+ */
+esp_transport_handle_t app_tls_transport_init(void);
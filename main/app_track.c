@@ -0,0 +1,418 @@
+/**
+ * @brief   SD 卡轨迹存储，定长二进制记录，按时间范围查询。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+
+#include "app_track.h"
+
+ /**
+ * @brief 轨迹目录，必须大写。
+ */
+#ifndef APP_TRACK_DIR
+#define APP_TRACK_DIR               "/sdcard/TRACK"
+#endif
+
+ /**
+ * @brief 块头魔数。
+ */
+#define APP_TRACK_MAGIC             0x314B5254  // "TRK1"
+
+ /**
+ * @brief 未满的块多久写一次 SD 卡，断电最多丢失这段时间的记录。
+ */
+#define APP_TRACK_FLUSH_MS          30000
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_track";
+
+/**
+ * @brief 初始化状态。
+ */
+static int app_track_init_status = 0;
+
+/**
+ * @brief 互斥锁，保护写入状态。
+ */
+static pthread_mutex_t app_track_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 当前写入的文件，以及文件对应的日期 YYYYMMDD。
+ */
+static FILE* app_track_file = NULL;
+static uint32_t app_track_day = 0;
+
+/**
+ * @brief 当前写入的块，以及块序号。
+ */
+static uint8_t app_track_block[APP_TRACK_BLOCK_SIZE];
+static uint32_t app_track_block_index = 0;
+static int app_track_block_dirty = 0;
+static uint32_t app_track_flush_ts = 0;
+
+/**
+ * @brief 最后一条记录的时间，新记录的时间必须大于此值。
+ */
+static int64_t app_track_last_ts = 0;
+
+/**
+ * @brief 当前块的块头和记录。
+ */
+#define APP_TRACK_HEADER(block)     ((app_track_block_header_t*)(block))
+#define APP_TRACK_RECORDS(block)    ((app_track_record_t*)((block) + sizeof(app_track_block_header_t)))
+
+/**
+ * @brief 毫秒时间对应的 UTC 日期 YYYYMMDD。
+ */
+static uint32_t app_track_day_of(int64_t ts_ms) {
+    time_t t = (time_t)(ts_ms / 1000);
+    struct tm timeinfo;
+    gmtime_r(&t, &timeinfo);
+    return (timeinfo.tm_year + 1900) * 10000 + (timeinfo.tm_mon + 1) * 100 + timeinfo.tm_mday;
+}
+
+/**
+ * @brief 日期对应的文件名。
+ */
+static void app_track_day_path(uint32_t day, char* buffer, size_t size) {
+    snprintf(buffer, size, APP_TRACK_DIR"/%08lu.TRK", (unsigned long)day);
+}
+
+/**
+ * @brief 计算块 CRC，包括块头（不含 crc 字段）和有效记录。
+ */
+static uint32_t app_track_block_crc(const uint8_t* block) {
+    const app_track_block_header_t* header = APP_TRACK_HEADER(block);
+    uint32_t crc = esp_rom_crc32_le(0, block, offsetof(app_track_block_header_t, crc));
+    return esp_rom_crc32_le(crc, block + sizeof(app_track_block_header_t), header->count * sizeof(app_track_record_t));
+}
+
+/**
+ * @brief 块是否有效。
+ */
+static bool app_track_block_valid(const uint8_t* block) {
+    const app_track_block_header_t* header = APP_TRACK_HEADER(block);
+    return header->magic == APP_TRACK_MAGIC &&
+        header->count > 0 &&
+        header->count <= APP_TRACK_BLOCK_RECORDS &&
+        header->crc == app_track_block_crc(block);
+}
+
+/**
+ * @brief 记录 CRC。
+ */
+static uint16_t app_track_record_crc(const app_track_record_t* record) {
+    return esp_rom_crc16_le(0, (const uint8_t*)record, offsetof(app_track_record_t, crc));
+}
+
+/**
+ * @brief 清空当前块。
+ */
+static void app_track_reset_block(uint32_t index) {
+    memset(app_track_block, 0, sizeof(app_track_block));
+    app_track_block_header_t* header = APP_TRACK_HEADER(app_track_block);
+    header->magic = APP_TRACK_MAGIC;
+    header->index = index;
+    app_track_block_index = index;
+    app_track_block_dirty = 0;
+}
+
+/**
+ * @brief 把当前块写到文件中的固定位置，未满的块以后会原地覆盖。
+ *        调用前必须持有互斥锁。
+ */
+static int app_track_write_block(void) {
+    if (app_track_file == NULL) {
+        return -1;
+    }
+    APP_TRACK_HEADER(app_track_block)->crc = app_track_block_crc(app_track_block);
+    fseek(app_track_file, (long)app_track_block_index * APP_TRACK_BLOCK_SIZE, SEEK_SET);
+    size_t write_len = fwrite(app_track_block, 1, APP_TRACK_BLOCK_SIZE, app_track_file);
+    fflush(app_track_file);
+    fsync(fileno(app_track_file));
+    app_track_block_dirty = 0;
+    app_track_flush_ts = esp_log_timestamp();
+    return write_len == APP_TRACK_BLOCK_SIZE ? 1 : -1;
+}
+
+/**
+ * @brief 读取文件中的一个块。
+ */
+static int app_track_read_block(FILE* file, uint32_t index, uint8_t* block, size_t size) {
+    if (fseek(file, (long)index * APP_TRACK_BLOCK_SIZE, SEEK_SET) != 0) {
+        return -1;
+    }
+    return fread(block, 1, size, file) == size ? 1 : -1;
+}
+
+/**
+ * @brief 打开某一天的文件，继续写入最后一个未满的块。
+ *        调用前必须持有互斥锁。
+ */
+static int app_track_open_day(uint32_t day) {
+    if (app_track_file != NULL) {
+        if (app_track_block_dirty) {
+            app_track_write_block();
+        }
+        fclose(app_track_file);
+        app_track_file = NULL;
+    }
+    char path[64];
+    app_track_day_path(day, path, sizeof(path));
+    app_track_file = fopen(path, "r+b");
+    if (app_track_file == NULL) {
+        app_track_file = fopen(path, "w+b");
+    }
+    if (app_track_file == NULL) {
+        ESP_LOGE(TAG, "------ 轨迹文件打开：失败！文件名：%s", path);
+        return -1;
+    }
+    app_track_day = day;
+
+    fseek(app_track_file, 0, SEEK_END);
+    uint32_t block_count = (uint32_t)(ftell(app_track_file) / APP_TRACK_BLOCK_SIZE);// 不完整的尾部直接覆盖。
+    app_track_reset_block(block_count);
+    for (uint32_t i = block_count; i > 0; i--) {// 从最后一块往前找到有效块，断电写坏的块会被覆盖。
+        if (app_track_read_block(app_track_file, i - 1, app_track_block, APP_TRACK_BLOCK_SIZE) > 0 && app_track_block_valid(app_track_block)) {
+            app_track_block_header_t* header = APP_TRACK_HEADER(app_track_block);
+            if (header->last_ts_ms > app_track_last_ts) {
+                app_track_last_ts = header->last_ts_ms;
+            }
+            if (header->count < APP_TRACK_BLOCK_RECORDS) {
+                app_track_block_index = i - 1;// 继续写入未满的块。
+            } else {
+                app_track_reset_block(i);
+            }
+            break;
+        }
+        app_track_reset_block(i - 1);
+    }
+    ESP_LOGI(TAG, "------ 轨迹文件打开：完成。文件名：%s，块序号：%" PRIu32, path, app_track_block_index);
+    return 1;
+}
+
+/**
+ * @brief 追加一条记录，时间必须递增，否则丢弃。
+ *        满一块写一次 SD 卡，未满的块每 APP_TRACK_FLUSH_MS 写一次。
+ * @param record crc 字段由函数计算。
+ * @return
+ */
+int app_track_append(app_track_record_t* record) {
+    if (app_track_init_status == 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&app_track_mutex);
+    uint32_t day = app_track_day_of(record->ts_ms);
+    if (app_track_file == NULL && app_track_open_day(day) < 0) {// 第一次写入，打开文件并读取最后一条记录的时间。
+        pthread_mutex_unlock(&app_track_mutex);
+        return -1;
+    }
+    if (record->ts_ms <= app_track_last_ts) {// 时间不递增，破坏时间索引，丢弃。
+        pthread_mutex_unlock(&app_track_mutex);
+        return 0;
+    }
+    if (day != app_track_day && app_track_open_day(day) < 0) {// 跨天，换文件。
+        pthread_mutex_unlock(&app_track_mutex);
+        return -1;
+    }
+
+    record->crc = app_track_record_crc(record);
+    app_track_block_header_t* header = APP_TRACK_HEADER(app_track_block);
+    APP_TRACK_RECORDS(app_track_block)[header->count] = *record;
+    if (header->count == 0) {
+        header->first_ts_ms = record->ts_ms;
+    }
+    header->count++;
+    header->last_ts_ms = record->ts_ms;
+    app_track_last_ts = record->ts_ms;
+    app_track_block_dirty = 1;
+
+    int ret = 1;
+    if (header->count == APP_TRACK_BLOCK_RECORDS) {// 块已满，写出并开始新块。
+        ret = app_track_write_block();
+        app_track_reset_block(app_track_block_index + 1);
+    } else if (esp_log_timestamp() - app_track_flush_ts > APP_TRACK_FLUSH_MS) {
+        ret = app_track_write_block();
+    }
+    pthread_mutex_unlock(&app_track_mutex);
+    return ret;
+}
+
+/**
+ * @brief 写出未满的块。
+ */
+void app_track_flush(void) {
+    if (app_track_init_status == 0) {
+        return;
+    }
+    pthread_mutex_lock(&app_track_mutex);
+    if (app_track_block_dirty) {
+        app_track_write_block();
+    }
+    pthread_mutex_unlock(&app_track_mutex);
+}
+
+/**
+ * @brief 二分查找：最后一个 first_ts_ms <= from_ms 的块。
+ *        块头损坏时按无穷大处理，只会让查找起点提前，不会漏掉记录。
+ */
+static uint32_t app_track_search(FILE* file, uint32_t block_count, int64_t from_ms) {
+    uint32_t lo = 0;
+    uint32_t hi = block_count;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        app_track_block_header_t header;
+        int64_t first_ts = INT64_MAX;
+        if (app_track_read_block(file, mid, (uint8_t*)&header, sizeof(header)) > 0 && header.magic == APP_TRACK_MAGIC) {
+            first_ts = header.first_ts_ms;
+        }
+        if (first_ts <= from_ms) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @brief 查询时间范围 [from_ms, to_ms] 内的记录。
+ *        查询不持有写入锁，正在覆盖的块如果读到一半，CRC 校验失败后跳过。
+ * @param from_ms
+ * @param to_ms
+ * @param cb
+ * @param arg
+ * @return 记录数，失败返回 -1。
+ */
+int app_track_query(int64_t from_ms, int64_t to_ms, app_track_query_cb_t cb, void* arg) {
+    if (app_track_init_status == 0 || from_ms > to_ms) {
+        return -1;
+    }
+    app_track_flush();// 先写出未满的块，查询只读文件。
+
+    uint8_t* block = malloc(APP_TRACK_BLOCK_SIZE);
+    if (block == NULL) {
+        return -1;
+    }
+    int64_t start_us = esp_timer_get_time();
+    int count = 0;
+    int blocks = 0;
+    bool stop = false;
+    int64_t day_start_ms = from_ms - (from_ms % 86400000);
+    for (int64_t t = day_start_ms; t <= to_ms && !stop; t += 86400000) {// 按天遍历文件。
+        char path[64];
+        app_track_day_path(app_track_day_of(t), path, sizeof(path));
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) {
+            continue;
+        }
+        fseek(file, 0, SEEK_END);
+        uint32_t block_count = (uint32_t)(ftell(file) / APP_TRACK_BLOCK_SIZE);
+        for (uint32_t i = app_track_search(file, block_count, from_ms); i < block_count && !stop; i++) {
+            if (app_track_read_block(file, i, block, APP_TRACK_BLOCK_SIZE) < 0) {
+                break;
+            }
+            blocks++;
+            if (!app_track_block_valid(block)) {
+                continue;
+            }
+            app_track_block_header_t* header = APP_TRACK_HEADER(block);
+            if (header->first_ts_ms > to_ms) {
+                break;
+            }
+            if (header->last_ts_ms < from_ms) {
+                continue;
+            }
+            app_track_record_t* records = APP_TRACK_RECORDS(block);
+            for (int j = 0; j < header->count; j++) {
+                if (records[j].ts_ms < from_ms || records[j].ts_ms > to_ms || records[j].crc != app_track_record_crc(&records[j])) {
+                    continue;
+                }
+                count++;
+                if (cb(&records[j], arg) < 0) {
+                    stop = true;
+                    break;
+                }
+            }
+        }
+        fclose(file);
+    }
+    free(block);
+    ESP_LOGI(TAG, "------ 轨迹查询：完成。记录数：%d，读取块数：%d，耗时：%" PRId64 " us", count, blocks, esp_timer_get_time() - start_us);
+    return count;
+}
+
+/**
+ * @brief 查找最早的轨迹文件，不包括正在写入的文件。
+ * @param day_ts 文件日期 0 点的 UTC 秒数。
+ * @param size 文件字节数。
+ * @param path 文件名。
+ * @param path_size
+ * @return 找到返回 1，否则返回 0。
+ */
+int app_track_oldest(uint32_t* day_ts, uint32_t* size, char* path, size_t path_size) {
+    if (app_track_init_status == 0) {
+        return 0;
+    }
+    DIR* dp = opendir(APP_TRACK_DIR);
+    if (dp == NULL) {
+        return 0;
+    }
+    uint32_t oldest_day = UINT32_MAX;
+    struct dirent* entry;
+    while ((entry = readdir(dp)) != NULL) {
+        unsigned long day;
+        char ext[4];
+        if (strlen(entry->d_name) != 12 || sscanf(entry->d_name, "%8lu.%3s", &day, ext) != 2 || strcmp(ext, "TRK") != 0) {
+            continue;
+        }
+        if (day != app_track_day && day < oldest_day) {
+            oldest_day = day;
+        }
+    }
+    closedir(dp);
+    if (oldest_day == UINT32_MAX) {
+        return 0;
+    }
+    app_track_day_path(oldest_day, path, path_size);
+    struct stat st;
+    *size = stat(path, &st) == 0 ? (uint32_t)st.st_size : 0;
+    struct tm timeinfo = {
+        .tm_year = oldest_day / 10000 - 1900,
+        .tm_mon = oldest_day / 100 % 100 - 1,
+        .tm_mday = oldest_day % 100,
+    };
+    *day_ts = (uint32_t)mktime(&timeinfo);// 没有设置 TZ，mktime() 按 UTC 计算。
+    return 1;
+}
+
+/**
+ * @brief 初始化函数，SD 卡挂载之后调用。
+ * @return
+ */
+esp_err_t app_track_init(void) {
+    if (access(APP_TRACK_DIR, F_OK) == -1 && mkdir(APP_TRACK_DIR, 0700) == -1) {
+        ESP_LOGE(TAG, "------ 轨迹目录创建：失败！%s: %s", APP_TRACK_DIR, strerror(errno));
+        return ESP_FAIL;
+    }
+    app_track_init_status = 1;
+    return ESP_OK;
+}
@@ -0,0 +1,105 @@
+/**
+ * @brief   SD 卡轨迹存储，定长二进制记录，按时间范围查询。
+ *
+ *          每天一个文件 /sdcard/TRACK/YYYYMMDD.TRK，文件由 4096 字节的块组成，
+ *          块头记录本块第一条和最后一条的时间，作为稀疏时间索引。
+ *          查询时先对块头二分查找，再顺序读取，耗时与数据总量无关。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+ /**
+  * @brief 块大小，与 FATFS 扇区大小一致。
+  */
+#define APP_TRACK_BLOCK_SIZE        4096
+
+ /**
+  * @brief 记录标志位。
+  */
+#define APP_TRACK_FLAG_VALID        0x01    // GNSS 有效。
+#define APP_TRACK_FLAG_BLE          0x02    // 蓝牙开关打开。
+
+ /**
+  * @brief 轨迹记录，32 字节，小端。
+  */
+typedef struct __attribute__((packed)) {
+    int64_t ts_ms;              // GNSS UTC 时间，毫秒。
+    int32_t lat_e7;             // 纬度 * 10^7。
+    int32_t lon_e7;             // 经度 * 10^7。
+    int32_t alt_cm;             // 高度，厘米。
+    uint16_t spd_cknot;         // 速度，0.01 节。
+    uint16_t trk_cdeg;          // 航向角度，0.01 度。
+    int16_t mag_cdeg;           // 磁偏角度，0.01 度。
+    uint8_t sat;                // 卫星数。
+    uint8_t flags;              // 标志位。
+    uint16_t reserved;
+    uint16_t crc;               // 以上内容的 CRC16。
+} app_track_record_t;
+
+/**
+ * @brief 块头，32 字节，小端。
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             // 魔数 "TRK1"。
+    uint16_t count;             // 本块记录数。
+    uint16_t reserved;
+    int64_t first_ts_ms;        // 第一条记录的时间。
+    int64_t last_ts_ms;         // 最后一条记录的时间。
+    uint32_t index;             // 块在文件中的序号。
+    uint32_t crc;               // 块头（不含 crc）和全部记录的 CRC32。
+} app_track_block_header_t;
+
+/**
+ * @brief 每块最多记录数。
+ */
+#define APP_TRACK_BLOCK_RECORDS     ((APP_TRACK_BLOCK_SIZE - sizeof(app_track_block_header_t)) / sizeof(app_track_record_t))
+
+/**
+ * @brief 查询回调函数，返回负数停止查询。
+ */
+typedef int (*app_track_query_cb_t)(const app_track_record_t* record, void* arg);
+
+/**
+ * @brief 追加一条记录，时间必须递增，否则丢弃。
+ *        满一块写一次 SD 卡，未满的块每 APP_TRACK_FLUSH_MS 写一次。
+ * @param record crc 字段由函数计算。
+ * @return
+ */
+int app_track_append(app_track_record_t* record);
+
+/**
+ * @brief 写出未满的块。
+ */
+void app_track_flush(void);
+
+/**
+ * @brief 查询时间范围 [from_ms, to_ms] 内的记录。
+ * @param from_ms
+ * @param to_ms
+ * @param cb
+ * @param arg
+ * @return 记录数，失败返回 -1。
+ */
+int app_track_query(int64_t from_ms, int64_t to_ms, app_track_query_cb_t cb, void* arg);
+
+/**
+ * @brief 查找最早的轨迹文件，不包括正在写入的文件。
+ * @param day_ts 文件日期 0 点的 UTC 秒数。
+ * @param size 文件字节数。
+ * @param path 文件名。
+ * @param path_size
+ * @return 找到返回 1，否则返回 0。
+ */
+int app_track_oldest(uint32_t* day_ts, uint32_t* size, char* path, size_t path_size);
+
+/**
+ * @brief 初始化函数，SD 卡挂载之后调用。
+ * @return
+ */
+esp_err_t app_track_init(void);
@@ -0,0 +1,715 @@
+/**
+ * @brief   本地网页服务器，通过设备热点访问。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_netif_sta_list.h"
+#include "esp_spiffs.h"
+#include "esp_http_server.h"
+#include "esp_random.h"
+#include "cJSON.h"
+
+#include "app_config.h"
+#include "app_web.h"
+#include "app_live.h"
+#include "app_wifi.h"
+
+ /**
+ * @brief 日志 TAG。
+ */
+static const char* TAG = "app_web";
+
+/**
+ * @brief 静态文件，从 /.etags 读取。
+ */
+typedef struct {
+    char path[APP_WEB_PATH_LEN];    // 原路径，例如 /index.html。
+    char etag[20];                  // 带引号的 ETag。
+    bool gzip;                      // true = SPIFFS 中保存为 path + ".gz"。
+} app_web_file_t;
+
+/**
+ * @brief 热点已连接的设备，保存名称和连接时间。
+ */
+typedef struct {
+    uint8_t mac[6];
+    char name[32];
+    int64_t online_us;              // 连接时间，esp_timer_get_time()，0 = 空位置。
+} app_web_sta_t;
+
+/**
+ * @brief 登录会话，令牌保存在浏览器的 Cookie 中。
+ */
+typedef struct {
+    char token[33];                 // 16 字节随机数的十六进制，空 = 空位置。
+    int64_t expire_us;              // 过期时间，esp_timer_get_time()。
+} app_web_session_t;
+
+/**
+ * @brief 静态文件列表，启动时读取，之后只读。
+ */
+static app_web_file_t app_web_files[APP_WEB_FILE_MAX];
+static int app_web_file_count = 0;
+
+/**
+ * @brief 热点设备列表，WIFI 事件和 HTTP 服务器任务中使用。
+ */
+static app_web_sta_t app_web_stas[APP_WEB_STA_MAX];
+static pthread_mutex_t app_web_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 登录会话和登录失败计数，只在 HTTP 服务器任务中使用。
+ */
+static app_web_session_t app_web_sessions[APP_WEB_SESSION_MAX];
+static int app_web_login_fails = 0;
+static int64_t app_web_login_lock_us = 0;
+
+/**
+ * @brief 文件读取缓冲区，处理函数都在 HTTP 服务器任务中执行，共用一个。
+ */
+static char app_web_buffer[APP_WEB_IO_SIZE];
+
+/**
+ * @brief 热点加密方式，名称与 wlan.html 中的选项相同。ESP32 热点不支持 WEP。
+ */
+static const struct {
+    const char* name;
+    wifi_auth_mode_t mode;
+} app_web_auth_modes[] = {
+    {"OPEN", WIFI_AUTH_OPEN},
+    {"WPA2_PSK", WIFI_AUTH_WPA2_PSK},
+    {"WPA_WPA2_PSK", WIFI_AUTH_WPA_WPA2_PSK},
+};
+
+/**
+ * @brief 读取 /.etags，格式：<原路径> <ETag> <是否压缩>，见 tools/spiffs_gzip.py。
+ */
+static void app_web_files_load(void) {
+    FILE* file = fopen(APP_WEB_BASE_PATH "/.etags", "r");
+    if (file == NULL) {
+        ESP_LOGE(TAG, "------ 打开 /.etags 失败！SPIFFS 镜像需要由构建生成。");
+        return;
+    }
+    char line[80];
+    while (app_web_file_count < APP_WEB_FILE_MAX && fgets(line, sizeof(line), file) != NULL) {
+        app_web_file_t* f = &app_web_files[app_web_file_count];
+        char etag[17];
+        int gzip = 0;
+        if (sscanf(line, "%31s %16s %d", f->path, etag, &gzip) == 3) {
+            snprintf(f->etag, sizeof(f->etag), "\"%s\"", etag);
+            f->gzip = gzip != 0;
+            app_web_file_count++;
+        }
+    }
+    fclose(file);
+    ESP_LOGI(TAG, "------ 网页文件数：%d。", app_web_file_count);
+}
+
+/**
+ * @brief 查找静态文件。
+ * @param path
+ * @return 没有返回 NULL。
+ */
+static const app_web_file_t* app_web_file_find(const char* path) {
+    for (int i = 0; i < app_web_file_count; i++) {
+        if (strcmp(app_web_files[i].path, path) == 0) {
+            return &app_web_files[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 按扩展名返回 Content-Type。
+ * @param path
+ * @return
+ */
+static const char* app_web_content_type(const char* path) {
+    static const struct {
+        const char* ext;
+        const char* type;
+    } types[] = {
+        {".html", "text/html; charset=utf-8"},
+        {".js", "application/javascript"},
+        {".css", "text/css"},
+        {".png", "image/png"},
+        {".jpg", "image/jpeg"},
+        {".ico", "image/x-icon"},
+    };
+    const char* ext = strrchr(path, '.');
+    for (int i = 0; ext != NULL && i < sizeof(types) / sizeof(types[0]); i++) {
+        if (strcmp(ext, types[i].ext) == 0) {
+            return types[i].type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+/**
+ * @brief 静态文件，GET 其他路径。
+ *        If-None-Match 与 ETag 相同时返回 304，否则分块读取文件并发送。
+ * @param req
+ * @return
+ */
+static esp_err_t app_web_file_handler(httpd_req_t* req) {
+    char uri[APP_WEB_PATH_LEN];
+    size_t len = strcspn(req->uri, "?#");// 去掉查询参数。
+    if (len >= sizeof(uri)) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+    memcpy(uri, req->uri, len);
+    uri[len] = '\0';
+    if (strcmp(uri, "/") == 0) {
+        strcpy(uri, "/index.html");
+    }
+    const app_web_file_t* f = app_web_file_find(uri);
+    if (f == NULL) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+
+    char cache_control[32];
+    if (strstr(f->path, ".html") != NULL) {// html 每次验证，保证修改后的页面引用到新的文件。
+        strcpy(cache_control, "no-cache");
+    } else {
+        snprintf(cache_control, sizeof(cache_control), "public, max-age=%d", APP_WEB_MAX_AGE_S);
+    }
+    httpd_resp_set_hdr(req, "ETag", f->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", cache_control);
+
+    char if_none_match[sizeof(f->etag)];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, f->etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    char path[sizeof(APP_WEB_BASE_PATH) + APP_WEB_PATH_LEN + 3];
+    snprintf(path, sizeof(path), "%s%s%s", APP_WEB_BASE_PATH, f->path, f->gzip ? ".gz" : "");
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        ESP_LOGE(TAG, "------ 打开文件失败：%s", path);
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+    httpd_resp_set_type(req, app_web_content_type(f->path));
+    if (f->gzip) {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    }
+    size_t read_len;
+    while ((read_len = fread(app_web_buffer, 1, sizeof(app_web_buffer), file)) > 0) {
+        if (httpd_resp_send_chunk(req, app_web_buffer, read_len) != ESP_OK) {
+            fclose(file);
+            ESP_LOGW(TAG, "------ 发送文件中断：%s", path);
+            return ESP_FAIL;
+        }
+    }
+    fclose(file);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+/**
+ * @brief 读取请求体，解析为 JSON。
+ * @param req
+ * @return 失败返回 NULL，调用者释放。
+ */
+static cJSON* app_web_recv_json(httpd_req_t* req) {
+    char body[APP_WEB_BODY_MAX];
+    if (req->content_len == 0 || req->content_len >= sizeof(body)) {
+        return NULL;
+    }
+    int received = 0;
+    while (received < req->content_len) {
+        int ret = httpd_req_recv(req, body + received, req->content_len - received);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (ret <= 0) {
+            return NULL;
+        }
+        received += ret;
+    }
+    body[received] = '\0';
+    return cJSON_Parse(body);
+}
+
+/**
+ * @brief 发送 JSON 并释放。
+ * @param req
+ * @param obj
+ * @return
+ */
+static esp_err_t app_web_send_json(httpd_req_t* req, cJSON* obj) {
+    char* json = cJSON_PrintUnformatted(obj);
+    cJSON_Delete(obj);
+    if (json == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    esp_err_t ret = httpd_resp_sendstr(req, json);
+    cJSON_free(json);
+    return ret;
+}
+
+/**
+ * @brief 发送 {"result":"ok"}。
+ * @param req
+ * @return
+ */
+static esp_err_t app_web_send_ok(httpd_req_t* req) {
+    cJSON* obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "result", "ok");
+    return app_web_send_json(req, obj);
+}
+
+/**
+ * @brief 读取 JSON 中的字符串。
+ * @param obj
+ * @param name
+ * @return 不是字符串返回 NULL。
+ */
+static const char* app_web_json_str(const cJSON* obj, const char* name) {
+    const cJSON* item = cJSON_GetObjectItemCaseSensitive(obj, name);
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+/**
+ * @brief 请求是否已登录：Cookie 中的令牌有效，有效时重新计时。
+ * @param req
+ * @return
+ */
+static bool app_web_authorized(httpd_req_t* req) {
+    char token[sizeof(app_web_sessions[0].token)];
+    size_t len = sizeof(token);
+    if (httpd_req_get_cookie_val(req, "sid", token, &len) != ESP_OK || strlen(token) != sizeof(token) - 1) {
+        return false;
+    }
+    int64_t now_us = esp_timer_get_time();
+    for (int i = 0; i < APP_WEB_SESSION_MAX; i++) {
+        app_web_session_t* session = &app_web_sessions[i];
+        if (session->token[0] != '\0' && session->expire_us > now_us && strcmp(session->token, token) == 0) {
+            session->expire_us = now_us + (int64_t)APP_WEB_SESSION_S * 1000000;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 未登录，返回 401，页面跳转到 login.html。
+ * @param req
+ * @return
+ */
+static esp_err_t app_web_send_unauthorized(httpd_req_t* req) {
+    return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "login required");
+}
+
+/**
+ * @brief 解析 MAC 地址字符串。
+ * @param str
+ * @param mac
+ * @return
+ */
+static bool app_web_parse_mac(const char* str, uint8_t* mac) {
+    unsigned int m[6];
+    if (str == NULL || sscanf(str, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        mac[i] = (uint8_t)m[i];
+    }
+    return true;
+}
+
+/**
+ * @brief 查找热点设备，调用前必须持有互斥锁。
+ * @param mac
+ * @return 没有返回 NULL。
+ */
+static app_web_sta_t* app_web_sta_find_locked(const uint8_t* mac) {
+    for (int i = 0; i < APP_WEB_STA_MAX; i++) {
+        if (app_web_stas[i].online_us != 0 && memcmp(app_web_stas[i].mac, mac, 6) == 0) {
+            return &app_web_stas[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 热点设备连接，记录连接时间。已有的设备保留名称，没有空位置时替换最早连接的设备。
+ */
+static void app_web_wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
+    if (event_id == WIFI_EVENT_AP_STACONNECTED) {
+        wifi_event_ap_staconnected_t* event = (wifi_event_ap_staconnected_t*)event_data;
+        ESP_LOGI(TAG, "------ 热点设备连接：" MACSTR "，AID：%d。", MAC2STR(event->mac), event->aid);
+        pthread_mutex_lock(&app_web_mutex);
+        app_web_sta_t* sta = app_web_sta_find_locked(event->mac);
+        if (sta == NULL) {
+            sta = &app_web_stas[0];
+            for (int i = 1; i < APP_WEB_STA_MAX; i++) {
+                if (app_web_stas[i].online_us < sta->online_us) {
+                    sta = &app_web_stas[i];
+                }
+            }
+            memcpy(sta->mac, event->mac, 6);
+            sta->name[0] = '\0';
+        }
+        sta->online_us = esp_timer_get_time();
+        pthread_mutex_unlock(&app_web_mutex);
+    } else if (event_id == WIFI_EVENT_AP_STADISCONNECTED) {
+        wifi_event_ap_stadisconnected_t* event = (wifi_event_ap_stadisconnected_t*)event_data;
+        ESP_LOGI(TAG, "------ 热点设备断开：" MACSTR "。", MAC2STR(event->mac));
+    }
+}
+
+/**
+ * @brief 热点已连接的设备，GET /system/station_state，需要登录，返回其他设备的 MAC 和 IP 地址。
+ * @param req
+ * @return
+ */
+static esp_err_t app_web_station_get(httpd_req_t* req) {
+    if (!app_web_authorized(req)) {
+        return app_web_send_unauthorized(req);
+    }
+    wifi_sta_list_t sta_list = {0};
+    esp_netif_sta_list_t ip_list = {0};
+    if (esp_wifi_ap_get_sta_list(&sta_list) == ESP_OK) {
+        esp_netif_get_sta_list(&sta_list, &ip_list);
+    }
+    cJSON* obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(obj, "now_time", (double)esp_timer_get_time());
+    cJSON* list = cJSON_AddArrayToObject(obj, "station_list");
+    pthread_mutex_lock(&app_web_mutex);
+    for (int i = 0; i < ip_list.num; i++) {
+        char mac[18];
+        char ip[16];
+        snprintf(mac, sizeof(mac), MACSTR, MAC2STR(ip_list.sta[i].mac));
+        snprintf(ip, sizeof(ip), IPSTR, IP2STR(&ip_list.sta[i].ip));
+        const app_web_sta_t* sta = app_web_sta_find_locked(ip_list.sta[i].mac);
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name_str", sta != NULL && sta->name[0] != '\0' ? sta->name : mac);
+        cJSON_AddStringToObject(item, "mac_str", mac);
+        cJSON_AddStringToObject(item, "ip_str", ip);
+        cJSON_AddNumberToObject(item, "online_time_s", sta != NULL ? (double)sta->online_us : 0);// 微秒，页面用 now_time 计算连接时长。
+        cJSON_AddItemToArray(list, item);
+    }
+    pthread_mutex_unlock(&app_web_mutex);
+    return app_web_send_json(req, obj);
+}
+
+/**
+ * @brief 修改设备名称，POST /system/station_state/change_name。
+ * @param req
+ * @return
+ */
+static esp_err_t app_web_station_name_post(httpd_req_t* req) {
+    if (!app_web_authorized(req)) {
+        return app_web_send_unauthorized(req);
+    }
+    cJSON* body = app_web_recv_json(req);
+    const char* name = app_web_json_str(body, "name_str");
+    uint8_t mac[6];
+    bool found = false;
+    if (name != NULL && app_web_parse_mac(app_web_json_str(body, "mac_str"), mac)) {
+        pthread_mutex_lock(&app_web_mutex);
+        app_web_sta_t* sta = app_web_sta_find_locked(mac);
+        if (sta != NULL) {
+            strlcpy(sta->name, name, sizeof(sta->name));
+            found = true;
+        }
+        pthread_mutex_unlock(&app_web_mutex);
+    }
+    cJSON_Delete(body);
+    if (!found) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown station");
+    }
+    return app_web_send_ok(req);
+}
+
+/**
+ * @brief 断开设备，POST /system/station_state/delete_device。
+ * @param req
+ * @return
+ */
+static esp_err_t app_web_station_delete_post(httpd_req_t* req) {
+    if (!app_web_authorized(req)) {
+        return app_web_send_unauthorized(req);
+    }
+    cJSON* body = app_web_recv_json(req);
+    uint8_t mac[6];
+    uint16_t aid = 0;
+    bool ok = app_web_parse_mac(app_web_json_str(body, "mac_str"), mac) && esp_wifi_ap_get_sta_aid(mac, &aid) == ESP_OK;
+    cJSON_Delete(body);
+    if (!ok) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown station");
+    }
+    ESP_LOGI(TAG, "------ 网页断开热点设备：" MACSTR "。", MAC2STR(mac));
+    esp_wifi_deauth_sta(aid);
+    return app_web_send_ok(req);
+}
+
+/**
+ * @brief 热点基本配置，GET /wlan_general。不返回密码。
+ * @param req
+ * @return
+ */
+static esp_err_t app_web_wlan_general_get(httpd_req_t* req) {
+    wifi_config_t wifi_config = {0};
+    esp_wifi_get_config(WIFI_IF_AP, &wifi_config);
+    char ssid[sizeof(wifi_config.ap.ssid) + 1] = {0};
+    memcpy(ssid, wifi_config.ap.ssid, wifi_config.ap.ssid_len > 0 && wifi_config.ap.ssid_len < sizeof(ssid) ? wifi_config.ap.ssid_len : sizeof(wifi_config.ap.ssid));
+    const char* auth_mode = "WPA2_PSK";
+    for (int i = 0; i < sizeof(app_web_auth_modes) / sizeof(app_web_auth_modes[0]); i++) {
+        if (app_web_auth_modes[i].mode == wifi_config.ap.authmode) {
+            auth_mode = app_web_auth_modes[i].name;
+        }
+    }
+    cJSON* obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "ssid", ssid);
+    cJSON_AddStringToObject(obj, "password", "");// 不返回密码，修改时留空表示不变。
+    cJSON_AddStringToObject(obj, "auth_mode", auth_mode);
+    cJSON_AddStringToObject(obj, "if_hide_ssid", wifi_config.ap.ssid_hidden ? "true" : "false");
+    return app_web_send_json(req, obj);
+}
+
+/**
+ * @brief 修改热点基本配置，POST /wlan_general，需要登录。
+ *        密码留空时保留原密码。先发送响应再修改配置，修改后热点重启，已连接的设备断开。
+ * @param req
+ * @return
+ */
+static esp_err_t app_web_wlan_general_post(httpd_req_t* req) {
+    if (!app_web_authorized(req)) {
+        return app_web_send_unauthorized(req);
+    }
+    cJSON* body = app_web_recv_json(req);
+    const char* ssid = app_web_json_str(body, "ssid");
+    const char* password = app_web_json_str(body, "password");
+    const char* auth_mode = app_web_json_str(body, "auth_mode");
+    const char* hide = app_web_json_str(body, "if_hide_ssid");
+
+    wifi_config_t wifi_config = {0};
+    esp_wifi_get_config(WIFI_IF_AP, &wifi_config);
+    int mode = -1;
+    for (int i = 0; auth_mode != NULL && i < sizeof(app_web_auth_modes) / sizeof(app_web_auth_modes[0]); i++) {
+        if (strcmp(app_web_auth_modes[i].name, auth_mode) == 0) {
+            mode = app_web_auth_modes[i].mode;
+        }
+    }
+    bool keep_password = (password == NULL || password[0] == '\0') && wifi_config.ap.password[0] != '\0';
+    if (keep_password) {
+        password = (const char*)wifi_config.ap.password;
+    }
+    const char* err = NULL;
+    if (ssid == NULL || strlen(ssid) == 0 || strlen(ssid) > sizeof(wifi_config.ap.ssid)) {
+        err = "invalid ssid";
+    } else if (mode < 0) {
+        err = "unsupported auth_mode";
+    } else if (mode != WIFI_AUTH_OPEN && (password == NULL || strlen(password) < 8 || strlen(password) >= sizeof(wifi_config.ap.password))) {
+        err = "password must be 8 to 63 characters";
+    }
+    if (err != NULL) {
+        cJSON_Delete(body);
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, err);
+    }
+
+    memset(wifi_config.ap.ssid, 0, sizeof(wifi_config.ap.ssid));
+    memcpy(wifi_config.ap.ssid, ssid, strlen(ssid));
+    wifi_config.ap.ssid_len = strlen(ssid);
+    if (!keep_password || mode == WIFI_AUTH_OPEN) {
+        memset(wifi_config.ap.password, 0, sizeof(wifi_config.ap.password));
+    }
+    if (!keep_password && mode != WIFI_AUTH_OPEN) {
+        strlcpy((char*)wifi_config.ap.password, password, sizeof(wifi_config.ap.password));
+    }
+    wifi_config.ap.authmode = mode;
+    wifi_config.ap.ssid_hidden = hide != NULL && strcmp(hide, "true") == 0;
+    cJSON_Delete(body);
+
+    esp_err_t ret = app_web_send_ok(req);
+    ESP_LOGI(TAG, "------ 网页修改热点配置：%s。", (char*)wifi_config.ap.ssid);
+    esp_wifi_set_config(WIFI_IF_AP, &wifi_config);// 保存到 WIFI 的 NVS，重启后使用。
+    return ret;
+}
+
+/**
+ * @brief 登录，POST /login：{"password"}，密码是设备密码（见 app_wifi_device_key()）。
+ *        成功时设置 Cookie：sid，连续失败 APP_WEB_LOGIN_FAIL_MAX 次后锁定 APP_WEB_LOGIN_LOCK_S 秒。
+ * @param req
+ * @return
+ */
+static esp_err_t app_web_login_post(httpd_req_t* req) {
+    int64_t now_us = esp_timer_get_time();
+    if (now_us < app_web_login_lock_us) {
+        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "too many attempts");
+    }
+    cJSON* body = app_web_recv_json(req);
+    const char* password = app_web_json_str(body, "password");
+    char key[APP_WIFI_DEVICE_KEY_LEN + 1];
+    app_wifi_device_key(key, sizeof(key));
+    uint8_t diff = password == NULL || strlen(password) != strlen(key);
+    for (int i = 0; diff == 0 && i < sizeof(key) - 1; i++) {
+        diff |= password[i] ^ key[i];
+    }
+    cJSON_Delete(body);
+    if (diff != 0) {
+        if (++app_web_login_fails >= APP_WEB_LOGIN_FAIL_MAX) {
+            app_web_login_fails = 0;
+            app_web_login_lock_us = now_us + (int64_t)APP_WEB_LOGIN_LOCK_S * 1000000;
+            ESP_LOGW(TAG, "------ 网页登录连续失败，锁定 %d 秒。", APP_WEB_LOGIN_LOCK_S);
+        }
+        return app_web_send_unauthorized(req);
+    }
+    app_web_login_fails = 0;
+
+    app_web_session_t* session = &app_web_sessions[0];
+    for (int i = 1; i < APP_WEB_SESSION_MAX; i++) {// 替换最早过期的，空位置过期时间为 0。
+        if (app_web_sessions[i].expire_us < session->expire_us) {
+            session = &app_web_sessions[i];
+        }
+    }
+    uint8_t random[16];
+    esp_fill_random(random, sizeof(random));
+    for (int i = 0; i < sizeof(random); i++) {
+        snprintf(session->token + i * 2, 3, "%02x", random[i]);
+    }
+    session->expire_us = now_us + (int64_t)APP_WEB_SESSION_S * 1000000;
+    char cookie[80];
+    snprintf(cookie, sizeof(cookie), "sid=%s; Path=/; HttpOnly; SameSite=Strict", session->token);
+    httpd_resp_set_hdr(req, "Set-Cookie", cookie);
+    ESP_LOGI(TAG, "------ 网页登录：成功。");
+    return app_web_send_ok(req);
+}
+
+/**
+ * @brief 热点高级配置，GET /wlan_advance。
+ * @param req
+ * @return
+ */
+static esp_err_t app_web_wlan_advance_get(httpd_req_t* req) {
+    wifi_config_t wifi_config = {0};
+    esp_wifi_get_config(WIFI_IF_AP, &wifi_config);
+    wifi_bandwidth_t bandwidth = WIFI_BW_HT20;
+    esp_wifi_get_bandwidth(WIFI_IF_AP, &bandwidth);
+    char channel[4];
+    snprintf(channel, sizeof(channel), "%u", wifi_config.ap.channel);
+    cJSON* obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "bandwidth", bandwidth == WIFI_BW_HT40 ? "40" : "20");
+    cJSON_AddStringToObject(obj, "channel", channel);
+    return app_web_send_json(req, obj);
+}
+
+/**
+ * @brief 修改热点高级配置，POST /wlan_advance。STA 已连接时热点使用 STA 的信道，修改的信道在 STA 断开后生效。
+ * @param req
+ * @return
+ */
+static esp_err_t app_web_wlan_advance_post(httpd_req_t* req) {
+    if (!app_web_authorized(req)) {
+        return app_web_send_unauthorized(req);
+    }
+    cJSON* body = app_web_recv_json(req);
+    const char* bandwidth = app_web_json_str(body, "bandwidth");
+    const char* channel = app_web_json_str(body, "channel");
+    int ch = channel != NULL ? atoi(channel) : 0;
+    bool ok = bandwidth != NULL && (strcmp(bandwidth, "20") == 0 || strcmp(bandwidth, "40") == 0) && ch >= 1 && ch <= 13;
+    wifi_bandwidth_t bw = bandwidth != NULL && strcmp(bandwidth, "40") == 0 ? WIFI_BW_HT40 : WIFI_BW_HT20;
+    cJSON_Delete(body);
+    if (!ok) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "invalid bandwidth or channel");
+    }
+
+    esp_err_t ret = app_web_send_ok(req);
+    ESP_LOGI(TAG, "------ 网页修改热点带宽：%sMHz，信道：%d。", bw == WIFI_BW_HT40 ? "40" : "20", ch);
+    wifi_config_t wifi_config = {0};
+    esp_wifi_get_config(WIFI_IF_AP, &wifi_config);
+    wifi_config.ap.channel = ch;
+    esp_wifi_set_bandwidth(WIFI_IF_AP, bw);
+    esp_wifi_set_config(WIFI_IF_AP, &wifi_config);
+    return ret;
+}
+
+/**
+ * @brief HTTP 服务器关闭连接，释放 WebSocket 客户端位置。
+ * @param server
+ * @param sockfd
+ */
+static void app_web_close_fn(httpd_handle_t server, int sockfd) {
+    app_live_on_close(sockfd);
+    close(sockfd);
+}
+
+/**
+ * @brief 接口，按顺序匹配，静态文件的通配符放在最后。
+ */
+static const httpd_uri_t app_web_uris[] = {
+    {.uri = "/system/station_state", .method = HTTP_GET, .handler = app_web_station_get},
+    {.uri = "/system/station_state/change_name", .method = HTTP_POST, .handler = app_web_station_name_post},
+    {.uri = "/system/station_state/delete_device", .method = HTTP_POST, .handler = app_web_station_delete_post},
+    {.uri = "/wlan_general", .method = HTTP_GET, .handler = app_web_wlan_general_get},
+    {.uri = "/wlan_general", .method = HTTP_POST, .handler = app_web_wlan_general_post},
+    {.uri = "/login", .method = HTTP_POST, .handler = app_web_login_post},
+    {.uri = "/wlan_advance", .method = HTTP_GET, .handler = app_web_wlan_advance_get},
+    {.uri = "/wlan_advance", .method = HTTP_POST, .handler = app_web_wlan_advance_post},
+    {.uri = "/*", .method = HTTP_GET, .handler = app_web_file_handler},
+};
+
+/**
+ * @brief 初始化函数。
+ * @return
+ */
+esp_err_t app_web_init(void) {
+    esp_vfs_spiffs_conf_t spiffs_conf = {
+        .base_path = APP_WEB_BASE_PATH,
+        .partition_label = APP_WEB_PARTITION,
+        .max_files = 4,
+        .format_if_mount_failed = false,// 分区内容由构建生成，不格式化。
+    };
+    esp_err_t ret = esp_vfs_spiffs_register(&spiffs_conf);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "------ 挂载 SPIFFS 失败：%s", esp_err_to_name(ret));
+        return ret;
+    }
+    app_web_files_load();
+
+    ret = esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_AP_STACONNECTED, app_web_wifi_event_handler, NULL, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_AP_STADISCONNECTED, app_web_wifi_event_handler, NULL, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    httpd_handle_t server = NULL;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.max_uri_handlers = sizeof(app_web_uris) / sizeof(app_web_uris[0]) + 2;
+    config.max_open_sockets = APP_LIVE_CLIENT_MAX + 4;// WebSocket 客户端加网页，不超过 CONFIG_LWIP_MAX_SOCKETS - 3。
+    config.stack_size = 6144;// cJSON 和请求体缓冲区。
+    config.send_wait_timeout = 1;// 单位是秒，最小值。实时数据发送前先等待可写（见 APP_LIVE_SEND_TIMEOUT_MS），这里只是兜底。
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    config.lru_purge_enable = true;// 连接数满时关闭最久未使用的连接，浏览器会保持多个空闲连接。
+    config.close_fn = app_web_close_fn;
+    ret = httpd_start(&server, &config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "------ 启动 HTTP 服务器失败：%s", esp_err_to_name(ret));
+        return ret;
+    }
+    ret = app_live_register(server);// 在通配符之前注册。
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    for (int i = 0; i < sizeof(app_web_uris) / sizeof(app_web_uris[0]); i++) {
+        httpd_register_uri_handler(server, &app_web_uris[i]);
+    }
+    return ESP_OK;
+}
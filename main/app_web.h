@@ -0,0 +1,28 @@
+/**
+ * @brief   本地网页服务器，通过设备热点访问（见 APP_WIFI_AP_ENABLE）。
+ *
+ *          静态文件保存在 SPIFFS（storage 分区），构建时由 tools/spiffs_gzip.py 压缩为 .gz，发送时加 Content-Encoding: gzip。
+ *          ETag 使用构建时计算的内容哈希（/.etags），If-None-Match 匹配返回 304；html 每次验证，其他文件缓存 APP_WEB_MAX_AGE_S 秒。
+ *          文件分块读取和发送，不把整个文件读入内存。
+ *
+ *          接口（spiffs/js 中使用），POST 接口和 GET /system/station_state 需要先登录，未登录返回 401，页面跳转到 login.html：
+ *          POST /login                                     登录：{"password"}，设备密码（见 app_wifi_device_key()，印在标签上），成功时设置 Cookie。
+ *          GET  /system/station_state                      热点已连接的设备：{"now_time":微秒,"station_list":[{"name_str","mac_str","ip_str","online_time_s"}]}
+ *          POST /system/station_state/change_name          修改设备名称：{"mac_str","name_str"}，只保存在内存中。
+ *          POST /system/station_state/delete_device        断开设备：{"mac_str"}
+ *          GET  /wlan_general，POST /wlan_general         热点基本配置：{"ssid","password","auth_mode","if_hide_ssid"}，GET 不返回密码，POST 密码留空不修改。
+ *          GET  /wlan_advance，POST /wlan_advance          热点高级配置：{"bandwidth","channel"}
+ *          GET  /live                                      WebSocket 实时数据，见 app_live.h。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include "esp_err.h"
+
+/**
+ * @brief 初始化函数，WIFI 初始化之后调用，挂载 SPIFFS，启动 HTTP 服务器。
+ * @return
+ */
+esp_err_t app_web_init(void);
@@ -4,7 +4,9 @@
  * @author  nyx
  * @date    2024-08-18
  */
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
@@ -13,9 +15,15 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "nvs.h"
 #include "lwip/err.h"
 #include "lwip/sys.h"
+#include "bootloader_random.h"
 
+#include "app_wifi.h"
+#include "app_metrics.h"
 #include "app_config.h"
 
 #define WIFI_CONNECTED_BIT  BIT0
@@ -36,32 +44,585 @@ static const char* TAG = "app_wifi";
 */
 static int app_wifi_retry_count = 0;
 
+/**
+* @brief 断开连接的时间，0 表示已连接或者启动后还没有连接过。
+*/
+static int64_t app_wifi_disconnected_us = 0;
+
+/**
+* @brief 重连定时器，在定时器任务中扫描或者连接，不阻塞默认事件循环。
+*/
+static esp_timer_handle_t app_wifi_retry_timer = NULL;
+
+/**
+* @brief 信号检查定时器，已连接时定期读取 RSSI，信号弱时扫描，寻找更好的 AP。
+*/
+static esp_timer_handle_t app_wifi_roam_timer = NULL;
+
+/**
+* @brief NVS 命名空间和键。
+*/
+#define APP_WIFI_NVS_NAMESPACE  "app_wifi"
+#define APP_WIFI_NVS_KEY        "fast"
+#define APP_WIFI_NVS_NETS_KEY   "nets"
+#define APP_WIFI_NVS_DEV_KEY    "dev_key"
+
+/**
+* @brief 已知网络列表，NVS 中没有时使用 APP_WIFI_SSID。
+*/
+static app_wifi_net_t app_wifi_nets[APP_WIFI_NET_COUNT];
+static int app_wifi_net_count = 0;
+
+/**
+* @brief 互斥锁，保护已知网络列表和连接质量统计。
+*/
+static pthread_mutex_t app_wifi_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+* @brief 快速连接缓存：最近一次连接成功的 AP，保存到 NVS，下次启动直接连接，不扫描。
+*/
+typedef struct {
+    char ssid[33];              // 网络名称，必须在已知网络列表中。
+    uint8_t bssid[6];           // AP 的 MAC 地址。
+    uint8_t channel;            // 信道。
+} app_wifi_fast_t;
+
+static app_wifi_fast_t app_wifi_fast;
+
+/**
+* @brief true = 使用缓存的 AP 连接，失败后改为扫描选择。
+*/
+static bool app_wifi_fast_mode = false;
+
+/**
+* @brief 当前连接的 AP 和连接质量，断开或者切换时输出。
+*/
+typedef struct {
+    char ssid[33];
+    uint8_t bssid[6];
+    int64_t connected_us;       // 获取 IP 的时间，0 = 未连接。
+    int32_t rssi_sum;
+    int8_t rssi_min;
+    uint32_t rssi_count;
+} app_wifi_quality_t;
+
+static app_wifi_quality_t app_wifi_quality;
+
+/**
+* @brief 漫游：true = 本次扫描是信号弱时的扫描；切换 AP 时主动断开，断开后立即连接新的 AP。
+*/
+static bool app_wifi_roam_scan = false;
+static bool app_wifi_roam_pending = false;
+static int64_t app_wifi_roam_us = 0;
+
+/**
+* @brief WIFI 网络接口，静态 IP 时使用。
+*/
+static esp_netif_t* app_wifi_netif = NULL;
+
+/**
+* @brief 启动 WIFI 的时间，第一次获取 IP 时输出耗时，之后为 0。
+*/
+static int64_t app_wifi_start_us = 0;
+
+/**
+* @brief 查找已知网络。
+* @return 没有返回 NULL。调用前必须持有互斥锁。
+*/
+static const app_wifi_net_t* app_wifi_find_net_locked(const char* ssid) {
+    for (int i = 0; i < app_wifi_net_count; i++) {
+        if (strcmp(app_wifi_nets[i].ssid, ssid) == 0) {
+            return &app_wifi_nets[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+* @brief WIFI 配置，只连接指定的 AP 和信道。
+* @return 不是已知网络返回 ESP_ERR_NOT_FOUND。
+*/
+static esp_err_t app_wifi_set_config(const char* ssid, const uint8_t* bssid, uint8_t channel) {
+    wifi_config_t wifi_config = {
+        .sta = {
+            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+            .bssid_set = true,
+            .channel = channel,
+        },
+    };
+    pthread_mutex_lock(&app_wifi_mutex);
+    const app_wifi_net_t* net = app_wifi_find_net_locked(ssid);
+    if (net != NULL) {
+        strlcpy((char*)wifi_config.sta.ssid, net->ssid, sizeof(wifi_config.sta.ssid));
+        strlcpy((char*)wifi_config.sta.password, net->password, sizeof(wifi_config.sta.password));
+    }
+    pthread_mutex_unlock(&app_wifi_mutex);
+    if (net == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    memcpy(wifi_config.sta.bssid, bssid, sizeof(wifi_config.sta.bssid));
+    return esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+}
+
+/**
+* @brief 读取已知网络列表。
+*/
+static void app_wifi_nets_load(void) {
+    nvs_handle_t handle;
+    size_t size = sizeof(app_wifi_nets);
+    app_wifi_net_count = 0;
+    if (nvs_open(APP_WIFI_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        if (nvs_get_blob(handle, APP_WIFI_NVS_NETS_KEY, app_wifi_nets, &size) == ESP_OK && size % sizeof(app_wifi_net_t) == 0) {
+            app_wifi_net_count = size / sizeof(app_wifi_net_t);
+        }
+        nvs_close(handle);
+    }
+    if (app_wifi_net_count == 0) {
+        strlcpy(app_wifi_nets[0].ssid, APP_WIFI_SSID, sizeof(app_wifi_nets[0].ssid));
+        strlcpy(app_wifi_nets[0].password, APP_WIFI_PASSWORD, sizeof(app_wifi_nets[0].password));
+        app_wifi_nets[0].priority = 0;
+        app_wifi_net_count = 1;
+    }
+    ESP_LOGI(TAG, "------ WIFI 已知网络：%d 个。", app_wifi_net_count);
+}
+
+/**
+* @brief 读取快速连接缓存。
+* @return true = 有缓存，并且网络仍在已知网络列表中。
+*/
+static bool app_wifi_fast_load(void) {
+    nvs_handle_t handle;
+    if (nvs_open(APP_WIFI_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    size_t size = sizeof(app_wifi_fast);
+    esp_err_t ret = nvs_get_blob(handle, APP_WIFI_NVS_KEY, &app_wifi_fast, &size);
+    nvs_close(handle);
+    if (ret != ESP_OK || size != sizeof(app_wifi_fast) || app_wifi_fast.channel == 0) {
+        memset(&app_wifi_fast, 0, sizeof(app_wifi_fast));
+        return false;
+    }
+    return true;
+}
+
+/**
+* @brief 保存快速连接缓存，AP 没有变化时不写入。
+*/
+static void app_wifi_fast_save(const wifi_ap_record_t* ap) {
+    if (strcmp(app_wifi_fast.ssid, (const char*)ap->ssid) == 0 &&
+        memcmp(app_wifi_fast.bssid, ap->bssid, sizeof(ap->bssid)) == 0 && app_wifi_fast.channel == ap->primary) {
+        return;
+    }
+    strlcpy(app_wifi_fast.ssid, (const char*)ap->ssid, sizeof(app_wifi_fast.ssid));
+    memcpy(app_wifi_fast.bssid, ap->bssid, sizeof(ap->bssid));
+    app_wifi_fast.channel = ap->primary;
+    nvs_handle_t handle;
+    if (nvs_open(APP_WIFI_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(handle, APP_WIFI_NVS_KEY, &app_wifi_fast, sizeof(app_wifi_fast)) == ESP_OK) {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+    ESP_LOGI(TAG, "------ WIFI 快速连接缓存：%s，" MACSTR "，信道：%d", app_wifi_fast.ssid, MAC2STR(ap->bssid), ap->primary);
+}
+
+/**
+* @brief 配置静态 IP，APP_WIFI_STATIC_IP 为空时使用 DHCP。
+*/
+static void app_wifi_set_static_ip(void) {
+    if (strlen(APP_WIFI_STATIC_IP) == 0) {
+        return;
+    }
+    esp_netif_ip_info_t ip_info = {
+        .ip.addr = esp_ip4addr_aton(APP_WIFI_STATIC_IP),
+        .netmask.addr = esp_ip4addr_aton(APP_WIFI_STATIC_NETMASK),
+        .gw.addr = esp_ip4addr_aton(APP_WIFI_STATIC_GW),
+    };
+    esp_netif_dns_info_t dns_info = {
+        .ip.u_addr.ip4.addr = esp_ip4addr_aton(APP_WIFI_STATIC_DNS),
+        .ip.type = ESP_IPADDR_TYPE_V4,
+    };
+    esp_netif_dhcpc_stop(app_wifi_netif);
+    if (esp_netif_set_ip_info(app_wifi_netif, &ip_info) != ESP_OK) {// 设置成功后产生 IP_EVENT_STA_GOT_IP。
+        ESP_LOGE(TAG, "------ WIFI 设置静态 IP 失败！");
+    }
+    esp_netif_set_dns_info(app_wifi_netif, ESP_NETIF_DNS_MAIN, &dns_info);
+}
+
+/**
+* @brief 输出当前 AP 的连接质量，清零。
+* @param reason
+*/
+static void app_wifi_log_quality(const char* reason) {
+    pthread_mutex_lock(&app_wifi_mutex);
+    app_wifi_quality_t quality = app_wifi_quality;
+    memset(&app_wifi_quality, 0, sizeof(app_wifi_quality));
+    pthread_mutex_unlock(&app_wifi_mutex);
+    if (quality.connected_us == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "------ WIFI 连接质量（%s）：%s，" MACSTR "，连接 %lld 秒，RSSI 平均 %ld，最小 %d，采样 %lu 次。",
+        reason, quality.ssid, MAC2STR(quality.bssid), (esp_timer_get_time() - quality.connected_us) / 1000000,
+        quality.rssi_count > 0 ? quality.rssi_sum / (int32_t)quality.rssi_count : 0, quality.rssi_min, quality.rssi_count);
+}
+
+/**
+* @brief 扫描所有信道，扫描完成后在 WIFI_EVENT_SCAN_DONE 中选择 AP。
+* @param roam true = 已连接，信号弱时寻找更好的 AP。
+*/
+static void app_wifi_start_scan(bool roam) {
+    app_wifi_roam_scan = roam;
+    esp_err_t ret = esp_wifi_scan_start(NULL, false);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "------ WIFI 扫描失败！%s", esp_err_to_name(ret));
+    }
+}
+
+/**
+* @brief 下次重连的等待毫秒数：指数退避，最大 APP_WIFI_RETRY_MAX_MS，在后一半范围内随机，避免多个设备同时重连。
+*/
+static uint32_t app_wifi_retry_delay_ms(int retry_count) {
+    uint32_t delay_ms = APP_WIFI_RETRY_MAX_MS;
+    if (retry_count < 16 && ((uint32_t)APP_WIFI_RETRY_MIN_MS << retry_count) < APP_WIFI_RETRY_MAX_MS) {
+        delay_ms = APP_WIFI_RETRY_MIN_MS << retry_count;
+    }
+    return delay_ms / 2 + esp_random() % (delay_ms / 2 + 1);
+}
+
+/**
+* @brief 按退避时间安排下一次重连。
+*/
+static void app_wifi_schedule_retry(void) {
+    uint32_t delay_ms = app_wifi_retry_delay_ms(app_wifi_retry_count);
+    app_wifi_retry_count++;
+    if (esp_timer_is_active(app_wifi_retry_timer)) {// 已经在等待重连。
+        return;
+    }
+    ESP_LOGI(TAG, "------ WIFI 等待 %lu 毫秒后重试。重试次数：%d", delay_ms, app_wifi_retry_count);
+    esp_timer_start_once(app_wifi_retry_timer, (uint64_t)delay_ms * 1000);
+}
+
+/**
+* @brief 重连定时器回调：有快速连接缓存时直接连接，否则扫描选择 AP。
+*/
+static void app_wifi_retry_cb(void* arg) {
+    app_metrics_count(APP_METRICS_WIFI_RETRIES);
+    if (app_wifi_fast_mode) {
+        esp_wifi_connect();
+    } else {
+        app_wifi_start_scan(false);
+    }
+}
+
+/**
+* @brief 信号检查定时器回调：累计 RSSI，低于 APP_WIFI_ROAM_RSSI 时扫描，两次漫游之间至少间隔 APP_WIFI_ROAM_INTERVAL_MS。
+*/
+static void app_wifi_roam_cb(void* arg) {
+    wifi_ap_record_t ap;
+    if ((xEventGroupGetBits(app_wifi_event_group) & WIFI_CONNECTED_BIT) == 0 || esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+    pthread_mutex_lock(&app_wifi_mutex);
+    app_wifi_quality.rssi_sum += ap.rssi;
+    app_wifi_quality.rssi_count++;
+    if (ap.rssi < app_wifi_quality.rssi_min) {
+        app_wifi_quality.rssi_min = ap.rssi;
+    }
+    pthread_mutex_unlock(&app_wifi_mutex);
+
+    int64_t now_us = esp_timer_get_time();
+    if (ap.rssi < APP_WIFI_ROAM_RSSI && now_us - app_wifi_roam_us >= (int64_t)APP_WIFI_ROAM_INTERVAL_MS * 1000) {
+        ESP_LOGI(TAG, "------ WIFI 信号弱：RSSI %d，扫描更好的 AP。", ap.rssi);
+        app_wifi_roam_us = now_us;
+        app_wifi_start_scan(true);
+    }
+}
+
+/**
+* @brief 从扫描结果中选择 AP：已知网络中 RSSI + 优先级 * APP_WIFI_PRIORITY_DB 最大的一个。
+*        漫游时，新的 AP 要比当前 AP 强 APP_WIFI_ROAM_HYSTERESIS_DB 才切换，避免来回切换。
+*/
+static void app_wifi_on_scan_done(void) {
+    uint16_t count = 0;
+    esp_wifi_scan_get_ap_num(&count);
+    if (count > APP_WIFI_SCAN_MAX) {
+        count = APP_WIFI_SCAN_MAX;
+    }
+    wifi_ap_record_t* records = calloc(count > 0 ? count : 1, sizeof(wifi_ap_record_t));
+    if (records == NULL || esp_wifi_scan_get_ap_records(&count, records) != ESP_OK) {
+        count = 0;
+    }
+
+    const wifi_ap_record_t* best = NULL;
+    int best_score = INT32_MIN;
+    pthread_mutex_lock(&app_wifi_mutex);
+    for (int i = 0; i < count; i++) {
+        const app_wifi_net_t* net = app_wifi_find_net_locked((const char*)records[i].ssid);
+        if (net == NULL) {
+            continue;
+        }
+        int score = records[i].rssi + net->priority * APP_WIFI_PRIORITY_DB;
+        if (score > best_score) {
+            best = &records[i];
+            best_score = score;
+        }
+    }
+    pthread_mutex_unlock(&app_wifi_mutex);
+
+    bool roam = app_wifi_roam_scan;
+    app_wifi_roam_scan = false;
+    wifi_ap_record_t current;
+    bool connected = (xEventGroupGetBits(app_wifi_event_group) & WIFI_CONNECTED_BIT) != 0 && esp_wifi_sta_get_ap_info(&current) == ESP_OK;
+    if (best == NULL) {
+        ESP_LOGW(TAG, "------ WIFI 扫描到 %d 个 AP，没有已知网络。", count);
+        if (!connected) {
+            app_wifi_schedule_retry();
+        }
+    } else if (connected) {
+        if (roam && memcmp(best->bssid, current.bssid, sizeof(current.bssid)) != 0 && best->rssi >= current.rssi + APP_WIFI_ROAM_HYSTERESIS_DB) {
+            ESP_LOGI(TAG, "------ WIFI 漫游：%s RSSI %d -> %s，" MACSTR " RSSI %d", current.ssid, current.rssi, best->ssid, MAC2STR(best->bssid), best->rssi);
+            app_wifi_log_quality("漫游");
+            if (app_wifi_set_config((const char*)best->ssid, best->bssid, best->primary) == ESP_OK) {
+                app_wifi_roam_pending = true;
+                app_metrics_count(APP_METRICS_WIFI_ROAMS);
+                esp_wifi_disconnect();// 断开后立即连接新的 AP。
+            }
+        }
+    } else {
+        ESP_LOGI(TAG, "------ WIFI 选择 AP：%s，" MACSTR "，信道：%d，RSSI：%d", best->ssid, MAC2STR(best->bssid), best->primary, best->rssi);
+        if (app_wifi_set_config((const char*)best->ssid, best->bssid, best->primary) == ESP_OK) {
+            esp_wifi_connect();
+        } else {
+            app_wifi_schedule_retry();
+        }
+    }
+    free(records);
+}
+
 /**
 * @brief WIFI 事件句柄。
 */
 static void app_wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
     if (event_base == WIFI_EVENT) {
         if (event_id == WIFI_EVENT_STA_START) {
-            ESP_LOGI(TAG, "------ 执行 WIFI 连接。");
-            esp_wifi_connect();
+            if (app_wifi_fast_mode) {
+                ESP_LOGI(TAG, "------ 执行 WIFI 快速连接：%s", app_wifi_fast.ssid);
+                esp_wifi_connect();
+            } else {
+                ESP_LOGI(TAG, "------ 执行 WIFI 扫描。");
+                app_wifi_start_scan(false);
+            }
+
+        } else if (event_id == WIFI_EVENT_SCAN_DONE) {
+            app_wifi_on_scan_done();
+
+        } else if (event_id == WIFI_EVENT_STA_CONNECTED) {
+            app_wifi_set_static_ip();
 
         } else if (event_id == WIFI_EVENT_STA_DISCONNECTED) {
-            app_wifi_retry_count++;
-            ESP_LOGI(TAG, "------ WIFI 连接已断开，等待 10 秒后重试。重试次数：%d", app_wifi_retry_count);
-            vTaskDelay(pdMS_TO_TICKS(10000));// 等待 10 秒，自动重连。
-            esp_wifi_connect();
+            xEventGroupClearBits(app_wifi_event_group, WIFI_CONNECTED_BIT);
+            if (app_wifi_roam_pending) {// 主动断开，立即连接新的 AP。
+                app_wifi_roam_pending = false;
+                esp_wifi_connect();
+                return;
+            }
+            app_wifi_log_quality("断开");
+            if (app_wifi_disconnected_us == 0) {
+                app_wifi_disconnected_us = esp_timer_get_time();
+            }
+            if (app_wifi_fast_mode) {// 缓存的 AP 连接失败，改为扫描选择，连接成功后更新缓存。
+                ESP_LOGW(TAG, "------ WIFI 快速连接失败，改为扫描。");
+                app_wifi_fast_mode = false;
+            }
+            ESP_LOGI(TAG, "------ WIFI 连接已断开。");
+            app_wifi_schedule_retry();
         }
 
     } else if (event_base == IP_EVENT) {
         if (event_id == IP_EVENT_STA_GOT_IP) {
             ip_event_got_ip_t* event = (ip_event_got_ip_t*)event_data;
-            ESP_LOGI(TAG, "------ WIFI 已连接。SSID：" APP_WIFI_SSID "，获取 IP：" IPSTR, IP2STR(&event->ip_info.ip));
+            wifi_ap_record_t ap = {0};
+            esp_wifi_sta_get_ap_info(&ap);
+            ESP_LOGI(TAG, "------ WIFI 已连接。SSID：%s，RSSI：%d，获取 IP：" IPSTR, ap.ssid, ap.rssi, IP2STR(&event->ip_info.ip));
+            if (app_wifi_disconnected_us != 0) {
+                int64_t now_us = esp_timer_get_time();
+                app_metrics_wifi_reconnect(app_wifi_disconnected_us, now_us);
+                ESP_LOGI(TAG, "------ WIFI 重连：%d 次，断开 %lld 毫秒。", app_wifi_retry_count, (now_us - app_wifi_disconnected_us) / 1000);
+            }
+            if (app_wifi_start_us != 0) {
+                ESP_LOGI(TAG, "------ WIFI 启动到获取 IP：%lld 毫秒，%s。", (esp_timer_get_time() - app_wifi_start_us) / 1000,
+                    app_wifi_fast_mode ? "快速连接" : "扫描选择");
+                app_wifi_start_us = 0;
+            }
+            app_wifi_fast_save(&ap);
+            app_wifi_fast_mode = false;// 之后断开时扫描选择。
+
+            pthread_mutex_lock(&app_wifi_mutex);
+            strlcpy(app_wifi_quality.ssid, (const char*)ap.ssid, sizeof(app_wifi_quality.ssid));
+            memcpy(app_wifi_quality.bssid, ap.bssid, sizeof(ap.bssid));
+            app_wifi_quality.connected_us = esp_timer_get_time();
+            app_wifi_quality.rssi_sum = 0;
+            app_wifi_quality.rssi_count = 0;
+            app_wifi_quality.rssi_min = 0;
+            pthread_mutex_unlock(&app_wifi_mutex);
+
+            app_wifi_disconnected_us = 0;
             app_wifi_retry_count = 0;
             xEventGroupSetBits(app_wifi_event_group, WIFI_CONNECTED_BIT);
         }
     }
 }
 
+/**
+ * @brief WIFI 是否已获取 IP。
+ * @return
+ */
+bool app_wifi_is_connected(void) {
+    return app_wifi_event_group != NULL && (xEventGroupGetBits(app_wifi_event_group) & WIFI_CONNECTED_BIT) != 0;
+}
+
+/**
+ * @brief 修改已知网络列表，保存到 NVS，下次扫描时生效。
+ * @param nets
+ * @param count 不超过 APP_WIFI_NET_COUNT，0 表示恢复为 APP_WIFI_SSID。
+ * @return
+ */
+esp_err_t app_wifi_set_networks(const app_wifi_net_t* nets, int count) {
+    if (count < 0 || count > APP_WIFI_NET_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(APP_WIFI_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = count > 0 ? nvs_set_blob(handle, APP_WIFI_NVS_NETS_KEY, nets, count * sizeof(app_wifi_net_t)) : nvs_erase_key(handle, APP_WIFI_NVS_NETS_KEY);
+    if (ret == ESP_OK || ret == ESP_ERR_NVS_NOT_FOUND) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    pthread_mutex_lock(&app_wifi_mutex);
+    app_wifi_nets_load();
+    pthread_mutex_unlock(&app_wifi_mutex);
+    return ESP_OK;
+}
+
+/**
+ * @brief 复制已知网络列表。
+ * @param nets 至少 APP_WIFI_NET_COUNT 个。
+ * @return 网络数。
+ */
+int app_wifi_get_networks(app_wifi_net_t* nets) {
+    pthread_mutex_lock(&app_wifi_mutex);
+    int count = app_wifi_net_count;
+    memcpy(nets, app_wifi_nets, count * sizeof(app_wifi_net_t));
+    pthread_mutex_unlock(&app_wifi_mutex);
+    return count;
+}
+
+/**
+ * @brief 设备密码，启动时从 NVS 读取，只在 app_wifi_device_key_init() 中写入。
+ */
+static char app_wifi_dev_key[APP_WIFI_DEVICE_KEY_LEN + 1];
+
+/**
+ * @brief 设备密码的字符，去掉了容易看错的 0、1、l、o，32 个字符，每个字符 5 位。
+ */
+static const char app_wifi_dev_key_chars[] = "23456789abcdefghijkmnpqrstuvwxyz";
+
+/**
+ * @brief 读取设备密码，第一次启动时生成并保存到 NVS。
+ *        密码是硬件随机数，不由 MAC 地址等公开信息计算。RF 启动之前随机数发生器没有熵源，
+ *        生成时用 bootloader_random_enable() 打开 SAR ADC 熵源，所以必须在蓝牙和 WIFI 启动之前调用。
+ *        新生成的密码只输出到串口（不经过日志，日志会写入 SD 卡并上传），产线读取后打印标签。
+ * @return
+ */
+esp_err_t app_wifi_device_key_init(void) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(APP_WIFI_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    size_t size = sizeof(app_wifi_dev_key);
+    ret = nvs_get_str(handle, APP_WIFI_NVS_DEV_KEY, app_wifi_dev_key, &size);
+    if (ret == ESP_OK && size == sizeof(app_wifi_dev_key)) {
+        nvs_close(handle);
+        return ESP_OK;
+    }
+
+    uint8_t random[APP_WIFI_DEVICE_KEY_LEN];
+    bootloader_random_enable();
+    esp_fill_random(random, sizeof(random));
+    bootloader_random_disable();
+    for (int i = 0; i < APP_WIFI_DEVICE_KEY_LEN; i++) {
+        app_wifi_dev_key[i] = app_wifi_dev_key_chars[random[i] & 0x1f];
+    }
+    app_wifi_dev_key[APP_WIFI_DEVICE_KEY_LEN] = '\0';
+    memset(random, 0, sizeof(random));
+    ret = nvs_set_str(handle, APP_WIFI_NVS_DEV_KEY, app_wifi_dev_key);
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (ret != ESP_OK) {// 密码只在内存中，重启后改变，热点和网页登录本次仍然可用。
+        ESP_LOGE(TAG, "------ 保存设备密码失败！%s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGW(TAG, "------ 第一次启动，已生成设备密码，从串口读取后打印标签。");
+    printf("DEVICE_KEY=%s\n", app_wifi_dev_key);
+    return ESP_OK;
+}
+
+/**
+ * @brief 设备密码，见 app_wifi_device_key_init()。
+ * @param buffer
+ * @param size 至少 APP_WIFI_DEVICE_KEY_LEN + 1。
+ */
+void app_wifi_device_key(char* buffer, size_t size) {
+    snprintf(buffer, size, "%s", app_wifi_dev_key);
+}
+
+#if APP_WIFI_AP_ENABLE
+ /**
+ * @brief 旧版本所有设备共用的热点默认密码，启动时替换为设备密码。
+ */
+#define APP_WIFI_AP_LEGACY_PASSWORD     "12345678"
+
+/**
+ * @brief 热点配置。WIFI 的 NVS 中已有配置（网页修改过）时使用已有配置，否则使用默认值。
+ * @param mac
+ * @return
+ */
+static esp_err_t app_wifi_ap_config(const uint8_t* mac) {
+    wifi_config_t wifi_config = {0};
+    if (esp_wifi_get_config(WIFI_IF_AP, &wifi_config) == ESP_OK && wifi_config.ap.ssid[0] != '\0' &&
+        strncmp((char*)wifi_config.ap.ssid, "ESP_", 4) != 0) {// ESP_ 开头是驱动的默认名称。
+        if (strcmp((char*)wifi_config.ap.password, APP_WIFI_AP_LEGACY_PASSWORD) != 0) {
+            ESP_LOGI(TAG, "------ WIFI 热点：%s。", (char*)wifi_config.ap.ssid);
+            return ESP_OK;
+        }
+        app_wifi_device_key((char*)wifi_config.ap.password, sizeof(wifi_config.ap.password));// 旧版本的固定默认密码，改为设备密码，保留其他配置。
+        wifi_config.ap.authmode = WIFI_AUTH_WPA2_PSK;
+        ESP_LOGW(TAG, "------ WIFI 热点：%s，旧的默认密码改为设备密码。", (char*)wifi_config.ap.ssid);
+        return esp_wifi_set_config(WIFI_IF_AP, &wifi_config);
+    }
+    memset(&wifi_config, 0, sizeof(wifi_config));
+    int len = snprintf((char*)wifi_config.ap.ssid, sizeof(wifi_config.ap.ssid), "%s%02X%02X%02X", APP_WIFI_AP_SSID_PREFIX, mac[3], mac[4], mac[5]);
+    wifi_config.ap.ssid_len = len;
+    app_wifi_device_key((char*)wifi_config.ap.password, sizeof(wifi_config.ap.password));// 每台设备不同，不使用固定的默认密码。
+    wifi_config.ap.channel = APP_WIFI_AP_CHANNEL;
+    wifi_config.ap.max_connection = APP_WIFI_AP_MAX_CONN;
+    wifi_config.ap.authmode = WIFI_AUTH_WPA2_PSK;
+    wifi_config.ap.pmf_cfg.required = false;
+    ESP_LOGI(TAG, "------ WIFI 热点使用默认配置：%s。", (char*)wifi_config.ap.ssid);
+    return esp_wifi_set_config(WIFI_IF_AP, &wifi_config);
+}
+#endif
+
 /**
  * @brief 初始化函数。
  * @param
@@ -75,7 +636,26 @@ esp_err_t app_wifi_init(char* dev_addr) {
         mac_addr_t[0], mac_addr_t[1], mac_addr_t[2], mac_addr_t[3], mac_addr_t[4], mac_addr_t[5]);
     ESP_LOGI(TAG, "------ 获取 MAC 地址：%s", dev_addr);
 
-    esp_netif_create_default_wifi_sta();
+    app_wifi_event_group = xEventGroupCreate();// 先于 WIFI 启动创建，事件句柄中使用。
+    const esp_timer_create_args_t retry_args = {
+        .callback = app_wifi_retry_cb,
+        .name = "app_wifi_retry",
+    };
+    const esp_timer_create_args_t roam_args = {
+        .callback = app_wifi_roam_cb,
+        .name = "app_wifi_roam",
+    };
+    if (app_wifi_event_group == NULL || esp_timer_create(&retry_args, &app_wifi_retry_timer) != ESP_OK ||
+        esp_timer_create(&roam_args, &app_wifi_roam_timer) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    pthread_mutex_lock(&app_wifi_mutex);
+    app_wifi_nets_load();
+    app_wifi_fast_mode = app_wifi_fast_load() && app_wifi_find_net_locked(app_wifi_fast.ssid) != NULL;
+    pthread_mutex_unlock(&app_wifi_mutex);
+
+    app_wifi_netif = esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     esp_err_t ret = esp_wifi_init(&cfg);
@@ -93,33 +673,40 @@ esp_err_t app_wifi_init(char* dev_addr) {
         return ret;
     }
 
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = APP_WIFI_SSID,
-            .password = APP_WIFI_PASSWORD,
-            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
-        },
-    };
-    ret = esp_wifi_set_mode(WIFI_MODE_STA);
+#if APP_WIFI_AP_ENABLE
+    esp_netif_create_default_wifi_ap();
+    ret = esp_wifi_set_mode(WIFI_MODE_APSTA);
     if (ret != ESP_OK) {
         return ret;
     }
-    ret = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    ret = app_wifi_ap_config(mac_addr_t);
+#else
+    ret = esp_wifi_set_mode(WIFI_MODE_STA);
+#endif
     if (ret != ESP_OK) {
         return ret;
     }
+    if (app_wifi_fast_mode) {// 有缓存时直接连接上次的 AP，不扫描。
+        ret = app_wifi_set_config(app_wifi_fast.ssid, app_wifi_fast.bssid, app_wifi_fast.channel);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    app_wifi_start_us = esp_timer_get_time();
     ret = esp_wifi_start();
     if (ret != ESP_OK) {
         return ret;
     }
+    esp_timer_start_periodic(app_wifi_roam_timer, (uint64_t)APP_WIFI_ROAM_CHECK_MS * 1000);
 
     ESP_LOGI(TAG, "------ WIFI 启动：完成。");
 
-    app_wifi_event_group = xEventGroupCreate();
-    EventBits_t bits = xEventGroupWaitBits(app_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
-    if (bits & WIFI_CONNECTED_BIT) {
-        return ESP_OK;
+    EventBits_t bits = xEventGroupWaitBits(app_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(APP_WIFI_BOOT_WAIT_MS));
+    if (bits & WIFI_FAIL_BIT) {
+        return ESP_FAIL;
     }
-
-    return ESP_FAIL;
+    if ((bits & WIFI_CONNECTED_BIT) == 0) {// 没有网络也继续启动，数据写入缓存，WIFI 在后台重连，MQTT 连接后补发。
+        ESP_LOGW(TAG, "------ WIFI 启动后 %d 毫秒未连接，继续启动，后台重连。", APP_WIFI_BOOT_WAIT_MS);
+    }
+    return ESP_OK;
 }
@@ -1,11 +1,70 @@
 /**
  * @brief   WIFI 初始化。
  *
+ *          已知网络列表保存在 NVS，扫描后按 RSSI 和优先级选择 AP；已连接时信号变弱，扫描并切换到更好的 AP。
+ *          最近一次连接成功的 AP 保存为快速连接缓存，启动时直接连接，不扫描。
+ *          APP_WIFI_AP_ENABLE = 1 时同时开启热点（APSTA），本地网页通过热点访问，见 app_web.h。
+ *
  * @author  nyx
  * @date    2024-08-15
  */
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+ /**
+  * @brief 已知网络最多个数。
+  */
+#define APP_WIFI_NET_COUNT          8
+
+/**
+ * @brief 已知网络。
+ */
+typedef struct {
+    char ssid[33];              // 网络名称。
+    char password[65];          // 密码。
+    uint8_t priority;           // 优先级，每级相当于 APP_WIFI_PRIORITY_DB 的信号强度。
+} app_wifi_net_t;
+
+/**
+ * @brief 读取设备密码，第一次启动时由硬件随机数生成，保存到 NVS，并输出到串口供产线打印标签（DEVICE_KEY=...）。
+ *        NVS 初始化之后、蓝牙和 WIFI 启动之前调用。NVS 分区被擦除后重新生成，需要重新打印标签。
+ * @return
+ */
+esp_err_t app_wifi_device_key_init(void);
+
+/**
+ * @brief 设备密码，每台设备不同，印在标签上。
+ *        热点的默认密码，也是本地网页的登录密码（热点密码修改后不变）。
+ * @param buffer
+ * @param size 至少 APP_WIFI_DEVICE_KEY_LEN + 1。
+ */
+void app_wifi_device_key(char* buffer, size_t size);
+
+/**
+ * @brief WIFI 是否已获取 IP。
+ * @return
+ */
+bool app_wifi_is_connected(void);
+
+/**
+ * @brief 修改已知网络列表，保存到 NVS，下次扫描时生效。
+ * @param nets
+ * @param count 不超过 APP_WIFI_NET_COUNT，0 表示恢复为 APP_WIFI_SSID。
+ * @return
+ */
+esp_err_t app_wifi_set_networks(const app_wifi_net_t* nets, int count);
+
+/**
+ * @brief 复制已知网络列表。
+ * @param nets 至少 APP_WIFI_NET_COUNT 个。
+ * @return 网络数。
+ */
+int app_wifi_get_networks(app_wifi_net_t* nets);
+
  /**
   * @brief 初始化函数。
   * @return
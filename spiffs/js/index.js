@@ -24,6 +24,9 @@ var Ajax = {
                 if(xhr.status === 200 || xhr.status === 304){
                     console.log(xhr.responseText);
                     callback(xhr.responseText);
+                } else if (xhr.status === 401) {
+                    // 未登录或者登录已过期
+                    window.location.href = 'login.html'
                 } else {
                     console.log(xhr.responseText);
                 }
@@ -56,6 +59,9 @@ var Ajax = {
             if (xhr.readyState === 4){
                 if (xhr.status === 200 || xhr.status === 304){
                     callback(xhr.responseText);
+                } else if (xhr.status === 401) {
+                    // 未登录或者登录已过期
+                    window.location.href = 'login.html'
                 }
             }
         }
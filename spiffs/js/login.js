@@ -17,6 +17,10 @@ var Ajax = {
             if (xhr.readyState === 4){
                 if (xhr.status === 200 || xhr.status === 304){
                     callback(xhr.responseText);
+                } else if (xhr.status === 401) {
+                    alert('密码错误')
+                } else if (xhr.status === 403) {
+                    alert('登录失败次数过多，请稍后再试')
                 }
             }
         }
@@ -25,20 +29,9 @@ var Ajax = {
 }
 
 function login() {
-    var wlanName = document.getElementById('wlanName')
-    console.log('wlan 名称：', wlanName.value)
-    var model = document.getElementById('model')
-    console.log('安全模式：', model.value)
     var password = document.getElementById('password')
-    console.log('密码：', password.value)
-    var select = document.getElementById('select')
-    console.log('wlan 隐身：', select.checked)
-    var isSelect = 'false'
-    if (select.checked) {
-        isSelect = 'true'
-    }
-    Ajax.post(CONSTANT.POST_LOGIN_URL, {ssid: wlanName.value, if_hide_ssid: isSelect, auth_mode: model.value, password: password.value}, function (res) {
-        console.log('基本信息保存：', res)
+    Ajax.post(CONSTANT.POST_LOGIN_URL, {password: password.value}, function (res) {
+        console.log('登录：', res)
+        window.location.href = 'index.html'
     })
 }
-
@@ -54,6 +54,9 @@ var Ajax = {
       if (xhr.readyState === 4){
         if (xhr.status === 200 || xhr.status === 304){
           callback(xhr.responseText);
+        } else if (xhr.status === 401) {
+          // 未登录或者登录已过期
+          window.location.href = 'login.html'
         }
       }
     }
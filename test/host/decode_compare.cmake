@@ -0,0 +1,9 @@
+# 运行解压程序，输出与原始文件比较。
+execute_process(COMMAND ${PYTHON} ${SCRIPT} ${INPUT} ${OUTPUT} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "解压失败：${INPUT}")
+endif()
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${EXPECTED} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "解压结果不一致：${OUTPUT} ${EXPECTED}")
+endif()
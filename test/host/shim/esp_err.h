@@ -0,0 +1,14 @@
+/**
+ * @brief   主机测试用的 ESP-IDF 替身：esp_err.h。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+typedef int esp_err_t;
+
+#define ESP_OK          0
+#define ESP_FAIL        -1
+
+const char* esp_err_to_name(esp_err_t code);
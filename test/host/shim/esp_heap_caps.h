@@ -0,0 +1,13 @@
+/**
+ * @brief   主机测试用的 ESP-IDF 替身：esp_heap_caps.h。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_DMA          (1 << 3)
+
+#define heap_caps_malloc(size, caps)    malloc(size)
@@ -0,0 +1,52 @@
+/**
+ * @brief   主机测试用的 ESP-IDF 替身：esp_http_client.h，只实现批量上传用到的函数。
+ *          底层是阻塞 socket，HTTP/1.1，Content-Length 已知，响应不支持分块编码。
+ *          连接保持打开，同一个客户端的多个请求复用一个连接。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef enum {
+    HTTP_METHOD_GET = 0,
+    HTTP_METHOD_POST,
+} esp_http_client_method_t;
+
+typedef struct {
+    const char* url;
+    esp_http_client_method_t method;
+    int timeout_ms;
+    bool keep_alive_enable;
+} esp_http_client_config_t;
+
+typedef struct esp_http_client* esp_http_client_handle_t;
+
+/**
+ * @brief 建立的 TCP 连接数，测试检查连接复用。
+ */
+extern int shim_http_connect_count;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t* config);
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char* key, const char* value);
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len);
+
+int esp_http_client_write(esp_http_client_handle_t client, const char* buffer, int len);
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client);
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+
+int esp_http_client_read(esp_http_client_handle_t client, char* buffer, int len);
+
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int* len);
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client);
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
@@ -0,0 +1,22 @@
+/**
+ * @brief   主机测试用的 ESP-IDF 替身：esp_log.h。
+ *          日志输出到标准输出，最后一行保存在 shim_log_last 中，测试从中读取统计值。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+extern char shim_log_last[512];
+
+void shim_log(const char* level, const char* tag, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+uint32_t esp_log_timestamp(void);
+
+#define ESP_LOGE(tag, fmt, ...)     shim_log("E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...)     shim_log("W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...)     shim_log("I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...)     do {} while (0)
@@ -0,0 +1,14 @@
+/**
+ * @brief   主机测试用的 ESP-IDF 替身：esp_rom_crc.h。
+ *          与 ROM 中的实现相同：低位在前，输入输出取反；CRC32 多项式 0xEDB88320，CRC16 多项式 0x8408（CCITT）。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdint.h>
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len);
+
+uint16_t esp_rom_crc16_le(uint16_t crc, const uint8_t* buf, uint32_t len);
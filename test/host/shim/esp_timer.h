@@ -0,0 +1,14 @@
+/**
+ * @brief   主机测试用的 ESP-IDF 替身：esp_timer.h，单调时钟，微秒。
+ *          shim_timer_offset_us 加到返回值上，测试用来跳过等待时间。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
+
+extern int64_t shim_timer_offset_us;
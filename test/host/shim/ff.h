@@ -0,0 +1,50 @@
+/**
+ * @brief   主机测试用的 FATFS 替身：ff.h，只实现分段存储用到的函数，底层是 stdio 文件。
+ *          路径直接使用主机路径，测试中分段存储的 dir 和 fat_dir 相同。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+typedef unsigned int UINT;
+typedef uint8_t BYTE;
+typedef uint32_t DWORD;
+typedef DWORD FSIZE_t;
+
+typedef enum {
+    FR_OK = 0,
+    FR_DISK_ERR,
+    FR_NO_FILE,
+    FR_INVALID_OBJECT,
+} FRESULT;
+
+typedef struct {
+    FILE* fp;
+} FIL;
+
+#define FA_READ                 0x01
+#define FA_WRITE                0x02
+#define FA_OPEN_EXISTING        0x00
+#define FA_CREATE_ALWAYS        0x08
+
+#define FF_USE_EXPAND           0
+
+FRESULT f_open(FIL* fp, const char* path, BYTE mode);
+
+FRESULT f_close(FIL* fp);
+
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br);
+
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw);
+
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs);
+
+FRESULT f_truncate(FIL* fp);
+
+FRESULT f_sync(FIL* fp);
+
+FSIZE_t f_size(FIL* fp);
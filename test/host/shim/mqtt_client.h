@@ -0,0 +1,9 @@
+/**
+ * @brief   主机测试用的 esp-mqtt 替身：mqtt_client.h，只有类型，主机测试不连接 MQTT。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#pragma once
+
+typedef struct esp_mqtt_client* esp_mqtt_client_handle_t;
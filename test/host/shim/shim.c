@@ -0,0 +1,61 @@
+/**
+ * @brief   主机测试用的 ESP-IDF 替身实现：日志、时间、ROM CRC。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+
+char shim_log_last[512];
+
+int64_t shim_timer_offset_us = 0;
+
+void shim_log(const char* level, const char* tag, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(shim_log_last, sizeof(shim_log_last), fmt, args);
+    va_end(args);
+    printf("%s (%s) %s\n", level, tag, shim_log_last);
+}
+
+int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 + shim_timer_offset_us;
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    return code == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
+
+uint32_t esp_log_timestamp(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+uint16_t esp_rom_crc16_le(uint16_t crc, const uint8_t* buf, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0x8408 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,67 @@
+/**
+ * @brief   主机测试用的 FATFS 替身实现，底层是 stdio 文件。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ff.h"
+
+FRESULT f_open(FIL* fp, const char* path, BYTE mode) {
+    const char* fmode = "rb";
+    if (mode & FA_CREATE_ALWAYS) {
+        fmode = "w+b";
+    } else if (mode & FA_WRITE) {
+        fmode = "r+b";
+    }
+    fp->fp = fopen(path, fmode);
+    return fp->fp != NULL ? FR_OK : FR_NO_FILE;
+}
+
+FRESULT f_close(FIL* fp) {
+    if (fp->fp == NULL) {
+        return FR_INVALID_OBJECT;
+    }
+    int ret = fclose(fp->fp);
+    fp->fp = NULL;
+    return ret == 0 ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br) {
+    *br = (UINT)fread(buff, 1, btr, fp->fp);
+    return ferror(fp->fp) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw) {
+    *bw = (UINT)fwrite(buff, 1, btw, fp->fp);
+    return ferror(fp->fp) ? FR_DISK_ERR : FR_OK;
+}
+
+/**
+ * @brief 与 FATFS 相同，写打开的文件 seek 到文件结尾之后会扩展文件。
+ */
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs) {
+    fflush(fp->fp);
+    if (ofs > f_size(fp) && ftruncate(fileno(fp->fp), ofs) != 0) {
+        return FR_DISK_ERR;
+    }
+    return fseek(fp->fp, ofs, SEEK_SET) == 0 ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT f_truncate(FIL* fp) {
+    fflush(fp->fp);
+    return ftruncate(fileno(fp->fp), ftell(fp->fp)) == 0 ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT f_sync(FIL* fp) {
+    return fflush(fp->fp) == 0 ? FR_OK : FR_DISK_ERR;
+}
+
+FSIZE_t f_size(FIL* fp) {
+    struct stat st;
+    fflush(fp->fp);
+    return fstat(fileno(fp->fp), &st) == 0 ? (FSIZE_t)st.st_size : 0;
+}
@@ -0,0 +1,194 @@
+/**
+ * @brief   主机测试用的 esp_http_client 替身实现，阻塞 socket，HTTP/1.1。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "esp_http_client.h"
+
+#define SHIM_HTTP_HEADERS       8
+
+struct esp_http_client {
+    char host[64];
+    char port[8];
+    char path[128];
+    int timeout_ms;
+    char headers[SHIM_HTTP_HEADERS][2][128];
+    int header_count;
+    int sock;
+    int status;
+    int64_t content_length;
+    int64_t body_left;
+};
+
+int shim_http_connect_count = 0;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t* config) {
+    esp_http_client_handle_t client = calloc(1, sizeof(struct esp_http_client));
+    if (client == NULL) {
+        return NULL;
+    }
+    client->sock = -1;
+    client->timeout_ms = config->timeout_ms;
+    strcpy(client->port, "80");
+    strcpy(client->path, "/");
+    const char* p = strstr(config->url, "://");
+    p = p != NULL ? p + 3 : config->url;
+    const char* path = strchr(p, '/');
+    const char* end = path != NULL ? path : p + strlen(p);
+    const char* colon = memchr(p, ':', end - p);
+    snprintf(client->host, sizeof(client->host), "%.*s", (int)((colon != NULL ? colon : end) - p), p);
+    if (colon != NULL) {
+        snprintf(client->port, sizeof(client->port), "%.*s", (int)(end - colon - 1), colon + 1);
+    }
+    if (path != NULL) {
+        snprintf(client->path, sizeof(client->path), "%s", path);
+    }
+    return client;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char* key, const char* value) {
+    if (client->header_count >= SHIM_HTTP_HEADERS) {
+        return ESP_FAIL;
+    }
+    snprintf(client->headers[client->header_count][0], 128, "%s", key);
+    snprintf(client->headers[client->header_count][1], 128, "%s", value);
+    client->header_count++;
+    return ESP_OK;
+}
+
+static int shim_http_send_all(int sock, const char* data, int len) {
+    int sent = 0;
+    while (sent < len) {
+        ssize_t ret = send(sock, data + sent, len - sent, MSG_NOSIGNAL);
+        if (ret <= 0) {
+            return -1;
+        }
+        sent += ret;
+    }
+    return sent;
+}
+
+static esp_err_t shim_http_connect(esp_http_client_handle_t client) {
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo* res;
+    if (getaddrinfo(client->host, client->port, &hints, &res) != 0) {
+        return ESP_FAIL;
+    }
+    client->sock = socket(res->ai_family, res->ai_socktype, 0);
+    if (client->sock < 0 || connect(client->sock, res->ai_addr, res->ai_addrlen) != 0) {
+        freeaddrinfo(res);
+        esp_http_client_close(client);
+        return ESP_FAIL;
+    }
+    freeaddrinfo(res);
+    struct timeval tv = { .tv_sec = client->timeout_ms / 1000, .tv_usec = client->timeout_ms % 1000 * 1000 };
+    setsockopt(client->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    shim_http_connect_count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len) {
+    char request[1024];
+    int len = snprintf(request, sizeof(request), "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Length: %d\r\n", client->path, client->host, write_len);
+    for (int i = 0; i < client->header_count; i++) {
+        len += snprintf(request + len, sizeof(request) - len, "%s: %s\r\n", client->headers[i][0], client->headers[i][1]);
+    }
+    len += snprintf(request + len, sizeof(request) - len, "\r\n");
+    for (int attempt = 0; attempt < 2; attempt++) {// 复用的连接可能已被服务器关闭，重新连接一次。
+        if (client->sock < 0 && shim_http_connect(client) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        if (shim_http_send_all(client->sock, request, len) == len) {
+            return ESP_OK;
+        }
+        esp_http_client_close(client);
+    }
+    return ESP_FAIL;
+}
+
+int esp_http_client_write(esp_http_client_handle_t client, const char* buffer, int len) {
+    if (client->sock < 0) {
+        return -1;
+    }
+    return shim_http_send_all(client->sock, buffer, len);
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+    char header[2048];
+    int len = 0;
+    while (len < (int)sizeof(header) - 1) {// 逐字节读取，不读到响应体。
+        if (recv(client->sock, header + len, 1, 0) != 1) {
+            return ESP_FAIL;
+        }
+        len++;
+        if (len >= 4 && memcmp(header + len - 4, "\r\n\r\n", 4) == 0) {
+            break;
+        }
+    }
+    header[len] = '\0';
+    if (sscanf(header, "HTTP/1.%*d %d", &client->status) != 1) {
+        return ESP_FAIL;
+    }
+    client->content_length = 0;
+    const char* cl = strcasestr(header, "\r\nContent-Length:");
+    if (cl != NULL) {
+        client->content_length = strtoll(cl + 17, NULL, 10);
+    }
+    client->body_left = client->content_length;
+    return client->content_length;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+    return client->status;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char* buffer, int len) {
+    if (client->body_left <= 0) {
+        return 0;
+    }
+    if (len > client->body_left) {
+        len = (int)client->body_left;
+    }
+    ssize_t ret = recv(client->sock, buffer, len, 0);
+    if (ret <= 0) {
+        return -1;
+    }
+    client->body_left -= ret;
+    return (int)ret;
+}
+
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int* len) {
+    char buffer[256];
+    int total = 0;
+    int ret;
+    while ((ret = esp_http_client_read(client, buffer, sizeof(buffer))) > 0) {
+        total += ret;
+    }
+    if (len != NULL) {
+        *len = total;
+    }
+    return ret < 0 ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+    if (client->sock >= 0) {
+        close(client->sock);
+        client->sock = -1;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    esp_http_client_close(client);
+    free(client);
+    return ESP_OK;
+}
@@ -0,0 +1,441 @@
+/**
+ * @brief   app_http 主机测试，批量上传连接本地的替身服务器（本进程中的线程）。
+ *
+ *          替身服务器与服务器端约定相同：按（kind、seq、offset）重组文件，偏移等于已保存的字节数时返回 200，
+ *          否则返回 409，响应体是已保存的偏移。可以注入故障：上传中途断开、丢失已保存的数据、总是返回 409。
+ *          检查：分片上传、同一个连接复用、断开后暂停重试、恢复后从已确认的偏移继续、
+ *          409 回退和前进、每段只允许回退一次，服务器重组的文件与 .LZS 文件一致。
+ *          最后在模拟往返延迟下输出排空时间，APP_HTTP_BULK_PART_SIZE 不同的两个可执行文件对比。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "esp_timer.h"
+#include "esp_http_client.h"
+#include "app_seg.h"
+#include "app_http.h"
+#include "app_main.h"
+#include "app_config.h"
+
+#define TEST_DIR                    "BULK"
+#define TEST_SRV_MAX_FILE           (2 * 1024 * 1024)
+#define TEST_SRV_MAX_REQUESTS       256
+
+app_main_data_t app_main_data = {
+    .dev_addr = "df:90:78:01:b0:37",
+};
+
+/**
+ * @brief app_seg.c 的 MQTT 推送路径使用，本测试不经过 MQTT。
+ */
+int app_pub_flush(app_pub_ack_cb_t ack_cb, void* arg, uint32_t timeout_ms) {
+    return 0;
+}
+
+static int test_failed = 0;
+
+#define TEST_CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            test_failed = 1; \
+        } \
+    } while (0)
+
+/**
+ * @brief 替身服务器保存的文件，按 seq 存放。
+ */
+typedef struct {
+    uint8_t* data;
+    uint32_t len;
+    uint32_t total;
+    bool last;
+} test_srv_file_t;
+
+static pthread_mutex_t test_srv_mutex = PTHREAD_MUTEX_INITIALIZER;
+static test_srv_file_t test_srv_files[APP_SEG_MAX_COUNT];
+static uint32_t test_srv_offsets[TEST_SRV_MAX_REQUESTS];    // 每个请求的块头偏移。
+static int test_srv_requests = 0;           // 收到的请求数。
+static int test_srv_409 = 0;                // 返回 409 的次数。
+static int test_srv_drop_at = -1;           // 第几个请求（从 0 开始）收到一部分请求体后断开，不保存，只生效一次。
+static int test_srv_lose_response_at = -1;  // 第几个请求保存数据之后断开，不响应，只生效一次。
+static bool test_srv_always_409 = false;    // 模拟出错的服务器。
+static int test_srv_delay_ms = 0;           // 模拟往返延迟。
+static uint8_t test_srv_body[APP_HTTP_BULK_PART_SIZE + 64];
+
+static int test_recv_all(int sock, void* buffer, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t ret = recv(sock, (uint8_t*)buffer + done, len - done, 0);
+        if (ret <= 0) {
+            return -1;
+        }
+        done += ret;
+    }
+    return 0;
+}
+
+static void test_srv_respond(int sock, int status, const char* body) {
+    char response[256];
+    int len = snprintf(response, sizeof(response), "HTTP/1.1 %d %s\r\nContent-Length: %zu\r\nConnection: keep-alive\r\n\r\n%s",
+        status, status == 200 ? "OK" : (status == 409 ? "Conflict" : "Bad Request"), strlen(body), body);
+    send(sock, response, len, MSG_NOSIGNAL);
+}
+
+/**
+ * @brief 处理一个请求。
+ * @return 连接继续使用返回 0，关闭返回 -1。
+ */
+static int test_srv_request(int sock) {
+    char header[2048];
+    int len = 0;
+    while (len < (int)sizeof(header) - 1) {
+        if (recv(sock, header + len, 1, 0) != 1) {
+            return -1;
+        }
+        len++;
+        if (len >= 4 && memcmp(header + len - 4, "\r\n\r\n", 4) == 0) {
+            break;
+        }
+    }
+    header[len] = '\0';
+    const char* cl = strcasestr(header, "\r\nContent-Length:");
+    long content_length = cl != NULL ? strtol(cl + 17, NULL, 10) : -1;
+    if (strncmp(header, "POST /bulk ", 11) != 0 || content_length < (long)sizeof(app_seg_chunk_header_t) ||
+        content_length > (long)sizeof(test_srv_body) || strcasestr(header, "\r\nX-Dev-Addr: df:90:78:01:b0:37\r\n") == NULL) {
+        printf("FAIL 替身服务器：请求格式错误\n%s", header);
+        test_failed = 1;
+        test_srv_respond(sock, 400, "");
+        return -1;
+    }
+
+    pthread_mutex_lock(&test_srv_mutex);
+    int request = test_srv_requests++;
+    bool drop = request == test_srv_drop_at;
+    bool lose_response = request == test_srv_lose_response_at;
+    if (drop) {
+        test_srv_drop_at = -1;
+    }
+    if (lose_response) {
+        test_srv_lose_response_at = -1;
+    }
+    bool always_409 = test_srv_always_409;
+    int delay_ms = test_srv_delay_ms;
+    pthread_mutex_unlock(&test_srv_mutex);
+    if (drop) {// 收到一部分后断开，不保存，不响应。
+        test_recv_all(sock, test_srv_body, 1000);
+        return -1;
+    }
+    if (test_recv_all(sock, test_srv_body, content_length) < 0) {
+        return -1;
+    }
+
+    app_seg_chunk_header_t chunk;
+    memcpy(&chunk, test_srv_body, sizeof(chunk));
+    uint32_t data_len = content_length - sizeof(chunk);
+    if (chunk.magic != 0x314B4C42 || chunk.header_len != sizeof(chunk) || chunk.seq >= APP_SEG_MAX_COUNT ||
+        chunk.offset + data_len > chunk.total || chunk.total > TEST_SRV_MAX_FILE) {
+        printf("FAIL 替身服务器：块头错误，seq：%lu，偏移：%lu\n", (unsigned long)chunk.seq, (unsigned long)chunk.offset);
+        test_failed = 1;
+        test_srv_respond(sock, 400, "");
+        return -1;
+    }
+
+    pthread_mutex_lock(&test_srv_mutex);
+    if (request < TEST_SRV_MAX_REQUESTS) {
+        test_srv_offsets[request] = chunk.offset;
+    }
+    test_srv_file_t* file = &test_srv_files[chunk.seq];
+    if (file->data == NULL) {
+        file->data = malloc(TEST_SRV_MAX_FILE);
+    }
+    int status = 200;
+    char body[16] = "";
+    if (always_409 || chunk.offset != file->len) {// 偏移不一致，返回已保存的偏移。
+        status = 409;
+        snprintf(body, sizeof(body), "%lu", (unsigned long)file->len);
+        test_srv_409++;
+    } else {
+        memcpy(file->data + file->len, test_srv_body + sizeof(chunk), data_len);
+        file->len += data_len;
+        file->total = chunk.total;
+        file->last = (chunk.flags & APP_SEG_CHUNK_LAST) != 0;
+    }
+    pthread_mutex_unlock(&test_srv_mutex);
+    if (lose_response) {// 已保存，响应丢失。
+        return -1;
+    }
+    if (delay_ms > 0) {
+        usleep(delay_ms * 1000);
+    }
+    test_srv_respond(sock, status, body);
+    return 0;
+}
+
+static void* test_srv_task(void* arg) {
+    int listen_sock = *(int*)arg;
+    while (1) {
+        int sock = accept(listen_sock, NULL, NULL);
+        if (sock < 0) {
+            continue;
+        }
+        while (test_srv_request(sock) == 0) {
+        }
+        close(sock);
+    }
+    return NULL;
+}
+
+static int test_srv_start(void) {
+    static int listen_sock;
+    listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(TEST_HTTP_PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(listen_sock, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_sock, 4) != 0) {
+        printf("FAIL 替身服务器监听端口 %d 失败\n", TEST_HTTP_PORT);
+        return -1;
+    }
+    pthread_t thread;
+    pthread_create(&thread, NULL, test_srv_task, &listen_sock);
+    pthread_detach(thread);
+    return 0;
+}
+
+/**
+ * @brief 重置替身服务器的请求记录和故障。
+ */
+static void test_srv_reset(void) {
+    pthread_mutex_lock(&test_srv_mutex);
+    test_srv_requests = 0;
+    test_srv_409 = 0;
+    test_srv_drop_at = -1;
+    test_srv_lose_response_at = -1;
+    test_srv_always_409 = false;
+    test_srv_delay_ms = 0;
+    pthread_mutex_unlock(&test_srv_mutex);
+    shim_http_connect_count = 0;
+}
+
+/**
+ * @brief 可重复的伪随机数。
+ */
+static uint32_t test_rand_state = 7;
+
+static uint8_t test_rand(void) {
+    test_rand_state = test_rand_state * 1103515245 + 12345;
+    return (uint8_t)(test_rand_state >> 16);
+}
+
+/**
+ * @brief 写入一个段，每行一半随机字母，压缩后仍有多个分片。封存并压缩。
+ * @return 段序号。
+ */
+static uint32_t test_make_seg(app_seg_store_t* store, size_t size) {
+    uint32_t seq = store->manifest.active_seq;
+    char line[256];
+    size_t written = 0;
+    while (written < size) {
+        size_t len = 0;
+        for (; len < 120; len++) {
+            line[len] = 'a' + test_rand() % 26;
+        }
+        len += snprintf(line + len, sizeof(line) - len, ",\"lat\":-33.865143,\"lon\":151.209900,\"f\":1}\n");
+        TEST_CHECK(app_seg_append(store, line, len) == (int)len);
+        written += len;
+    }
+    app_seg_fsync(store);
+    TEST_CHECK(app_seg_rotate(store) == 1);
+    TEST_CHECK(app_seg_compress(store) == 1);
+    return seq;
+}
+
+/**
+ * @brief 服务器重组的文件与 .LZS 文件一致。
+ */
+static void test_check_file(app_seg_store_t* store, uint32_t seq) {
+    char path[64];
+    app_seg_zpath(store, seq, path, sizeof(path));
+    FILE* file = fopen(path, "rb");
+    TEST_CHECK(file != NULL);
+    if (file == NULL) {
+        return;
+    }
+    uint8_t* data = malloc(TEST_SRV_MAX_FILE);
+    size_t len = fread(data, 1, TEST_SRV_MAX_FILE, file);
+    fclose(file);
+    pthread_mutex_lock(&test_srv_mutex);
+    test_srv_file_t* srv = &test_srv_files[seq];
+    bool same = srv->data != NULL && srv->len == len && srv->total == len && srv->last && memcmp(srv->data, data, len) == 0;
+    uint32_t srv_len = srv->len;
+    pthread_mutex_unlock(&test_srv_mutex);
+    if (!same) {
+        printf("FAIL 段 %lu：服务器文件与 %s 不一致，服务器：%lu 字节，本地：%zu 字节\n", (unsigned long)seq, path, (unsigned long)srv_len, len);
+        test_failed = 1;
+    }
+    free(data);
+}
+
+/**
+ * @brief 清单中段的状态。
+ */
+static app_seg_entry_t test_entry(app_seg_store_t* store, uint32_t seq) {
+    return store->manifest.entries[seq % APP_SEG_MAX_COUNT];
+}
+
+/**
+ * @brief 跳过失败后暂停重试的时间。
+ */
+static void test_skip_retry(void) {
+    shim_timer_offset_us += (int64_t)(APP_HTTP_BULK_RETRY_MS + 1000) * 1000;
+}
+
+static int64_t test_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 清除上次运行留下的文件。
+ */
+static void test_clean(void) {
+    DIR* dp = opendir(TEST_DIR);
+    if (dp == NULL) {
+        mkdir(TEST_DIR, 0700);
+        return;
+    }
+    struct dirent* entry;
+    char path[300];
+    while ((entry = readdir(dp)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            snprintf(path, sizeof(path), TEST_DIR"/%s", entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dp);
+}
+
+int main(void) {
+    test_clean();
+    if (test_srv_start() < 0) {
+        return 1;
+    }
+    static app_seg_store_t store;
+    TEST_CHECK(app_seg_open(&store, TEST_DIR, TEST_DIR, 1) == 1);
+    printf("分片：%d 字节\n", APP_HTTP_BULK_PART_SIZE);
+
+    // 1. 两个段，分片上传，复用同一个连接。
+    test_srv_reset();
+    uint32_t seq1 = test_make_seg(&store, 300 * 1024);
+    uint32_t seq2 = test_make_seg(&store, 200 * 1024);
+    int64_t uploaded = app_http_upload(&store);
+    TEST_CHECK(uploaded == test_entry(&store, seq1).zsize + test_entry(&store, seq2).zsize);
+    TEST_CHECK(test_entry(&store, seq1).zsize > APP_HTTP_BULK_PART_SIZE);
+    TEST_CHECK(shim_http_connect_count == 1);
+    TEST_CHECK(test_srv_409 == 0);
+    TEST_CHECK(test_entry(&store, seq1).state & APP_SEG_STATE_UPLOADED);
+    TEST_CHECK(test_entry(&store, seq2).state & APP_SEG_STATE_UPLOADED);
+    test_check_file(&store, seq1);
+    test_check_file(&store, seq2);
+    printf("1. 正常上传：%lld 字节，请求 %d 个，连接 %d 个\n", (long long)uploaded, test_srv_requests, shim_http_connect_count);
+
+    // 2. 第二个分片中途断开：返回失败，已确认第一个分片；暂停期间不连接；之后从第一个分片之后继续。
+    test_srv_reset();
+    uint32_t seq3 = test_make_seg(&store, 300 * 1024);
+    test_srv_drop_at = 1;
+    TEST_CHECK(app_http_upload(&store) == -1);
+    TEST_CHECK(test_entry(&store, seq3).pub_offset == APP_HTTP_BULK_PART_SIZE);
+    TEST_CHECK(!(test_entry(&store, seq3).state & APP_SEG_STATE_UPLOADED));
+    int connects = shim_http_connect_count;
+    TEST_CHECK(app_http_upload(&store) == -1);// 暂停重试。
+    TEST_CHECK(shim_http_connect_count == connects);
+    test_skip_retry();
+    test_srv_requests = 0;
+    uploaded = app_http_upload(&store);
+    TEST_CHECK(uploaded == test_entry(&store, seq3).zsize - APP_HTTP_BULK_PART_SIZE);
+    TEST_CHECK(test_srv_offsets[0] == APP_HTTP_BULK_PART_SIZE);
+    TEST_CHECK(test_srv_409 == 0);
+    test_check_file(&store, seq3);
+    printf("2. 断开后续传：从 %lu 继续，%lld 字节\n", (unsigned long)test_srv_offsets[0], (long long)uploaded);
+
+    // 3. 服务器丢失了一部分数据：409 返回较小的偏移，回退一次后完成。
+    test_srv_reset();
+    uint32_t seq4 = test_make_seg(&store, 300 * 1024);
+    test_srv_drop_at = 1;
+    TEST_CHECK(app_http_upload(&store) == -1);
+    pthread_mutex_lock(&test_srv_mutex);
+    test_srv_files[seq4].len = APP_HTTP_BULK_PART_SIZE / 2;
+    test_srv_requests = 0;
+    pthread_mutex_unlock(&test_srv_mutex);
+    test_skip_retry();
+    TEST_CHECK(app_http_upload(&store) > 0);
+    TEST_CHECK(test_srv_409 == 1);
+    TEST_CHECK(test_srv_offsets[0] == APP_HTTP_BULK_PART_SIZE);
+    TEST_CHECK(test_srv_offsets[1] == APP_HTTP_BULK_PART_SIZE / 2);
+    test_check_file(&store, seq4);
+    printf("3. 服务器回退：%lu -> %lu\n", (unsigned long)test_srv_offsets[0], (unsigned long)test_srv_offsets[1]);
+
+    // 4. 服务器已保存、响应丢失：409 返回较大的偏移，跳过已保存的数据，不重发。
+    test_srv_reset();
+    uint32_t seq5 = test_make_seg(&store, 300 * 1024);
+    test_srv_lose_response_at = 0;
+    TEST_CHECK(app_http_upload(&store) == -1);
+    TEST_CHECK(test_entry(&store, seq5).pub_offset == 0);
+    pthread_mutex_lock(&test_srv_mutex);
+    test_srv_requests = 0;
+    pthread_mutex_unlock(&test_srv_mutex);
+    test_skip_retry();
+    uploaded = app_http_upload(&store);
+    TEST_CHECK(uploaded == test_entry(&store, seq5).zsize);
+    TEST_CHECK(test_srv_409 == 1);
+    TEST_CHECK(test_srv_offsets[0] == 0);
+    TEST_CHECK(test_srv_offsets[1] == APP_HTTP_BULK_PART_SIZE);
+    test_check_file(&store, seq5);
+    printf("4. 服务器前进：0 -> %lu\n", (unsigned long)test_srv_offsets[1]);
+
+    // 5. 服务器总是返回 409：每段只回退一次，然后返回失败，不死循环。
+    test_srv_reset();
+    uint32_t seq6 = test_make_seg(&store, 100 * 1024);
+    test_srv_always_409 = true;
+    TEST_CHECK(app_http_upload(&store) == -1);
+    TEST_CHECK(test_srv_requests == 2);
+    TEST_CHECK(!(test_entry(&store, seq6).state & APP_SEG_STATE_UPLOADED));
+    test_srv_always_409 = false;
+    test_skip_retry();
+    TEST_CHECK(app_http_upload(&store) > 0);
+    test_check_file(&store, seq6);
+    printf("5. 总是 409：请求 2 个后放弃\n");
+
+    // 6. 排空时间：模拟往返延迟，与另一个分片大小的可执行文件对比。
+    test_srv_reset();
+    uint32_t seq7 = test_make_seg(&store, 400 * 1024);
+    uint32_t seq8 = test_make_seg(&store, 400 * 1024);
+    test_srv_delay_ms = TEST_HTTP_RTT_MS;
+    int64_t start_ms = test_now_ms();
+    uploaded = app_http_upload(&store);
+    int64_t elapsed_ms = test_now_ms() - start_ms;
+    TEST_CHECK(uploaded == test_entry(&store, seq7).zsize + test_entry(&store, seq8).zsize);
+    test_check_file(&store, seq7);
+    test_check_file(&store, seq8);
+    printf("6. 排空：%lld 字节，分片 %d 字节，往返 %d ms，请求 %d 个，耗时 %lld ms\n",
+        (long long)uploaded, APP_HTTP_BULK_PART_SIZE, TEST_HTTP_RTT_MS, test_srv_requests, (long long)elapsed_ms);
+
+    printf(test_failed ? "FAILED\n" : "PASSED\n");
+    return test_failed;
+}
@@ -0,0 +1,222 @@
+/**
+ * @brief   app_lz 主机测试，压缩后解压，检查内容、文件头的原始字节数和 CRC。
+ *
+ *          用例：空输入、小于和大于 8 KB 缓冲区、正好一个缓冲区、距离正好 4096 的匹配跨过窗口滑动、
+ *          不可压缩数据、长串相同字节、模拟定位 JSON（输出压缩率），以及读取错误时返回失败。
+ *          模拟定位 JSON 的原始数据和压缩数据保存在 lz/ 目录，由 tools/lz_decode.py 再解压一次。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "esp_rom_crc.h"
+#include "app_lz.h"
+
+static int test_failed = 0;
+
+#define TEST_CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            test_failed = 1; \
+        } \
+    } while (0)
+
+static uint32_t test_le32(const uint8_t* p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief 按 app_lz.h 的格式解压，返回原始字节数，失败返回 -1。
+ */
+static long test_decode(const uint8_t* data, size_t size, uint8_t* out, size_t out_size) {
+    if (size < APP_LZ_HEADER_SIZE || memcmp(data, "LZS1", 4) != 0) {
+        return -1;
+    }
+    size_t raw_size = test_le32(data + 4);
+    if (raw_size > out_size) {
+        return -1;
+    }
+    size_t pos = APP_LZ_HEADER_SIZE;
+    size_t len = 0;
+    while (len < raw_size) {
+        if (pos >= size) {
+            return -1;
+        }
+        uint8_t flags = data[pos++];
+        for (int bit = 0; bit < 8 && len < raw_size; bit++) {
+            if (flags & (1 << bit)) {
+                if (pos >= size) {
+                    return -1;
+                }
+                out[len++] = data[pos++];
+            } else {
+                if (pos + 2 > size) {
+                    return -1;
+                }
+                size_t dist = ((data[pos] << 4) | (data[pos + 1] >> 4)) + 1;
+                size_t match = (data[pos + 1] & 0x0F) + APP_LZ_MIN_MATCH;
+                pos += 2;
+                if (dist > len || len + match > raw_size) {
+                    return -1;
+                }
+                for (size_t i = 0; i < match; i++, len++) {
+                    out[len] = out[len - dist];
+                }
+            }
+        }
+    }
+    if (pos != size) {// 压缩数据不能有多余的字节。
+        return -1;
+    }
+    if (esp_rom_crc32_le(0, out, len) != test_le32(data + 8)) {
+        return -1;
+    }
+    return (long)len;
+}
+
+/**
+ * @brief 压缩 raw，再解压比较。path 不为 NULL 时保存压缩文件。
+ */
+static void test_round_trip(const char* name, const uint8_t* raw, size_t size, const char* path) {
+    FILE* in = tmpfile();
+    FILE* out = path != NULL ? fopen(path, "w+b") : tmpfile();
+    if (in == NULL || out == NULL) {
+        printf("FAIL %s: 创建文件失败\n", name);
+        test_failed = 1;
+        return;
+    }
+    fwrite(raw, 1, size, in);
+    rewind(in);
+
+    app_lz_t* lz = malloc(sizeof(app_lz_t));
+    int zsize = app_lz_compress_file(lz, in, out);
+    free(lz);
+    fflush(out);
+
+    uint8_t* data = malloc(zsize > 0 ? zsize : 1);
+    uint8_t* back = malloc(size + 1);
+    long len = -1;
+    if (zsize >= APP_LZ_HEADER_SIZE) {
+        rewind(out);
+        TEST_CHECK(fread(data, 1, zsize, out) == (size_t)zsize);
+        TEST_CHECK(fgetc(out) == EOF);// 返回值与文件长度一致。
+        TEST_CHECK(test_le32(data + 4) == size);
+        TEST_CHECK(test_le32(data + 8) == esp_rom_crc32_le(0, raw, size));
+        len = test_decode(data, zsize, back, size);
+    }
+    printf("%-16s 原始：%8zu  压缩：%8d  压缩率：%.2f\n", name, size, zsize, zsize > 0 ? (double)size / zsize : 0.0);
+    if (len != (long)size || memcmp(raw, back, size) != 0) {
+        printf("FAIL %s: 解压结果不一致，压缩：%d，解压：%ld\n", name, zsize, len);
+        test_failed = 1;
+    }
+    free(data);
+    free(back);
+    fclose(in);
+    fclose(out);
+}
+
+/**
+ * @brief 可重复的伪随机数。
+ */
+static uint32_t test_rand_state = 1;
+
+static uint8_t test_rand(void) {
+    test_rand_state = test_rand_state * 1103515245 + 12345;
+    return (uint8_t)(test_rand_state >> 16);
+}
+
+/**
+ * @brief 模拟定位记录 JSON，与 app_json.c 的格式相同，1 Hz。
+ */
+static size_t test_fix_json(uint8_t* buffer, size_t size) {
+    size_t len = 0;
+    for (int i = 0; ; i++) {
+        char line[512];
+        int sec = 9000 + i;
+        int n = snprintf(line, sizeof(line),
+            "{\"devTime\":\"20240711%02d%02d%02d%03d\",\"logTs\":%d,\"bleTs\":%d,\"gpios\":\",211,40\",\"gnssTime\":\"20240711%02d%02d%02d000\","
+            "\"gnssValid\":1,\"sat\":%d,\"alt\":%f,\"lat\":%f,\"lon\":%f,\"spd\":%f,\"trk\":%f,\"mag\":%f,\"seq\":%d,\"f\":0}\n",
+            sec / 3600, sec / 60 % 60, sec % 60, 100 + i % 7, 1720660000 + i, 1720659990 + i / 30 * 30,
+            sec / 3600, sec / 60 % 60, sec % 60,
+            9 + i / 600 % 4, 35.2 + (i % 50) * 0.1, -33.865143 + i * 0.000021, 151.209900 + i * 0.000017,
+            12.4 + (i % 13) * 0.3, 87.5 + (i % 9), 12.7, i + 1);
+        if (len + n > size) {
+            return len;
+        }
+        memcpy(buffer + len, line, n);
+        len += n;
+    }
+}
+
+/**
+ * @brief 读取错误时必须返回失败，不能生成截断的压缩数据。
+ */
+static void test_read_error(void) {
+    FILE* wo = fopen("lz/wo.bin", "wb");// 只写打开，fread() 设置错误标志。
+    FILE* out = tmpfile();
+    app_lz_t* lz = malloc(sizeof(app_lz_t));
+    TEST_CHECK(app_lz_compress_file(lz, wo, out) == -1);
+    free(lz);
+    fclose(wo);
+    fclose(out);
+}
+
+int main(void) {
+    mkdir("lz", 0700);
+
+    size_t size = 256 * 1024;
+    uint8_t* raw = malloc(size);
+
+    test_round_trip("empty", raw, 0, NULL);
+
+    memcpy(raw, "abcabcabcabc hello hello hello", 30);
+    test_round_trip("small", raw, 30, NULL);
+
+    for (size_t i = 0; i < size; i++) {
+        raw[i] = "GNSS,fix,"[i % 9] ^ (i / 1000 % 3);
+    }
+    test_round_trip("buffer-1", raw, 2 * APP_LZ_WINDOW_SIZE - 1, NULL);
+    test_round_trip("buffer", raw, 2 * APP_LZ_WINDOW_SIZE, NULL);
+    test_round_trip("buffer+1", raw, 2 * APP_LZ_WINDOW_SIZE + 1, NULL);
+    test_round_trip("over-buffer", raw, 3 * 2 * APP_LZ_WINDOW_SIZE + 123, NULL);
+
+    for (size_t i = 0; i < APP_LZ_WINDOW_SIZE; i++) {// 随机块重复，匹配距离正好是窗口大小，跨过多次滑动。
+        raw[i] = test_rand();
+    }
+    for (size_t i = APP_LZ_WINDOW_SIZE; i < 10 * APP_LZ_WINDOW_SIZE + 77; i++) {
+        raw[i] = raw[i - APP_LZ_WINDOW_SIZE];
+    }
+    test_round_trip("window-edge", raw, 10 * APP_LZ_WINDOW_SIZE + 77, NULL);
+
+    for (size_t i = 0; i < APP_LZ_WINDOW_SIZE + 100; i++) {// 距离比窗口大 1，不能匹配。
+        raw[i] = test_rand();
+    }
+    for (size_t i = APP_LZ_WINDOW_SIZE + 100; i < 6 * APP_LZ_WINDOW_SIZE; i++) {
+        raw[i] = raw[i - APP_LZ_WINDOW_SIZE - 1];
+    }
+    test_round_trip("window+1", raw, 6 * APP_LZ_WINDOW_SIZE, NULL);
+
+    for (size_t i = 0; i < 50000; i++) {
+        raw[i] = test_rand();
+    }
+    test_round_trip("random", raw, 50000, NULL);
+
+    memset(raw, 0, 50000);
+    test_round_trip("zero", raw, 50000, NULL);
+
+    size_t json_size = test_fix_json(raw, size);
+    FILE* file = fopen("lz/fix.json", "wb");
+    fwrite(raw, 1, json_size, file);
+    fclose(file);
+    test_round_trip("fix-json", raw, json_size, "lz/fix.lz");
+
+    test_read_error();
+
+    free(raw);
+    printf(test_failed ? "FAILED\n" : "PASSED\n");
+    return test_failed;
+}
@@ -0,0 +1,158 @@
+/**
+ * @brief   app_track 主机测试。
+ *
+ *          按 1 Hz 连续写入 7 天轨迹，每写完一天查询第一天和最新一天的 15 分钟，
+ *          检查记录数，并检查读取块数不随数据总量增长（块头二分查找）。
+ *          另外检查跨天查询、时间不递增的记录被丢弃、CRC 错误的记录被跳过。
+ *
+ * @author  nyx
+ * @date    2026-10-19
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "app_track.h"
+
+#define TEST_DAY0_MS                1720569600000LL     // 2024-07-10 00:00:00 UTC。
+#define TEST_DAY_MS                 86400000LL
+#define TEST_DAYS                   7
+#define TEST_WINDOW_MS              (15 * 60 * 1000LL)  // 15 分钟，1 Hz 共 901 条（闭区间）。
+
+static int test_failed = 0;
+
+#define TEST_CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            test_failed = 1; \
+        } \
+    } while (0)
+
+/**
+ * @brief 查询回调，检查时间递增。
+ */
+static int test_query_cb(const app_track_record_t* record, void* arg) {
+    int64_t* last = arg;
+    if (record->ts_ms <= *last) {
+        printf("FAIL 查询结果时间不递增：%lld\n", (long long)record->ts_ms);
+        test_failed = 1;
+    }
+    *last = record->ts_ms;
+    return 0;
+}
+
+/**
+ * @brief 查询并从日志中取出读取块数和耗时。
+ */
+static int test_query(int64_t from_ms, int64_t to_ms, int* blocks, long long* us) {
+    int64_t last = from_ms - 1;
+    int count = app_track_query(from_ms, to_ms, test_query_cb, &last);
+    int log_count = -1;
+    *blocks = -1;
+    *us = -1;
+    sscanf(shim_log_last, "------ 轨迹查询：完成。记录数：%d，读取块数：%d，耗时：%lld us", &log_count, blocks, us);
+    TEST_CHECK(log_count == count);
+    return count;
+}
+
+static void test_record(int64_t ts_ms, app_track_record_t* record) {
+    memset(record, 0, sizeof(*record));
+    record->ts_ms = ts_ms;
+    record->lat_e7 = -337000000 + (int32_t)((ts_ms / 1000) % 100000);
+    record->lon_e7 = 1511000000;
+    record->sat = 12;
+    record->flags = APP_TRACK_FLAG_VALID;
+}
+
+/**
+ * @brief 清除上次运行留下的文件。
+ */
+static void test_clean(void) {
+    DIR* dp = opendir("TRACK");
+    if (dp == NULL) {
+        return;
+    }
+    struct dirent* entry;
+    char path[300];
+    while ((entry = readdir(dp)) != NULL) {
+        if (strstr(entry->d_name, ".TRK") != NULL) {
+            snprintf(path, sizeof(path), "TRACK/%s", entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dp);
+}
+
+int main(void) {
+    test_clean();
+    TEST_CHECK(app_track_init() == ESP_OK);
+
+    app_track_record_t record;
+    int first_blocks = -1;
+    printf("天数  第一天记录  块数  耗时(us)  最新一天记录  块数  耗时(us)\n");
+    for (int day = 0; day < TEST_DAYS; day++) {
+        for (int64_t s = 0; s < 86400; s++) {
+            test_record(TEST_DAY0_MS + day * TEST_DAY_MS + s * 1000, &record);
+            if (app_track_append(&record) != 1) {
+                printf("FAIL 写入失败：%d %lld\n", day, (long long)s);
+                return 1;
+            }
+        }
+        int blocks0, blocks1;
+        long long us0, us1;
+        int64_t from0 = TEST_DAY0_MS + 12 * 3600000LL;
+        int64_t from1 = from0 + day * TEST_DAY_MS;
+        int count0 = test_query(from0, from0 + TEST_WINDOW_MS, &blocks0, &us0);
+        int count1 = test_query(from1, from1 + TEST_WINDOW_MS, &blocks1, &us1);
+        printf("%4d  %10d  %4d  %8lld  %12d  %4d  %8lld\n", day + 1, count0, blocks0, us0, count1, blocks1, us1);
+        TEST_CHECK(count0 == 901);
+        TEST_CHECK(count1 == 901);
+        if (first_blocks < 0) {
+            first_blocks = blocks0;
+        }
+        TEST_CHECK(blocks0 > 0 && blocks0 <= first_blocks + 1);// 读取块数与数据总量无关。
+        TEST_CHECK(blocks1 > 0 && blocks1 <= first_blocks + 1);
+    }
+
+    // 跨天查询。
+    int blocks;
+    long long us;
+    int64_t midnight = TEST_DAY0_MS + 3 * TEST_DAY_MS;
+    TEST_CHECK(test_query(midnight - TEST_WINDOW_MS / 2, midnight + TEST_WINDOW_MS / 2, &blocks, &us) == 901);
+
+    // 时间不递增的记录被丢弃。
+    test_record(TEST_DAY0_MS + (TEST_DAYS - 1) * TEST_DAY_MS + 86399000, &record);
+    TEST_CHECK(app_track_append(&record) == 0);
+
+    // 改写第二天的一条记录并重新计算块 CRC，只留下记录 CRC 错误，查询跳过这一条。
+    app_track_flush();
+    FILE* file = fopen("TRACK/20240711.TRK", "r+b");
+    TEST_CHECK(file != NULL);
+    if (file != NULL) {
+        uint8_t block[APP_TRACK_BLOCK_SIZE];
+        int64_t target = TEST_DAY0_MS + TEST_DAY_MS + 12 * 3600000LL + 60000;
+        for (long offset = 0; fread(block, 1, sizeof(block), file) == sizeof(block); offset += sizeof(block)) {
+            app_track_block_header_t* header = (app_track_block_header_t*)block;
+            if (target < header->first_ts_ms || target > header->last_ts_ms) {
+                continue;
+            }
+            app_track_record_t* records = (app_track_record_t*)(block + sizeof(*header));
+            records[(target - header->first_ts_ms) / 1000].lat_e7 ^= 1;
+            uint32_t crc = esp_rom_crc32_le(0, block, offsetof(app_track_block_header_t, crc));
+            header->crc = esp_rom_crc32_le(crc, block + sizeof(*header), header->count * sizeof(app_track_record_t));
+            fseek(file, offset, SEEK_SET);
+            fwrite(block, 1, sizeof(block), file);
+            break;
+        }
+        fclose(file);
+    }
+    int64_t from = TEST_DAY0_MS + TEST_DAY_MS + 12 * 3600000LL;
+    TEST_CHECK(test_query(from, from + TEST_WINDOW_MS, &blocks, &us) == 900);
+
+    printf(test_failed ? "FAILED\n" : "PASSED\n");
+    return test_failed;
+}
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+"""
+WebSocket 实时数据压力测试，帧格式见 main/app_live.h。
+
+连接设备热点后运行，只使用 Python 标准库：
+    python3 tools/live_load.py --clients 7 --slow 1 --seconds 600    # 共 8 个，APP_LIVE_CLIENT_MAX
+
+--clients 个客户端正常读取，检查每帧 28 字节、版本、序号，统计：
+    帧数      收到的帧数。
+    缺失      序号不连续缺少的帧数。
+    设备丢弃  帧中记录的设备端丢弃帧数（偏移 3），应该等于缺失。
+    延迟      同一序号第一个客户端收到到本客户端收到的时间（毫秒，平均 / 最大），衡量扇出延迟。
+    时钟差    收到时间减去帧中的 UTC 时间（秒），电脑时钟需要同步，包括 GNSS 输出延迟。
+--slow 个客户端握手后不读取，模拟慢客户端，结束时检查是否已被设备关闭。
+    设备在发送缓冲区满之后才会关闭慢客户端，1 Hz 时需要几分钟，--seconds 要足够长。
+帧格式错误、缺失不等于设备丢弃、正常客户端被关闭时退出码为 1。
+"""
+import argparse
+import base64
+import os
+import socket
+import struct
+import sys
+import threading
+import time
+
+FRAME_LEN = 28
+FRAME_VERSION = 1
+FRAME_STRUCT = struct.Struct("<BBBBIIiiiHH")
+
+
+def ws_connect(host, port, path, timeout):
+    """WebSocket 握手，返回 socket 和握手后已经读到的数据。"""
+    sock = socket.create_connection((host, port), timeout=timeout)
+    key = base64.b64encode(os.urandom(16)).decode()
+    request = (f"GET {path} HTTP/1.1\r\nHost: {host}:{port}\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+               f"Sec-WebSocket-Key: {key}\r\nSec-WebSocket-Version: 13\r\n\r\n")
+    sock.sendall(request.encode())
+    data = b""
+    while b"\r\n\r\n" not in data:
+        chunk = sock.recv(1024)
+        if not chunk:
+            raise ConnectionError("握手时连接关闭，客户端可能已满")
+        data += chunk
+    header, rest = data.split(b"\r\n\r\n", 1)
+    if not header.startswith(b"HTTP/1.1 101"):
+        raise ConnectionError(header.split(b"\r\n", 1)[0].decode(errors="replace"))
+    return sock, rest
+
+
+class Client(threading.Thread):
+    def __init__(self, index, args, first_arrival, lock):
+        super().__init__(daemon=True)
+        self.index = index
+        self.args = args
+        self.first_arrival = first_arrival
+        self.lock = lock
+        self.frames = 0
+        self.missing = 0
+        self.device_dropped = 0
+        self.errors = []
+        self.closed = False
+        self.delays = []
+        self.clock_diffs = []
+        self.last_seq = None
+
+    def recv_frames(self, sock, buffer):
+        """解析服务器发送的帧（不加掩码），返回 (opcode, payload) 列表和剩余数据。"""
+        frames = []
+        while len(buffer) >= 2:
+            opcode = buffer[0] & 0x0f
+            length = buffer[1] & 0x7f
+            offset = 2
+            if length == 126:
+                if len(buffer) < 4:
+                    break
+                length = struct.unpack(">H", buffer[2:4])[0]
+                offset = 4
+            elif length == 127:
+                if len(buffer) < 10:
+                    break
+                length = struct.unpack(">Q", buffer[2:10])[0]
+                offset = 10
+            if len(buffer) < offset + length:
+                break
+            frames.append((opcode, buffer[offset:offset + length]))
+            buffer = buffer[offset + length:]
+        return frames, buffer
+
+    def check_frame(self, payload, now):
+        if len(payload) != FRAME_LEN:
+            self.errors.append(f"帧长度 {len(payload)}")
+            return
+        version, flags, sat, dropped, seq, utc, lat, lon, alt, spd, trk = FRAME_STRUCT.unpack(payload)
+        if version != FRAME_VERSION:
+            self.errors.append(f"版本 {version}")
+            return
+        self.frames += 1
+        self.device_dropped += dropped
+        if self.last_seq is not None:
+            gap = (seq - self.last_seq - 1) & 0xffffffff
+            if gap > 0x7fffffff:
+                self.errors.append(f"序号倒退 {self.last_seq} -> {seq}")
+            else:
+                self.missing += gap
+        self.last_seq = seq
+        with self.lock:
+            first = self.first_arrival.setdefault(seq, now)
+        self.delays.append((now - first) * 1000)
+        if flags & 1 and utc > 0:
+            self.clock_diffs.append(time.time() - utc)
+
+    def run(self):
+        try:
+            sock, buffer = ws_connect(self.args.host, self.args.port, self.args.path, 5)
+        except (OSError, ConnectionError) as e:
+            self.errors.append(f"连接失败：{e}")
+            self.closed = True
+            return
+        sock.settimeout(1)
+        deadline = time.monotonic() + self.args.seconds
+        while time.monotonic() < deadline:
+            try:
+                data = sock.recv(4096)
+            except socket.timeout:
+                continue
+            except OSError:
+                data = b""
+            if not data:
+                self.closed = True
+                break
+            now = time.monotonic()
+            frames, buffer = self.recv_frames(sock, buffer + data)
+            for opcode, payload in frames:
+                if opcode == 0x8:
+                    self.closed = True
+                elif opcode == 0x2:
+                    self.check_frame(payload, now)
+                elif opcode != 0x9 and opcode != 0xa:
+                    self.errors.append(f"帧类型 {opcode}")
+            if self.closed:
+                break
+        sock.close()
+
+
+def slow_client(args):
+    """握手后不读取，返回 socket，结束时检查是否已被关闭。"""
+    sock, _ = ws_connect(args.host, args.port, args.path, 5)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1024)
+    return sock
+
+
+def slow_closed(sock):
+    """读出缓冲区中的数据，遇到 FIN 或者 RST 说明设备已关闭连接。"""
+    sock.settimeout(2)
+    try:
+        while True:
+            data = sock.recv(65536)
+            if not data:
+                return True
+    except socket.timeout:
+        return False
+    except OSError:
+        return True
+    finally:
+        sock.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="WebSocket 实时数据压力测试")
+    parser.add_argument("--host", default="192.168.4.1")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--path", default="/live")
+    parser.add_argument("--clients", type=int, default=7, help="正常读取的客户端数")
+    parser.add_argument("--slow", type=int, default=1, help="不读取的慢客户端数")
+    parser.add_argument("--seconds", type=float, default=60)
+    args = parser.parse_args()
+
+    slow = []
+    for _ in range(args.slow):
+        try:
+            slow.append(slow_client(args))
+        except (OSError, ConnectionError) as e:
+            print(f"慢客户端连接失败：{e}")
+    first_arrival = {}
+    lock = threading.Lock()
+    clients = [Client(i, args, first_arrival, lock) for i in range(args.clients)]
+    for client in clients:
+        client.start()
+    for client in clients:
+        client.join()
+
+    failed = False
+    print(f"{'客户端':<6}{'帧数':>8}{'缺失':>8}{'设备丢弃':>10}{'延迟平均':>10}{'延迟最大':>10}{'时钟差':>8}  错误")
+    for client in clients:
+        delays = client.delays or [0]
+        clock = f"{sum(client.clock_diffs) / len(client.clock_diffs):.1f}" if client.clock_diffs else "-"
+        errors = "；".join(client.errors[:3]) + (f" 等 {len(client.errors)} 个" if len(client.errors) > 3 else "")
+        if client.closed:
+            errors = ("被关闭；" + errors) if errors else "被关闭"
+        print(f"{client.index:<6}{client.frames:>8}{client.missing:>8}{client.device_dropped:>10}"
+              f"{sum(delays) / len(delays):>10.1f}{max(delays):>10.1f}{clock:>8}  {errors}")
+        if client.errors or client.closed or client.missing != client.device_dropped or client.frames == 0:
+            failed = True
+    for i, sock in enumerate(slow):
+        closed = slow_closed(sock)
+        print(f"慢客户端 {i}：{'已被设备关闭' if closed else '仍然连接'}")
+    print("失败" if failed else "通过")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,64 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+"""
+@brief   LZSS 压缩段的参考解压程序，格式见 main/app_lz.h，服务器端按此实现解压。
+
+         检查魔数、原始字节数和 CRC32（与 esp_rom_crc32_le 初值 0 的结果相同，即 zlib.crc32）。
+
+用法：python lz_decode.py <压缩文件> <输出文件>
+
+@author  nyx
+@date    2026-10-19
+"""
+import struct
+import sys
+import zlib
+
+MAGIC = b'LZS1'
+HEADER_SIZE = 12
+MIN_MATCH = 3
+
+
+def decode(data):
+    if len(data) < HEADER_SIZE or data[:4] != MAGIC:
+        raise ValueError('魔数错误')
+    raw_size, crc = struct.unpack_from('<II', data, 4)
+    out = bytearray()
+    pos = HEADER_SIZE
+    while len(out) < raw_size:
+        if pos >= len(data):
+            raise ValueError('数据不完整：%d / %d' % (len(out), raw_size))
+        flags = data[pos]
+        pos += 1
+        for bit in range(8):
+            if len(out) >= raw_size:
+                break
+            if flags & (1 << bit):
+                out.append(data[pos])
+                pos += 1
+            else:
+                dist = ((data[pos] << 4) | (data[pos + 1] >> 4)) + 1
+                length = (data[pos + 1] & 0x0F) + MIN_MATCH
+                pos += 2
+                if dist > len(out):
+                    raise ValueError('距离超出已解压数据：%d' % dist)
+                for _ in range(length):# 距离可能小于长度，逐字节复制。
+                    out.append(out[-dist])
+    if len(out) != raw_size:
+        raise ValueError('原始字节数错误：%d / %d' % (len(out), raw_size))
+    if zlib.crc32(bytes(out)) & 0xFFFFFFFF != crc:
+        raise ValueError('CRC 错误')
+    return bytes(out)
+
+
+def main():
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+    out = decode(data)
+    with open(sys.argv[2], 'wb') as f:
+        f.write(out)
+    print('%s: %d -> %d' % (sys.argv[1], len(data), len(out)))
+
+
+if __name__ == '__main__':
+    main()
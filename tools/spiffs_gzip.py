@@ -0,0 +1,65 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+"""
+@brief   构建时压缩 spiffs 目录中的网页文件，生成 SPIFFS 分区镜像的输入目录。
+
+         文本文件（html、js、css、ico 等）压缩为 .gz，只保存压缩后的文件；已经压缩的图片原样复制。
+         生成 /.etags 清单，每行：<原路径> <ETag> <是否压缩>，由 app_web.c 启动时读取。
+         gzip 的 mtime 固定为 0，内容不变时输出不变，ETag 也不变。
+
+用法：python spiffs_gzip.py <源目录> <输出目录>
+
+@author  nyx
+@date    2026-10-19
+"""
+import gzip
+import hashlib
+import os
+import shutil
+import sys
+
+# 已经压缩的格式，不再压缩。
+STORED_EXTS = ('.jpg', '.jpeg', '.png', '.gif', '.gz')
+
+# SPIFFS 文件名最大长度，见 CONFIG_SPIFFS_OBJ_NAME_LEN，包括结尾的 0。
+OBJ_NAME_LEN = 32
+
+
+def main():
+    src_dir, out_dir = sys.argv[1], sys.argv[2]
+    if os.path.isdir(out_dir):
+        shutil.rmtree(out_dir)
+    os.makedirs(out_dir)
+
+    lines = []
+    for root, dirs, files in os.walk(src_dir):
+        dirs.sort()
+        for name in sorted(files):
+            if name.startswith('.'):
+                continue
+            src = os.path.join(root, name)
+            path = '/' + os.path.relpath(src, src_dir).replace(os.sep, '/')
+            with open(src, 'rb') as f:
+                data = f.read()
+            etag = hashlib.sha256(data).hexdigest()[:16]
+            stored = name.lower().endswith(STORED_EXTS)
+            out_path = path if stored else path + '.gz'
+            if len(out_path) >= OBJ_NAME_LEN:
+                sys.exit('文件名太长：%s' % out_path)
+
+            dst = os.path.join(out_dir, out_path[1:])
+            os.makedirs(os.path.dirname(dst), exist_ok=True)
+            with open(dst, 'wb') as f:
+                if stored:
+                    f.write(data)
+                else:
+                    with gzip.GzipFile(filename='', mode='wb', fileobj=f, compresslevel=9, mtime=0) as gz:
+                        gz.write(data)
+            lines.append('%s %s %d\n' % (path, etag, 0 if stored else 1))
+
+    with open(os.path.join(out_dir, '.etags'), 'w') as f:
+        f.writelines(lines)
+
+
+if __name__ == '__main__':
+    main()